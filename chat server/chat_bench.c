@@ -0,0 +1,463 @@
+// 채팅 서버 부하 생성기 + 지연 시간 측정기
+// 클라이언트 N 개를 한 프로세스에서 epoll 로 돌리면서 닉네임 설정, /add, /join 후
+// 정해진 속도로 메시지를 보내고, 방 멤버들에게 퍼져 나간 메시지의 지연 시간을 잰다
+// 보낼 때 메시지 안에 보낸 시각을 넣어 두고, 받은 쪽에서 지금 시각과 뺀다 (같은 호스트에서만 의미 있음)
+//
+// 빌드 : gcc -O2 -o chat_bench chat_bench.c frame.c
+// 실행 : ./chat_bench [-h 주소] [-p 포트] [-c 클라이언트 수] [-r 방 수] [-P 발행자 수]
+//                     [-R 발행자당 초당 메시지] [-d 측정 초] [-w 마무리 대기 초] [-s 메시지 크기]
+//                     [-m frame|raw]
+//        -m raw 는 길이 머리말 없이 그대로 쓰는 예전 프로토콜 (fork_server.c)
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "frame.h"
+
+// --- 매크로 정의 ---
+#define BENCH_OUTBUF    (64 * 1024)  // 클라이언트별 보내기 버퍼 (서버가 못 받으면 여기 쌓인다)
+#define BENCH_TICK_MS   1            // 발행 주기 검사 간격
+#define BENCH_MARK      "@@"         // 메시지 안의 측정 정보 표시 : @@발행자:번호:보낸시각@@
+#define BENCH_RAW_TAIL  64           // raw 모드에서 read() 경계에 걸친 표시를 잇기 위해 남기는 바이트
+#define HIST_SUB        32           // 2의 거듭제곱 구간 하나를 나누는 칸 수 (오차 약 3%)
+#define HIST_BUCKETS    (64 + 26 * HIST_SUB)
+
+enum { PROTO_FRAME, PROTO_RAW };
+
+// --- 구조체 정의 ---
+typedef struct {
+    int fd;
+    int room;
+    bool publisher;
+    uint32_t seq;                // 다음에 보낼 메시지 번호
+    char out[BENCH_OUTBUF];      // 아직 못 보낸 바이트
+    size_t out_len;
+    frame_buf_t in;              // frame 모드 재조립 버퍼
+    char raw[BENCH_RAW_TAIL + FRAME_MAX]; // raw 모드 읽기 버퍼
+    size_t raw_len;
+    bool closed;
+} bench_client_t;
+
+// 마이크로초 단위 로그-선형 히스토그램 (정렬 없이 백분위를 구한다)
+typedef struct {
+    uint64_t count[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t max;
+} hist_t;
+
+typedef struct {
+    const char *host;
+    int port;
+    int clients;
+    int rooms;
+    int publishers;
+    double rate;                 // 발행자당 초당 메시지
+    double duration;
+    double drain;
+    int size;
+    int proto;
+} bench_opt_t;
+
+// --- 전역 변수 ---
+static bench_opt_t opt = {
+    .host = "127.0.0.1", .port = 5100, .clients = 10, .rooms = 1, .publishers = -1,
+    .rate = 10, .duration = 10, .drain = 2, .size = 64, .proto = PROTO_FRAME,
+};
+static bench_client_t *clients;
+static int *room_members;        // 방 번호 -> 멤버 수 (발행 하나당 기대 전달 수)
+static hist_t hist;
+static uint64_t published, expected, delivered, send_skipped, disconnects;
+static volatile sig_atomic_t stop_flag = 0;
+
+// --- 시간 ---
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// --- 히스토그램 ---
+static int hist_index(uint64_t v)
+{
+    if (v < 64) return (int)v;
+    int e = 63 - __builtin_clzll(v);            // 가장 높은 1 비트 위치 (6 이상)
+    if (e > 31) return HIST_BUCKETS - 1;
+    int mant = (int)((v >> (e - 5)) & (HIST_SUB - 1));
+    return 64 + (e - 6) * HIST_SUB + mant;
+}
+
+static uint64_t hist_value(int idx)
+{
+    if (idx < 64) return idx;
+    int e = (idx - 64) / HIST_SUB + 6;
+    int mant = (idx - 64) % HIST_SUB;
+    return (uint64_t)(HIST_SUB + mant) << (e - 5);
+}
+
+static void hist_add(hist_t *h, uint64_t v)
+{
+    h->count[hist_index(v)]++;
+    h->total++;
+    if (v > h->max) h->max = v;
+}
+
+static uint64_t hist_percentile(const hist_t *h, double p)
+{
+    if (h->total == 0) return 0;
+    uint64_t want = (uint64_t)(p * h->total);
+    if (want >= h->total) want = h->total - 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->count[i];
+        if (seen > want) return hist_value(i);
+    }
+    return h->max;
+}
+
+// --- 보내기 ---
+// 보내기 버퍼를 소켓으로 밀어낸다. 연결이 끊겼으면 -1
+static int client_flush(bench_client_t *c)
+{
+    size_t off = 0;
+    while (off < c->out_len) {
+        ssize_t n = send(c->fd, c->out + off, c->out_len - off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return -1;
+        }
+        off += n;
+    }
+    memmove(c->out, c->out + off, c->out_len - off);
+    c->out_len -= off;
+    return 0;
+}
+
+// 메시지 하나를 보내기 버퍼에 넣는다. 버퍼가 가득 차면 false (서버가 못 따라오는 중)
+static bool client_queue(bench_client_t *c, const char *payload, size_t len)
+{
+    size_t need = (opt.proto == PROTO_FRAME) ? FRAME_HDR + len : len;
+    if (c->out_len + need > sizeof(c->out)) return false;
+    if (opt.proto == PROTO_FRAME) {
+        c->out_len += frame_encode(c->out + c->out_len, sizeof(c->out) - c->out_len, payload, len);
+    } else {
+        memcpy(c->out + c->out_len, payload, len);
+        c->out_len += len;
+    }
+    return true;
+}
+
+static void client_send_text(bench_client_t *c, const char *text)
+{
+    if (!client_queue(c, text, strlen(text)) || client_flush(c) == -1) {
+        fprintf(stderr, "setup send failed on fd %d\n", c->fd);
+    }
+}
+
+// 측정용 메시지 하나 발행
+static void client_publish(int id)
+{
+    bench_client_t *c = &clients[id];
+    char payload[FRAME_MAX];
+    int n = snprintf(payload, sizeof(payload), BENCH_MARK "%d:%u:%llu" BENCH_MARK,
+                     id, c->seq, (unsigned long long)now_ns());
+    // 나머지는 크기를 맞추기 위한 채움 문자
+    while (n < opt.size && n < (int)sizeof(payload)) payload[n++] = 'x';
+
+    if (!client_queue(c, payload, n)) {
+        send_skipped++;
+        return;
+    }
+    c->seq++;
+    published++;
+    expected += room_members[c->room];
+}
+
+// --- 받기 ---
+// 메시지 안의 측정 표시를 찾아 지연 시간을 기록한다
+static void record_marks(const char *p, size_t len)
+{
+    const char *end = p + len;
+    while (p < end) {
+        const char *m = memmem(p, end - p, BENCH_MARK, 2);
+        if (m == NULL) return;
+        const char *close = memmem(m + 2, end - (m + 2), BENCH_MARK, 2);
+        if (close == NULL) return;
+
+        int id;
+        unsigned seq;
+        unsigned long long sent;
+        char tmp[64];
+        size_t tl = close - (m + 2);
+        if (tl < sizeof(tmp)) {
+            memcpy(tmp, m + 2, tl);
+            tmp[tl] = '\0';
+            if (sscanf(tmp, "%d:%u:%llu", &id, &seq, &sent) == 3) {
+                uint64_t now = now_ns();
+                hist_add(&hist, now > sent ? (now - sent) / 1000 : 0);
+                delivered++;
+            }
+        }
+        p = close + 2;
+    }
+}
+
+static int client_read(bench_client_t *c)
+{
+    while (1) {
+        ssize_t n;
+        if (opt.proto == PROTO_FRAME) {
+            n = frame_read(&c->in, c->fd);
+            if (n > 0) {
+                frame_view_t f;
+                int rc;
+                while ((rc = frame_next(&c->in, &f)) == 1) record_marks(f.data, f.len);
+                if (rc < 0) return -1;
+                continue;
+            }
+        } else {
+            n = read(c->fd, c->raw + c->raw_len, sizeof(c->raw) - c->raw_len);
+            if (n > 0) {
+                c->raw_len += n;
+                // 마지막 표시 뒤에 남은 조각은 다음 read() 와 이어 붙인다
+                const char *last = c->raw;
+                const char *p;
+                while ((p = memmem(last, c->raw + c->raw_len - last, BENCH_MARK, 2)) != NULL) {
+                    const char *q = memmem(p + 2, c->raw + c->raw_len - (p + 2), BENCH_MARK, 2);
+                    if (q == NULL) break;
+                    record_marks(p, q + 2 - p);
+                    last = q + 2;
+                }
+                size_t keep = c->raw + c->raw_len - last;
+                if (keep > BENCH_RAW_TAIL) keep = BENCH_RAW_TAIL;
+                memmove(c->raw, c->raw + c->raw_len - keep, keep);
+                c->raw_len = keep;
+                continue;
+            }
+        }
+        if (n == 0) return -1;
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+        return -1;
+    }
+}
+
+// --- 준비 ---
+static int client_connect(bench_client_t *c)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(opt.port);
+    if (inet_pton(AF_INET, opt.host, &addr.sin_addr) != 1) {
+        fprintf(stderr, "bad address %s\n", opt.host);
+        return -1;
+    }
+
+    c->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (c->fd < 0) {
+        perror("socket()");
+        return -1;
+    }
+    if (connect(c->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("connect()");
+        close(c->fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(c->fd, F_SETFL, fcntl(c->fd, F_GETFL) | O_NONBLOCK);
+    if (opt.proto == PROTO_FRAME && frame_buf_init(&c->in, 0) == -1) return -1;
+    return 0;
+}
+
+// 서버가 명령을 처리할 시간을 준다 (fork 서버는 자식이 10ms 마다 깨어난다)
+static void settle(int ms)
+{
+    usleep(ms * 1000);
+    for (int i = 0; i < opt.clients; i++) {
+        if (!clients[i].closed) client_read(&clients[i]);
+    }
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "usage : %s [-h host] [-p port] [-c clients] [-r rooms] [-P publishers]\n"
+        "          [-R msgs/sec per publisher] [-d seconds] [-w drain seconds] [-s bytes] [-m frame|raw]\n",
+        prog);
+}
+
+static void handle_stop(int signo)
+{
+    stop_flag = 1;
+}
+
+int main(int argc, char **argv)
+{
+    int ch;
+    while ((ch = getopt(argc, argv, "h:p:c:r:P:R:d:w:s:m:")) != -1) {
+        switch (ch) {
+        case 'h': opt.host = optarg; break;
+        case 'p': opt.port = atoi(optarg); break;
+        case 'c': opt.clients = atoi(optarg); break;
+        case 'r': opt.rooms = atoi(optarg); break;
+        case 'P': opt.publishers = atoi(optarg); break;
+        case 'R': opt.rate = atof(optarg); break;
+        case 'd': opt.duration = atof(optarg); break;
+        case 'w': opt.drain = atof(optarg); break;
+        case 's': opt.size = atoi(optarg); break;
+        case 'm':
+            if (strcmp(optarg, "raw") == 0) opt.proto = PROTO_RAW;
+            else if (strcmp(optarg, "frame") == 0) opt.proto = PROTO_FRAME;
+            else { usage(argv[0]); return 1; }
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (opt.clients < 1 || opt.rooms < 1 || opt.rate <= 0 || opt.duration <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (opt.rooms > opt.clients) opt.rooms = opt.clients;
+    if (opt.publishers < 0 || opt.publishers > opt.clients) opt.publishers = opt.clients;
+    if (opt.size >= FRAME_MAX) opt.size = FRAME_MAX - 1;
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, handle_stop);
+
+    clients = calloc(opt.clients, sizeof(bench_client_t));
+    room_members = calloc(opt.rooms, sizeof(int));
+    if (clients == NULL || room_members == NULL) {
+        perror("calloc()");
+        return 1;
+    }
+
+    // 1. 접속 + 닉네임
+    for (int i = 0; i < opt.clients; i++) {
+        bench_client_t *c = &clients[i];
+        char text[64];
+        if (client_connect(c) == -1) return 1;
+        c->room = i % opt.rooms;
+        c->publisher = i < opt.publishers;
+        room_members[c->room]++;
+        snprintf(text, sizeof(text), "bench%d", i);
+        client_send_text(c, text);
+    }
+    settle(200);
+
+    // 2. 방마다 첫 클라이언트가 /add, 모두 /join
+    for (int r = 0; r < opt.rooms; r++) {
+        char text[64];
+        snprintf(text, sizeof(text), "/add benchroom%d", r);
+        client_send_text(&clients[r], text);
+    }
+    settle(200);
+    for (int i = 0; i < opt.clients; i++) {
+        char text[64];
+        snprintf(text, sizeof(text), "/join benchroom%d", clients[i].room);
+        client_send_text(&clients[i], text);
+    }
+    settle(500);
+
+    int epfd = epoll_create1(0);
+    for (int i = 0; i < opt.clients; i++) {
+        struct epoll_event ev = { .events = EPOLLIN, .data.u32 = i };
+        epoll_ctl(epfd, EPOLL_CTL_ADD, clients[i].fd, &ev);
+    }
+
+    // 3. 측정 : 발행자마다 보낼 개수를 경과 시간으로 계산해서 모자란 만큼 보낸다
+    struct epoll_event events[256];
+    uint64_t start = now_ns();
+    uint64_t pub_end = start + (uint64_t)(opt.duration * 1e9);
+    uint64_t end = pub_end + (uint64_t)(opt.drain * 1e9);
+    // 발행자들이 한꺼번에 몰리지 않도록 시작을 조금씩 어긋낸다
+    double spread = 1.0 / opt.rate / (opt.publishers ? opt.publishers : 1);
+
+    while (!stop_flag) {
+        uint64_t now = now_ns();
+        if (now >= end) break;
+        if (now < pub_end) {
+            double elapsed = (now - start) / 1e9;
+            for (int i = 0; i < opt.publishers; i++) {
+                bench_client_t *c = &clients[i];
+                if (c->closed) continue;
+                double t = elapsed - i * spread;
+                uint32_t due = t > 0 ? (uint32_t)(t * opt.rate) + 1 : 0;
+                while (c->seq < due) {
+                    uint32_t before = c->seq;
+                    client_publish(i);
+                    if (c->seq == before) {
+                        // 보내기 버퍼가 가득 찼으면 이번 몫은 건너뛴 것으로 센다
+                        send_skipped += due - c->seq - 1;
+                        c->seq = due;
+                    }
+                }
+            }
+        }
+        for (int i = 0; i < opt.clients; i++) {
+            bench_client_t *c = &clients[i];
+            if (!c->closed && c->out_len && client_flush(c) == -1) {
+                c->closed = true;
+                disconnects++;
+            }
+        }
+
+        int n = epoll_wait(epfd, events, 256, BENCH_TICK_MS);
+        for (int k = 0; k < n; k++) {
+            bench_client_t *c = &clients[events[k].data.u32];
+            if (c->closed) continue;
+            if (client_read(c) == -1) {
+                c->closed = true;
+                disconnects++;
+                epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+            }
+        }
+    }
+    double secs = (now_ns() - start) / 1e9;
+    double pub_secs = opt.duration < secs ? opt.duration : secs;
+
+    // 4. 결과
+    uint64_t dropped = expected > delivered ? expected - delivered : 0;
+    printf("clients %d, rooms %d, publishers %d, rate %.1f/s each, payload %d B, %s protocol\n",
+           opt.clients, opt.rooms, opt.publishers, opt.rate, opt.size,
+           opt.proto == PROTO_FRAME ? "frame" : "raw");
+    printf("published   %10llu  (%.1f msgs/s)\n", (unsigned long long)published, published / pub_secs);
+    printf("expected    %10llu  (fan-out to every room member)\n", (unsigned long long)expected);
+    printf("delivered   %10llu  (%.1f msgs/s)\n", (unsigned long long)delivered, delivered / secs);
+    printf("dropped     %10llu  (%.3f%%)\n", (unsigned long long)dropped,
+           expected ? 100.0 * dropped / expected : 0.0);
+    printf("skipped     %10llu  (client send buffer full)\n", (unsigned long long)send_skipped);
+    printf("disconnects %10llu\n", (unsigned long long)disconnects);
+    printf("latency us  p50 %llu  p99 %llu  p999 %llu  max %llu\n",
+           (unsigned long long)hist_percentile(&hist, 0.50),
+           (unsigned long long)hist_percentile(&hist, 0.99),
+           (unsigned long long)hist_percentile(&hist, 0.999),
+           (unsigned long long)hist.max);
+
+    for (int i = 0; i < opt.clients; i++) {
+        close(clients[i].fd);
+        if (opt.proto == PROTO_FRAME) frame_buf_free(&clients[i].in);
+    }
+    close(epfd);
+    free(clients);
+    free(room_members);
+    return dropped ? 2 : 0;
+}
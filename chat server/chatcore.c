@@ -0,0 +1,119 @@
+#include "reactor.h"
+
+// --- 채팅 명령 처리 ---
+// server.c 부모 루프의 /add, /join, /rm, /list, /users, /leave, !whisper 와
+// 같은 의미를 리액터 안에서 처리한다 (자식 프로세스/파이프/시그널 없음)
+// 방/닉네임 상태는 주인 샤드가 들고 있으므로 shard.c 를 거친다 (샤드가 하나면 바로 처리)
+
+static void cmd_add(void *srv, void *cli, const cmd_t *cmd)
+{
+    char room[NAME];
+
+    if (cmd->arg.len == 0) return;
+    sv_copy(room, sizeof(room), cmd->arg);
+    // 방 이름의 주인 샤드가 만들고, 이미 있으면 "room already exists" 로 응답한다
+    shard_room_add(srv, cli, room);
+}
+
+static void cmd_join(void *srv, void *cli, const cmd_t *cmd)
+{
+    char room[NAME];
+
+    sv_copy(room, sizeof(room), cmd->arg);
+    // 없는 방이면 주인 샤드가 "no such room" 으로 응답한다
+    shard_room_join(srv, cli, room);
+}
+
+static void cmd_rm(void *srv, void *cli, const cmd_t *cmd)
+{
+    char room[NAME];
+
+    sv_copy(room, sizeof(room), cmd->arg);
+    // 방에 있던 멤버들만 방에서 빠진다
+    shard_room_rm(srv, cli, room);
+}
+
+static void cmd_list(void *srv, void *cli, const cmd_t *cmd)
+{
+    shard_room_list(srv, cli);
+}
+
+static void cmd_users(void *srv, void *cli, const cmd_t *cmd)
+{
+    shard_room_users(srv, cli);
+}
+
+static void cmd_leave(void *srv, void *cli, const cmd_t *cmd)
+{
+    shard_room_leave(srv, cli);
+}
+
+static void cmd_whisper(void *srv, void *cli, const cmd_t *cmd)
+{
+    conn_t *c = cli;
+    char user_name[NAME];
+
+    if (cmd->target.len == 0 || cmd->target.len >= NAME) return;
+    sv_copy(user_name, sizeof(user_name), cmd->target);
+
+    // 받는 사람이 어느 샤드에 있든 닉네임 주인 샤드가 찾아서 넘겨 준다
+    message_t *m = msg_framef("from %s : %.*s", c->name, (int)cmd->body.len, cmd->body.p);
+    if (m == NULL) return;
+    shard_whisper(srv, c, user_name, m);
+    msg_unref(m);
+}
+
+// 명령 번호 -> 핸들러. 새 명령은 command.h/command.c 에 등록하고 여기 한 줄 추가한다
+static const cmd_handler_t chat_commands[CMD_COUNT] = {
+    [CMD_ADD]     = cmd_add,
+    [CMD_JOIN]    = cmd_join,
+    [CMD_RM]      = cmd_rm,
+    [CMD_LIST]    = cmd_list,
+    [CMD_USERS]   = cmd_users,
+    [CMD_LEAVE]   = cmd_leave,
+    [CMD_WHISPER] = cmd_whisper,
+};
+
+static void broadcast(reactor_t *r, conn_t *c, const char *content, size_t len)
+{
+    if (c->room.room_id < 0) {
+        chat_log(LOG_DEBUG, "Reactor: Message from fd %d ('%s') but not in a room.", c->fd, c->name);
+        return;
+    }
+    // 메시지는 한 번만 만들고, 방 멤버들의 출력 큐는 같은 메시지를 가리킨다
+    message_t *m = msg_framef("%s: %.*s", c->name, (int)len, content);
+    if (m == NULL) return;
+
+    // 방 주인 샤드가 멤버가 있는 샤드마다 한 번씩 넘기고,
+    // 각 샤드는 자기 멤버 목록만 따라가므로 비용은 방 크기에 비례한다
+    shard_publish(r, c, m);
+    msg_unref(m);
+}
+
+void chat_handle_line(reactor_t *r, conn_t *c, const char *line, size_t len)
+{
+    cmd_t cmd;
+    cmd_id_t id = cmd_parse(line, len, &cmd);
+
+    if (line[0] == '/') {
+        cmd_dispatch(chat_commands, r, c, &cmd);
+    }
+    else if (c->name[0] == '\0') {
+        // 첫 메시지는 닉네임
+        sv_copy(c->name, NAME, (strview_t){ line, len });
+        shard_nick_set(r, c);
+        chat_log(LOG_INFO, "Reactor: Client fd %d set name to '%s'.", c->fd, c->name);
+    }
+    else if (id != CMD_NONE) {
+        cmd_dispatch(chat_commands, r, c, &cmd);
+    }
+    else {
+        broadcast(r, c, line, len);
+    }
+}
+
+void chat_on_close(reactor_t *r, conn_t *c)
+{
+    shard_room_leave(r, c);
+    shard_nick_del(r, c);
+}
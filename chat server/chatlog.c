@@ -0,0 +1,278 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+
+#include "chatlog.h"
+
+// --- 구조체 정의 ---
+typedef struct {
+    int level;
+    uint32_t len;
+    struct timespec ts;          // 남긴 시각 (파일로 쓸 때만 쓴다. syslog 는 내보낸 시각을 찍는다)
+    char text[CHATLOG_LINE];
+} chatlog_rec_t;
+
+// 스레드 하나의 SPSC 링 (생산자 : 그 스레드, 소비자 : 플러셔)
+typedef struct chatlog_ring {
+    _Atomic uint32_t head;       // 다음에 쓸 칸 (계속 증가)
+    char pad1[64 - sizeof(uint32_t)];
+    _Atomic uint32_t tail;       // 플러셔가 다음에 읽을 칸
+    char pad2[64 - sizeof(uint32_t)];
+    _Atomic uint32_t dropped;    // 링이 가득 차서 버린 레코드 수
+    struct chatlog_ring *next;   // 링 목록 (한 번 들어가면 빠지지 않는다)
+    chatlog_rec_t rec[CHATLOG_SLOTS];
+} chatlog_ring_t;
+
+// --- 전역 변수 ---
+static _Atomic(chatlog_ring_t *) rings;      // 모든 스레드의 링 (앞에 끼워 넣기만 한다)
+static __thread chatlog_ring_t *my_ring;
+static atomic_bool running;
+static atomic_bool stopping;
+static pthread_t flusher;
+static int wake_fd = -1;                     // 링이 차 가면 플러셔를 일찍 깨운다
+static int file_fd = -1;                     // CHAT_LOG_FILE (-1 이면 syslog)
+static pthread_mutex_t sink_lock = PTHREAD_MUTEX_INITIALIZER; // 내보내는 중에 fork() 되지 않도록
+
+static const char *const level_names[] = {
+    [LOG_EMERG] = "EMERG", [LOG_ALERT] = "ALERT", [LOG_CRIT] = "CRIT", [LOG_ERR] = "ERR",
+    [LOG_WARNING] = "WARN", [LOG_NOTICE] = "NOTICE", [LOG_INFO] = "INFO", [LOG_DEBUG] = "DEBUG",
+};
+
+// --- 생산자 ---
+static chatlog_ring_t *ring_register(void)
+{
+    chatlog_ring_t *r = calloc(1, sizeof(chatlog_ring_t));
+    if (r == NULL) return NULL;
+    chatlog_ring_t *old = atomic_load_explicit(&rings, memory_order_relaxed);
+    do {
+        r->next = old;
+    } while (!atomic_compare_exchange_weak_explicit(&rings, &old, r, memory_order_release, memory_order_relaxed));
+    my_ring = r;
+    return r;
+}
+
+void chatlog_write(int level, const char *fmt, ...)
+{
+    int saved_errno = errno;     // %m 은 부른 쪽의 errno 를 보여야 한다
+    va_list ap;
+
+    chatlog_ring_t *r = my_ring;
+    if (!atomic_load_explicit(&running, memory_order_acquire) ||
+        (r == NULL && (r = ring_register()) == NULL)) {
+        va_start(ap, fmt);
+        errno = saved_errno;
+        vsyslog(level, fmt, ap);
+        va_end(ap);
+        return;
+    }
+
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint32_t used = head - atomic_load_explicit(&r->tail, memory_order_acquire);
+    if (used == CHATLOG_SLOTS) {
+        // 로그 때문에 메시지 처리가 막히면 안 되므로 기다리지 않고 버린다
+        atomic_fetch_add_explicit(&r->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    chatlog_rec_t *rec = &r->rec[head & (CHATLOG_SLOTS - 1)];
+    rec->level = level;
+    clock_gettime(CLOCK_REALTIME, &rec->ts);
+    va_start(ap, fmt);
+    errno = saved_errno;
+    int n = vsnprintf(rec->text, sizeof(rec->text), fmt, ap);
+    va_end(ap);
+    if (n < 0) n = 0;
+    rec->len = (size_t)n < sizeof(rec->text) ? (uint32_t)n : sizeof(rec->text) - 1;
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+
+    // 3/4 를 넘는 순간에만 깨운다. 평소에는 플러셔가 주기적으로 가져간다
+    if (used + 1 == CHATLOG_SLOTS * 3 / 4) {
+        uint64_t one = 1;
+        ssize_t w = write(wake_fd, &one, sizeof(one));
+        (void)w;
+    }
+    errno = saved_errno;
+}
+
+// --- 플러셔 ---
+typedef struct {
+    char buf[64 * 1024];
+    size_t len;
+} batch_t;
+
+static void batch_flush(batch_t *b)
+{
+    size_t off = 0;
+    while (off < b->len) {
+        ssize_t n = write(file_fd, b->buf + off, b->len - off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        off += n;
+    }
+    b->len = 0;
+}
+
+static void emit(batch_t *b, int level, const struct timespec *ts, const char *text, uint32_t len)
+{
+    if (file_fd < 0) {
+        syslog(level, "%.*s", (int)len, text);
+        return;
+    }
+    // 파일은 묶어서 write() 한 번에 쓴다
+    if (b->len + len + 64 > sizeof(b->buf)) batch_flush(b);
+    struct tm tm;
+    localtime_r(&ts->tv_sec, &tm);
+    b->len += strftime(b->buf + b->len, 32, "%Y-%m-%d %H:%M:%S", &tm);
+    b->len += snprintf(b->buf + b->len, sizeof(b->buf) - b->len, ".%06ld %-5s %.*s\n",
+                       ts->tv_nsec / 1000, level_names[level & 7], (int)len, text);
+}
+
+// 모든 링을 비운다. 스레드마다 순서는 지키지만 스레드 사이의 순서는 시각으로만 알 수 있다
+static void drain_all(batch_t *b)
+{
+    pthread_mutex_lock(&sink_lock);
+    for (chatlog_ring_t *r = atomic_load_explicit(&rings, memory_order_acquire); r; r = r->next) {
+        uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+        uint32_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+        for (; tail != head; tail++) {
+            chatlog_rec_t *rec = &r->rec[tail & (CHATLOG_SLOTS - 1)];
+            emit(b, rec->level, &rec->ts, rec->text, rec->len);
+        }
+        atomic_store_explicit(&r->tail, tail, memory_order_release);
+
+        uint32_t dropped = atomic_exchange_explicit(&r->dropped, 0, memory_order_relaxed);
+        if (dropped) {
+            char text[64];
+            struct timespec now;
+            clock_gettime(CLOCK_REALTIME, &now);
+            int n = snprintf(text, sizeof(text), "chatlog: %u records dropped (ring full)", dropped);
+            emit(b, LOG_WARNING, &now, text, n);
+        }
+    }
+    if (file_fd >= 0) batch_flush(b);
+    pthread_mutex_unlock(&sink_lock);
+}
+
+static void *flusher_main(void *arg)
+{
+    static batch_t batch;
+    struct pollfd pfd = { .fd = wake_fd, .events = POLLIN };
+
+    while (!atomic_load_explicit(&stopping, memory_order_acquire)) {
+        if (poll(&pfd, 1, CHATLOG_FLUSH_MS) > 0) {
+            uint64_t v;
+            ssize_t n = read(wake_fd, &v, sizeof(v));
+            (void)n;
+        }
+        drain_all(&batch);
+    }
+    drain_all(&batch);
+    return NULL;
+}
+
+static int flusher_start(void)
+{
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd < 0) {
+        syslog(LOG_ERR, "chatlog: eventfd failed: %m");
+        return -1;
+    }
+    atomic_store(&stopping, false);
+    // 플러셔는 시그널을 받지 않는다. 프로세스로 온 SIGCHLD/SIGTERM 이 플러셔에게 가면
+    // 메인 스레드의 poll() 이 깨지 않고, signalfd 로 기다리는 쪽은 시그널을 놓친다
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int rc = pthread_create(&flusher, NULL, flusher_main, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (rc != 0) {
+        syslog(LOG_ERR, "chatlog: cannot start flusher thread");
+        close(wake_fd);
+        wake_fd = -1;
+        return -1;
+    }
+    atomic_store_explicit(&running, true, memory_order_release);
+    return 0;
+}
+
+// --- fork() 처리 ---
+static void before_fork(void)
+{
+    pthread_mutex_lock(&sink_lock);
+}
+
+static void after_fork_parent(void)
+{
+    pthread_mutex_unlock(&sink_lock);
+}
+
+// 자식에는 fork() 한 스레드만 남는다. 링에 남은 레코드는 부모의 플러셔가 내보내므로
+// 자식은 자기 링만 비운 채로 남기고, 초인종과 플러셔를 새로 만든다
+static void after_fork_child(void)
+{
+    pthread_mutex_init(&sink_lock, NULL);
+    if (!atomic_load(&running)) return;
+    atomic_store(&running, false);
+
+    chatlog_ring_t *r = my_ring;
+    if (r) {
+        atomic_store(&r->tail, atomic_load(&r->head));
+        atomic_store(&r->dropped, 0);
+        r->next = NULL;
+    }
+    atomic_store(&rings, r);
+    close(wake_fd);
+    flusher_start();
+}
+
+// --- 시작 / 정리 ---
+int chatlog_init(const char *ident)
+{
+    static bool once;
+
+    openlog(ident, LOG_PID | LOG_CONS, LOG_DAEMON);
+    if (atomic_load(&running)) return 0;
+
+    const char *path = getenv(CHATLOG_ENV);
+    if (path && *path) {
+        file_fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        if (file_fd < 0) syslog(LOG_ERR, "chatlog: cannot open %s: %m (using syslog)", path);
+    }
+    if (!once) {
+        once = true;
+        pthread_atfork(before_fork, after_fork_parent, after_fork_child);
+        atexit(chatlog_shutdown);
+    }
+    return flusher_start();
+}
+
+void chatlog_shutdown(void)
+{
+    if (!atomic_load(&running)) return;
+    // 이후의 chat_log() 는 syslog() 로 바로 간다
+    atomic_store_explicit(&running, false, memory_order_release);
+    atomic_store_explicit(&stopping, true, memory_order_release);
+    uint64_t one = 1;
+    ssize_t w = write(wake_fd, &one, sizeof(one));
+    (void)w;
+    pthread_join(flusher, NULL);
+    close(wake_fd);
+    wake_fd = -1;
+    if (file_fd >= 0) {
+        close(file_fd);
+        file_fd = -1;
+    }
+}
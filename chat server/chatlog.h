@@ -0,0 +1,31 @@
+#ifndef CHATLOG_H
+#define CHATLOG_H
+
+#include <syslog.h>   // LOG_ERR ... LOG_DEBUG 레벨을 그대로 쓴다
+
+// --- 매크로 정의 ---
+// 이보다 상세한 레벨의 chat_log() 는 컴파일 때 통째로 사라진다 (인자도 계산하지 않는다)
+// 메시지/수신자마다 찍는 로그는 LOG_DEBUG 이므로, 보려면 -DCHATLOG_LEVEL=LOG_DEBUG 로 빌드한다
+#ifndef CHATLOG_LEVEL
+#define CHATLOG_LEVEL    LOG_INFO
+#endif
+#define CHATLOG_SLOTS    512     // 스레드별 링 칸 수 (2의 거듭제곱). 가득 차면 버리고 센다
+#define CHATLOG_LINE     240     // 레코드 하나의 최대 길이 (넘으면 자른다)
+#define CHATLOG_FLUSH_MS 100     // 플러셔가 링들을 훑는 주기
+#define CHATLOG_ENV      "CHAT_LOG_FILE"  // 있으면 syslog 대신 이 파일에 묶어서 붙여 쓴다
+
+#define chat_log(level, ...) do { \
+    if ((level) <= CHATLOG_LEVEL) chatlog_write((level), __VA_ARGS__); \
+} while (0)
+
+// --- 함수 ---
+// openlog() 하고 플러셔 스레드를 띄운다. fork() 한 자식은 자기 플러셔를 새로 띄운다
+// 부르기 전이나 실패한 뒤의 chat_log() 는 예전처럼 syslog() 를 바로 부른다
+int chatlog_init(const char *ident);
+// 부른 스레드의 링에 레코드 하나를 넣는다 (락, 시스템 콜 없음. %m 도 쓸 수 있다)
+// 시그널 핸들러에서는 부르지 않는다 (끼어든 코드가 같은 링에 쓰는 중일 수 있다)
+void chatlog_write(int level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+// 플러셔를 멈추고 남은 레코드를 모두 내보낸다. exit() 때도 자동으로 불린다
+void chatlog_shutdown(void);
+
+#endif //CHATLOG_H
@@ -2,15 +2,16 @@
 #include <unistd.h>
 #include <string.h>
 #include <stdlib.h>
-#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <fcntl.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
-#include <sys/stat.h>
-#include <sys/resource.h>
-#include <sys/wait.h>
-#include <errno.h> 
+#include <errno.h>
 #include <netinet/in.h>
 
+#include "frame.h"
+
 #define COLOR_RED     "\x1b[31m"
 #define COLOR_GREEN   "\x1b[32m"
 #define COLOR_YELLOW  "\x1b[33m"
@@ -19,47 +20,147 @@
 #define COLOR_CYAN    "\x1b[36m"
 #define COLOR_RESET   "\x1b[0m"
 
+#define OUT_MAX     (256 * 1024)	// 보내지 못하고 쌓아 두는 최대 바이트 (넘으면 스크립트를 잠시 멈춘다)
+#define LINGER_MS   1000		// 스크립트를 다 보낸 뒤 남은 응답을 받는 시간
+
+// 스크립트 한 줄 : "<앞 줄로부터 ms> <메시지>" (숫자가 없으면 바로 보낸다)
 typedef struct {
-	int type;
-	char msg[BUFSIZ-4];
-} data_t;
+	long delay_ms;
+	char *msg;
+} script_line_t;
 
-static int g_pfd[2], g_sockfd, g_cont = 1;
+// 소켓에 보낼 프레임들 (논블로킹 소켓이라 덜 보낸 것은 POLLOUT 때 이어서 보낸다)
+typedef struct {
+	char *buf;
+	size_t len, off, cap;
+} out_buf_t;
 
 // 위의 선언없이 extern inline void clrscr(void)로 선언
 inline void clrscr(void);		// C99, C11에 대응하기 위해서 사용
-void clrscr(void)				
+void clrscr(void)
 {
     write(1, "\033[1;1H\033[2J", 10);		// ANSI escape 코드로 화면 지우기
 }
 
-void sigHandler(int signo)
+static long now_ms(void)
 {
-	if(signo == SIGUSR1) { 
-		char buf[BUFSIZ];
-		int n = read(g_pfd[0], buf, BUFSIZ);
-		write(g_sockfd, buf, n);
-	} else if(signo == SIGCHLD) {
-		g_cont = 0;
-		printf("Connection is lost\n");
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000L + ts.tv_nsec / 1000000;
+}
+
+// 한 줄을 [4바이트 길이][내용] 프레임 하나로 붙인다 (줄바꿈과 '\0' 은 보내지 않는다)
+static int out_push(out_buf_t *o, const char *msg, size_t len)
+{
+	if(len > FRAME_MAX) len = FRAME_MAX;
+	if(o->cap - o->len < FRAME_HDR + len) {
+		// 보낸 앞부분을 당기고, 그래도 모자라면 늘린다
+		memmove(o->buf, o->buf + o->off, o->len - o->off);
+		o->len -= o->off;
+		o->off = 0;
+		if(o->cap - o->len < FRAME_HDR + len) {
+			size_t cap = o->cap ? o->cap : BUFSIZ;
+			while(cap - o->len < FRAME_HDR + len) cap *= 2;
+			char *p = realloc(o->buf, cap);
+			if(p == NULL) return -1;
+			o->buf = p;
+			o->cap = cap;
+		}
+	}
+	o->len += frame_encode(o->buf + o->len, o->cap - o->len, msg, len);
+	return 0;
+}
+
+// 보낼 수 있는 만큼 보낸다. 오류면 -1
+static int out_flush(out_buf_t *o, int fd)
+{
+	while(o->off < o->len) {
+		ssize_t n = send(fd, o->buf + o->off, o->len - o->off, MSG_NOSIGNAL);
+		if(n < 0) {
+			if(errno == EINTR) continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+			return -1;
+		}
+		o->off += n;
 	}
+	o->len = o->off = 0;
+	return 0;
+}
+
+// 스크립트 파일을 한 번에 읽어 둔다 (보내는 동안 파일을 읽지 않도록). 줄 수, 실패하면 -1
+// 빈 줄과 '#' 으로 시작하는 줄은 건너뛴다
+static int script_load(const char *path, script_line_t **out)
+{
+	FILE *fp = fopen(path, "r");
+	if(fp == NULL) {
+		perror(path);
+		return -1;
+	}
+	script_line_t *lines = NULL;
+	int n = 0, cap = 0;
+	char *line = NULL;
+	size_t lcap = 0;
+	ssize_t len;
+	while((len = getline(&line, &lcap, fp)) >= 0) {
+		line[strcspn(line, "\r\n")] = '\0';
+		if(line[0] == '\0' || line[0] == '#') continue;
+		char *msg = line, *end;
+		long delay = strtol(line, &end, 10);
+		if(end != line && (*end == ' ' || *end == '\t') && delay >= 0) {
+			msg = end + 1;
+		} else {
+			delay = 0;
+		}
+		if(n == cap) {
+			cap = cap ? cap * 2 : 64;
+			script_line_t *p = realloc(lines, cap * sizeof(*lines));
+			if(p == NULL) break;
+			lines = p;
+		}
+		lines[n].delay_ms = delay;
+		lines[n].msg = strdup(msg);
+		if(lines[n].msg == NULL) break;
+		n++;
+	}
+	free(line);
+	fclose(fp);
+	*out = lines;
+	return n;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage : %s IP_ADDR PORT_NO [--script FILE [--speed X]]\n", prog);
+	fprintf(stderr, "  --script FILE : FILE 의 줄을 \"<ms> <메시지>\" 간격대로 보낸다 (첫 줄은 닉네임)\n");
+	fprintf(stderr, "  --speed X     : 간격에 곱할 배율 (0 이면 기다리지 않고 최대 속도로)\n");
 }
 
 int main(int argc, char** argv)
-{ 
+{
 	struct sockaddr_in servaddr;
-	int pid;
-	char buf[BUFSIZ]; 
-
-	clrscr();
+	const char *script_path = NULL;
+	double speed = 1.0;
 
 	if(argc < 3) {
-		fprintf(stderr, "usage : %s IP_ADDR PORT_NO\n", argv[0]);
+		usage(argv[0]);
 		return -1;
 	}
+	for(int i = 3; i < argc; i++) {
+		if(!strcmp(argv[i], "--script") && i + 1 < argc) script_path = argv[++i];
+		else if(!strcmp(argv[i], "--speed") && i + 1 < argc) speed = atof(argv[++i]);
+		else {
+			usage(argv[0]);
+			return -1;
+		}
+	}
 
-	g_sockfd = socket(AF_INET, SOCK_STREAM, 0);
-	if(g_sockfd < 0) {
+	script_line_t *script = NULL;
+	int script_n = 0;
+	if(script_path && (script_n = script_load(script_path, &script)) < 0) return -1;
+	if(!script_path) clrscr();
+
+	int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+	if(sockfd < 0) {
 		perror("socket");
 		return -1;
 	}
@@ -68,41 +169,125 @@ int main(int argc, char** argv)
 	servaddr.sin_family = AF_INET;
 	inet_pton(AF_INET, argv[1], &(servaddr.sin_addr.s_addr));
 	servaddr.sin_port = htons(atoi(argv[2]));
-	connect(g_sockfd, (struct sockaddr*)&servaddr, sizeof(servaddr));
-
-	pipe(g_pfd);
-	if((pid = fork()) < 0) {
-		perror("fork( )");
-	} else if (pid == 0) {
-		signal(SIGCHLD, sigHandler);
-		close(g_pfd[0]);
-		do { 
-			memset(buf, 0, BUFSIZ); 
-			printf(COLOR_BLUE "\r> " COLOR_RESET);
-			fflush(NULL);
-			fgets(buf, BUFSIZ, stdin);
-			write(g_pfd[1], buf, strlen(buf)+1);
-			kill(getppid( ), SIGUSR1);
-		} while (strcmp(buf, "quit") && g_cont);
-		close(g_pfd[1]);
-	} else { 			// pid > 0
-		signal(SIGUSR1, sigHandler);
-		signal(SIGCHLD, sigHandler);
-		close(g_pfd[1]);
-		while(g_cont) { 
-			memset(buf, 0, BUFSIZ);
-			int n = read(g_sockfd, buf, BUFSIZ);
-			if(n <= 0) break;
-			printf(COLOR_GREEN "\r%s\n" COLOR_RESET, buf);
-			printf(COLOR_BLUE "\r> " COLOR_RESET);
-			fflush(NULL);
+	if(connect(sockfd, (struct sockaddr*)&servaddr, sizeof(servaddr)) < 0) {
+		perror("connect");
+		return -1;
+	}
+	// 읽기와 쓰기를 한 poll() 루프에서 하므로 소켓은 논블로킹으로 둔다
+	fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL, 0) | O_NONBLOCK);
+
+	frame_buf_t in;			// 서버 메시지 재조립 버퍼
+	frame_view_t f;
+	out_buf_t out = { 0 };
+	char line[BUFSIZ];		// 아직 줄바꿈이 오지 않은 입력
+	size_t line_len = 0;
+	if(frame_buf_init(&in, 0) < 0) {
+		perror("frame_buf_init");
+		return -1;
+	}
+
+	// 스크립트 모드 : 다음 줄을 보낼 시각과 통계
+	int next = 0;
+	long start = now_ms(), due = start + (script_n > 0 ? (long)(script[0].delay_ms * speed) : 0), end_at = -1;
+	long sent = 0, received = 0;
+	int cont = 1, stdin_open = !script_path;
+
+	if(!script_path) {
+		printf(COLOR_BLUE "\r> " COLOR_RESET);
+		fflush(NULL);
+	}
+
+	// --- 한 프로세스, 한 poll() 루프 ---
+	// 키보드(또는 스크립트 타이머)와 소켓을 함께 기다린다. 예전처럼 읽기/쓰기 프로세스를 따로 두고
+	// 파이프 + SIGUSR1 로 넘기지 않는다.
+	while(cont) {
+		int timeout = -1;
+		long now = now_ms();
+
+		// 스크립트에서 때가 된 줄을 모두 보낼 프레임으로 붙인다 (쌓인 것이 많으면 소켓이 빌 때까지 멈춤)
+		while(script_path && next < script_n && out.len - out.off < OUT_MAX && due <= now) {
+			out_push(&out, script[next].msg, strlen(script[next].msg));
+			sent++;
+			if(++next < script_n) due += (long)(script[next].delay_ms * speed);
+		}
+		if(script_path && next < script_n && out.len - out.off < OUT_MAX) {
+			timeout = due > now ? (int)(due - now) : 0;
+		}
+		if(script_path && next == script_n && out.off == out.len) {
+			// 다 보냈으면 남은 응답을 잠시 더 받고 끝낸다
+			if(end_at < 0) end_at = now + LINGER_MS;
+			if(now >= end_at) break;
+			timeout = (int)(end_at - now);
+		}
+		if(out_flush(&out, sockfd) < 0) {
+			printf("Connection is lost\n");
+			break;
+		}
+
+		struct pollfd pfds[2] = {
+			{ .fd = sockfd, .events = POLLIN | (out.off < out.len ? POLLOUT : 0) },
+			{ .fd = stdin_open ? 0 : -1, .events = POLLIN },
+		};
+		if(poll(pfds, 2, timeout) < 0) {
+			if(errno == EINTR) continue;
+			perror("poll");
+			break;
+		}
+
+		if(pfds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+			ssize_t n = frame_read(&in, sockfd);
+			if(n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+				printf("\rConnection is lost\n");
+				break;
+			}
+			// read() 한 번에 여러 메시지가 오거나 반쪽만 와도 프레임 단위로 출력
+			while(frame_next(&in, &f) == 1) {
+				received++;
+				if(!script_path) printf(COLOR_GREEN "\r%.*s\n" COLOR_RESET, (int)f.len, f.data);
+			}
+			if(!script_path) {
+				printf(COLOR_BLUE "\r> " COLOR_RESET);
+				fflush(NULL);
+			}
+		}
+
+		if(pfds[1].revents & (POLLIN | POLLHUP)) {
+			ssize_t n = read(0, line + line_len, sizeof(line) - 1 - line_len);
+			if(n > 0) line_len += n;
+			// 완성된 줄마다 프레임 하나
+			char *p = line, *nl;
+			while((nl = memchr(p, '\n', line + line_len - p)) != NULL) {
+				if(nl - p == 4 && !memcmp(p, "quit", 4)) cont = 0;
+				out_push(&out, p, nl - p);
+				p = nl + 1;
+			}
+			line_len -= p - line;
+			memmove(line, p, line_len);
+			// 버퍼보다 긴 줄은 잘라서 보내고, 입력이 끝났으면 (Ctrl-D) 남은 것을 보내고 끝낸다
+			if(line_len == sizeof(line) - 1 || (n <= 0 && line_len > 0)) {
+				out_push(&out, line, line_len);
+				line_len = 0;
+			}
+			if(n <= 0) {
+				stdin_open = 0;
+				cont = 0;
+			}
 		}
-		close(g_pfd[0]);
-		kill(pid, SIGCHLD);
-		wait(NULL);
 	}
+	// 마지막으로 붙인 프레임은 블로킹으로 끝까지 보낸다
+	fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL, 0) & ~O_NONBLOCK);
+	out_flush(&out, sockfd);
 
-	close(g_sockfd);
+	if(script_path) {
+		double secs = (now_ms() - start) / 1000.0;
+		fprintf(stderr, "sent %ld, received %ld in %.2fs (%.0f msg/s out, %.0f msg/s in)\n",
+			sent, received, secs, secs > 0 ? sent / secs : 0, secs > 0 ? received / secs : 0);
+		for(int i = 0; i < script_n; i++) free(script[i].msg);
+		free(script);
+	}
+	frame_buf_free(&in);
+	free(out.buf);
+	close(sockfd);
 
 	return 0;
 }
@@ -1,126 +1,479 @@
 #include "clientprocess.h"
+#include "uring.h"
+#include <poll.h>
+#include <sys/prctl.h>
+#include <sys/signalfd.h>
 
 
-// --- 클라이언트 서버 (2차 자식) 프로세스의 메인 로직 함수 ---
-// 이 함수는 fork()된 자식 프로세스에서 실행.
-void client_work(pid_t client_pid, pid_t main_pid, int csock, int parent_pfd[2], int child_pfd[2]) {
-    // 자식 프로세스 시그널 핸들러 설정
-    setup_signal_handlers_child_main(); 
+// 재조립 버퍼의 완성된 프레임을 부모 링으로 넘긴다
+// 다 넘겼으면 1, 링이 가득 차서 남았으면 0 (프레임은 버퍼에 되돌려 둔다), 잘못된 프레임이면 -1
+static int forward_frames(pid_t client_pid, frame_buf_t *in, shm_chan_t *to_parent)
+{
+    frame_view_t frame;
+    int rc;
 
-    // 부모->자식 파이프 (parent_pfd):
-    // 자식은 이 파이프의 '읽기 끝'(parent_pfd[0])을 사용해서 부모 메시지를 받습니다.
-    // 따라서 '쓰기 끝'(parent_pfd[1])은 자식에게 불필요하므로 닫습니다.
-    close(parent_pfd[1]); 
+    while ((rc = frame_next(in, &frame)) == 1) {
+        chat_log(LOG_DEBUG, "Child %d received from client: %.*s", client_pid, (int)frame.len, frame.data);
 
-    // 자식->부모 파이프 (child_pfd):
-    // 자식은 이 파이프의 '쓰기 끝'(child_pfd[1])을 사용해서 부모에게 메시지를 보냅니다.
-    // 따라서 '읽기 끝'(child_pfd[0])은 자식에게 불필요하므로 닫습니다.
-    close(child_pfd[0]);
+        // 클라이언트에게 받은 메시지를 부모에게 링을 통해 전달합니다.
+        // 링마다 보낸 자식이 정해져 있으므로 "PID:" 머리말은 붙이지 않습니다.
+        // 링에 넣고 eventfd 초인종을 한 번 누르면 끝 (write + kill 두 번 대신)
+        if (shm_chan_send(to_parent, frame.data, frame.len) == -1) {
+            // 버리지 않고 되돌려 두었다가 부모가 링을 비우면 다시 넘긴다
+            frame_unget(in, &frame);
+            return 0;
+        }
+    }
+    if (rc < 0) {
+        chat_log(LOG_WARNING, "Child %d: bad frame from client. Exiting child loop.", client_pid);
+        return -1;
+    }
+    return 1;
+}
 
-    // 자식 프로세스가 실제로 통신에 사용할 파일 디스크립터들을 명확히 정의합니다.
-    int client_socket_fd = csock;           // 클라이언트와의 1대1 통신 소켓
-    int read_from_parent_pipe_fd = parent_pfd[0]; // 부모로부터 메시지를 읽을 파이프 FD
-    int write_to_parent_pipe_fd = child_pfd[1];   // 부모에게 메시지를 쓸 파이프 FD
-    
-    char child_mesg_buffer[BUFSIZ]; // 자식 프로세스 내부용 메시지 버퍼
+// --- 링 -> 소켓 직접 보내기 ---
+// 부모가 링에 넣은 메시지는 자식이 들여다볼 일이 없으므로, 버퍼로 꺼내 복사하지 않고
+// [헤더(여기서 만든 4바이트)][링 안의 내용] 을 가리키는 iovec 으로 엮어 sendmsg() 한 번에 보냅니다.
+// 링 자리는 소켓에 다 넘어간 레코드만큼만 돌려주므로, 보내는 동안 부모가 내용을 덮어쓰지 않습니다.
+// (클라이언트에게서 온 쪽은 프레임을 잘라 봐야 하므로 예전처럼 재조립 버퍼로 복사합니다)
+#define RELAY_RECORDS (CLIENT_RELAY_IOV / 3) // 레코드마다 헤더 하나 + 내용 최대 두 조각
+
+typedef struct {
+    struct iovec iov[CLIENT_RELAY_IOV];
+    char hdr[RELAY_RECORDS][FRAME_HDR];
+    uint32_t end[RELAY_RECORDS];     // 레코드 다음 위치 (여기까지 보냈으면 링에 돌려준다)
+    size_t wire[RELAY_RECORDS];      // 레코드가 소켓에 나가는 바이트 (헤더 + 내용)
+    int records;
+    size_t skip;                     // 첫 레코드에서 이미 보낸 바이트 (덜 보낸 채 끝났을 때)
+    int more;                        // iovec 이 모자라 링에 더 남았다 (MSG_MORE 로 보낸다)
+    struct msghdr mh;
+} relay_t;
+
+// 링의 레코드들을 iovec 으로 엮는다. 보낼 바이트 (0 이면 링이 비었음)
+static size_t relay_fill(relay_t *rl, shm_ring_t *ring)
+{
+    uint32_t pos = shm_ring_tail(ring);
+    size_t total = 0;
+    int cnt = 0;
+
+    rl->records = 0;
+    while (rl->records < RELAY_RECORDS) {
+        struct iovec *hv = &rl->iov[cnt];
+        int k = shm_ring_peek(ring, &pos, &rl->iov[cnt + 1]);
+        if (k < 0) break;
+        size_t len = (k > 0 ? rl->iov[cnt + 1].iov_len : 0) + (k > 1 ? rl->iov[cnt + 2].iov_len : 0);
+        frame_put_hdr(rl->hdr[rl->records], len);
+        *hv = (struct iovec){ .iov_base = rl->hdr[rl->records], .iov_len = FRAME_HDR };
+        cnt += 1 + k;
+        rl->end[rl->records] = pos;
+        rl->wire[rl->records] = FRAME_HDR + len;
+        rl->records++;
+        total += FRAME_HDR + len;
+    }
+    struct iovec probe[2];
+    rl->more = shm_ring_peek(ring, &pos, probe) >= 0 ? MSG_MORE : 0;
+
+    // 지난번에 덜 보낸 첫 레코드의 앞부분은 건너뛴다
+    int first = 0;
+    size_t skip = rl->skip;
+    while (skip > 0 && skip >= rl->iov[first].iov_len) skip -= rl->iov[first++].iov_len;
+    if (skip > 0) {
+        rl->iov[first].iov_base = (char *)rl->iov[first].iov_base + skip;
+        rl->iov[first].iov_len -= skip;
+    }
+    rl->mh = (struct msghdr){ .msg_iov = rl->iov + first, .msg_iovlen = cnt - first };
+    return total - rl->skip;
+}
+
+// n 바이트가 소켓에 넘어갔다. 다 넘어간 레코드의 링 자리를 돌려준다
+static void relay_done(relay_t *rl, shm_ring_t *ring, size_t n)
+{
+    int i = 0;
+
+    n += rl->skip;
+    while (i < rl->records && n >= rl->wire[i]) n -= rl->wire[i++];
+    if (i > 0) shm_ring_release(ring, rl->end[i - 1]);
+    rl->skip = n;
+}
+
+// 부모 링의 메시지들을 소켓으로 보낸다. 덜 보낸 것은 링에 남겨 두고 POLLOUT 을 기다린다
+// 계속 보낼 수 있으면 0, 소켓이 가득 찼으면 1, 쓰기 오류면 -1
+static int flush_to_client(int fd, shm_chan_t *from_parent, relay_t *rl)
+{
+    while (1) {
+        if (relay_fill(rl, from_parent->ring) == 0) return 0; // 링이 비었음
+        // 회차마다 링에 와 있는 것을 모두 한 번에 보내므로, 바쁜 방에서도 작은 세그먼트가 줄줄이 나가지 않습니다.
+        // iovec 이 모자라 링에 더 남았으면 MSG_MORE 로 꼬리를 붙잡아 두고 이어서 보냅니다.
+        // 혼자 온 메시지는 MSG_MORE 없이 보내므로 TCP_NODELAY 덕에 바로 나갑니다.
+        // 소켓은 처음부터 논블로킹이라 fcntl 로 모드를 바꾸지 않습니다.
+        ssize_t n = sendmsg(fd, &rl->mh, MSG_NOSIGNAL | rl->more);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            // 소켓이 가득 참: 보낸 만큼만 기억하고 나머지는 링에 남겨 둡니다.
+            // 링이 차면 부모가 대기열에 쌓고, 대기열이 한도를 넘으면 부모가 이 자식을 퇴출합니다.
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 1;
+            return -1;
+        }
+        relay_done(rl, from_parent->ring, n);
+    }
+}
+
+// --- 부모 지켜보기 ---
+// 부모가 끝나면 자식도 끝낸다 (공유 메모리 링에는 EOF 가 없다). 예전에는 PR_SET_PDEATHSIG 였지만
+// 무중단 업그레이드 때는 옛 부모가 끝나도 새 바이너리가 링을 이어받으므로, 부모의 pidfd 를 지켜보다가
+// 끝나면 링 머리말의 주인(owner)을 보고 새 부모를 따라간다
+static int owner_fd = -1;        // 지금 부모의 pidfd (-1 : 커널이 지원하지 않아 PDEATHSIG 로 끝난다)
+static pid_t owner_pid;
+
+// 지켜보던 부모가 끝났다. 링의 주인이 살아 있는 다른 프로세스로 바뀌었으면 그쪽을 지켜보고 0, 아니면 -1
+static int follow_owner(pid_t client_pid, shm_chan_t *from_parent)
+{
+    pid_t owner = shm_ring_owner(from_parent->ring);
+
+    close(owner_fd);
+    owner_fd = -1;
+    if (owner > 0 && owner != owner_pid && (owner_fd = pid_watch(owner)) >= 0) {
+        chat_log(LOG_INFO, "Child %d: parent %d handed over to %d.", client_pid, owner_pid, owner);
+        owner_pid = owner;
+        return 0;
+    }
+    chat_log(LOG_INFO, "Child %d: parent %d exited. Exiting child loop.", client_pid, owner_pid);
+    return -1;
+}
+
+// --- poll() 루프 ---
+// 소켓, 부모 링의 초인종, 시그널(signalfd), 부모 pidfd 를 poll() 한 번으로 기다립니다.
+// 일이 없으면 잠들어 있고, 메시지가 오면 바로 깨어나므로 고정 지연(예전의 usleep 10ms)이 없습니다.
+static void client_loop_poll(pid_t client_pid, int client_socket_fd, int sfd, frame_buf_t *client_in,
+                             shm_chan_t *from_parent, shm_chan_t *to_parent, relay_t *relay)
+{
     ssize_t child_n_read_write;
+    bool parent_full = false; // 부모 링이 가득 차서 재조립 버퍼에 프레임이 남아 있음
+    bool client_full = false; // 소켓 송신 버퍼가 가득 차서 POLLOUT 을 기다림
+
+    enum { PFD_SOCK, PFD_PARENT, PFD_SIG, PFD_OWNER };
+    struct pollfd pfds[4] = {
+        [PFD_SOCK]   = { .fd = client_socket_fd },
+        [PFD_PARENT] = { .fd = from_parent->efd, .events = POLLIN },
+        [PFD_SIG]    = { .fd = sfd, .events = POLLIN },
+        [PFD_OWNER]  = { .fd = owner_fd, .events = POLLIN },
+    };
 
     // --- 자식 프로세스의 주된 통신 루프 ---
-    // 이 루프 안에서 클라이언트와 부모로부터의 메시지를 지속적으로 확인하고 처리합니다.
-    // O_NONBLOCK을 사용하므로, 각 read() 호출은 블로킹되지 않고 즉시 반환하며, 데이터가 없으면 EAGAIN을 반환합니다.
-    // 시그널에 의해 read()가 EINTR로 중단되면, 루프가 다시 돌면서 플래그를 확인합니다.
     while (1) {
-        // 1. 부모로부터 메시지가 도착했는지 확인 (SIGUSR1 시그널 플래그 이용)
-        // 부모가 SIGUSR1을 보내면 child_sigusr_arrived 플래그가 설정됩니다.
-        // 이 블록은 플래그가 설정되었을 때 실행됩니다. O_NONBLOCK 설정으로 블로킹을 피합니다.
-        if (child_sigusr_arrived) {
-            child_sigusr_arrived = 0; // 플래그를 초기화합니다.
-            syslog(LOG_INFO, "Child %d: SIGUSR1 received, checking parent pipe for broadcast.", client_pid);
-            
-            // 부모 파이프 FD에서 메시지를 읽기 시도: 논블로킹이므로 데이터가 없으면 즉시 반환됩니다.
-            child_n_read_write = read(read_from_parent_pipe_fd, child_mesg_buffer, sizeof(child_mesg_buffer) - 1);
-            
+        // 부모 링이 가득 찼으면 소켓을 읽지 않으므로, 소켓 버퍼가 차면 TCP 가 클라이언트를 늦춥니다.
+        // 소켓이 가득 찼으면 링을 꺼내지 않고 POLLOUT 을 기다립니다. (링이 차면 부모가 대기열에 쌓습니다)
+        pfds[PFD_SOCK].events = (parent_full ? 0 : POLLIN) | (client_full ? POLLOUT : 0);
+        pfds[PFD_PARENT].fd = client_full ? -1 : from_parent->efd;
+
+        // 부모가 링을 비웠다는 알림은 없으므로, 부모 링이 가득 찼을 때만 짧게 자고 다시 넣어 봅니다.
+        int n = poll(pfds, 4, parent_full ? CLIENT_RETRY_MS : -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            chat_log(LOG_ERR, "Child %d: poll failed: %m", client_pid);
+            break;
+        }
+
+        // 1. 종료 시그널 (부모가 퇴출했거나 부모가 죽었음)
+        if (pfds[PFD_SIG].revents & POLLIN) {
+            struct signalfd_siginfo si;
+            if (read(sfd, &si, sizeof(si)) == sizeof(si)) {
+                chat_log(LOG_INFO, "Child %d: received signal %u. Exiting child loop.", client_pid, si.ssi_signo);
+            }
+            break;
+        }
+        // 부모가 끝났으면 새 부모가 이어받았는지 봅니다.
+        if (pfds[PFD_OWNER].revents & POLLIN) {
+            if (follow_owner(client_pid, from_parent) == -1) break;
+            pfds[PFD_OWNER].fd = owner_fd;
+        }
+
+        // 2. 부모로부터 온 메시지, 또는 덜 보낸 프레임을 소켓에 보냅니다.
+        // 레코드 단위로 꺼내므로 여러 메시지가 한 덩어리로 붙어서 읽히지 않습니다.
+        if ((pfds[PFD_PARENT].revents & POLLIN) || (pfds[PFD_SOCK].revents & POLLOUT)) {
+            shm_chan_ack(from_parent); // 초인종 카운터 비우기 (묶음당 한 번)
+            int rc = flush_to_client(client_socket_fd, from_parent, relay);
+            if (rc < 0) break; // 쓰기 오류 시 통신 루프 종료
+            client_full = (rc == 1);
+        }
+
+        // 3. 부모 링이 가득 차서 못 넘긴 프레임이 남아 있으면 그것부터 넘깁니다.
+        if (parent_full) {
+            int rc = forward_frames(client_pid, client_in, to_parent);
+            if (rc < 0) break;
+            parent_full = (rc == 0);
+        }
+
+        // 4. 클라이언트 소켓에서 메시지 읽기
+        if (!parent_full && (pfds[PFD_SOCK].revents & (POLLIN | POLLHUP | POLLERR))) {
+            child_n_read_write = frame_read(client_in, client_socket_fd);
             if (child_n_read_write > 0) {
-                child_mesg_buffer[child_n_read_write] = '\0';
-                syslog(LOG_INFO, "Child %d received from parent (broadcast): %s", client_pid, child_mesg_buffer);
-
-                // 부모로부터 받은 메시지를 해당 클라이언트에게 전달합니다.
-                // 클라이언트 소켓도 논블로킹으로 설정하고 쓰기 시도합니다.
-                set_nonblocking(client_socket_fd);
-                if (write(client_socket_fd, child_mesg_buffer, child_n_read_write) <= 0) {
-                    if (errno != EAGAIN && errno != EWOULDBLOCK) {
-                        //syslog(LOG_ERR, "Child %d failed to write to client (broadcast): %m", client_pid);
-                        break; // 쓰기 오류 시 통신 루프 종료
-                    }
-                }
-                set_blocking(client_socket_fd); // 쓰기 후 다시 블로킹 모드로 복원합니다.
+                // read() 한 번에 프레임이 여러 개 들어 있을 수도, 반쪽만 있을 수도 있습니다.
+                // 완성된 프레임만 하나씩 꺼내 부모에게 보내고, 나머지는 다음 read() 를 기다립니다.
+                int rc = forward_frames(client_pid, client_in, to_parent);
+                if (rc < 0) break;
+                parent_full = (rc == 0);
             } else if (child_n_read_write == 0) {
-                // 부모 파이프가 닫힘 (부모 프로세스가 종료되었거나 파이프의 모든 쓰기 끝이 닫힘)
-                syslog(LOG_INFO, "Child %d: Parent pipe closed. Exiting child loop.", client_pid);
+                // 클라이언트 연결 종료 (EOF): 클라이언트가 연결을 끊었습니다.
+                chat_log(LOG_INFO, "Child %d: Client disconnected. Exiting child loop.", client_pid);
                 break; // 통신 루프 종료
-            } else { // child_n_read_write < 0
-                // read 오류 발생. EAGAIN/EWOULDBLOCK은 논블로킹 모드에서 데이터가 없다는 의미입니다.
-                // EINTR은 시그널에 의해 중단된 것이므로 실제 오류가 아닙니다.
-                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) { 
-                    //syslog(LOG_ERR, "Child %d read from parent pipe error: %m", client_pid);
-                    break; // 다른 오류 발생 시 통신 루프 종료
-                }
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                break; // 다른 오류 발생 시 통신 루프 종료
             }
+        } else if (parent_full && (pfds[PFD_SOCK].revents & (POLLHUP | POLLERR))) {
+            break; // 읽기를 멈춘 동안 연결이 끊겼음
         }
+    } // --- while (1) 루프 종료 ---
+}
 
-        // 2. 클라이언트 소켓에서 메시지 읽기 시도 (논블로킹)
-        // O_NONBLOCK 설정으로 인해 클라이언트가 데이터를 보내지 않아도 블로킹되지 않고 즉시 반환합니다.
-        // 부모가 SIGUSR1 시그널을 보내면 이 read()는 EINTR 오류로 중단될 수 있습니다.
-        set_nonblocking(client_socket_fd);
-        child_n_read_write = read(client_socket_fd, child_mesg_buffer, sizeof(child_mesg_buffer) - 1);
-        set_blocking(client_socket_fd); // 읽기 후 다시 블로킹 모드로 복원합니다.
-
-        if (child_n_read_write > 0) {
-            child_mesg_buffer[child_n_read_write] = '\0'; // 문자열 종료 처리
-            syslog(LOG_INFO, "Child %d received from client: %s", client_pid, child_mesg_buffer);
-
-            // 클라이언트에게 받은 메시지를 부모에게 파이프를 통해 전달합니다.
-            // 메시지 형식: "PID:메시지내용" (부모가 어떤 자식에게서 왔는지 알 수 있도록)
-            char formatted_mesg[BUFSIZ + 32]; // PID 공간을 고려하여 버퍼 크기 증가
-            snprintf(formatted_mesg, sizeof(formatted_mesg), "%d:%s", client_pid, child_mesg_buffer);
-            ssize_t formatted_len = strlen(formatted_mesg);
-
-            // 부모에게 메시지를 보내기 전, 부모에게 SIGUSR1 시그널을 전송합니다.
-            // 이렇게 해야 부모의 accept()나 다른 read()가 EINTR로 중단되어 이 메시지를 처리할 수 있습니다.
-            if (kill(main_pid, SIGUSR1) == -1) { // getppid() 대신 전달받은 main_pid 사용
-                syslog(LOG_ERR, "Child %d: Failed to send SIGUSR1 to parent %d: %m", client_pid, main_pid);
-            } 
-            // 파이프에 메시지 쓰기 시도 (O_NONBLOCK 설정으로 버퍼가 가득 차면 블로킹되지 않고 즉시 반환합니다.)
-            set_nonblocking(write_to_parent_pipe_fd);
-            if (write(write_to_parent_pipe_fd, formatted_mesg, formatted_len + 1) <= 0) { // NULL 종료 문자 포함
-                if (errno != EAGAIN && errno != EWOULDBLOCK) {
-                    //syslog(LOG_ERR, "Child %d failed to write to parent pipe: %m", client_pid);
-                    break; // 쓰기 오류 시 통신 루프 종료
+// --- io_uring 루프 ---
+// 받기는 다중 recv 하나가 버퍼 링에서 버퍼를 골라 계속 채우고, 보내기는 회차마다 부모 링의 레코드들을
+// 복사하지 않고 sendmsg 하나로 넘긴다. 부모 초인종도 eventfd read 요청으로 받으므로
+// 메시지가 오가는 동안 시스템 콜은 io_uring_enter() 한 번뿐이다
+enum { UD_RECV = 1, UD_PARENT, UD_SIG, UD_SEND, UD_RETRY, UD_OWNER };
+
+// 받았지만 재조립 버퍼로 아직 다 옮기지 못한 받기 버퍼 (돌려주지 않으면 커널이 그 버퍼를 쓰지 않는다)
+typedef struct {
+    uint16_t bid;
+    uint32_t off;
+    uint32_t len;
+} pending_buf_t;
+
+typedef struct {
+    uring_t u;
+    uring_bufs_t bufs;
+    pid_t pid;
+    int fd;
+    frame_buf_t *in;
+    shm_chan_t *from_parent;
+    shm_chan_t *to_parent;
+
+    pending_buf_t pend[CLIENT_RECV_BUFS];   // 도착 순서대로
+    uint32_t pend_head;
+    uint32_t pend_count;
+    bool recv_multi;             // 다중 recv 를 못 쓰는 커널(6.0 전)이면 한 번씩 다시 건다
+    bool recv_armed;
+    bool parent_full;            // 부모 링이 가득 차서 버퍼를 붙잡고 있다 (버퍼가 떨어지면 커널이 받기를 멈춘다)
+    bool retry_armed;
+
+    relay_t *relay;              // 보내는 중인 링 레코드들 (완료가 올 때까지 iovec 을 그대로 둔다)
+    int sends;                   // 아직 완료가 오지 않은 sendmsg 수 (0 또는 1)
+    uint64_t doorbell;           // 부모 초인종 eventfd 를 읽어 오는 자리
+    bool done;
+} uclient_t;
+
+// 링의 레코드들을 sendmsg 하나로 넘긴다. 앞 묶음이 끝나기 전에는 엮지 않는다
+// (그동안 링이 차면 부모가 대기열에 쌓고, 한도를 넘으면 퇴출한다)
+static void uc_flush(uclient_t *c)
+{
+    if (c->sends > 0 || c->done) return;
+    if (relay_fill(c->relay, c->from_parent->ring) == 0) return;
+    if (uring_sendmsg(&c->u, c->fd, &c->relay->mh, c->relay->more, UD_SEND) == -1) {
+        chat_log(LOG_ERR, "Child %d: cannot queue send: %m", c->pid);
+        c->done = true;
+        return;
+    }
+    c->sends++;
+}
+
+static void uc_send_done(uclient_t *c, int res)
+{
+    c->sends--;
+    if (res < 0) {
+        chat_log(LOG_INFO, "Child %d: send failed (%s). Exiting child loop.", c->pid, strerror(-res));
+        c->done = true;
+        return;
+    }
+    // 시그널 등으로 덜 보낸 채 끝났으면 남은 것은 링에 그대로 있고, 회차 끝의 uc_flush() 가 이어서 보낸다
+    relay_done(c->relay, c->from_parent->ring, res);
+}
+
+// 붙잡은 받기 버퍼를 재조립 버퍼로 옮기며 완성된 프레임을 부모 링에 넘긴다
+// 재조립 버퍼는 가장 긴 프레임보다 크므로, 들어가는 만큼씩 옮기다 보면 프레임이 완성되어 자리가 난다
+static int uc_pump(uclient_t *c)
+{
+    for (;;) {
+        int rc = forward_frames(c->pid, c->in, c->to_parent);
+        if (rc < 0) return -1;
+        c->parent_full = (rc == 0);
+        if (c->parent_full || c->pend_count == 0) return 0;
+
+        pending_buf_t *p = &c->pend[c->pend_head];
+        size_t avail;
+        char *dst = frame_buf_space(c->in, &avail);
+        size_t n = p->len - p->off < avail ? p->len - p->off : avail;
+        memcpy(dst, uring_buf(&c->bufs, p->bid) + p->off, n);
+        frame_buf_commit(c->in, n);
+        p->off += n;
+        if (p->off == p->len) {
+            uring_buf_put(&c->bufs, p->bid);
+            c->pend_head = (c->pend_head + 1) % CLIENT_RECV_BUFS;
+            c->pend_count--;
+        }
+    }
+}
+
+static void uc_recv_done(uclient_t *c, int res, uint32_t flags)
+{
+    if (!(flags & IORING_CQE_F_MORE)) c->recv_armed = false;
+    if (res > 0) {
+        pending_buf_t *p = &c->pend[(c->pend_head + c->pend_count++) % CLIENT_RECV_BUFS];
+        p->bid = flags >> IORING_CQE_BUFFER_SHIFT;
+        p->off = 0;
+        p->len = res;
+        return;
+    }
+    if (flags & IORING_CQE_F_BUFFER) uring_buf_put(&c->bufs, flags >> IORING_CQE_BUFFER_SHIFT);
+    if (res == 0) {
+        chat_log(LOG_INFO, "Child %d: Client disconnected. Exiting child loop.", c->pid);
+        c->done = true;
+    } else if (res == -EINVAL && c->recv_multi) {
+        c->recv_multi = false;
+    } else if (res != -ENOBUFS && res != -EINTR && res != -EAGAIN) {
+        c->done = true;          // ENOBUFS : 버퍼를 다 붙잡고 있다. 돌려준 뒤에 다시 건다
+    }
+}
+
+// 처음 거는 요청을 넣지 못하면 -1 (부른 쪽이 poll() 루프로 돌아간다)
+static int client_loop_uring(pid_t client_pid, int fd, int sfd, frame_buf_t *client_in,
+                             shm_chan_t *from_parent, shm_chan_t *to_parent, relay_t *relay)
+{
+    struct io_uring_cqe cqes[URING_BATCH];
+    uclient_t c = {
+        .pid = client_pid, .fd = fd, .in = client_in,
+        .from_parent = from_parent, .to_parent = to_parent, .recv_multi = true, .relay = relay,
+    };
+
+    if (uring_init(&c.u, CLIENT_URING_ENTRIES) == -1) return -1;
+    if (uring_bufs_init(&c.u, &c.bufs, 0, CLIENT_RECV_BUFS, CLIENT_RECV_BUF) == -1 ||
+        uring_poll(&c.u, sfd, UD_SIG) == -1 ||
+        (owner_fd >= 0 && uring_poll(&c.u, owner_fd, UD_OWNER) == -1) ||
+        uring_read(&c.u, from_parent->efd, &c.doorbell, sizeof(c.doorbell), UD_PARENT) == -1) {
+        chat_log(LOG_WARNING, "Child %d: io_uring setup failed, using poll().", client_pid);
+        uring_bufs_free(&c.u, &c.bufs);
+        uring_close(&c.u);
+        return -1;
+    }
+    // 부모가 fork() 전에 넣어 둔 메시지가 있을 수 있다
+    uc_flush(&c);
+
+    while (!c.done) {
+        // 받기 버퍼가 하나라도 커널에 있으면 받기를 다시 건다
+        if (!c.recv_armed && c.pend_count < CLIENT_RECV_BUFS) {
+            if (uring_recv(&c.u, fd, &c.bufs, c.recv_multi, UD_RECV) == 0) c.recv_armed = true;
+        }
+        // 부모 링이 가득 찼다는 알림은 없으므로 짧게 자고 다시 넣어 본다
+        if (c.parent_full && !c.retry_armed) {
+            if (uring_timeout(&c.u, CLIENT_RETRY_MS, UD_RETRY) == 0) c.retry_armed = true;
+        }
+        if (uring_submit(&c.u, 1) == -1) {
+            chat_log(LOG_ERR, "Child %d: io_uring_enter failed: %m", client_pid);
+            break;
+        }
+
+        unsigned n = uring_reap(&c.u, cqes, URING_BATCH);
+        for (unsigned i = 0; i < n && !c.done; i++) {
+            struct io_uring_cqe *cqe = &cqes[i];
+            switch (cqe->user_data) {
+            case UD_RECV:
+                uc_recv_done(&c, cqe->res, cqe->flags);
+                break;
+            case UD_PARENT:
+                if (cqe->res < 0 && cqe->res != -EINTR) {
+                    c.done = true;
+                    break;
                 }
+                // 보내기는 회차 끝에 한 번 (이 회차에 온 초인종과 send 완료를 모두 본 뒤)
+                uring_read(&c.u, from_parent->efd, &c.doorbell, sizeof(c.doorbell), UD_PARENT);
+                break;
+            case UD_SEND:
+                uc_send_done(&c, cqe->res);
+                break;
+            case UD_RETRY:
+                c.retry_armed = false;
+                break;
+            case UD_OWNER:
+                if (cqe->res < 0 || follow_owner(client_pid, from_parent) == -1) {
+                    c.done = true;
+                    break;
+                }
+                uring_poll(&c.u, owner_fd, UD_OWNER);
+                break;
+            case UD_SIG: {
+                struct signalfd_siginfo si;
+                if (read(sfd, &si, sizeof(si)) == sizeof(si)) {
+                    chat_log(LOG_INFO, "Child %d: received signal %u. Exiting child loop.", client_pid, si.ssi_signo);
+                }
+                c.done = true;
+                break;
             }
-            set_blocking(write_to_parent_pipe_fd); // 쓰기 후 다시 블로킹 모드로 복원합니다.
-        } else if (child_n_read_write == 0) {
-            // 클라이언트 연결 종료 (EOF): 클라이언트가 연결을 끊었습니다.
-            syslog(LOG_INFO, "Child %d: Client disconnected. Exiting child loop.", client_pid);
-            break; // 통신 루프 종료
-        } else { // child_n_read_write < 0
-            // read 오류 발생. EAGAIN/EWOULDBLOCK은 논블로킹 모드에서 데이터가 없다는 의미입니다.
-            // EINTR은 시그널에 의해 중단된 것이므로 실제 오류가 아닙니다.
-            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) { 
-                //syslog(LOG_ERR, "Child %d read from client error: %m", client_pid);
-                break; // 다른 오류 발생 시 통신 루프 종료
             }
         }
-        // CPU 과부하 방지를 위해 잠시 쉬어줍니다.
-        // 논블로킹 모드에서는 CPU를 계속 소모할 수 있으므로, usleep은 필수적입니다.
-        usleep(10000); // 10ms (10000 microseconds)
-    } // --- while (1) 루프 종료 ---
+        if (uc_pump(&c) == -1) break;
+        uc_flush(&c);
+    }
+
+    // 걸어 둔 요청은 링을 닫을 때 커널이 취소한다
+    uring_bufs_free(&c.u, &c.bufs);
+    uring_close(&c.u);
+    return 0;
+}
+
+// --- 클라이언트 서버 (2차 자식) 프로세스의 메인 로직 함수 ---
+// 이 함수는 fork()된 자식 프로세스에서 실행.
+// CHAT_IO=uring 이면 io_uring 루프, 아니면(또는 링을 못 만들면) poll() 루프로 돕니다.
+void client_work(pid_t client_pid, pid_t main_pid, int csock, shm_chan_t *from_parent, shm_chan_t *to_parent) {
+    // 종료 시그널은 핸들러 대신 signalfd 로 받아서 같은 poll() 에서 처리합니다.
+    // fork() 직후라 부모의 SIGCHLD 핸들러를 물려받았지만 자식은 자식 프로세스가 없어서 상관없습니다.
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGINT);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+
+    // 부모가 죽으면 자식도 정리되도록 부모의 pidfd 를 지켜봅니다 (부모 지켜보기)
+    // pidfd 가 없는 커널이면 예전처럼 SIGTERM 을 받습니다. (그때는 업그레이드하면 함께 끝납니다)
+    owner_pid = main_pid;
+    owner_fd = pid_watch(main_pid);
+    if (owner_fd < 0) prctl(PR_SET_PDEATHSIG, SIGTERM);
+    if (getppid() != main_pid) {
+        exit(0); // 지켜보기 전에 이미 부모가 죽은 경우
+    }
+
+    int sfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (sfd < 0) {
+        chat_log(LOG_ERR, "Child %d: signalfd failed: %m", client_pid);
+        exit(1);
+    }
+
+    // 자식 프로세스가 실제로 통신에 사용할 파일 디스크립터들을 명확히 정의합니다.
+    int client_socket_fd = csock;           // 클라이언트와의 1대1 통신 소켓
+    frame_buf_t client_in; // 클라이언트 소켓 재조립 버퍼 (프레임이 붙거나 나뉘어 와도 된다)
+    relay_t *relay = calloc(1, sizeof(*relay)); // 부모 링 -> 소켓 (복사하지 않고 보낼 레코드들)
+
+    if (relay == NULL || frame_buf_init(&client_in, 0) == -1) {
+        chat_log(LOG_ERR, "Child %d: out of memory for frame buffer", client_pid);
+        exit(1);
+    }
+
+    // io_uring 은 블로킹 소켓에 걸어야 커널이 준비될 때까지 기다려 준다 (논블로킹이면 -EAGAIN 으로 돌아온다)
+    if (!uring_on() || client_loop_uring(client_pid, client_socket_fd, sfd, &client_in, from_parent, to_parent, relay) == -1) {
+        // 소켓은 이 자식만 쓰므로 한 번 논블로킹으로 두고 다시 바꾸지 않습니다.
+        if (set_nonblocking(client_socket_fd) == -1) {
+            exit(1);
+        }
+        client_loop_poll(client_pid, client_socket_fd, sfd, &client_in, from_parent, to_parent, relay);
+    }
 
     // 자식 프로세스 종료 전 모든 열린 파일 디스크립터를 닫습니다.
     // 자원 누수를 방지하고 운영체제에 FD를 반환합니다.
     close(client_socket_fd);
-    close(read_from_parent_pipe_fd);
-    close(write_to_parent_pipe_fd);
-    syslog(LOG_INFO, "Child %d process exiting gracefully.", client_pid);
+    close(sfd);
+    if (owner_fd >= 0) close(owner_fd);
+    frame_buf_free(&client_in);
+    free(relay);
+    shm_chan_close(from_parent);
+    shm_chan_close(to_parent);
+    chat_log(LOG_INFO, "Child %d process exiting gracefully.", client_pid);
     exit(0); // 자식 프로세스는 자신의 역할을 마치면 반드시 종료합니다.
-}
\ No newline at end of file
+}
@@ -3,7 +3,17 @@
 
 #include "comm.h"
 #include "sig.h"
+#include "frame.h"
+
+// --- 매크로 정의 ---
+#define CLIENT_RETRY_MS 10 // 부모 링이 가득 찼을 때 다시 넣어 보는 간격 (그때만 타이머를 쓴다)
+#define CLIENT_RELAY_IOV 1024 // 부모 링의 레코드들을 소켓에 보내는 sendmsg() 한 번의 iovec 수 (UIO_MAXIOV 이하)
+// CHAT_IO=uring 일 때
+#define CLIENT_URING_ENTRIES 64          // 제출 큐 크기
+#define CLIENT_RECV_BUFS     16          // 커널에 맡겨 두는 받기 버퍼 수 (2의 거듭제곱)
+#define CLIENT_RECV_BUF      4096        // 받기 버퍼 하나의 크기
+
 void client_work(pid_t client_pid, pid_t main_pid, \
-                 int csock, int parent_pfd[2], int child_pfd[2]);
+                 int csock, shm_chan_t *from_parent, shm_chan_t *to_parent);
 
 #endif //CLIENTPROCESS_H
\ No newline at end of file
@@ -0,0 +1,604 @@
+#define _GNU_SOURCE // accept4()
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/timerfd.h>
+
+#include "comm.h"
+#include "frame.h"
+#include "cluster.h"
+
+// --- 구조체 정의 ---
+// 다른 노드 하나. 보내기는 내가 연 연결(out)로만 하고, 받기는 그 노드가 연 연결(in_link_t)로만 한다
+// 그래서 노드 쌍마다 방향별로 연결이 하나씩이고, 한 방향의 메시지 순서가 그대로 지켜진다
+typedef struct {
+    char addr[CLUSTER_ADDR];
+    struct sockaddr_in sa;
+    int out;                     // -1 : 끊김
+    bool connecting;             // 논블로킹 connect() 가 끝나기를 기다리는 중
+    bool up;
+    bool dirty;                  // 이번 회차에 대기열에 넣었다
+    bool held;                   // 이 노드가 연 링크를 읽지 않는다 (cluster_hold)
+    msg_queue_t outq;
+    note_t note;
+} peer_t;
+
+// 다른 노드가 연 연결 (받기만 한다)
+typedef struct {
+    int fd;                      // -1 : 빈 칸
+    int from;                    // LINK_HELLO 를 받기 전에는 -1
+    frame_buf_t in;
+    note_t note;
+} in_link_t;
+
+// 해시 고리의 점 하나
+typedef struct {
+    uint32_t hash;
+    int node;
+} vnode_t;
+
+static struct {
+    bool on;
+    int self;
+    int n;
+    peer_t peers[CLUSTER_MAX];   // peers[self] 는 쓰지 않는다
+    in_link_t in[CLUSTER_MAX * 2]; // 다시 이어지는 동안 옛 연결과 새 연결이 잠시 함께 있을 수 있다
+    vnode_t ring[CLUSTER_MAX * CLUSTER_VNODES];
+    int ring_n;
+    int lfd;
+    int tfd;                     // 다시 잇기 타이머 (끊긴 링크가 있을 때만 돈다)
+    bool timer_armed;
+    note_t listen_note;
+    note_t timer_note;
+    notify_t *nt;
+    const link_handler_t *handlers;
+} cl = { .lfd = -1, .tfd = -1 };
+
+// --- 해시 ---
+// FNV-1a 뒤에 비트를 한 번 더 섞는다 ("a:1#0", "a:1#1" 처럼 끝만 다른 이름도 고리 위에 고르게 흩어지도록)
+static uint32_t ring_hash(const char *p, size_t len)
+{
+    uint32_t h = fnv1a(p, len);
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+static int vnode_cmp(const void *a, const void *b)
+{
+    const vnode_t *x = a, *y = b;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    return x->node - y->node;
+}
+
+// 노드마다 "주소#i" 점을 CLUSTER_VNODES 개 찍는다. 모든 노드가 같은 목록으로 같은 고리를 만든다
+// 노드가 하나 늘거나 줄어도 그 노드의 점 사이에 있던 방만 주인이 바뀐다
+static void ring_build(void)
+{
+    char key[CLUSTER_ADDR + 16];
+
+    cl.ring_n = 0;
+    for (int i = 0; i < cl.n; i++) {
+        for (int v = 0; v < CLUSTER_VNODES; v++) {
+            int len = snprintf(key, sizeof(key), "%s#%d", cl.peers[i].addr, v);
+            cl.ring[cl.ring_n++] = (vnode_t){ .hash = ring_hash(key, len), .node = i };
+        }
+    }
+    qsort(cl.ring, cl.ring_n, sizeof(vnode_t), vnode_cmp);
+}
+
+int cluster_owner(const char *room)
+{
+    if (!cl.on) return cl.self;
+    uint32_t h = ring_hash(room, strlen(room));
+    // h 보다 크거나 같은 첫 점 (없으면 고리를 돌아 처음 점)
+    int lo = 0, hi = cl.ring_n;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (cl.ring[mid].hash < h) lo = mid + 1;
+        else hi = mid;
+    }
+    return cl.ring[lo == cl.ring_n ? 0 : lo].node;
+}
+
+bool cluster_owns(const char *room)
+{
+    return cluster_owner(room) == cl.self;
+}
+
+bool cluster_enabled(void)
+{
+    return cl.on;
+}
+
+int cluster_self(void)
+{
+    return cl.self;
+}
+
+int cluster_nodes(void)
+{
+    return cl.on ? cl.n : 1;
+}
+
+// --- 설정 ---
+// "host:port" -> 주소. host 는 이름이어도 된다 (처음 한 번만 찾는다)
+static int parse_addr(const char *s, struct sockaddr_in *sa)
+{
+    char host[CLUSTER_ADDR];
+    const char *colon = strrchr(s, ':');
+    if (colon == NULL || colon == s || (size_t)(colon - s) >= sizeof(host)) return -1;
+    memcpy(host, s, colon - s);
+    host[colon - s] = '\0';
+    char *end;
+    long port = strtol(colon + 1, &end, 10);
+    if (*end != '\0' || port <= 0 || port > 65535) return -1;
+
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM }, *res;
+    if (getaddrinfo(host, NULL, &hints, &res) != 0) return -1;
+    *sa = *(struct sockaddr_in *)res->ai_addr;
+    sa->sin_port = htons(port);
+    freeaddrinfo(res);
+    return 0;
+}
+
+static int load_config(void)
+{
+    const char *list = getenv(CLUSTER_ENV);
+    const char *self = getenv(CLUSTER_SELF_ENV);
+    if (list == NULL || *list == '\0' || self == NULL || *self == '\0') return 0;
+
+    // 업그레이드가 실패해서 다시 부를 수 있으므로 처음부터 채운다
+    cl.self = -1;
+    cl.n = 0;
+    for (const char *p = list; *p; ) {
+        const char *comma = strchr(p, ',');
+        size_t len = comma ? (size_t)(comma - p) : strlen(p);
+        if (len > 0) {
+            if (cl.n == CLUSTER_MAX || len >= CLUSTER_ADDR) {
+                chat_log(LOG_ERR, "Cluster: too many nodes or address too long in %s.", CLUSTER_ENV);
+                return -1;
+            }
+            peer_t *pe = &cl.peers[cl.n];
+            memset(pe, 0, sizeof(*pe));
+            memcpy(pe->addr, p, len);
+            pe->addr[len] = '\0';
+            if (parse_addr(pe->addr, &pe->sa) == -1) {
+                chat_log(LOG_ERR, "Cluster: bad node address '%s'.", pe->addr);
+                return -1;
+            }
+            pe->out = -1;
+            if (strcmp(pe->addr, self) == 0) cl.self = cl.n;
+            cl.n++;
+        }
+        p += len + (comma ? 1 : 0);
+    }
+    if (cl.self < 0) {
+        chat_log(LOG_ERR, "Cluster: %s '%s' is not in %s.", CLUSTER_SELF_ENV, self, CLUSTER_ENV);
+        return -1;
+    }
+    return 1;
+}
+
+// --- 다시 잇기 타이머 ---
+static void timer_arm(bool on)
+{
+    if (cl.timer_armed == on) return;
+    struct itimerspec its = { 0 };
+    if (on) {
+        its.it_value.tv_sec = CLUSTER_RETRY_MS / 1000;
+        its.it_value.tv_nsec = (CLUSTER_RETRY_MS % 1000) * 1000000L;
+        its.it_interval = its.it_value;
+    }
+    timerfd_settime(cl.tfd, 0, &its, NULL);
+    cl.timer_armed = on;
+}
+
+// --- 내보내는 링크 ---
+static void peer_down(peer_t *pe, const char *why)
+{
+    if (pe->out >= 0) {
+        notify_del(cl.nt, &pe->note);
+        close(pe->out);
+    }
+    if (pe->up) {
+        chat_log(LOG_WARNING, "Cluster: link to %s down (%s), %zu bytes queued.", pe->addr, why, pe->outq.bytes);
+        metrics_gauge_add(MET_CLUSTER_LINKS, -1);
+    }
+    pe->out = -1;
+    pe->up = false;
+    pe->connecting = false;
+    // 반쯤 보낸 프레임은 받는 쪽 연결과 함께 사라졌으므로 다시 이으면 처음부터 보낸다
+    pe->outq.bytes += pe->outq.off;
+    pe->outq.off = 0;
+    timer_arm(true);
+}
+
+static void peer_up(peer_t *pe)
+{
+    // 연결마다 처음에 내가 누구인지 알린다. 막 열린 소켓이라 송신 버퍼가 비어 있어 한 번에 들어간다
+    message_t *hello = cluster_encode(LINK_HELLO, "", "", cl.peers[cl.self].addr, strlen(cl.peers[cl.self].addr));
+    ssize_t n = hello ? send(pe->out, hello->data, hello->len, MSG_NOSIGNAL) : -1;
+    bool ok = hello && n == (ssize_t)hello->len;
+    msg_unref(hello);
+    if (!ok) {
+        peer_down(pe, "hello");
+        return;
+    }
+    pe->connecting = false;
+    pe->up = true;
+    pe->dirty = !msgq_empty(&pe->outq);
+    metrics_gauge_add(MET_CLUSTER_LINKS, 1);
+    chat_log(LOG_INFO, "Cluster: link to %s up, %zu bytes queued.", pe->addr, pe->outq.bytes);
+}
+
+static void peer_connect(peer_t *pe)
+{
+    pe->out = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (pe->out < 0) {
+        chat_log(LOG_ERR, "Cluster: socket for %s: %m", pe->addr);
+        return;
+    }
+    set_nodelay(pe->out);
+    if (notify_add(cl.nt, &pe->note, NOTE_LINK_OUT, pe->out) == -1) {
+        close(pe->out);
+        pe->out = -1;
+        return;
+    }
+    if (connect(pe->out, (struct sockaddr *)&pe->sa, sizeof(pe->sa)) == 0) {
+        peer_up(pe);
+        return;
+    }
+    if (errno != EINPROGRESS) {
+        peer_down(pe, strerror(errno));
+        return;
+    }
+    // 연결이 끝나면 쓰기 알림이 온다
+    pe->connecting = true;
+    notify_want_write(cl.nt, &pe->note, true);
+}
+
+// 끊긴 링크를 모두 다시 잇는다. 모두 이어져 있으면 타이머를 멈춘다
+static void reconnect_all(void)
+{
+    bool down = false;
+    for (int i = 0; i < cl.n; i++) {
+        peer_t *pe = &cl.peers[i];
+        if (i == cl.self) continue;
+        if (pe->out < 0) peer_connect(pe);
+        if (!pe->up) down = true;
+    }
+    timer_arm(down);
+}
+
+static void peer_event(peer_t *pe)
+{
+    if (pe->connecting) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(pe->out, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err != 0) {
+            // 상대가 아직 뜨지 않았으면 타이머가 다시 잇는다 (로그는 한 번만)
+            chat_log(LOG_DEBUG, "Cluster: connect to %s: %s", pe->addr, strerror(err));
+            peer_down(pe, strerror(err));
+            return;
+        }
+        peer_up(pe);
+        if (!pe->up) return;
+    }
+    // 이 연결로는 받을 것이 없다. 읽히면 상대가 닫은 것이다
+    char buf[64];
+    ssize_t n = recv(pe->out, buf, sizeof(buf), MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        peer_down(pe, n == 0 ? "closed by peer" : strerror(errno));
+        return;
+    }
+    pe->dirty = true;            // 쓰기 알림이면 남은 것을 보낸다
+}
+
+// --- 받는 링크 ---
+static void in_close(in_link_t *l)
+{
+    notify_del(cl.nt, &l->note);
+    close(l->fd);
+    frame_buf_free(&l->in);
+    if (l->from >= 0) chat_log(LOG_INFO, "Cluster: inbound link from %s closed.", cl.peers[l->from].addr);
+    l->fd = -1;
+}
+
+static void accept_links(void)
+{
+    while (1) {
+        int fd = accept4(cl.lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) chat_log(LOG_ERR, "Cluster: accept: %m");
+            return;
+        }
+        in_link_t *l = NULL;
+        for (size_t i = 0; i < sizeof(cl.in) / sizeof(cl.in[0]); i++) {
+            if (cl.in[i].fd < 0) {
+                l = &cl.in[i];
+                break;
+            }
+        }
+        if (l == NULL || frame_buf_init(&l->in, 0) == -1) {
+            chat_log(LOG_WARNING, "Cluster: no room for another inbound link.");
+            close(fd);
+            continue;
+        }
+        l->fd = fd;
+        l->from = -1;
+        if (notify_add(cl.nt, &l->note, NOTE_LINK_IN, fd) == -1) {
+            frame_buf_free(&l->in);
+            close(fd);
+            l->fd = -1;
+        }
+    }
+}
+
+// [종류][방 길이][방][사람 길이][사람][내용] 을 조각으로 나눈다. 틀렸으면 -1
+static int link_decode(const char *p, uint32_t len, link_msg_t *m)
+{
+    const char *end = p + len;
+
+    if (len < 3) return -1;
+    m->type = (unsigned char)*p++;
+    m->room.len = (unsigned char)*p++;
+    if (m->room.len > (size_t)(end - p) - 1) return -1;
+    m->room.p = p;
+    p += m->room.len;
+    m->user.len = (unsigned char)*p++;
+    if (m->user.len > (size_t)(end - p)) return -1;
+    m->user.p = p;
+    p += m->user.len;
+    m->text.p = p;
+    m->text.len = end - p;
+    return m->type < LINK_COUNT ? 0 : -1;
+}
+
+static int hello_node(strview_t addr)
+{
+    for (int i = 0; i < cl.n; i++) {
+        if (i != cl.self && sv_eq(addr, cl.peers[i].addr)) return i;
+    }
+    return -1;
+}
+
+// 재조립 버퍼에 쌓인 프레임을 처리한다. 보낸 노드를 붙잡으면 남은 것은 놓아 줄 때 처리한다
+static void in_drain(in_link_t *l)
+{
+    frame_view_t f;
+    link_msg_t m;
+    int rc;
+
+    while ((l->from < 0 || !cl.peers[l->from].held) && (rc = frame_next(&l->in, &f)) != 0) {
+        if (rc < 0 || link_decode(f.data, f.len, &m) == -1) {
+            chat_log(LOG_WARNING, "Cluster: bad frame on link from %s.", l->from >= 0 ? cl.peers[l->from].addr : "?");
+            in_close(l);
+            return;
+        }
+        if (l->from < 0) {
+            // 처음 프레임은 반드시 LINK_HELLO 이고, 목록에 있는 노드여야 한다
+            if (m.type != LINK_HELLO || (l->from = hello_node(m.text)) < 0) {
+                chat_log(LOG_WARNING, "Cluster: inbound link from unknown node '%.*s'.", (int)m.text.len, m.text.p);
+                in_close(l);
+                return;
+            }
+            chat_log(LOG_INFO, "Cluster: inbound link from %s.", cl.peers[l->from].addr);
+            if (cl.peers[l->from].held) notify_pause(cl.nt, &l->note, true);
+            continue;
+        }
+        if (cl.handlers[m.type]) cl.handlers[m.type](l->from, &m);
+    }
+}
+
+static void in_event(in_link_t *l)
+{
+    ssize_t n = frame_read(&l->in, l->fd);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        in_close(l);
+        return;
+    }
+    in_drain(l);
+}
+
+// --- 함수 ---
+int cluster_init(notify_t *nt, const link_handler_t handlers[LINK_COUNT])
+{
+    int rc = load_config();
+    if (rc <= 0) return rc;
+
+    cl.nt = nt;
+    cl.handlers = handlers;
+    cl.listen_note.fd = cl.timer_note.fd = -1;
+    cl.timer_armed = false;
+    for (int i = 0; i < cl.n; i++) cl.peers[i].note.fd = -1;
+    for (size_t i = 0; i < sizeof(cl.in) / sizeof(cl.in[0]); i++) cl.in[i].fd = cl.in[i].note.fd = -1;
+    ring_build();
+
+    // 링크 받기 소켓은 CHAT_NODE 주소에 연다 (클라이언트 포트와 따로)
+    const struct sockaddr_in *me = &cl.peers[cl.self].sa;
+    int optval = 1;
+    cl.lfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (cl.lfd < 0 || setsockopt(cl.lfd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)) < 0 ||
+        bind(cl.lfd, (const struct sockaddr *)me, sizeof(*me)) < 0 || listen(cl.lfd, CLUSTER_MAX) < 0) {
+        chat_log(LOG_ERR, "Cluster: cannot listen on %s: %m", cl.peers[cl.self].addr);
+        goto fail;
+    }
+    cl.tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (cl.tfd < 0 || notify_add(nt, &cl.listen_note, NOTE_LINK_LISTEN, cl.lfd) == -1 ||
+        notify_add(nt, &cl.timer_note, NOTE_LINK_TIMER, cl.tfd) == -1) {
+        chat_log(LOG_ERR, "Cluster: cannot watch link sockets: %m");
+        goto fail;
+    }
+    cl.on = true;
+    chat_log(LOG_INFO, "Cluster: node %d of %d (%s).", cl.self, cl.n, cl.peers[cl.self].addr);
+    reconnect_all();
+    return 0;
+
+fail:
+    notify_del(nt, &cl.listen_note);
+    notify_del(nt, &cl.timer_note);
+    if (cl.lfd >= 0) close(cl.lfd);
+    if (cl.tfd >= 0) close(cl.tfd);
+    cl.lfd = cl.tfd = -1;
+    return -1;
+}
+
+void cluster_forget(void)
+{
+    if (!cl.on) return;
+    // epoll 은 notify_forget() 이 이미 닫았다. 소켓만 닫고 대기열은 건드리지 않는다
+    for (int i = 0; i < cl.n; i++) {
+        if (cl.peers[i].out >= 0) close(cl.peers[i].out);
+    }
+    for (size_t i = 0; i < sizeof(cl.in) / sizeof(cl.in[0]); i++) {
+        if (cl.in[i].fd >= 0) close(cl.in[i].fd);
+    }
+    close(cl.lfd);
+    close(cl.tfd);
+    cl.on = false;
+}
+
+void cluster_shutdown(void)
+{
+    if (!cl.on) return;
+    cluster_flush();
+    for (int i = 0; i < cl.n; i++) {
+        peer_t *pe = &cl.peers[i];
+        if (pe->out >= 0) {
+            notify_del(cl.nt, &pe->note);
+            close(pe->out);
+        }
+        msgq_clear(&pe->outq);
+    }
+    for (size_t i = 0; i < sizeof(cl.in) / sizeof(cl.in[0]); i++) {
+        if (cl.in[i].fd >= 0) in_close(&cl.in[i]);
+    }
+    notify_del(cl.nt, &cl.listen_note);
+    notify_del(cl.nt, &cl.timer_note);
+    close(cl.lfd);
+    close(cl.tfd);
+    cl.on = false;
+}
+
+message_t *cluster_encode(int type, const char *room, const char *user, const char *text, size_t len)
+{
+    size_t rl = strnlen(room, ROOM_NAME), ul = strnlen(user, NAME);
+    // 링크 프레임도 FRAME_MAX 를 넘을 수 없으므로 가장 긴 메시지는 머리말만큼 잘린다
+    if (len > FRAME_MAX - 3 - rl - ul) len = FRAME_MAX - 3 - rl - ul;
+    size_t body = 3 + rl + ul + len;
+
+    message_t *m = msg_new(FRAME_HDR + body);
+    if (m == NULL) return NULL;
+    char *p = m->data;
+    frame_put_hdr(p, body);
+    p += FRAME_HDR;
+    *p++ = (char)type;
+    *p++ = (char)rl;
+    memcpy(p, room, rl);
+    p += rl;
+    *p++ = (char)ul;
+    memcpy(p, user, ul);
+    p += ul;
+    memcpy(p, text, len);
+    return m;
+}
+
+void cluster_send_msg(int node, message_t *m)
+{
+    if (!cl.on || node == cl.self || node < 0 || node >= cl.n || m == NULL) return;
+    peer_t *pe = &cl.peers[node];
+    // 상대가 오래 죽어 있으면 끝없이 쌓지 않고 버린다
+    if (pe->outq.bytes + m->len > CLUSTER_QUEUE_MAX || msgq_push(&pe->outq, m) == -1) {
+        metrics_inc(MET_CLUSTER_DROPPED);
+        return;
+    }
+    pe->dirty = true;
+}
+
+void cluster_send(int node, int type, const char *room, const char *user, const char *text, size_t len)
+{
+    if (!cl.on || node == cl.self) return;
+    message_t *m = cluster_encode(type, room, user, text, len);
+    if (m == NULL) {
+        metrics_inc(MET_CLUSTER_DROPPED);
+        return;
+    }
+    cluster_send_msg(node, m);
+    msg_unref(m);
+}
+
+void cluster_broadcast(int type, const char *room, const char *user, const char *text, size_t len)
+{
+    if (!cl.on) return;
+    message_t *m = cluster_encode(type, room, user, text, len);
+    if (m == NULL) {
+        metrics_inc(MET_CLUSTER_DROPPED);
+        return;
+    }
+    for (int i = 0; i < cl.n; i++) cluster_send_msg(i, m);
+    msg_unref(m);
+}
+
+void cluster_event(note_t *note)
+{
+    switch (note->kind) {
+    case NOTE_LINK_LISTEN:
+        accept_links();
+        break;
+    case NOTE_LINK_TIMER: {
+        uint64_t ticks;
+        if (read(cl.tfd, &ticks, sizeof(ticks)) < 0 && errno != EAGAIN) chat_log(LOG_WARNING, "Cluster: timer: %m");
+        reconnect_all();
+        break;
+    }
+    case NOTE_LINK_OUT:
+        peer_event(note_entry(note, peer_t, note));
+        break;
+    case NOTE_LINK_IN:
+        in_event(note_entry(note, in_link_t, note));
+        break;
+    }
+}
+
+void cluster_hold(int node, bool held)
+{
+    if (!cl.on || node < 0 || node >= cl.n || cl.peers[node].held == held) return;
+    cl.peers[node].held = held;
+    for (size_t i = 0; i < sizeof(cl.in) / sizeof(cl.in[0]); i++) {
+        in_link_t *l = &cl.in[i];
+        if (l->fd < 0 || l->from != node) continue;
+        notify_pause(cl.nt, &l->note, held);
+        // 붙잡기 전에 읽어 둔 프레임은 소켓 알림이 다시 오지 않으므로 바로 처리한다
+        if (!held) in_drain(l);
+    }
+}
+
+bool cluster_congested(int node)
+{
+    if (!cl.on || node < 0 || node >= cl.n) return false;
+    return cl.peers[node].outq.bytes > CLUSTER_QUEUE_HIGH;
+}
+
+void cluster_flush(void)
+{
+    if (!cl.on) return;
+    for (int i = 0; i < cl.n; i++) {
+        peer_t *pe = &cl.peers[i];
+        if (!pe->dirty || !pe->up) continue;
+        pe->dirty = false;
+        int rc = msgq_flush(&pe->outq, pe->out);
+        if (rc < 0) {
+            peer_down(pe, strerror(errno));
+            continue;
+        }
+        // 다 못 보냈으면 쓰기 알림을 켜 두고, 다 보냈으면 끈다
+        notify_want_write(cl.nt, &pe->note, rc == 0);
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "notify.h"
+#include "message.h"
+#include "command.h"
+
+// --- 매크로 정의 ---
+// 여러 서버가 한 묶음(클러스터)으로 돈다. 방마다 주인 노드가 하나 있고 (방 이름의 일관 해시),
+// 방의 기록과 메시지 순서는 주인만 들고 있다. 다른 노드에 있는 멤버의 메시지는 주인에게 보내고,
+// 주인이 그 방 멤버가 있는 노드들에게 다시 뿌린다. 노드 사이는 오래 붙어 있는 TCP 연결(링크)이다
+#define CLUSTER_ENV       "CHAT_CLUSTER"   // 모든 노드의 링크 주소 "host:port,host:port,..." (노드마다 같게)
+#define CLUSTER_SELF_ENV  "CHAT_NODE"      // 이 노드의 링크 주소 (CHAT_CLUSTER 안의 하나). 둘 중 하나라도 없으면 혼자 돈다
+#define CLUSTER_MAX       32               // 최대 노드 수
+#define CLUSTER_VNODES    64               // 해시 고리에 노드 하나가 차지하는 점 수 (많을수록 방이 고르게 나뉜다)
+#define CLUSTER_ADDR      64
+#define CLUSTER_RETRY_MS  1000             // 끊긴 링크를 다시 잇는 간격
+#define CLUSTER_QUEUE_MAX (8 * 1024 * 1024) // 링크 하나에 쌓아 두는 최대 바이트 (넘으면 버린다)
+#define CLUSTER_QUEUE_HIGH (1024 * 1024)   // 이보다 쌓이면 그 링크로 보내는 발행자를 멈춘다 (cluster_congested)
+
+// 링크 메시지 종류. 프레임 하나 = [종류 1][방 길이 1][방][사람 길이 1][사람][내용...]
+// 프레임 틀은 클라이언트 프로토콜과 같아서 (frame.h) 한 회차에 쌓인 것을 writev() 한 번으로 보낸다
+enum {
+    LINK_HELLO = 0,   // 연 쪽 -> 받은 쪽 : 내용 = 보낸 노드의 주소 (연결마다 처음 한 번)
+    LINK_ADD,         // -> 주인 : 방 만들기
+    LINK_RM,          // -> 주인 : 방 지우기, 주인 -> 멤버 노드 : 방이 지워졌다
+    LINK_SUB,         // -> 주인 : 사람이 이 노드에서 방에 들어왔다 (주인은 이 노드에 방 메시지를 보내고 기록을 사람에게 보낸다)
+    LINK_NOROOM,      // 주인 -> : 그런 방이 없다 (사람을 방에서 뺀다)
+    LINK_UNSUB,       // -> 주인 : 이 노드에는 방 멤버가 없다
+    LINK_PUB,         // -> 주인 : 방에 보낸 메시지 (내용 = "이름: 메시지")
+    LINK_MSG,         // 주인 -> 멤버 노드 : 방 메시지 (주인이 정한 순서)
+    LINK_TO,          // 사람 한 명에게 (명령 응답, 귓속말, 기록). 그 사람이 없는 노드는 버린다
+    LINK_LIST,        // 방 목록 요청 : 받은 노드는 자기가 주인인 방들을 LINK_TO 로 돌려준다
+    LINK_USERS,       // 방 사람 요청 : 받은 노드는 그 방의 자기 쪽 멤버들을 LINK_TO 로 돌려준다
+    LINK_HISTORY,     // -> 주인 : /history 인자 (결과는 LINK_TO)
+    LINK_SEARCH,      // -> 주인 : /search 인자 (결과는 LINK_TO)
+    LINK_COUNT
+};
+
+// --- 구조체 정의 ---
+// 받은 링크 메시지. 조각들은 링크의 재조립 버퍼 안을 가리키고 핸들러가 끝나면 사라진다
+typedef struct {
+    int type;
+    strview_t room;
+    strview_t user;
+    strview_t text;
+} link_msg_t;
+
+// from : 보낸 노드 번호
+typedef void (*link_handler_t)(int from, const link_msg_t *m);
+
+// --- 함수 ---
+// CHAT_CLUSTER/CHAT_NODE 를 읽고 링크를 연다. 꺼져 있으면 0 (혼자 돈다), 설정이 틀렸거나 못 열면 -1
+// 링크 소켓들은 nt 에 NOTE_LINK_* 로 건다. handlers[종류] 는 받은 메시지를 처리한다
+int cluster_init(notify_t *nt, const link_handler_t handlers[LINK_COUNT]);
+void cluster_shutdown(void);
+// fork() 한 자식에서 부른다. 물려받은 링크 소켓을 닫는다 (자식이 들고 있으면 부모가 닫아도 연결이 끊기지 않는다)
+void cluster_forget(void);
+bool cluster_enabled(void);
+
+// 방 이름의 주인 노드 번호. 혼자 돌면 늘 cluster_self()
+int cluster_owner(const char *room);
+bool cluster_owns(const char *room);
+int cluster_self(void);
+int cluster_nodes(void);
+
+// 보내기 : 링크별 대기열에 넣기만 하고, 소켓에는 회차 끝의 cluster_flush() 가 묶어서 쓴다
+// room/user 는 '\0' 으로 끝나는 문자열 ("" 이면 없음). 링크가 끊겨 있으면 다시 이어질 때 보낸다
+void cluster_send(int node, int type, const char *room, const char *user, const char *text, size_t len);
+// 나를 뺀 모든 노드에게
+void cluster_broadcast(int type, const char *room, const char *user, const char *text, size_t len);
+// 여러 노드에 같은 메시지를 보낼 때 한 번만 만든다 (refcnt 1). cluster_send_msg() 는 참조를 하나 더 잡는다
+message_t *cluster_encode(int type, const char *room, const char *user, const char *text, size_t len);
+void cluster_send_msg(int node, message_t *m);
+
+// 흐름 제어 : 주인의 방이 혼잡하면 그 방에 보내는 노드의 링크를 읽지 않는다 (TCP 가 그 노드를 늦춘다)
+// 보내는 쪽은 링크 대기열이 CLUSTER_QUEUE_HIGH 를 넘으면 그 링크로 보내는 자기 발행자를 멈춘다
+void cluster_hold(int node, bool held);
+bool cluster_congested(int node);
+
+// 부모 루프에서 NOTE_LINK_* 알림이 오면 부른다
+void cluster_event(note_t *note);
+// 회차 끝에 부른다. 이번 회차에 쌓인 것을 링크마다 writev() 한 번으로 보낸다
+void cluster_flush(void);
+
+#endif //CLUSTER_H
@@ -1,4 +1,6 @@
 #include "comm.h"
+#include <netinet/tcp.h> // TCP_NODELAY
+#include <sys/syscall.h>  // SYS_pidfd_open (glibc 에 감싼 함수가 없다)
 
 // --- FCNTL 관련 함수 ---
 int set_nonblocking(int fd) {
@@ -27,6 +29,27 @@ int set_blocking(int fd) {
     return 0;
 }
 
+// --- TCP 출력 묶기 ---
+int set_nodelay(int fd) {
+    int one = 1;
+    if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) == -1) {
+        syslog(LOG_ERR, "setsockopt(TCP_NODELAY) error for fd %d: %m", fd);
+        return -1;
+    }
+    return 0;
+}
+
+// --- 프로세스 지켜보기 ---
+int pid_watch(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return (int)syscall(SYS_pidfd_open, pid, 0); // pidfd 는 늘 CLOEXEC 로 열린다
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
 // --- 명령어 검사 함수 ---
 int check_command(const char* mesg, const char* command){
     if (mesg[0] == '/')
@@ -17,44 +17,90 @@
 #include <stdbool.h>  // bool 타입 사용을 위해 추가
 
 #include "deamon.h" // 데몬화 함수가 여기에 있다고 가정
+#include "shmring.h" // 부모<->자식 공유 메모리 링
+#include "room.h"    // 채팅방 목록 + 방별 멤버 리스트
+#include "command.h" // 명령 파서 + 핸들러 표
+#include "message.h" // 참조 카운트 메시지 + 출력 대기열
+#include "flowctl.h" // 출력 대기열 워터마크
+#include "metrics.h" // 카운터/히스토그램 + 유닉스 소켓 노출
+#include "slab.h"    // 자식 목록 (세대 핸들 + 빈칸 목록)
+#include "hashidx.h" // pid/닉네임 -> 자식 핸들 색인
+#include "notify.h"  // epoll + signalfd 알림
 #include <syslog.h> // syslog 사용
+#include "chatlog.h" // chat_log() : 스레드별 링 + 백그라운드 플러셔
 
 // --- 매크로 정의 ---
 #define TCP_PORT     5100
-#define MAX_CLIENT   32
-#define CHAT_ROOM    4
+#define PORT_ENV     "CHAT_PORT" // 클라이언트를 받을 포트 (없으면 TCP_PORT). 한 호스트에 노드 여럿을 띄울 때
+#define CHAT_ROOM    4     // 방 목록의 처음 칸 수 (모자라면 두 배로 늘어난다)
 #define NAME         32
+#define METRICS_SOCK "/tmp/chat_server.metrics" // CHAT_METRICS_SOCK 이 없을 때의 지표 소켓
+#define ACCEPT_RING_ENTRIES 64 // CHAT_IO=uring 일 때 부모 accept 링의 제출 큐 크기
+
+// 부모 루프가 기다리는 알림의 종류 (note_t.kind)
+enum {
+    NOTE_LISTEN,        // 서버 소켓
+    NOTE_METRICS,       // 지표 소켓
+    NOTE_SIGNAL,        // signalfd (SIGCHLD, SIGTERM, SIGINT, SIGUSR2)
+    NOTE_CHILD,         // 자식 하나의 to_parent 초인종 (pipeInfo.note)
+    NOTE_CHILD_EXIT,    // 업그레이드로 넘겨받은 자식의 pidfd (pipeInfo.exit_note). SIGCHLD 가 오지 않는 자식
+    NOTE_WORKER_RING,   // 작업자의 to_parent 초인종 (worker_t.ring_note)
+    NOTE_WORKER_CTL,    // 작업자의 제어 소켓 (worker_t.ctl_note)
+    NOTE_ACCEPT_RING,   // CHAT_IO=uring : 다중 accept 링의 완료 eventfd (서버 소켓 대신)
+    NOTE_LINK_LISTEN,   // 클러스터 : 다른 노드의 링크를 받는 소켓
+    NOTE_LINK_OUT,      // 클러스터 : 내가 연 링크 (보내기, 연결 끝남/끊김 감지)
+    NOTE_LINK_IN,       // 클러스터 : 다른 노드가 연 링크 (받기)
+    NOTE_LINK_TIMER,    // 클러스터 : 끊긴 링크 다시 잇기 timerfd
+    NOTE_ROOMLOG,       // 방 기록 쓰기 스레드가 끝낸 질의 (/history, /search)
+};
 
 // --- 구조체 정의 ---
-// 각 채팅방의 정보를 담는 구조체 (부모 프로세스에서 관리)
-typedef struct {
-    char name[NAME]; // 채팅방 이름
-    // 여기에 채팅방을 관리하는 추가적인 정보 (예: 채팅방을 담당하는 1차 자식 PID 등)를 추가할 수 있습니다.
-} roomInfo;
+struct worker; // workerpool.h
 
 // 각 클라이언트 핸들링 자식 프로세스(2차 자식)의 정보를 담는 구조체 (부모 프로세스에서 관리)
 typedef struct {
     pid_t pid;           // 2차 자식 프로세스의 PID
     char name[NAME];     // 클라이언트 닉네임 (입력받아 저장)
-    char room_name[NAME]; // 클라이언트가 접속한 채팅방 이름
-    int parent_to_child_write_fd; // 부모가 이 자식에게 메시지를 보낼 때 사용하는 파이프의 '쓰기' 끝 FD
-    int child_to_parent_read_fd;  // 이 자식이 부모에게 메시지를 보낼 때, 부모가 '읽을' 파이프의 FD
+    room_member_t room;   // 클라이언트가 접속한 채팅방 (방 id + 같은 방 멤버 링크)
+    shm_chan_t to_child;  // 부모 -> 자식 링 (부모가 넣고 자식이 꺼낸다)
+    shm_chan_t to_parent; // 자식 -> 부모 링 (자식이 넣고 부모가 꺼낸다)
+    msg_queue_t backlog;  // to_child 링이 가득 차서 못 넣은 메시지 (버리지 않고 순서대로 쌓는다)
+    flow_state_t flow;    // backlog 가 high/low 워터마크를 넘었는지
+    bool paused;          // 혼잡한 방에 보내다가 링을 읽지 않기로 한 발행자
     bool isActive;       // 클라이언트 연결의 활성 상태 (true: 활성, false: 비활성/종료)
+    struct worker *worker; // 작업자 풀 모드에서 이 연결을 맡은 작업자 (NULL : 자기 자식 프로세스, pid 는 그 자식)
+    note_t note;          // to_parent 초인종을 부모 epoll 에 건 것 (작업자 풀 모드에서는 쓰지 않는다)
+    bool adopted;         // 업그레이드 때 옛 프로세스에게서 넘겨받은 자식 (이 프로세스의 자식이 아니다)
+    int pidfd;            // adopted 일 때 그 자식의 pidfd (끝나면 읽을 수 있다)
+    note_t exit_note;     // pidfd 를 부모 epoll 에 건 것. 끝났다는 알림이 오면 떼어 두고 회차 끝에 레코드를 푼다
 } pipeInfo;
 
 // --- 전역 변수 선언 ---
-extern roomInfo room_info[CHAT_ROOM];  
-extern pipeInfo active_children[MAX_CLIENT]; 
-extern volatile int num_active_children; //활성화된 자식 프로세스(클라이언트 수);
-extern volatile int room_num;  // 만들어진 채팅방의 수
+extern room_registry_t rooms; // 채팅방 목록 (부모 프로세스에서 관리)
+extern slab_t active_children; // pipeInfo 들 (모자라면 SLAB_CHUNK 씩 늘어나고, 레코드 주소는 바뀌지 않는다)
+// 활성화된 자식 프로세스(클라이언트) 수는 active_children.used
+extern hidx_t child_by_pid;  // pid -> active_children 핸들 (접속 때 넣고 SIGCHLD 정리 때 뺀다)
+extern hidx_t child_by_name; // 닉네임 -> active_children 핸들 (이름을 정할 때 넣고 정리 때 뺀다)
 
-extern volatile sig_atomic_t parent_sigusr_arrived;  //부모에서 쓴다
-extern volatile sig_atomic_t child_sigusr_arrived;   //자식에서 쓴다
-extern volatile sig_atomic_t child_exited_flag;      //자식 죽음(클라이언트 종료)
+extern notify_t parent_notify; // 부모 루프의 epoll + signalfd (자식 초인종을 걸고 뺀다)
 
 // --- FCNTL 관련 함수 ---
 int set_nonblocking(int fd);
 int set_blocking(int fd);
+// --- TCP 출력 묶기 ---
+// 출력은 루프 한 바퀴(회차)마다 연결별로 모아 한 번에 보낸다. 그래서 Nagle 을 기다릴 이유가 없고
+// (혼자 온 메시지는 바로 나간다) 한 번에 다 못 보내는 큰 묶음은 MSG_MORE 로 이어 붙인다
+int set_nodelay(int fd);
 // 명령어 검사 함수
 int check_command(const char* mesg, const char* command);
+// --- 프로세스 지켜보기 ---
+// pid 프로세스가 끝나면 읽을 수 있게 되는 fd (pidfd). 자기 자식이 아니어도 된다 (SIGCHLD 가 오지 않는 프로세스)
+// 커널이 지원하지 않거나 그런 프로세스가 없으면 -1
+int pid_watch(pid_t pid);
+// --- 해시 (common.c) ---
+// 32비트 FNV-1a. 방 이름 -> 샤드/노드, 이름 색인, 방 기록 레코드 검사합에 같이 쓴다
+uint32_t fnv1a(const void *p, size_t len);
+// --- 설정 (common.c) ---
+// 환경 변수 name 의 정수 값. 없거나 비었으면 def, 숫자가 아니거나 min 보다 작으면 경고하고 def
+long env_long(const char *name, long def, long min);
 #endif // COMM_H
\ No newline at end of file
@@ -0,0 +1,96 @@
+#include <string.h>
+
+#include "command.h"
+#include "metrics.h"
+
+// --- 명령어 찾기 ---
+// 명령어 토큰을 (접두 문자, 길이, 첫 글자) 로 switch 해서 memcmp 한 번으로 확정한다
+// 새 명령을 추가할 때는 cmd_id_t 와 이 switch 에 한 줄씩 넣으면 된다
+static cmd_id_t cmd_lookup(char prefix, const char *tok, size_t len)
+{
+    if (prefix == '/') {
+        switch (len) {
+        case 2:
+            if (memcmp(tok, "rm", 2) == 0) return CMD_RM;
+            break;
+        case 3:
+            if (memcmp(tok, "add", 3) == 0) return CMD_ADD;
+            break;
+        case 4:
+            switch (tok[0]) {
+            case 'j': if (memcmp(tok, "join", 4) == 0) return CMD_JOIN; break;
+            case 'l': if (memcmp(tok, "list", 4) == 0) return CMD_LIST; break;
+            }
+            break;
+        case 5:
+            switch (tok[0]) {
+            case 'u': if (memcmp(tok, "users", 5) == 0) return CMD_USERS; break;
+            case 'l': if (memcmp(tok, "leave", 5) == 0) return CMD_LEAVE; break;
+            }
+            break;
+        case 6:
+            if (memcmp(tok, "search", 6) == 0) return CMD_SEARCH;
+            break;
+        case 7:
+            if (memcmp(tok, "history", 7) == 0) return CMD_HISTORY;
+            break;
+        }
+    } else if (prefix == '!') {
+        if (len == 7 && memcmp(tok, "whisper", 7) == 0) return CMD_WHISPER;
+    }
+    return CMD_UNKNOWN;
+}
+
+// --- 명령 함수 ---
+cmd_id_t cmd_parse(const char *mesg, size_t len, cmd_t *out)
+{
+    const char *end = mesg + len;
+
+    memset(out, 0, sizeof(*out));
+    // 일반 채팅은 여기서 바로 끝난다
+    if (len == 0 || (mesg[0] != '/' && mesg[0] != '!')) {
+        out->id = CMD_NONE;
+        return CMD_NONE;
+    }
+
+    // 명령어 토큰 : 접두 문자 뒤부터 공백/줄바꿈 전까지
+    const char *tok = mesg + 1;
+    const char *p = tok;
+    while (p < end && *p != ' ' && *p != '\n') p++;
+    out->id = cmd_lookup(mesg[0], tok, p - tok);
+
+    // 인자 : 공백 하나 뒤부터 끝까지 (끝의 줄바꿈은 뺀다)
+    if (p < end && *p == ' ') p++;
+    const char *arg_end = end;
+    while (arg_end > p && (arg_end[-1] == '\n' || arg_end[-1] == '\r')) arg_end--;
+    out->arg.p = p;
+    out->arg.len = arg_end - p;
+
+    // 첫 단어 / 나머지 (귓속말 대상과 내용)
+    const char *sp = memchr(p, ' ', arg_end - p);
+    out->target.p = p;
+    out->target.len = sp ? (size_t)(sp - p) : (size_t)(arg_end - p);
+    out->body.p = sp ? sp + 1 : arg_end;
+    out->body.len = sp ? (size_t)(arg_end - sp - 1) : 0;
+    return out->id;
+}
+
+void cmd_dispatch(const cmd_handler_t table[CMD_COUNT], void *srv, void *cli, const cmd_t *cmd)
+{
+    cmd_handler_t fn = table[cmd->id];
+    metrics_cmd(cmd->id);
+    if (fn) fn(srv, cli, cmd);
+}
+
+// --- 문자열 조각 함수 ---
+void sv_copy(char *dst, size_t size, strview_t sv)
+{
+    size_t n = sv.len < size - 1 ? sv.len : size - 1;
+    memcpy(dst, sv.p, n);
+    dst[n] = '\0';
+}
+
+bool sv_eq(strview_t sv, const char *s)
+{
+    return strncmp(s, sv.p, sv.len) == 0 && s[sv.len] == '\0';
+}
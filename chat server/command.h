@@ -1,6 +1,54 @@
 #ifndef COMMAND_H
 #define COMMAND_H
 
-void command();
+#include <stddef.h>
+#include <stdbool.h>
 
-#endif //COMMAND_H
\ No newline at end of file
+// --- 구조체 정의 ---
+// 원본 메시지 안을 가리키는 문자열 조각 (복사하지 않는다, '\0' 으로 끝나지 않음)
+typedef struct {
+    const char *p;
+    size_t len;
+} strview_t;
+
+// 명령어 번호. 핸들러 표의 인덱스로 바로 쓴다
+typedef enum {
+    CMD_NONE = 0,      // 일반 채팅 메시지 ('/' 나 '!' 로 시작하지 않음)
+    CMD_ADD,           // /add 방이름
+    CMD_JOIN,          // /join 방이름
+    CMD_RM,            // /rm 방이름
+    CMD_LIST,          // /list
+    CMD_USERS,         // /users
+    CMD_LEAVE,         // /leave
+    CMD_WHISPER,       // !whisper 닉네임 내용
+    CMD_HISTORY,       // /history N, /history since 유닉스시각(초)
+    CMD_SEARCH,        // /search 낱말...
+    CMD_UNKNOWN,       // '/' 나 '!' 로 시작하지만 모르는 명령
+    CMD_COUNT
+} cmd_id_t;
+
+// 한 번 훑어서 나눈 명령
+typedef struct {
+    cmd_id_t id;
+    strview_t arg;     // 명령어 뒤의 인자 전체 ("/add 방이름" -> "방이름")
+    strview_t target;  // arg 의 첫 단어 (!whisper 의 받는 사람)
+    strview_t body;    // 첫 단어 뒤 나머지 (!whisper 의 내용)
+} cmd_t;
+
+// 핸들러 : srv 는 서버 상태, cli 는 명령을 보낸 클라이언트 (백엔드마다 타입이 다르다)
+typedef void (*cmd_handler_t)(void *srv, void *cli, const cmd_t *cmd);
+
+// --- 명령 함수 ---
+// mesg[0..len) 을 명령어와 인자로 나눈다. 명령어 찾기는 길이/첫 글자 switch 라서
+// 명령이 늘어나도 일반 채팅 메시지는 첫 글자 하나만 보고 CMD_NONE 이 된다
+cmd_id_t cmd_parse(const char *mesg, size_t len, cmd_t *out);
+// table[cmd->id] 를 부른다. 등록되지 않은 명령은 무시한다
+void cmd_dispatch(const cmd_handler_t table[CMD_COUNT], void *srv, void *cli, const cmd_t *cmd);
+
+// --- 문자열 조각 함수 ---
+// 조각을 dst 에 '\0' 으로 끝나게 복사 (size 를 넘으면 자른다)
+void sv_copy(char *dst, size_t size, strview_t sv);
+// '\0' 으로 끝나는 s 와 같은지
+bool sv_eq(strview_t sv, const char *s);
+
+#endif //COMMAND_H
@@ -1,4 +1,7 @@
+#include <stdint.h>
+
 #include "common.h"
+#include "chatlog.h"
 
 volatile sig_atomic_t is_write_from_chat_room = 0;
 volatile sig_atomic_t is_write_from_client = 0;
@@ -9,3 +12,25 @@ volatile sig_atomic_t room_num = 0;
 roomInfo room_info[CHAT_ROOM];          // 실제 메모리 할당 및 초기화 (필요 시)
 pipeInfo client_pipe_info[CHAT_ROOM];
 
+// 32비트 FNV-1a
+uint32_t fnv1a(const void *p, size_t len)
+{
+    const unsigned char *c = p;
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) h = (h ^ c[i]) * 16777619u;
+    return h;
+}
+
+// 환경 변수 name 의 정수 값. 없거나 비었으면 def, 숫자가 아니거나 min 보다 작으면 경고하고 def
+long env_long(const char *name, long def, long min)
+{
+    const char *v = getenv(name);
+    if (v == NULL || *v == '\0') return def;
+    char *end;
+    long n = strtol(v, &end, 10);
+    if (*end != '\0' || n < min) {
+        chat_log(LOG_WARNING, "Ignoring bad %s='%s'", name, v);
+        return def;
+    }
+    return n;
+}
@@ -22,7 +22,7 @@ int daemonize(int argc, char *argv[])
         perror("error pid fork");
     }
     else if(pid !=0){
-        return 0;
+        exit(0); // 터미널에서 띄운 프로세스는 끝나고, 서버는 세션을 새로 연 자식이 돈다
     }
 
     setsid();
@@ -58,7 +58,5 @@ int daemonize(int argc, char *argv[])
 
     syslog(LOG_INFO, "Daemon Process");
 
-    while(1){}
-    closelog();
     return 0;
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #ifndef DAEMON_H
 #define DAEMON_H
 #include <stdio.h>
+#include <stdlib.h> // exit()
 #include <fcntl.h>
 #include <signal.h>
 #include <string.h>
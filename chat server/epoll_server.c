@@ -0,0 +1,64 @@
+// 단일 프로세스 epoll 채팅 서버
+// server.c 와 같은 명령어를 지원하지만, 연결마다 fork() 하지 않고
+// 한 프로세스가 모든 클라이언트 소켓을 epoll 로 직접 처리한다
+// 샤드 수를 주면 코어마다 리액터 스레드 하나씩 돌린다 (SO_REUSEPORT 로 연결을 나눔)
+//
+// 빌드 : gcc -O2 -pthread -o epoll_server epoll_server.c reactor.c chatcore.c shard.c mpsc.c flowctl.c metrics.c chatlog.c hashidx.c message.c frame.c room.c shmring.c comm.c command.c common.c
+// 실행 : ./epoll_server [포트] [샤드 수]   (기본 TCP_PORT, 샤드 1개)
+//        출력 대기열 한도는 CHAT_OUTQ_HIGH / CHAT_OUTQ_LOW / CHAT_OUTQ_HARD (바이트), CHAT_OUTQ_EVICT_MS 로 바꾼다
+//        로그는 CHAT_LOG_FILE 이 있으면 그 파일에, 없으면 syslog 로 (메시지마다 남기는 로그는 -DCHATLOG_LEVEL=LOG_DEBUG 로 빌드해야 나온다)
+//        지표는 CHAT_METRICS_SOCK (기본 /tmp/epoll_server.metrics) 유닉스 소켓에서 읽는다 : socat - UNIX-CONNECT:/tmp/epoll_server.metrics
+#include "reactor.h"
+
+#define EPOLL_METRICS_SOCK "/tmp/epoll_server.metrics"
+
+static shard_set_t shards;
+
+static void handle_shutdown(int signum)
+{
+    int saved_errno = errno;
+    reactor_shutdown = 1;
+    // 다른 스레드의 epoll_wait() 는 시그널로 깨지 않으므로 초인종을 눌러 준다
+    shard_set_wake(&shards);
+    errno = saved_errno;
+}
+
+int main(int argc, char **argv)
+{
+    int port = (argc > 1) ? atoi(argv[1]) : TCP_PORT;
+    int nshards = (argc > 2) ? atoi(argv[2]) : 1;
+
+    chatlog_init("epoll_server");
+
+    // 끊긴 소켓에 쓰다가 죽지 않도록 (send()는 MSG_NOSIGNAL 도 사용)
+    signal(SIGPIPE, SIG_IGN);
+
+    struct sigaction sa;
+    sa.sa_handler = handle_shutdown;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0; // epoll_wait()가 EINTR 로 깨어나 플래그를 확인하도록
+    if (sigaction(SIGINT, &sa, NULL) == -1 || sigaction(SIGTERM, &sa, NULL) == -1) {
+        chat_log(LOG_ERR, "Failed to set shutdown handler: %m");
+        exit(1);
+    }
+
+    flow_limits_load();
+    if (shard_set_init(&shards, nshards, port) == -1) exit(1);
+    chat_log(LOG_INFO, "epoll_server listening on port %d (%d shards)", port, shards.n);
+
+    // 지표 소켓은 0 번 샤드의 루프가 함께 본다 (지표 값은 원자 변수라 어느 샤드에서 읽어도 된다)
+    int mfd = metrics_listen(EPOLL_METRICS_SOCK);
+    if (mfd >= 0 && reactor_watch_metrics(shards.shard[0], mfd) == -1) {
+        metrics_close(mfd);
+        mfd = -1;
+    }
+
+    shard_set_run(&shards);
+
+    shard_set_destroy(&shards);
+    metrics_close(mfd);
+    chat_log(LOG_INFO, "Server shutting down gracefully.");
+    chatlog_shutdown();
+    closelog();
+    return 0;
+}
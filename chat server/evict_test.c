@@ -0,0 +1,295 @@
+// 느린 멤버 퇴출 시험 : 방 메시지를 퍼뜨리는 중에 한 멤버가 퇴출되어도 나머지 멤버는 모든 메시지를 받아야 한다
+// 발행자, fast_a, slow, fast_b 순서로 한 방에 들어간다 (방 멤버 목록은 나중에 들어온 것이 앞이라 slow 가 가운데에 온다)
+// slow 는 받기 버퍼를 줄이고 아무것도 읽지 않는다. 발행자가 번호를 붙인 메시지를 fast 멤버들이 받는 만큼 보내는 동안
+// 발행자, fast_a, fast_b 가 0 번부터 빠짐없이 차례대로 받는지, slow 는 퇴출되어 연결이 끊기는지 본다
+//
+// 빌드 : gcc -O2 -o evict_test evict_test.c frame.c
+// 실행 : ./evict_test [-h 주소] [-p 포트] [-n 메시지 수] [-s 메시지 크기] [-t 제한 초]
+//        서버는 high 와 hard 를 같게 띄운다. 그러면 발행자가 멈추기 전에 slow 의 대기열이 hard 에 닿아
+//        방 메시지를 퍼뜨리는 도중(backlog_push)에 퇴출된다
+//        예) CHAT_OUTQ_HIGH=524288 CHAT_OUTQ_HARD=524288 ./server
+// 결과 : 통과하면 0, 빠지거나 뒤바뀐 메시지가 있으면 1, slow 가 퇴출되지 않았거나 시간을 넘기면 2
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "frame.h"
+
+// --- 매크로 정의 ---
+#define EVT_MARK     "@@"         // 메시지 안의 번호 표시 : @@번호@@
+#define EVT_OUTBUF   (64 * 1024)  // 발행자 보내기 버퍼
+#define EVT_SLOW_BUF 4096         // slow 의 받기 버퍼 (서버 쪽 대기열이 빨리 차도록)
+#define EVT_WINDOW   64           // 읽는 멤버들이 받은 것보다 이만큼까지만 앞서 보낸다 (그 멤버들의 대기열은 쌓이지 않는다)
+#define EVT_ROOM     "evictroom"
+
+enum { PUB, FAST_A, SLOW, FAST_B, NCLIENT };
+
+// --- 구조체 정의 ---
+typedef struct {
+    const char *name;
+    int fd;
+    frame_buf_t in;
+    uint32_t next;               // 다음에 받아야 할 번호
+} evt_client_t;
+
+typedef struct {
+    const char *host;
+    int port;
+    uint32_t count;
+    int size;
+    double limit;
+} evt_opt_t;
+
+// --- 전역 변수 ---
+static evt_opt_t opt = { .host = "127.0.0.1", .port = 5100, .count = 20000, .size = 1000, .limit = 60 };
+static evt_client_t clients[NCLIENT] = {
+    [PUB] = { .name = "evt_pub" }, [FAST_A] = { .name = "evt_fast_a" },
+    [SLOW] = { .name = "evt_slow" }, [FAST_B] = { .name = "evt_fast_b" },
+};
+static bool failed;
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// --- 준비 ---
+static int client_connect(evt_client_t *c, bool slow)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(opt.port);
+    if (inet_pton(AF_INET, opt.host, &addr.sin_addr) != 1) {
+        fprintf(stderr, "bad address %s\n", opt.host);
+        return -1;
+    }
+
+    c->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (c->fd < 0) {
+        perror("socket()");
+        return -1;
+    }
+    // 받기 버퍼는 connect() 전에 줄여야 창 크기에 반영된다
+    if (slow) {
+        int sz = EVT_SLOW_BUF;
+        setsockopt(c->fd, SOL_SOCKET, SO_RCVBUF, &sz, sizeof(sz));
+    }
+    if (connect(c->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("connect()");
+        close(c->fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (frame_buf_init(&c->in, 0) == -1) return -1;
+    // 준비 명령은 블로킹으로 보내고 그 뒤로는 논블로킹으로 읽는다
+    if (frame_send(c->fd, c->name, strlen(c->name)) == -1) return -1;
+    return 0;
+}
+
+static void send_text(evt_client_t *c, const char *text)
+{
+    if (frame_send(c->fd, text, strlen(text)) == -1) {
+        fprintf(stderr, "%s: setup send failed\n", c->name);
+        failed = true;
+    }
+    // 서버가 명령을 처리할 시간을 준다 (fork 서버는 자식을 거쳐 부모로 간다)
+    usleep(100 * 1000);
+}
+
+// --- 받기 ---
+// 번호가 붙은 메시지만 본다 (입장 알림, 방 기록 같은 나머지 프레임은 건너뛴다)
+static void check_frame(evt_client_t *c, const char *p, size_t len)
+{
+    const char *m = memmem(p, len, EVT_MARK, 2);
+    if (m == NULL) return;
+    unsigned long seq = strtoul(m + 2, NULL, 10);
+    if (seq != c->next) {
+        fprintf(stderr, "%s: expected message %u, got %lu\n", c->name, c->next, seq);
+        failed = true;
+    }
+    c->next = seq + 1;
+}
+
+// 읽을 수 있는 만큼 읽는다. 연결이 끊겼으면 -1
+static int client_read(evt_client_t *c)
+{
+    while (1) {
+        ssize_t n = frame_read(&c->in, c->fd);
+        if (n > 0) {
+            frame_view_t f;
+            int rc;
+            while ((rc = frame_next(&c->in, &f)) == 1) {
+                check_frame(c, f.data, f.len);
+            }
+            if (rc < 0) return -1;
+            continue;
+        }
+        if (n == 0) return -1;
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+        return -1;
+    }
+}
+
+// --- 보내기 ---
+// 발행자 보내기 버퍼를 밀어낸다. 다 보냈으면 true
+static bool publish_some(char *out, size_t *out_len, uint32_t *seq)
+{
+    char payload[FRAME_MAX];
+    uint32_t acked = UINT32_MAX;
+
+    // slow 말고 가장 뒤처진 멤버 기준
+    for (int i = 0; i < NCLIENT; i++) {
+        if (i != SLOW && clients[i].next < acked) acked = clients[i].next;
+    }
+
+    while (*seq < opt.count && *seq < acked + EVT_WINDOW) {
+        int n = snprintf(payload, sizeof(payload), EVT_MARK "%u" EVT_MARK, *seq);
+        while (n < opt.size) payload[n++] = 'x';
+        size_t w = frame_encode(out + *out_len, EVT_OUTBUF - *out_len, payload, n);
+        if (w == 0) break;
+        *out_len += w;
+        (*seq)++;
+    }
+    size_t off = 0;
+    while (off < *out_len) {
+        ssize_t n = send(clients[PUB].fd, out + off, *out_len - off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("publisher send()");
+                failed = true;
+                *out_len = 0;
+                return true;
+            }
+            break;
+        }
+        off += n;
+    }
+    memmove(out, out + off, *out_len - off);
+    *out_len -= off;
+    return *seq == opt.count && *out_len == 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage : %s [-h host] [-p port] [-n messages] [-s bytes] [-t seconds]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    int ch;
+    while ((ch = getopt(argc, argv, "h:p:n:s:t:")) != -1) {
+        switch (ch) {
+        case 'h': opt.host = optarg; break;
+        case 'p': opt.port = atoi(optarg); break;
+        case 'n': opt.count = strtoul(optarg, NULL, 10); break;
+        case 's': opt.size = atoi(optarg); break;
+        case 't': opt.limit = atof(optarg); break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (opt.count == 0 || opt.limit <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (opt.size < 16) opt.size = 16;
+    if (opt.size >= FRAME_MAX) opt.size = FRAME_MAX - 1;
+    signal(SIGPIPE, SIG_IGN);
+
+    // 1. 접속 + 닉네임, 발행자가 /add, 발행자 -> fast_a -> slow -> fast_b 순서로 /join
+    for (int i = 0; i < NCLIENT; i++) {
+        if (client_connect(&clients[i], i == SLOW) == -1) return 2;
+    }
+    usleep(200 * 1000);
+    send_text(&clients[PUB], "/add " EVT_ROOM);
+    for (int i = 0; i < NCLIENT; i++) send_text(&clients[i], "/join " EVT_ROOM);
+    for (int i = 0; i < NCLIENT; i++) {
+        fcntl(clients[i].fd, F_SETFL, fcntl(clients[i].fd, F_GETFL) | O_NONBLOCK);
+        // 준비 중에 온 응답은 비워 둔다 (slow 도 여기까지는 읽는다)
+        client_read(&clients[i]);
+    }
+
+    // 2. 쏟아붓기 : slow 는 읽지 않는다
+    static char out[EVT_OUTBUF];
+    size_t out_len = 0;
+    uint32_t seq = 0;
+    bool sent_all = false;
+    uint64_t deadline = now_ms() + (uint64_t)(opt.limit * 1000);
+    struct pollfd pfd[NCLIENT];
+
+    while (clients[PUB].next < opt.count || clients[FAST_A].next < opt.count || clients[FAST_B].next < opt.count) {
+        if (now_ms() >= deadline) {
+            fprintf(stderr, "timed out: publisher %u, fast_a %u, fast_b %u of %u\n",
+                    clients[PUB].next, clients[FAST_A].next, clients[FAST_B].next, opt.count);
+            return 2;
+        }
+        if (!sent_all) sent_all = publish_some(out, &out_len, &seq);
+        for (int i = 0; i < NCLIENT; i++) {
+            pfd[i].fd = (i == SLOW) ? -1 : clients[i].fd;
+            pfd[i].events = POLLIN | (i == PUB && out_len ? POLLOUT : 0);
+        }
+        if (poll(pfd, NCLIENT, 100) < 0 && errno != EINTR) {
+            perror("poll()");
+            return 2;
+        }
+        for (int i = 0; i < NCLIENT; i++) {
+            if (pfd[i].fd < 0 || !(pfd[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            if (client_read(&clients[i]) == -1) {
+                fprintf(stderr, "%s: disconnected after message %u\n", clients[i].name, clients[i].next);
+                return 1;
+            }
+        }
+    }
+
+    // 3. slow 는 퇴출되어 끊겼어야 한다 (쌓인 것을 다 읽으면 EOF)
+    bool evicted = false;
+    uint64_t slow_end = now_ms() + 5000;
+    while (now_ms() < slow_end) {
+        struct pollfd p = { .fd = clients[SLOW].fd, .events = POLLIN };
+        if (poll(&p, 1, 100) <= 0) continue;
+        char buf[65536];
+        ssize_t n = read(clients[SLOW].fd, buf, sizeof(buf));
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+            evicted = true;
+            break;
+        }
+    }
+
+    printf("messages    %u x %d B\n", opt.count, opt.size);
+    printf("publisher   %u\n", clients[PUB].next);
+    printf("fast_a      %u\n", clients[FAST_A].next);
+    printf("fast_b      %u\n", clients[FAST_B].next);
+    printf("slow        %s\n", evicted ? "evicted" : "still connected");
+    for (int i = 0; i < NCLIENT; i++) {
+        close(clients[i].fd);
+        frame_buf_free(&clients[i].in);
+    }
+    if (failed) return 1;
+    if (!evicted) {
+        fprintf(stderr, "slow member was not evicted, nothing was tested\n");
+        return 2;
+    }
+    printf("ok\n");
+    return 0;
+}
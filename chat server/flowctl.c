@@ -0,0 +1,52 @@
+#include <stdlib.h>
+#include <syslog.h>
+#include <time.h>
+
+#include "flowctl.h"
+#include "comm.h"
+
+flow_limits_t flow_limits = {
+    .high     = FLOW_HIGH_WATER,
+    .low      = FLOW_LOW_WATER,
+    .hard     = FLOW_HARD_LIMIT,
+    .evict_ms = FLOW_EVICT_MS,
+};
+
+void flow_limits_load(void)
+{
+    flow_limits.high = env_long("CHAT_OUTQ_HIGH", FLOW_HIGH_WATER, 1);
+    flow_limits.low = env_long("CHAT_OUTQ_LOW", FLOW_LOW_WATER, 1);
+    flow_limits.hard = env_long("CHAT_OUTQ_HARD", FLOW_HARD_LIMIT, 1);
+    flow_limits.evict_ms = env_long("CHAT_OUTQ_EVICT_MS", FLOW_EVICT_MS, 1);
+
+    // low <= high <= hard 가 아니면 상태가 오락가락하므로 맞춰 준다
+    if (flow_limits.low > flow_limits.high) flow_limits.low = flow_limits.high;
+    if (flow_limits.hard < flow_limits.high) flow_limits.hard = flow_limits.high;
+    syslog(LOG_INFO, "Output queue limits: high %zu, low %zu, hard %zu bytes, evict after %ld ms",
+           flow_limits.high, flow_limits.low, flow_limits.hard, flow_limits.evict_ms);
+}
+
+int64_t flow_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int flow_update(flow_state_t *fs, size_t queued)
+{
+    if (queued >= flow_limits.hard) return FLOW_EVICT;
+
+    if (!fs->congested) {
+        if (queued <= flow_limits.high) return FLOW_OK;
+        fs->congested = true;
+        fs->since_ms = flow_now_ms();
+        return FLOW_CONGESTED;
+    }
+    if (queued <= flow_limits.low) {
+        fs->congested = false;
+        return FLOW_RELIEVED;
+    }
+    if (flow_now_ms() - fs->since_ms >= flow_limits.evict_ms) return FLOW_EVICT;
+    return FLOW_OK;
+}
@@ -0,0 +1,46 @@
+#ifndef FLOWCTL_H
+#define FLOWCTL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// --- 매크로 정의 ---
+// 연결별 출력 대기열 한도 기본값 (환경 변수로 바꿀 수 있다)
+#define FLOW_HIGH_WATER   (256 * 1024)  // CHAT_OUTQ_HIGH : 넘으면 혼잡 (그 방 발행자 읽기 멈춤)
+#define FLOW_LOW_WATER    (64 * 1024)   // CHAT_OUTQ_LOW  : 밑으로 빠지면 혼잡 해제 (발행자 다시 읽기)
+#define FLOW_HARD_LIMIT   (1024 * 1024) // CHAT_OUTQ_HARD : 넘으면 바로 퇴출
+#define FLOW_EVICT_MS     5000          // CHAT_OUTQ_EVICT_MS : 혼잡이 이만큼 이어지면 퇴출
+
+// --- 구조체 정의 ---
+typedef struct {
+    size_t high;
+    size_t low;
+    size_t hard;
+    long evict_ms;
+} flow_limits_t;
+
+// 연결 하나의 혼잡 상태
+typedef struct {
+    bool congested;              // high 를 넘은 뒤 아직 low 밑으로 안 내려갔다
+    int64_t since_ms;            // 혼잡이 시작된 시각 (CLOCK_MONOTONIC, 32비트 long 은 24일이면 넘친다)
+} flow_state_t;
+
+// flow_update() 결과
+enum {
+    FLOW_OK = 0,                 // 상태 변화 없음
+    FLOW_CONGESTED,              // 방금 high 를 넘었다
+    FLOW_RELIEVED,               // 방금 low 밑으로 내려갔다
+    FLOW_EVICT,                  // hard 를 넘었거나 너무 오래 혼잡했다
+};
+
+extern flow_limits_t flow_limits;
+
+// --- 함수 ---
+// CHAT_OUTQ_* 환경 변수를 읽어 flow_limits 를 채운다 (없으면 기본값)
+void flow_limits_load(void);
+// 대기열 길이가 바뀐 뒤 부른다. 시계는 혼잡한 동안에만 읽는다
+int flow_update(flow_state_t *fs, size_t queued);
+int64_t flow_now_ms(void);
+
+#endif //FLOWCTL_H
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/uio.h>
+
+#include "frame.h"
+
+// --- 인코더 ---
+void frame_put_hdr(char hdr[FRAME_HDR], uint32_t len)
+{
+    uint32_t be = htonl(len);
+    memcpy(hdr, &be, FRAME_HDR);
+}
+
+size_t frame_encode(char *dst, size_t cap, const void *payload, uint32_t len)
+{
+    if (cap < FRAME_HDR + (size_t)len) return 0;
+    frame_put_hdr(dst, len);
+    memcpy(dst + FRAME_HDR, payload, len);
+    return FRAME_HDR + len;
+}
+
+int frame_send(int fd, const void *payload, uint32_t len)
+{
+    char hdr[FRAME_HDR];
+    struct iovec iov[2];
+
+    frame_put_hdr(hdr, len);
+    iov[0].iov_base = hdr;
+    iov[0].iov_len = FRAME_HDR;
+    iov[1].iov_base = (void *)payload;
+    iov[1].iov_len = len;
+
+    int idx = 0;
+    while (idx < 2) {
+        ssize_t n = writev(fd, iov + idx, 2 - idx);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        // 덜 보낸 만큼 iovec 을 앞으로 민다
+        while (idx < 2 && (size_t)n >= iov[idx].iov_len) {
+            n -= iov[idx].iov_len;
+            idx++;
+        }
+        if (idx < 2) {
+            iov[idx].iov_base = (char *)iov[idx].iov_base + n;
+            iov[idx].iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+// --- 재조립 버퍼 ---
+int frame_buf_init(frame_buf_t *fb, size_t cap)
+{
+    // 가장 긴 프레임 하나는 통째로 들어가야 한다
+    if (cap < FRAME_HDR + FRAME_MAX) cap = FRAME_HDR + FRAME_MAX;
+    fb->buf = malloc(cap + 1);
+    if (fb->buf == NULL) return -1;
+    fb->cap = cap;
+    fb->start = fb->end = 0;
+    return 0;
+}
+
+void frame_buf_free(frame_buf_t *fb)
+{
+    free(fb->buf);
+    fb->buf = NULL;
+    fb->cap = fb->start = fb->end = 0;
+}
+
+char *frame_buf_space(frame_buf_t *fb, size_t *avail)
+{
+    if (fb->start == fb->end) {
+        fb->start = fb->end = 0;
+    } else if (fb->start > 0 && fb->cap - fb->end < FRAME_HDR + FRAME_MAX) {
+        // 뒤쪽 공간이 모자랄 때만 남은 조각을 앞으로 당긴다
+        memmove(fb->buf, fb->buf + fb->start, fb->end - fb->start);
+        fb->end -= fb->start;
+        fb->start = 0;
+    }
+    *avail = fb->cap - fb->end;
+    return fb->buf + fb->end;
+}
+
+void frame_buf_commit(frame_buf_t *fb, size_t n)
+{
+    fb->end += n;
+}
+
+ssize_t frame_read(frame_buf_t *fb, int fd)
+{
+    size_t avail;
+    char *p = frame_buf_space(fb, &avail);
+    ssize_t n = read(fd, p, avail);
+    if (n > 0) frame_buf_commit(fb, n);
+    return n;
+}
+
+int frame_next(frame_buf_t *fb, frame_view_t *out)
+{
+    size_t have = fb->end - fb->start;
+    uint32_t be, len;
+
+    if (have < FRAME_HDR) return 0;
+    memcpy(&be, fb->buf + fb->start, FRAME_HDR);
+    len = ntohl(be);
+    if (len > FRAME_MAX) return -1;
+    if (have < FRAME_HDR + (size_t)len) return 0;
+
+    out->data = fb->buf + fb->start + FRAME_HDR;
+    out->len = len;
+    fb->start += FRAME_HDR + len;
+    return 1;
+}
+
+void frame_unget(frame_buf_t *fb, const frame_view_t *f)
+{
+    fb->start -= FRAME_HDR + f->len;
+}
@@ -0,0 +1,55 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// --- 매크로 정의 ---
+// 채팅 프로토콜 프레임 : [4바이트 길이 (네트워크 바이트 순서)][내용]
+// read() 한 번이 메시지 하나라고 가정하지 않는다. 여러 메시지가 붙어서 오거나
+// 한 메시지가 여러 번에 나눠 와도 재조립 버퍼에서 프레임 단위로 잘라낸다
+#define FRAME_HDR   4
+#define FRAME_MAX   (BUFSIZ * 2)   // 이보다 긴 프레임은 프로토콜 오류로 본다
+
+// --- 구조체 정의 ---
+// 재조립 버퍼 안을 가리키는 프레임 (복사 없음)
+// 다음 frame_read()/frame_buf_space() 호출 전까지만 유효하다
+typedef struct {
+    char *data;
+    uint32_t len;
+} frame_view_t;
+
+// 연결별 재조립 버퍼
+// [start, end) 에 아직 처리하지 않은 바이트가 들어 있다
+// buf 는 cap + 1 바이트라서 프레임 바로 뒤에 '\0' 을 잠시 써서 문자열처럼 쓸 수 있다
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t start;
+    size_t end;
+} frame_buf_t;
+
+// --- 인코더 ---
+void frame_put_hdr(char hdr[FRAME_HDR], uint32_t len);
+// dst 에 헤더 + 내용을 쓴다. 전체 길이 (cap 이 모자라면 0)
+size_t frame_encode(char *dst, size_t cap, const void *payload, uint32_t len);
+// 헤더 + 내용을 한 번의 writev() 로 보낸다 (블로킹 소켓용, 다 보낼 때까지 반복)
+int frame_send(int fd, const void *payload, uint32_t len);
+
+// --- 재조립 버퍼 ---
+int frame_buf_init(frame_buf_t *fb, size_t cap);
+void frame_buf_free(frame_buf_t *fb);
+// 다음 read() 가 채울 빈 공간. 앞쪽의 처리 끝난 바이트는 이때 한 번에 당긴다
+char *frame_buf_space(frame_buf_t *fb, size_t *avail);
+void frame_buf_commit(frame_buf_t *fb, size_t n);
+// fd 에서 한 번 읽어 버퍼에 붙인다. read() 의 반환값 그대로
+ssize_t frame_read(frame_buf_t *fb, int fd);
+// 완성된 프레임 하나를 꺼낸다
+// 1 : 꺼냄, 0 : 아직 덜 왔음, -1 : 길이가 FRAME_MAX 를 넘는 잘못된 프레임
+int frame_next(frame_buf_t *fb, frame_view_t *out);
+// 방금 frame_next() 로 꺼낸 프레임을 버퍼에 되돌린다 (넘길 곳이 가득 찼을 때)
+void frame_unget(frame_buf_t *fb, const frame_view_t *f);
+
+#endif //FRAME_H
@@ -0,0 +1,160 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "hashidx.h"
+#include "comm.h"
+
+#define HIDX_INIT_CAP 64
+
+// --- 해시 ---
+static uint32_t hash_id(uint32_t id)
+{
+    // 연속된 pid 도 고르게 퍼지도록 섞는다 (murmur3 마무리 단계)
+    id ^= id >> 16;
+    id *= 0x85ebca6bu;
+    id ^= id >> 13;
+    id *= 0xc2b2ae35u;
+    id ^= id >> 16;
+    return id ? id : 1;
+}
+
+static uint32_t hash_name(const char *p, size_t len)
+{
+    uint32_t h = fnv1a(p, len);
+    return h ? h : 1;
+}
+
+// --- 칸 찾기 ---
+static bool slot_match(const hidx_slot_t *s, uint32_t hash, uint32_t key, const char *name)
+{
+    if (s->hash != hash || s->key != key) return false;
+    return name == NULL || memcmp(s->name, name, key) == 0;
+}
+
+// 키가 같은 첫 칸 (val_match 면 값까지 같은 칸). 없으면 -1
+static long find(const hidx_t *h, uint32_t hash, uint32_t key, const char *name, bool val_match, uint64_t val)
+{
+    if (h->cap == 0) return -1;
+    uint32_t mask = h->cap - 1;
+    for (uint32_t i = hash & mask; h->slots[i].hash != 0; i = (i + 1) & mask) {
+        const hidx_slot_t *s = &h->slots[i];
+        if (slot_match(s, hash, key, name) && (!val_match || s->val == val)) return i;
+    }
+    return -1;
+}
+
+static void place(hidx_t *h, const hidx_slot_t *src)
+{
+    uint32_t mask = h->cap - 1;
+    uint32_t i = src->hash & mask;
+    while (h->slots[i].hash != 0) i = (i + 1) & mask;
+    h->slots[i] = *src;
+}
+
+static int grow(hidx_t *h)
+{
+    uint32_t old_cap = h->cap;
+    hidx_slot_t *old = h->slots;
+    uint32_t cap = old_cap ? old_cap * 2 : HIDX_INIT_CAP;
+
+    hidx_slot_t *slots = calloc(cap, sizeof(hidx_slot_t));
+    if (slots == NULL) return -1;
+    h->slots = slots;
+    h->cap = cap;
+    for (uint32_t i = 0; i < old_cap; i++) {
+        if (old[i].hash != 0) place(h, &old[i]);
+    }
+    free(old);
+    return 0;
+}
+
+static int put(hidx_t *h, uint32_t hash, uint32_t key, char *name, uint64_t val)
+{
+    if ((uint64_t)(h->count + 1) * 10 > (uint64_t)h->cap * 7 && grow(h) == -1) return -1;
+    hidx_slot_t s = { .hash = hash, .key = key, .name = name, .val = val };
+    place(h, &s);
+    h->count++;
+    return 0;
+}
+
+// i 칸을 비우고, 뒤에 이어진 칸들 중 제자리(해시 위치)가 i 이전인 것을 당겨 온다
+static void remove_at(hidx_t *h, uint32_t i)
+{
+    uint32_t mask = h->cap - 1;
+    free(h->slots[i].name);
+    h->slots[i].hash = 0;
+    h->count--;
+
+    for (uint32_t j = (i + 1) & mask; h->slots[j].hash != 0; j = (j + 1) & mask) {
+        uint32_t home = h->slots[j].hash & mask;
+        // home 이 (i, j] 구간 밖이면 j 는 i 자리로 옮겨도 탐사가 끊기지 않는다
+        bool in_range = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+        if (in_range) continue;
+        h->slots[i] = h->slots[j];
+        h->slots[j].hash = 0;
+        h->slots[j].name = NULL;
+        i = j;
+    }
+}
+
+// --- 함수 ---
+void hidx_init(hidx_t *h)
+{
+    memset(h, 0, sizeof(*h));
+}
+
+void hidx_free(hidx_t *h)
+{
+    for (uint32_t i = 0; i < h->cap; i++) {
+        if (h->slots[i].hash != 0) free(h->slots[i].name);
+    }
+    free(h->slots);
+    hidx_init(h);
+}
+
+int hidx_put_id(hidx_t *h, uint32_t id, uint64_t val)
+{
+    return put(h, hash_id(id), id, NULL, val);
+}
+
+int hidx_get_id(const hidx_t *h, uint32_t id, uint64_t *val)
+{
+    long i = find(h, hash_id(id), id, NULL, false, 0);
+    if (i < 0) return 0;
+    *val = h->slots[i].val;
+    return 1;
+}
+
+void hidx_del_id(hidx_t *h, uint32_t id, uint64_t val)
+{
+    long i = find(h, hash_id(id), id, NULL, true, val);
+    if (i >= 0) remove_at(h, i);
+}
+
+int hidx_put_name(hidx_t *h, const char *name, size_t len, uint64_t val)
+{
+    char *copy = malloc(len + 1);
+    if (copy == NULL) return -1;
+    memcpy(copy, name, len);
+    copy[len] = '\0';
+    if (put(h, hash_name(name, len), len, copy, val) == -1) {
+        free(copy);
+        return -1;
+    }
+    return 0;
+}
+
+int hidx_get_name(const hidx_t *h, const char *name, size_t len, uint64_t *val)
+{
+    long i = find(h, hash_name(name, len), len, name, false, 0);
+    if (i < 0) return 0;
+    *val = h->slots[i].val;
+    return 1;
+}
+
+void hidx_del_name(hidx_t *h, const char *name, size_t len, uint64_t val)
+{
+    long i = find(h, hash_name(name, len), len, name, true, val);
+    if (i >= 0) remove_at(h, i);
+}
@@ -0,0 +1,40 @@
+#ifndef HASHIDX_H
+#define HASHIDX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- 구조체 정의 ---
+// 열린 주소(선형 탐사) 해시 색인 : 키 -> 64비트 값 (slab 핸들, 연결 참조 등을 접어 넣는다)
+// 표 하나에는 정수 키나 이름 키 한 종류만 넣는다
+// 같은 키를 여러 번 넣을 수 있고 (같은 닉네임), 지울 때는 키와 값이 모두 맞는 칸만 지운다
+// 지운 자리는 뒤 칸들을 당겨 메우므로 묘비가 쌓이지 않는다
+typedef struct {
+    uint32_t hash;               // 0 : 빈 칸 (실제 해시 0 은 1 로 바꿔 쓴다)
+    uint32_t key;                // 정수 키, 또는 이름 키의 길이
+    char *name;                  // 이름 키의 사본 (표가 가지고 있다). 정수 키면 NULL
+    uint64_t val;
+} hidx_slot_t;
+
+typedef struct {
+    hidx_slot_t *slots;
+    uint32_t cap;                // 칸 수 (2의 거듭제곱, 70% 를 넘으면 두 배)
+    uint32_t count;
+} hidx_t;
+
+// --- 함수 ---
+void hidx_init(hidx_t *h);
+void hidx_free(hidx_t *h);
+
+// 정수 키 (pid 등). 넣기는 메모리가 없으면 -1
+int hidx_put_id(hidx_t *h, uint32_t id, uint64_t val);
+// 찾으면 1 (*val 에 값), 없으면 0
+int hidx_get_id(const hidx_t *h, uint32_t id, uint64_t *val);
+void hidx_del_id(hidx_t *h, uint32_t id, uint64_t val);
+
+// 이름 키 (닉네임 등). name[0..len) 을 복사해서 들고 있으므로 '\0' 으로 끝나지 않는 조각도 된다
+int hidx_put_name(hidx_t *h, const char *name, size_t len, uint64_t val);
+int hidx_get_name(const hidx_t *h, const char *name, size_t len, uint64_t *val);
+void hidx_del_name(hidx_t *h, const char *name, size_t len, uint64_t val);
+
+#endif //HASHIDX_H
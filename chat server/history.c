@@ -0,0 +1,70 @@
+#include <stdlib.h>
+#include <syslog.h>
+
+#include "history.h"
+#include "comm.h"
+
+history_limits_t history_limits = { HISTORY_COUNT, HISTORY_BYTES };
+
+static size_t msg_cost(const message_t *m)
+{
+    return sizeof(message_t) + m->len;
+}
+
+// 가장 오래된 메시지를 놓는다
+static void drop_oldest(room_history_t *h)
+{
+    message_t *m = h->items[h->head];
+    h->bytes -= msg_cost(m);
+    msg_unref(m);
+    h->head = (h->head + 1) % h->cap;
+    h->count--;
+}
+
+// --- 함수 ---
+void history_limits_load(void)
+{
+    // 0 도 받는다 (기록 끄기)
+    history_limits.count = env_long("CHAT_HISTORY_COUNT", HISTORY_COUNT, 0);
+    history_limits.bytes = env_long("CHAT_HISTORY_BYTES", HISTORY_BYTES, 0);
+    if (history_limits.bytes == 0) history_limits.count = 0;
+    syslog(LOG_INFO, "Room history limits: %u messages, %zu bytes", history_limits.count, history_limits.bytes);
+}
+
+void history_init(room_history_t *h)
+{
+    h->items = NULL;
+    h->head = h->count = h->cap = 0;
+    h->bytes = 0;
+}
+
+void history_clear(room_history_t *h)
+{
+    while (h->count > 0) drop_oldest(h);
+    free(h->items);
+    history_init(h);
+}
+
+int history_push(room_history_t *h, message_t *m)
+{
+    size_t cost = msg_cost(m);
+
+    if (history_limits.count == 0 || cost > history_limits.bytes) return 0;
+    if (h->items == NULL) {
+        h->items = malloc(sizeof(message_t *) * history_limits.count);
+        if (h->items == NULL) return -1;
+        h->cap = history_limits.count;
+    }
+    while (h->count > 0 && (h->count == h->cap || h->bytes + cost > history_limits.bytes)) {
+        drop_oldest(h);
+    }
+    h->items[(h->head + h->count) % h->cap] = msg_ref(m);
+    h->count++;
+    h->bytes += cost;
+    return 0;
+}
+
+size_t history_mem(const room_history_t *h)
+{
+    return h->bytes + sizeof(message_t *) * h->cap;
+}
@@ -0,0 +1,51 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "message.h"
+
+// --- 매크로 정의 ---
+// 방마다 남겨 두는 최근 메시지 한도 기본값 (환경 변수로 바꿀 수 있다, 0 이면 기록하지 않는다)
+#define HISTORY_COUNT     100           // CHAT_HISTORY_COUNT : 메시지 수
+#define HISTORY_BYTES     (32 * 1024)   // CHAT_HISTORY_BYTES : 메시지 메모리 (머리말 포함)
+
+// --- 구조체 정의 ---
+typedef struct {
+    uint32_t count;
+    size_t bytes;
+} history_limits_t;
+
+// 방 하나의 최근 메시지 (브로드캐스트한 메시지 참조들의 원형 배열)
+// 멤버들의 출력 대기열과 같은 message_t 를 가리키므로 내용을 복사하지 않는다
+// 수나 바이트 한도를 넘으면 가장 오래된 것부터 놓는다
+typedef struct {
+    message_t **items;           // 처음 넣을 때 한도 수만큼 잡는다 (조용한 방은 메모리를 쓰지 않는다)
+    uint32_t head;               // 가장 오래된 메시지 위치
+    uint32_t count;
+    uint32_t cap;
+    size_t bytes;                // 들고 있는 메시지들의 크기 합 (sizeof(message_t) + len)
+} room_history_t;
+
+extern history_limits_t history_limits;
+
+// --- 함수 ---
+// CHAT_HISTORY_* 환경 변수를 읽어 history_limits 를 채운다 (없으면 기본값)
+void history_limits_load(void);
+
+void history_init(room_history_t *h);
+// 참조를 모두 놓고 배열도 푼다 (방이 지워질 때)
+void history_clear(room_history_t *h);
+// 참조를 하나 더 잡아서 끝에 넣는다. 한도를 넘는 메시지 하나짜리는 넣지 않는다. 메모리가 없으면 -1
+int history_push(room_history_t *h, message_t *m);
+// 이 방 기록이 쓰는 메모리 (메시지 + 참조 배열)
+size_t history_mem(const room_history_t *h);
+
+// i 번째로 오래된 메시지 (0 <= i < count)
+static inline message_t *history_at(const room_history_t *h, uint32_t i)
+{
+    return h->items[(h->head + i) % h->cap];
+}
+
+#endif //HISTORY_H
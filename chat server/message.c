@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+#include "message.h"
+#include "frame.h"
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+#define MSGQ_IOV 64   // writev() 한 번에 묶는 최대 메시지 수
+
+// --- 메시지 함수 ---
+message_t *msg_new(size_t len)
+{
+    message_t *m = malloc(sizeof(message_t) + len);
+    if (m == NULL) return NULL;
+    atomic_init(&m->refcnt, 1);
+    m->len = len;
+    return m;
+}
+
+message_t *msg_from(const void *data, size_t len)
+{
+    message_t *m = msg_new(len);
+    if (m) memcpy(m->data, data, len);
+    return m;
+}
+
+message_t *msg_frame(const void *payload, size_t len)
+{
+    if (len > FRAME_MAX) len = FRAME_MAX;
+    message_t *m = msg_new(FRAME_HDR + len);
+    if (m) frame_encode(m->data, m->len, payload, len);
+    return m;
+}
+
+message_t *msg_framef(const char *fmt, ...)
+{
+    char buf[FRAME_HDR + FRAME_MAX + 1];
+    va_list ap;
+
+    // 헤더 자리를 비워 두고 바로 뒤에 형식화한 뒤, 길이를 알고 나서 헤더를 채운다
+    va_start(ap, fmt);
+    int n = vsnprintf(buf + FRAME_HDR, sizeof(buf) - FRAME_HDR, fmt, ap);
+    va_end(ap);
+    if (n < 0) return NULL;
+    if (n > FRAME_MAX) n = FRAME_MAX;
+    frame_put_hdr(buf, n);
+    return msg_from(buf, FRAME_HDR + n);
+}
+
+void msg_unref(message_t *m)
+{
+    // 마지막 참조를 놓는 스레드가 다른 스레드의 사용이 모두 끝난 뒤에 해제하도록 acq_rel
+    if (m && atomic_fetch_sub_explicit(&m->refcnt, 1, memory_order_acq_rel) == 1) free(m);
+}
+
+// --- 출력 큐 함수 ---
+int msgq_push(msg_queue_t *q, message_t *m)
+{
+    if (q->count == q->cap) {
+        uint32_t cap = q->cap ? q->cap * 2 : 16;
+        message_t **items = malloc(sizeof(message_t *) * cap);
+        if (items == NULL) return -1;
+        // 원형 배열을 풀어서 새 배열 앞쪽에 차례대로 옮긴다
+        for (uint32_t i = 0; i < q->count; i++) {
+            items[i] = q->items[(q->head + i) & (q->cap - 1)];
+        }
+        free(q->items);
+        q->items = items;
+        q->head = 0;
+        q->cap = cap;
+    }
+    q->items[(q->head + q->count) & (q->cap - 1)] = msg_ref(m);
+    q->count++;
+    q->bytes += m->len;
+    return 0;
+}
+
+// 앞에서부터 n 바이트를 보낸 것으로 처리한다
+static void msgq_consume(msg_queue_t *q, size_t n)
+{
+    q->bytes -= n;
+    while (n > 0) {
+        message_t *m = q->items[q->head];
+        size_t left = m->len - q->off;
+        if (n < left) {
+            q->off += n;
+            return;
+        }
+        n -= left;
+        q->off = 0;
+        msg_unref(m);
+        q->head = (q->head + 1) & (q->cap - 1);
+        q->count--;
+    }
+}
+
+int msgq_flush(msg_queue_t *q, int fd)
+{
+    struct iovec iov[MSGQ_IOV];
+
+    while (q->count > 0) {
+        int cnt = 0;
+        for (uint32_t i = 0; i < q->count && cnt < MSGQ_IOV && cnt < IOV_MAX; i++) {
+            message_t *m = q->items[(q->head + i) & (q->cap - 1)];
+            size_t skip = (i == 0) ? q->off : 0;
+            iov[cnt].iov_base = m->data + skip;
+            iov[cnt].iov_len = m->len - skip;
+            cnt++;
+        }
+
+        // sendmsg 는 writev 와 같지만 MSG_NOSIGNAL 을 줄 수 있다
+        // iovec 에 다 못 담았으면 MSG_MORE 로 꼬리를 붙잡아 두어, 덜 찬 세그먼트가 중간에 나가지 않게 한다
+        // (마지막 묶음은 MSG_MORE 없이 보내므로 그때 모두 나간다)
+        struct msghdr mh = { .msg_iov = iov, .msg_iovlen = cnt };
+        ssize_t n = sendmsg(fd, &mh, MSG_NOSIGNAL | ((uint32_t)cnt < q->count ? MSG_MORE : 0));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+        msgq_consume(q, n);
+    }
+    return 1;
+}
+
+void msgq_pop(msg_queue_t *q)
+{
+    if (q->count == 0) return;
+    msgq_consume(q, q->items[q->head]->len - q->off);
+}
+
+void msgq_clear(msg_queue_t *q)
+{
+    for (uint32_t i = 0; i < q->count; i++) {
+        msg_unref(q->items[(q->head + i) & (q->cap - 1)]);
+    }
+    free(q->items);
+    memset(q, 0, sizeof(*q));
+}
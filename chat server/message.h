@@ -0,0 +1,65 @@
+#ifndef MESSAGE_H
+#define MESSAGE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+
+// --- 구조체 정의 ---
+// 한 번만 만들고 여러 연결의 출력 큐가 함께 가리키는 메시지
+// 브로드캐스트할 때 수신자 수만큼 복사하지 않고 참조 카운트만 올린다
+// 샤드(스레드) 사이에도 그대로 넘기므로 참조 카운트는 원자적으로 센다
+typedef struct message {
+    atomic_int refcnt;
+    uint32_t len;                // data 길이
+    char data[];
+} message_t;
+
+// 연결별 출력 큐 (메시지 참조들의 원형 배열)
+// 쌓인 메시지는 writev() 한 번으로 소켓에 내보낸다
+typedef struct {
+    message_t **items;
+    uint32_t head;               // 가장 오래된 메시지 위치
+    uint32_t count;              // 쌓인 메시지 수
+    uint32_t cap;                // items 칸 수 (2의 거듭제곱)
+    size_t off;                  // 첫 메시지에서 이미 보낸 바이트
+    size_t bytes;                // 아직 못 보낸 전체 바이트
+} msg_queue_t;
+
+// --- 메시지 함수 ---
+message_t *msg_new(size_t len);                      // refcnt 1, 내용은 호출한 쪽이 채운다
+message_t *msg_from(const void *data, size_t len);   // refcnt 1, data 를 복사
+// 채팅 프로토콜 프레임([길이][내용])으로 만든 메시지. 그대로 소켓에 쓰면 된다
+message_t *msg_frame(const void *payload, size_t len);  // refcnt 1
+message_t *msg_framef(const char *fmt, ...);            // refcnt 1, 형식화는 한 번만
+
+static inline message_t *msg_ref(message_t *m)
+{
+    // 이미 참조를 들고 있는 쪽만 부르므로 순서 보장은 필요 없다
+    atomic_fetch_add_explicit(&m->refcnt, 1, memory_order_relaxed);
+    return m;
+}
+void msg_unref(message_t *m);
+
+// --- 출력 큐 함수 ---
+// 메시지 참조를 하나 더 잡아서 큐 끝에 넣는다
+int msgq_push(msg_queue_t *q, message_t *m);
+// 쌓인 메시지를 writev() 로 보낸다
+// 다 보냈으면 1, 소켓이 가득 차서 남았으면 0, 오류면 -1
+int msgq_flush(msg_queue_t *q, int fd);
+void msgq_clear(msg_queue_t *q);
+// 맨 앞 메시지를 통째로 뺀다 (소켓이 아닌 곳으로 옮길 때)
+void msgq_pop(msg_queue_t *q);
+
+static inline message_t *msgq_head(const msg_queue_t *q)
+{
+    return q->count ? q->items[q->head] : NULL;
+}
+
+static inline int msgq_empty(const msg_queue_t *q)
+{
+    return q->count == 0;
+}
+
+#endif //MESSAGE_H
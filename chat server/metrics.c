@@ -0,0 +1,282 @@
+#define _GNU_SOURCE // accept4(), open_memstream()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "metrics.h"
+#include "comm.h"
+
+metrics_t metrics;
+
+// --- 방별 카운터 ---
+// 이름 해시로 자리를 찾는 열린 주소 표. 칸을 차지할 때만 CAS 하고 나머지는 읽기 + 원자 덧셈뿐이다
+enum { SLOT_EMPTY = 0, SLOT_WRITING, SLOT_READY };
+
+typedef struct {
+    atomic_int state;
+    char name[METRICS_ROOM_NAME];
+    _Atomic uint64_t msgs;
+    _Atomic uint64_t hist_msgs;      // 방 기록이 들고 있는 메시지 수 (게이지)
+    _Atomic uint64_t hist_bytes;     // 방 기록이 쓰는 메모리 (게이지)
+} room_slot_t;
+
+static room_slot_t room_slots[METRICS_ROOM_SLOTS];
+static _Atomic uint64_t room_other;          // 표가 가득 차서 못 센 방들
+static char sock_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+static const char *const counter_names[MET_COUNTER_COUNT][2] = {
+    [MET_CONN_ACCEPTED]    = { "chat_connections_accepted_total", "Accepted client connections" },
+    [MET_CONN_CLOSED]      = { "chat_connections_closed_total", "Closed client connections" },
+    [MET_CONN_REJECTED]    = { "chat_connections_rejected_total", "Connections closed because the server was full" },
+    [MET_CONN_EVICTED]     = { "chat_connections_evicted_total", "Slow consumers evicted by flow control" },
+    [MET_MSG_IN]           = { "chat_messages_received_total", "Messages received from clients, commands included" },
+    [MET_MSG_PUBLISHED]    = { "chat_messages_published_total", "Messages broadcast to a room" },
+    [MET_MSG_QUEUED]       = { "chat_messages_queued_total", "Messages queued to a connection" },
+    [MET_WRITE_DROPPED]    = { "chat_writes_dropped_total", "Queued messages discarded before reaching the client" },
+    [MET_PUBLISHER_PAUSED] = { "chat_publisher_pauses_total", "Times a publisher was paused by a saturated room" },
+    [MET_ROOMLOG_DROPPED]  = { "chat_roomlog_dropped_total", "Messages not written to the persistent room log" },
+    [MET_SEARCH_DROPPED]   = { "chat_search_dropped_total", "Messages left out of the search index" },
+    [MET_CLUSTER_DROPPED]  = { "chat_cluster_dropped_total", "Link messages dropped because a node stayed unreachable" },
+};
+
+static const char *const gauge_names[MET_GAUGE_COUNT][2] = {
+    [MET_CONN_ACTIVE]   = { "chat_connections_active", "Currently connected clients" },
+    [MET_SEARCH_BYTES]  = { "chat_search_index_bytes", "Memory held by the search index" },
+    [MET_CLUSTER_LINKS] = { "chat_cluster_links_up", "Outbound cluster links currently connected" },
+};
+
+static const char *const hist_names[MET_HIST_COUNT][2] = {
+    [MET_FANOUT]      = { "chat_fanout_recipients", "Recipients per broadcast" },
+    [MET_QUEUE_BYTES] = { "chat_queue_bytes", "Output queue length after an enqueue" },
+    [MET_LOOP_US]     = { "chat_loop_microseconds", "Time spent handling one batch of events" },
+};
+
+static const char *const cmd_names[CMD_COUNT] = {
+    [CMD_ADD] = "add", [CMD_JOIN] = "join", [CMD_RM] = "rm", [CMD_LIST] = "list",
+    [CMD_USERS] = "users", [CMD_LEAVE] = "leave", [CMD_WHISPER] = "whisper", [CMD_HISTORY] = "history",
+    [CMD_SEARCH] = "search",
+    [CMD_UNKNOWN] = "unknown",
+};
+
+// --- 갱신 함수 ---
+void metrics_observe(metric_hist_id_t id, uint64_t v)
+{
+    metric_hist_t *h = &metrics.hist[id];
+    int b = v ? 64 - __builtin_clzll(v) : 0;   // 값의 비트 수
+    if (b >= METRICS_HIST_BUCKETS) b = METRICS_HIST_BUCKETS - 1;
+    atomic_fetch_add_explicit(&h->bucket[b], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum, v, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+}
+
+// 방 이름의 칸. 처음 보는 방이면 빈 칸을 차지한다. 표가 가득 찼으면 NULL
+static room_slot_t *room_slot(const char *room)
+{
+    uint32_t i = fnv1a(room, strlen(room)) % METRICS_ROOM_SLOTS;
+    for (int probe = 0; probe < METRICS_ROOM_SLOTS; ) {
+        room_slot_t *s = &room_slots[i];
+        int state = atomic_load_explicit(&s->state, memory_order_acquire);
+        if (state == SLOT_READY) {
+            if (strncmp(s->name, room, METRICS_ROOM_NAME - 1) == 0) return s;
+        } else if (state == SLOT_EMPTY) {
+            if (!atomic_compare_exchange_strong_explicit(&s->state, &state, SLOT_WRITING,
+                                                         memory_order_acquire, memory_order_relaxed)) {
+                continue;  // 다른 스레드가 먼저 차지했다. 같은 칸을 다시 본다
+            }
+            snprintf(s->name, sizeof(s->name), "%s", room);
+            atomic_store_explicit(&s->state, SLOT_READY, memory_order_release);
+            return s;
+        } else {
+            continue;      // 이름을 쓰는 중. 금방 끝나므로 같은 칸을 다시 본다
+        }
+        i = (i + 1) % METRICS_ROOM_SLOTS;
+        probe++;
+    }
+    return NULL;
+}
+
+void metrics_room_msg(const char *room)
+{
+    room_slot_t *s = room_slot(room);
+    if (s) atomic_fetch_add_explicit(&s->msgs, 1, memory_order_relaxed);
+    else atomic_fetch_add_explicit(&room_other, 1, memory_order_relaxed);
+}
+
+void metrics_room_history(const char *room, uint64_t msgs, uint64_t bytes)
+{
+    room_slot_t *s = room_slot(room);
+    if (s == NULL) return;
+    atomic_store_explicit(&s->hist_msgs, msgs, memory_order_relaxed);
+    atomic_store_explicit(&s->hist_bytes, bytes, memory_order_relaxed);
+}
+
+uint64_t metrics_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// --- 노출 ---
+#define LOAD(x) ((unsigned long long)atomic_load_explicit(&(x), memory_order_relaxed))
+
+// 방 이름은 사용자가 정하므로 라벨 값 안에서 따옴표/역슬래시/줄바꿈을 이스케이프한다
+static void put_label(FILE *f, const char *s)
+{
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') fputc('\\', f);
+        if (*s == '\n') {
+            fputs("\\n", f);
+            continue;
+        }
+        fputc(*s, f);
+    }
+}
+
+int metrics_render(char **out, size_t *len)
+{
+    FILE *f = open_memstream(out, len);
+    if (f == NULL) return -1;
+
+    for (int i = 0; i < MET_COUNTER_COUNT; i++) {
+        fprintf(f, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", counter_names[i][0], counter_names[i][1],
+                counter_names[i][0], counter_names[i][0], LOAD(metrics.counter[i]));
+    }
+    for (int i = 0; i < MET_GAUGE_COUNT; i++) {
+        fprintf(f, "# HELP %s %s\n# TYPE %s gauge\n%s %lld\n", gauge_names[i][0], gauge_names[i][1],
+                gauge_names[i][0], gauge_names[i][0],
+                (long long)atomic_load_explicit(&metrics.gauge[i], memory_order_relaxed));
+    }
+
+    fputs("# HELP chat_commands_total Commands dispatched, by command\n# TYPE chat_commands_total counter\n", f);
+    for (int i = 0; i < CMD_COUNT; i++) {
+        if (cmd_names[i] == NULL) continue;
+        fprintf(f, "chat_commands_total{cmd=\"%s\"} %llu\n", cmd_names[i], LOAD(metrics.cmd[i]));
+    }
+
+    fputs("# HELP chat_room_messages_total Messages broadcast, by room\n# TYPE chat_room_messages_total counter\n", f);
+    for (int i = 0; i < METRICS_ROOM_SLOTS; i++) {
+        room_slot_t *s = &room_slots[i];
+        if (atomic_load_explicit(&s->state, memory_order_acquire) != SLOT_READY) continue;
+        fputs("chat_room_messages_total{room=\"", f);
+        put_label(f, s->name);
+        fprintf(f, "\"} %llu\n", LOAD(s->msgs));
+    }
+    if (LOAD(room_other)) fprintf(f, "chat_room_messages_total{room=\"\"} %llu\n", LOAD(room_other));
+
+    // 방 기록 게이지 (방 기록은 fork 서버만 쓴다. 리액터에서는 0 이다)
+    static const char *const hist_gauges[2][2] = {
+        { "chat_room_history_messages", "Messages kept in the room history for replay on join" },
+        { "chat_room_history_bytes", "Memory held by the room history" },
+    };
+    for (int g = 0; g < 2; g++) {
+        int header = 0;
+        for (int i = 0; i < METRICS_ROOM_SLOTS; i++) {
+            room_slot_t *s = &room_slots[i];
+            if (atomic_load_explicit(&s->state, memory_order_acquire) != SLOT_READY) continue;
+            unsigned long long v = g ? LOAD(s->hist_bytes) : LOAD(s->hist_msgs);
+            if (!header) {
+                fprintf(f, "# HELP %s %s\n# TYPE %s gauge\n", hist_gauges[g][0], hist_gauges[g][1], hist_gauges[g][0]);
+                header = 1;
+            }
+            fprintf(f, "%s{room=\"", hist_gauges[g][0]);
+            put_label(f, s->name);
+            fprintf(f, "\"} %llu\n", v);
+        }
+    }
+
+    // 칸마다 따로 읽으므로 갱신 중에는 count 와 칸 합이 조금 어긋날 수 있다
+    for (int i = 0; i < MET_HIST_COUNT; i++) {
+        const char *name = hist_names[i][0];
+        metric_hist_t *h = &metrics.hist[i];
+        unsigned long long cum = 0;
+
+        fprintf(f, "# HELP %s %s\n# TYPE %s histogram\n", name, hist_names[i][1], name);
+        for (int b = 0; b < METRICS_HIST_BUCKETS - 1; b++) {
+            cum += LOAD(h->bucket[b]);
+            fprintf(f, "%s_bucket{le=\"%llu\"} %llu\n", name, (1ull << b) - 1, cum);
+        }
+        cum += LOAD(h->bucket[METRICS_HIST_BUCKETS - 1]);
+        fprintf(f, "%s_bucket{le=\"+Inf\"} %llu\n%s_sum %llu\n%s_count %llu\n",
+                name, cum, name, LOAD(h->sum), name, LOAD(h->count));
+    }
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+int metrics_listen(const char *def_path)
+{
+    const char *path = getenv(METRICS_ENV);
+    if (path == NULL) path = def_path;
+    if (path == NULL || *path == '\0') return -1;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        syslog(LOG_ERR, "Metrics: socket path too long: %s", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        syslog(LOG_ERR, "Metrics: socket() failed: %m");
+        return -1;
+    }
+    // 지난번 실행이 남긴 소켓 파일은 지운다
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 8) < 0) {
+        syslog(LOG_ERR, "Metrics: cannot listen on %s: %m", path);
+        close(fd);
+        return -1;
+    }
+    strcpy(sock_path, path);
+    syslog(LOG_INFO, "Metrics available on %s", path);
+    return fd;
+}
+
+void metrics_serve(int lfd)
+{
+    char *text = NULL;
+    size_t len = 0;
+
+    while (1) {
+        int fd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) syslog(LOG_ERR, "Metrics: accept() error: %m");
+            break;
+        }
+        // 같은 깨어남에 들어온 접속들은 한 번 만든 텍스트를 함께 쓴다
+        if (text == NULL && metrics_render(&text, &len) == -1) {
+            free(text);
+            text = NULL;
+            close(fd);
+            continue;
+        }
+        // 읽는 쪽이 멈춰도 이벤트 루프가 오래 붙잡히지 않도록 짧게만 기다린다
+        struct timeval tv = { .tv_sec = 0, .tv_usec = 100000 };
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        for (size_t off = 0; off < len; ) {
+            ssize_t n = send(fd, text + off, len - off, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            off += n;
+        }
+        close(fd);
+    }
+    free(text);
+}
+
+void metrics_close(int lfd)
+{
+    if (lfd < 0) return;
+    close(lfd);
+    if (sock_path[0]) unlink(sock_path);
+}
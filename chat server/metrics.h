@@ -0,0 +1,107 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#include "command.h"
+
+// --- 매크로 정의 ---
+#define METRICS_HIST_BUCKETS 32    // 히스토그램 칸 수 (칸 i : 2^(i-1) <= 값 < 2^i, 마지막 칸은 그 이상 전부)
+#define METRICS_ROOM_SLOTS   256   // 방별 메시지 수를 세는 칸 수 (넘치면 "기타" 로 센다)
+#define METRICS_ROOM_NAME    32    // room.h 의 ROOM_NAME 과 같게
+#define METRICS_ENV          "CHAT_METRICS_SOCK"  // 유닉스 소켓 경로 (빈 문자열이면 끈다)
+
+// --- 지표 번호 ---
+// 카운터 : 계속 늘기만 하는 값
+typedef enum {
+    MET_CONN_ACCEPTED = 0,       // 받은 연결
+    MET_CONN_CLOSED,             // 닫힌 연결
+    MET_CONN_REJECTED,           // 자리가 없어 바로 닫은 연결
+    MET_CONN_EVICTED,            // 느린 소비자로 퇴출한 연결
+    MET_MSG_IN,                  // 클라이언트에게서 받은 메시지 (명령 포함)
+    MET_MSG_PUBLISHED,           // 방에 브로드캐스트한 메시지
+    MET_MSG_QUEUED,              // 연결 출력 큐(또는 자식 링)에 넣은 메시지
+    MET_WRITE_DROPPED,           // 보내지 못하고 버린 메시지 (퇴출, 메모리 부족)
+    MET_PUBLISHER_PAUSED,        // 방이 혼잡해서 읽기를 멈춘 횟수
+    MET_ROOMLOG_DROPPED,         // 방 기록 파일에 쓰지 못하고 버린 메시지 (쓰기 스레드 밀림, 디스크 오류)
+    MET_SEARCH_DROPPED,          // 검색 색인에 넣지 못한 메시지 (색인 스레드 밀림, 메모리 부족)
+    MET_CLUSTER_DROPPED,         // 다른 노드로 보내지 못하고 버린 링크 메시지 (오래 끊긴 링크의 대기열이 가득 참)
+    MET_COUNTER_COUNT
+} metric_counter_id_t;
+
+// 게이지 : 오르내리는 값
+typedef enum {
+    MET_CONN_ACTIVE = 0,         // 지금 연결 수
+    MET_SEARCH_BYTES,            // 검색 색인이 쓰는 메모리 (번호 목록 + 낱말 표)
+    MET_CLUSTER_LINKS,           // 이어져 있는 클러스터 링크 (내가 연 것만)
+    MET_GAUGE_COUNT
+} metric_gauge_id_t;
+
+// 히스토그램
+typedef enum {
+    MET_FANOUT = 0,              // 브로드캐스트 한 번의 수신자 수
+    MET_QUEUE_BYTES,             // 메시지를 넣은 직후 출력 대기열 길이 (바이트)
+    MET_LOOP_US,                 // 이벤트 한 묶음을 처리하는 데 걸린 시간 (마이크로초)
+    MET_HIST_COUNT
+} metric_hist_id_t;
+
+// --- 구조체 정의 ---
+// 모든 값은 relaxed 원자 연산으로만 바꾼다 (샤드 스레드들이 락 없이 함께 올린다)
+typedef struct {
+    _Atomic uint64_t bucket[METRICS_HIST_BUCKETS];
+    _Atomic uint64_t sum;
+    _Atomic uint64_t count;
+} metric_hist_t;
+
+typedef struct {
+    _Atomic uint64_t counter[MET_COUNTER_COUNT];
+    _Atomic int64_t gauge[MET_GAUGE_COUNT];
+    metric_hist_t hist[MET_HIST_COUNT];
+    _Atomic uint64_t cmd[CMD_COUNT];       // 명령 번호별 실행 횟수
+} metrics_t;
+
+extern metrics_t metrics;
+
+// --- 갱신 함수 (hot path, 모두 락 없음) ---
+static inline void metrics_inc(metric_counter_id_t id)
+{
+    atomic_fetch_add_explicit(&metrics.counter[id], 1, memory_order_relaxed);
+}
+
+static inline void metrics_add(metric_counter_id_t id, uint64_t n)
+{
+    atomic_fetch_add_explicit(&metrics.counter[id], n, memory_order_relaxed);
+}
+
+static inline void metrics_gauge_add(metric_gauge_id_t id, int64_t delta)
+{
+    atomic_fetch_add_explicit(&metrics.gauge[id], delta, memory_order_relaxed);
+}
+
+static inline void metrics_cmd(cmd_id_t id)
+{
+    atomic_fetch_add_explicit(&metrics.cmd[id], 1, memory_order_relaxed);
+}
+
+void metrics_observe(metric_hist_id_t id, uint64_t v);
+// 방 이름별 발행 수. 처음 보는 방이면 빈 칸을 하나 차지한다 (칸은 지워지지 않는다)
+void metrics_room_msg(const char *room);
+// 방 기록이 들고 있는 메시지 수와 메모리 (게이지, 바뀔 때마다 덮어쓴다)
+void metrics_room_history(const char *room, uint64_t msgs, uint64_t bytes);
+// MET_LOOP_US 측정용 단조 시계
+uint64_t metrics_now_us(void);
+
+// --- 노출 ---
+// 지표 전체를 텍스트(Prometheus 형식)로 만든다. *out 은 호출한 쪽이 free()
+int metrics_render(char **out, size_t *len);
+// CHAT_METRICS_SOCK (없으면 def_path) 에 유닉스 소켓을 연다. 꺼져 있거나 실패하면 -1
+// 돌려받은 fd 를 이벤트 루프에 넣고, 읽을 수 있을 때 metrics_serve() 를 부른다
+int metrics_listen(const char *def_path);
+// 대기 중인 접속마다 지표를 한 번 써 주고 닫는다
+void metrics_serve(int lfd);
+// 소켓을 닫고 파일을 지운다 (fork 한 자식은 close() 만 한다)
+void metrics_close(int lfd);
+
+#endif //METRICS_H
@@ -0,0 +1,95 @@
+#include <unistd.h>
+#include <syslog.h>
+#include <sys/eventfd.h>
+
+#include "mpsc.h"
+
+// --- 큐 함수 ---
+int mpsc_init(mpsc_t *q)
+{
+    atomic_store_explicit(&q->stub.next, NULL, memory_order_relaxed);
+    atomic_store_explicit(&q->tail, &q->stub, memory_order_relaxed);
+    atomic_store_explicit(&q->pending, 0, memory_order_relaxed);
+    q->head = &q->stub;
+
+    q->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (q->efd == -1) {
+        syslog(LOG_ERR, "eventfd failed: %m");
+        return -1;
+    }
+    return 0;
+}
+
+void mpsc_destroy(mpsc_t *q)
+{
+    if (q->efd >= 0) close(q->efd);
+    q->efd = -1;
+}
+
+// 초인종 없이 링크만 잇는다
+static void mpsc_link(mpsc_t *q, mpsc_node_t *n)
+{
+    atomic_store_explicit(&n->next, NULL, memory_order_relaxed);
+    // 마지막 노드를 먼저 바꿔 끼우고, 이전 마지막 노드에서 새 노드로 잇는다
+    // 두 동작 사이에는 소비자가 잠깐 끝을 못 보는데, mpsc_pop() 이 NULL 로 처리한다
+    mpsc_node_t *prev = atomic_exchange_explicit(&q->tail, n, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, n, memory_order_release);
+}
+
+void mpsc_push(mpsc_t *q, mpsc_node_t *n)
+{
+    mpsc_link(q, n);
+    // 링크를 다 이은 뒤에 센다. 소비자가 비운 뒤 첫 번째인 생산자만 시스템 콜을 한다
+    if (atomic_fetch_add_explicit(&q->pending, 1, memory_order_acq_rel) == 0) {
+        mpsc_kick(q);
+    }
+}
+
+mpsc_node_t *mpsc_pop(mpsc_t *q)
+{
+    mpsc_node_t *head = q->head;
+    mpsc_node_t *next = atomic_load_explicit(&head->next, memory_order_acquire);
+
+    // 자리 노드는 건너뛴다
+    if (head == &q->stub) {
+        if (next == NULL) return NULL;
+        q->head = next;
+        head = next;
+        next = atomic_load_explicit(&head->next, memory_order_acquire);
+    }
+    if (next != NULL) {
+        q->head = next;
+        return head;
+    }
+
+    // head 가 마지막 노드처럼 보인다. 생산자가 링크를 잇는 중이면 다음 초인종에서 꺼낸다
+    if (head != atomic_load_explicit(&q->tail, memory_order_acquire)) return NULL;
+
+    // 정말 마지막이면 자리 노드를 뒤에 붙여야 head 를 내줄 수 있다
+    mpsc_link(q, &q->stub);
+    next = atomic_load_explicit(&head->next, memory_order_acquire);
+    if (next != NULL) {
+        q->head = next;
+        return head;
+    }
+    return NULL;
+}
+
+void mpsc_ack(mpsc_t *q)
+{
+    uint64_t cnt;
+    if (read(q->efd, &cnt, sizeof(cnt)) == -1) {
+        // EAGAIN : 이미 비어 있음
+    }
+    // 이 뒤에 들어오는 첫 생산자가 다시 초인종을 누른다
+    // exchange 로 읽어야 이미 센 생산자들이 이어 둔 링크가 보인다
+    atomic_exchange_explicit(&q->pending, 0, memory_order_acq_rel);
+}
+
+void mpsc_kick(mpsc_t *q)
+{
+    uint64_t one = 1;
+    if (write(q->efd, &one, sizeof(one)) == -1) {
+        // EAGAIN 은 카운터가 넘칠 때뿐이고, 이미 깨울 일이 쌓여 있다는 뜻
+    }
+}
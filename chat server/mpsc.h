@@ -0,0 +1,42 @@
+#ifndef MPSC_H
+#define MPSC_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// --- 매크로 정의 ---
+#define MPSC_LINE 64   // 캐시 라인 크기 (생산자 쪽 tail 과 소비자 쪽 head 분리용)
+
+// --- 구조체 정의 ---
+// 큐에 넣을 구조체 맨 앞에 박아 두는 링크 (침투형, 큐가 따로 할당하지 않는다)
+typedef struct mpsc_node {
+    _Atomic(struct mpsc_node *) next;
+} mpsc_node_t;
+
+// 여러 스레드가 넣고(생산자 N) 한 스레드만 꺼내는(소비자 1) 잠금 없는 큐
+// 넣기는 atomic exchange 한 번, 꺼내기는 소비자 혼자라서 CAS 반복이 없다
+// 비어 있다가 처음 들어올 때만 eventfd 초인종을 눌러 시스템 콜을 아낀다
+typedef struct {
+    _Atomic(mpsc_node_t *) tail;       // 생산자들이 마지막 노드를 바꿔 끼운다
+    char pad1[MPSC_LINE - sizeof(void *)];
+    _Atomic uint32_t pending;          // 소비자가 마지막으로 비운 뒤 들어온 수
+    char pad2[MPSC_LINE - sizeof(uint32_t)];
+    mpsc_node_t *head;                 // 소비자 전용
+    mpsc_node_t stub;                  // 빈 큐를 나타내는 자리 노드
+    int efd;                           // 초인종 (소비자의 epoll 에 등록)
+} mpsc_t;
+
+// --- 큐 함수 ---
+int mpsc_init(mpsc_t *q);
+void mpsc_destroy(mpsc_t *q);
+// 노드 하나 넣기 (어느 스레드에서나). 큐가 비어 있었으면 초인종을 누른다
+void mpsc_push(mpsc_t *q, mpsc_node_t *n);
+// 노드 하나 꺼내기 (소비자 스레드만). 비었거나 생산자가 넣는 중이면 NULL
+// 넣는 중이던 생산자는 끝나고 초인종을 누르므로 놓치지 않는다
+mpsc_node_t *mpsc_pop(mpsc_t *q);
+// 초인종 카운터를 비우고 꺼내기 시작한다 (소비자 스레드만, 꺼내기 전에 부른다)
+void mpsc_ack(mpsc_t *q);
+// 소비자를 깨운다 (시그널 핸들러에서 불러도 된다)
+void mpsc_kick(mpsc_t *q);
+
+#endif //MPSC_H
@@ -0,0 +1,107 @@
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <syslog.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+
+#include "notify.h"
+
+// --- 함수 ---
+int notify_init(notify_t *nt, int sig_kind, const int *signals, int nsig)
+{
+    sigset_t mask;
+
+    nt->epfd = -1;
+    nt->sfd = -1;
+    nt->sig.fd = -1;
+    sigemptyset(&mask);
+    for (int i = 0; i < nsig; i++) sigaddset(&mask, signals[i]);
+    // 막아 두어야 기본 동작(종료 등)이나 핸들러 대신 signalfd 로 온다
+    if (sigprocmask(SIG_BLOCK, &mask, &nt->old_mask) == -1) return -1;
+
+    nt->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (nt->epfd == -1) goto fail;
+    nt->sfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (nt->sfd == -1) goto fail;
+    if (notify_add(nt, &nt->sig, sig_kind, nt->sfd) == -1) goto fail;
+    return 0;
+
+fail:
+    syslog(LOG_ERR, "notify_init failed: %m");
+    notify_close(nt);
+    return -1;
+}
+
+void notify_close(notify_t *nt)
+{
+    if (nt->sfd >= 0) close(nt->sfd);
+    if (nt->epfd >= 0) close(nt->epfd);
+    nt->sfd = -1;
+    nt->epfd = -1;
+    nt->sig.fd = -1;
+}
+
+void notify_forget(notify_t *nt)
+{
+    notify_close(nt);
+    sigprocmask(SIG_SETMASK, &nt->old_mask, NULL);
+}
+
+int notify_add(notify_t *nt, note_t *note, int kind, int fd)
+{
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = note };
+
+    note->kind = kind;
+    note->fd = -1;
+    if (epoll_ctl(nt->epfd, EPOLL_CTL_ADD, fd, &ev) == -1) return -1;
+    note->fd = fd;
+    return 0;
+}
+
+void notify_pause(notify_t *nt, note_t *note, bool paused)
+{
+    // 이벤트 0 으로 바꿔 두면 EPOLLHUP/EPOLLERR 말고는 오지 않는다
+    struct epoll_event ev = { .events = paused ? 0 : EPOLLIN, .data.ptr = note };
+
+    if (note->fd < 0) return;
+    epoll_ctl(nt->epfd, EPOLL_CTL_MOD, note->fd, &ev);
+}
+
+void notify_want_write(notify_t *nt, note_t *note, bool on)
+{
+    struct epoll_event ev = { .events = EPOLLIN | (on ? EPOLLOUT : 0), .data.ptr = note };
+
+    if (note->fd < 0) return;
+    epoll_ctl(nt->epfd, EPOLL_CTL_MOD, note->fd, &ev);
+}
+
+void notify_del(notify_t *nt, note_t *note)
+{
+    if (note->fd < 0) return;
+    if (nt->epfd >= 0) epoll_ctl(nt->epfd, EPOLL_CTL_DEL, note->fd, NULL);
+    note->fd = -1;
+}
+
+int notify_wait(notify_t *nt, note_t **ready, int max, int timeout)
+{
+    struct epoll_event evs[NOTIFY_BATCH];
+
+    if (max > NOTIFY_BATCH) max = NOTIFY_BATCH;
+    int n = epoll_wait(nt->epfd, evs, max, timeout);
+    if (n < 0) return errno == EINTR ? 0 : -1;
+    for (int i = 0; i < n; i++) ready[i] = evs[i].data.ptr;
+    return n;
+}
+
+int notify_signal(notify_t *nt)
+{
+    struct signalfd_siginfo si;
+
+    for (;;) {
+        ssize_t n = read(nt->sfd, &si, sizeof(si));
+        if (n == sizeof(si)) return si.ssi_signo;
+        if (n < 0 && errno == EINTR) continue;
+        return 0;   // EAGAIN : 더 없음
+    }
+}
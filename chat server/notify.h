@@ -0,0 +1,54 @@
+#ifndef NOTIFY_H
+#define NOTIFY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <signal.h>
+
+// --- 매크로 정의 ---
+#define NOTIFY_BATCH 64          // epoll_wait() 한 번에 받는 최대 알림 수
+
+// note 를 품고 있는 레코드의 주소 (room_entry 와 같은 방식)
+#define note_entry(ptr, type, field) ((type *)((char *)(ptr) - offsetof(type, field)))
+
+// --- 구조체 정의 ---
+// 알림을 보내는 곳 하나 (자식의 초인종, 작업자 제어 소켓, 서버 소켓 ...)
+// 레코드 안에 넣어 두고 그 주소를 epoll 에 건다. 깨어나면 어느 레코드인지 바로 안다
+// (예전처럼 모든 자식의 초인종을 read() 해 보며 찾지 않는다)
+typedef struct note {
+    int kind;                    // 부른 쪽이 정하는 종류 (comm.h 의 NOTE_*)
+    int fd;                      // -1 : 걸려 있지 않음
+} note_t;
+
+// epoll + signalfd
+// 기다리는 시그널은 막아 두고 signalfd 로 읽으므로 핸들러와 sig_atomic_t 플래그가 없다
+// (시그널도 다른 알림과 같은 epoll_wait() 에서 순서대로 나온다)
+typedef struct {
+    int epfd;
+    int sfd;
+    note_t sig;                  // signalfd 의 note
+    sigset_t old_mask;           // 막기 전의 시그널 마스크 (fork() 한 자식에서 되돌린다)
+} notify_t;
+
+// --- 함수 ---
+// signals[0..nsig) 를 막고 signalfd 를 sig_kind 로 건다. 실패하면 -1
+int notify_init(notify_t *nt, int sig_kind, const int *signals, int nsig);
+void notify_close(notify_t *nt);
+// fork() 한 자식에서 부른다. 물려받은 epoll/signalfd 를 닫고 시그널 마스크를 되돌린다
+void notify_forget(notify_t *nt);
+
+// fd 의 읽기 알림을 note 로 건다
+int notify_add(notify_t *nt, note_t *note, int kind, int fd);
+// 걸어 둔 채로 알림만 끄고 켠다 (멈춘 발행자 등)
+void notify_pause(notify_t *nt, note_t *note, bool paused);
+// 쓰기 알림도 함께 받을지 (논블로킹 connect() 가 끝났을 때, 소켓 송신 버퍼가 다시 비었을 때)
+void notify_want_write(notify_t *nt, note_t *note, bool on);
+// 여러 번 불러도 된다. fd 를 닫기 전에 부른다 (fork() 한 자식이 같은 fd 를 들고 있으면 epoll 에서 저절로 빠지지 않는다)
+void notify_del(notify_t *nt, note_t *note);
+
+// 알림이 온 note 들을 ready[] 에 넣고 그 수를 돌려준다. 시간 초과면 0, EINTR 도 0, 오류면 -1
+int notify_wait(notify_t *nt, note_t **ready, int max, int timeout);
+// 받은 시그널 하나의 번호 (더 없으면 0)
+int notify_signal(notify_t *nt);
+
+#endif //NOTIFY_H
@@ -0,0 +1,484 @@
+#define _GNU_SOURCE // accept4()
+#include "reactor.h"
+
+atomic_int reactor_shutdown = 0;
+
+// --- 리스닝 소켓 ---
+int reactor_listen(int port, bool reuseport)
+{
+    struct sockaddr_in servaddr;
+    int lfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (lfd < 0) {
+        chat_log(LOG_ERR, "socket not create: %m");
+        return -1;
+    }
+
+    int optval = 1;
+    if (setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)) < 0) {
+        chat_log(LOG_ERR, "setsockopt(SO_REUSEADDR) failed: %m");
+        close(lfd);
+        return -1;
+    }
+    if (reuseport && setsockopt(lfd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval)) < 0) {
+        chat_log(LOG_ERR, "setsockopt(SO_REUSEPORT) failed: %m");
+        close(lfd);
+        return -1;
+    }
+
+    memset(&servaddr, 0, sizeof(servaddr));
+    servaddr.sin_family = AF_INET;
+    servaddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    servaddr.sin_port = htons(port);
+    if (bind(lfd, (struct sockaddr *)&servaddr, sizeof(servaddr)) < 0) {
+        chat_log(LOG_ERR, "No Bind: %m");
+        close(lfd);
+        return -1;
+    }
+    // 접속 폭주 때 SYN 이 버려지지 않도록 대기 큐를 최대로 잡는다
+    if (listen(lfd, SOMAXCONN) < 0) {
+        chat_log(LOG_ERR, "Cannot listen: %m");
+        close(lfd);
+        return -1;
+    }
+    return lfd;
+}
+
+// --- 연결 관리 ---
+static int conn_table_reserve(reactor_t *r, int fd)
+{
+    if (fd < r->conn_cap) return 0;
+
+    int cap = r->conn_cap ? r->conn_cap : 1024;
+    while (cap <= fd) cap *= 2;
+    conn_t **p = realloc(r->conns, sizeof(conn_t *) * cap);
+    if (p == NULL) return -1;
+    memset(p + r->conn_cap, 0, sizeof(conn_t *) * (cap - r->conn_cap));
+    r->conns = p;
+    r->conn_cap = cap;
+    return 0;
+}
+
+// 감시할 이벤트를 바꾼다. 멈춘 발행자는 읽기 이벤트를 빼서 소켓에 남겨 둔다 (TCP 가 보내는 쪽을 늦춘다)
+static void update_events(reactor_t *r, conn_t *c, bool want_out, bool paused)
+{
+    struct epoll_event ev;
+    if (c->want_out == want_out && c->paused == paused) return;
+
+    ev.events = (paused ? 0 : EPOLLIN | EPOLLRDHUP) | (want_out ? EPOLLOUT : 0);
+    ev.data.fd = c->fd;
+    if (epoll_ctl(r->epfd, EPOLL_CTL_MOD, c->fd, &ev) == -1) {
+        chat_log(LOG_ERR, "epoll_ctl(MOD) fd %d: %m", c->fd);
+        return;
+    }
+    c->want_out = want_out;
+    c->paused = paused;
+}
+
+// --- 흐름 제어 ---
+static void conn_list_remove(conn_t **head, conn_t *c)
+{
+    for (conn_t **pp = head; *pp; pp = &(*pp)->paused_next) {
+        if (*pp == c) {
+            *pp = c->paused_next;
+            c->paused_next = NULL;
+            return;
+        }
+    }
+}
+
+// 방 멤버 중 하나라도 high 워터마크를 넘어 있으면 혼잡한 방
+static bool room_saturated(reactor_t *r, int room_id)
+{
+    if (room_id < 0) return false;
+    room_for_each(&r->rooms, room_id, m) {
+        if (room_entry(m, conn_t, room)->flow.congested) return true;
+    }
+    return false;
+}
+
+// 방이 풀린 발행자들을 다시 읽는다. 버퍼에 남은 프레임은 process_resumed() 에서 처리한다
+static void resume_publishers(reactor_t *r)
+{
+    conn_t **pp = &r->paused;
+    while (*pp) {
+        conn_t *c = *pp;
+        if (!c->closing && room_saturated(r, c->room.room_id)) {
+            pp = &c->paused_next;
+            continue;
+        }
+        *pp = c->paused_next;
+        update_events(r, c, c->want_out, false);
+        c->resume = true;
+        c->paused_next = r->resumed;
+        r->resumed = c;
+    }
+}
+
+// 너무 느린 소비자를 내보낸다. 메모리와 지연이 연결 하나 때문에 끝없이 늘지 않게 한다
+static void conn_evict(reactor_t *r, conn_t *c)
+{
+    if (c->closing) return;
+    chat_log(LOG_WARNING, "Reactor: evicting slow consumer fd %d ('%s'), %zu bytes queued.", c->fd, c->name, c->outq.bytes);
+    metrics_inc(MET_CONN_EVICTED);
+    c->closing = true;
+    shutdown(c->fd, SHUT_RDWR);
+}
+
+// outq 길이가 바뀐 뒤 혼잡 상태를 갱신한다. 퇴출했으면 -1
+static int flow_check(reactor_t *r, conn_t *c)
+{
+    switch (flow_update(&c->flow, c->outq.bytes)) {
+    case FLOW_CONGESTED:
+        r->ncongested++;
+        break;
+    case FLOW_RELIEVED:
+        r->ncongested--;
+        resume_publishers(r);
+        break;
+    case FLOW_EVICT:
+        conn_evict(r, c);
+        return -1;
+    }
+    return 0;
+}
+
+void reactor_pause(reactor_t *r, conn_t *c)
+{
+    if (c->paused || c->resume || c->closing) return;
+    update_events(r, c, c->want_out, true);
+    if (!c->paused) return;
+    c->paused_next = r->paused;
+    r->paused = c;
+    metrics_inc(MET_PUBLISHER_PAUSED);
+    chat_log(LOG_INFO, "Reactor: room of fd %d ('%s') is saturated, pausing reads.", c->fd, c->name);
+}
+
+static void conn_close(reactor_t *r, conn_t *c)
+{
+    chat_on_close(r, c);
+    // 내보낼 목록에 걸려 있으면 먼저 비운다 (목록에 해제된 연결이 남지 않도록)
+    if (c->dirty) reactor_flush(r);
+    if (c->paused) conn_list_remove(&r->paused, c);
+    if (c->resume) conn_list_remove(&r->resumed, c);
+    if (c->flow.congested) {
+        // 방을 막고 있던 연결이 빠졌으니 멈춘 발행자들을 다시 본다
+        r->ncongested--;
+        c->flow.congested = false;
+        resume_publishers(r);
+    }
+    // close() 하면 epoll 집합에서도 자동으로 빠진다
+    close(c->fd);
+    r->conns[c->fd] = NULL;
+    r->nconns--;
+    metrics_inc(MET_CONN_CLOSED);
+    metrics_gauge_add(MET_CONN_ACTIVE, -1);
+    if (c->outq.count) metrics_add(MET_WRITE_DROPPED, c->outq.count);
+    chat_log(LOG_INFO, "Reactor: fd %d closed. Active clients: %d.", c->fd, r->nconns);
+    msgq_clear(&c->outq);
+    frame_buf_free(&c->in);
+    free(c);
+}
+
+static void accept_clients(reactor_t *r)
+{
+    struct sockaddr_in cliaddr;
+    socklen_t cli_len;
+    char addr[INET_ADDRSTRLEN];
+
+    // 레벨 트리거지만 한 번 깨어났을 때 대기 중인 연결을 모두 받는다
+    while (1) {
+        cli_len = sizeof(cliaddr);
+        int fd = accept4(r->lfd, (struct sockaddr *)&cliaddr, &cli_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                chat_log(LOG_ERR, "accept() error: %m");
+            }
+            return;
+        }
+
+        conn_t *c = calloc(1, sizeof(conn_t));
+        if (c == NULL || conn_table_reserve(r, fd) == -1) {
+            chat_log(LOG_ERR, "Reactor: out of memory for fd %d", fd);
+            free(c);
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->gen = ++r->next_gen;
+        // 출력은 reactor_flush() 가 회차마다 연결별로 모아 보낸다
+        set_nodelay(fd);
+        room_member_init(&c->room);
+        if (frame_buf_init(&c->in, 0) == -1) {
+            chat_log(LOG_ERR, "Reactor: out of memory for fd %d", fd);
+            free(c);
+            close(fd);
+            continue;
+        }
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = fd;
+        if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+            chat_log(LOG_ERR, "epoll_ctl(ADD) fd %d: %m", fd);
+            frame_buf_free(&c->in);
+            free(c);
+            close(fd);
+            continue;
+        }
+        r->conns[fd] = c;
+        r->nconns++;
+        metrics_inc(MET_CONN_ACCEPTED);
+        metrics_gauge_add(MET_CONN_ACTIVE, 1);
+
+        inet_ntop(AF_INET, &cliaddr.sin_addr, addr, sizeof(addr));
+        chat_log(LOG_INFO, "Client is connected : %s (fd %d)", addr, fd);
+    }
+}
+
+// 재조립 버퍼에서 완성된 프레임을 모두 꺼내 처리한다
+// 프레임이 붙어서 오거나 나눠서 와도 프레임 단위로만 넘긴다. 잘못된 프레임이면 -1
+static int process_input(reactor_t *r, conn_t *c)
+{
+    frame_view_t f;
+    int rc;
+
+    // 멈춘 발행자의 나머지 프레임은 버퍼에 두었다가 다시 읽을 때 처리한다
+    while (!c->paused && (rc = frame_next(&c->in, &f)) == 1) {
+        // 명령 파서가 길이로 다루므로 버퍼 안의 프레임을 그대로 넘긴다 (복사 없음)
+        metrics_inc(MET_MSG_IN);
+        if (f.len > 0) chat_handle_line(r, c, f.data, f.len);
+        if (c->closing) return 0;
+    }
+    if (rc < 0) {
+        chat_log(LOG_WARNING, "Reactor: bad frame from fd %d", c->fd);
+        return -1;
+    }
+    return 0;
+}
+
+// 읽기 이벤트. 연결을 닫아야 하면 -1
+static int handle_read(reactor_t *r, conn_t *c)
+{
+    while (1) {
+        ssize_t n = frame_read(&c->in, c->fd);
+        if (n > 0) {
+            if (process_input(r, c) == -1) return -1;
+            if (c->closing) return -1;
+            if (c->paused) return 0;
+            continue;
+        }
+        if (n == 0) {
+            chat_log(LOG_INFO, "Reactor: client fd %d disconnected.", c->fd);
+            return -1;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+        chat_log(LOG_ERR, "Reactor: read fd %d: %m", c->fd);
+        return -1;
+    }
+}
+
+// 출력 큐를 writev() 로 내보낸다. 연결을 닫아야 하면 -1
+static int flush_out(reactor_t *r, conn_t *c)
+{
+    int rc = msgq_flush(&c->outq, c->fd);
+    if (rc < 0) return -1;
+    // 다 못 보냈으면 EPOLLOUT 을 켜 두고, 다 보냈으면 끈다
+    update_events(r, c, rc == 0, c->paused);
+    if (c->flow.congested) return flow_check(r, c);
+    return 0;
+}
+
+int reactor_send_msg(reactor_t *r, conn_t *c, message_t *m)
+{
+    if (c->closing) return -1;
+    if (msgq_push(&c->outq, m) == -1) {
+        metrics_inc(MET_WRITE_DROPPED);
+        c->closing = true;
+        shutdown(c->fd, SHUT_RDWR);
+        return -1;
+    }
+    metrics_inc(MET_MSG_QUEUED);
+    metrics_observe(MET_QUEUE_BYTES, c->outq.bytes);
+    if (flow_check(r, c) == -1) return -1;
+    if (!c->dirty) {
+        c->dirty = true;
+        c->dirty_next = r->dirty;
+        r->dirty = c;
+    }
+    return 0;
+}
+
+int reactor_send(reactor_t *r, conn_t *c, const char *data, size_t len)
+{
+    message_t *m = msg_frame(data, len);
+    if (m == NULL) return -1;
+    int rc = reactor_send_msg(r, c, m);
+    msg_unref(m);
+    return rc;
+}
+
+void reactor_flush(reactor_t *r)
+{
+    while (r->dirty) {
+        conn_t *c = r->dirty;
+        r->dirty = c->dirty_next;
+        c->dirty = false;
+        c->dirty_next = NULL;
+
+        // EPOLLOUT 을 기다리는 중이면 소켓이 가득 찬 것이므로 이벤트가 올 때까지 둔다
+        if (c->closing || c->want_out) continue;
+        if (flush_out(r, c) == -1) {
+            // 브로드캐스트 대상일 수 있으므로 바로 닫지 않고 표시만 한다
+            c->closing = true;
+            shutdown(c->fd, SHUT_RDWR);
+        }
+    }
+}
+
+conn_t *reactor_conn(reactor_t *r, conn_ref_t ref)
+{
+    if (ref.fd < 0 || ref.fd >= r->conn_cap) return NULL;
+    conn_t *c = r->conns[ref.fd];
+    if (c == NULL || c->gen != ref.gen || c->closing) return NULL;
+    return c;
+}
+
+// 다시 읽기 시작한 발행자들의 버퍼에 남은 프레임을 처리한다
+static void process_resumed(reactor_t *r)
+{
+    while (r->resumed) {
+        conn_t *c = r->resumed;
+        r->resumed = c->paused_next;
+        c->paused_next = NULL;
+        c->resume = false;
+
+        int rc = process_input(r, c);
+        reactor_flush(r);
+        if (rc == -1 || c->closing) conn_close(r, c);
+    }
+}
+
+// 혼잡이 오래 이어진 연결을 퇴출하고, 방이 풀린 발행자를 다시 읽는다
+static void flow_sweep(reactor_t *r)
+{
+    int64_t now = flow_now_ms();
+    if (now - r->last_sweep < REACTOR_SWEEP_MS) return;
+    r->last_sweep = now;
+
+    for (int fd = 0; fd < r->conn_cap && r->ncongested > 0; fd++) {
+        conn_t *c = r->conns[fd];
+        if (c && c->flow.congested && !c->closing) flow_check(r, c);
+    }
+    // 방이 지워졌거나 막던 멤버가 방을 나간 경우도 여기서 풀린다
+    resume_publishers(r);
+    process_resumed(r);
+}
+
+// --- 리액터 본체 ---
+int reactor_init(reactor_t *r, int lfd)
+{
+    memset(r, 0, sizeof(*r));
+    r->lfd = lfd;
+    r->mfd = -1;
+    r->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (r->epfd == -1) {
+        chat_log(LOG_ERR, "epoll_create1() failed: %m");
+        return -1;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = lfd;
+    if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, lfd, &ev) == -1) {
+        chat_log(LOG_ERR, "epoll_ctl(ADD) listen socket: %m");
+        close(r->epfd);
+        return -1;
+    }
+    if (room_registry_init(&r->rooms, REACTOR_ROOM_INIT) == -1) {
+        close(r->epfd);
+        return -1;
+    }
+    return conn_table_reserve(r, lfd);
+}
+
+int reactor_watch_metrics(reactor_t *r, int mfd)
+{
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = mfd;
+    if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, mfd, &ev) == -1) {
+        chat_log(LOG_ERR, "epoll_ctl(ADD) metrics socket: %m");
+        return -1;
+    }
+    r->mfd = mfd;
+    return 0;
+}
+
+void reactor_run(reactor_t *r)
+{
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+
+    while (!reactor_shutdown) {
+        // 혼잡한 연결이나 멈춘 발행자가 있으면 이벤트가 없어도 주기적으로 깨어나 검사한다
+        int timeout = (r->ncongested || r->paused) ? REACTOR_SWEEP_MS : -1;
+        int nfds = epoll_wait(r->epfd, events, REACTOR_MAX_EVENTS, timeout);
+        if (nfds < 0) {
+            if (errno == EINTR) continue;
+            chat_log(LOG_ERR, "epoll_wait() error: %m");
+            break;
+        }
+
+        uint64_t t0 = nfds > 0 ? metrics_now_us() : 0;
+        for (int i = 0; i < nfds; i++) {
+            int fd = events[i].data.fd;
+            if (fd == r->lfd) {
+                accept_clients(r);
+                continue;
+            }
+            if (fd == r->mfd) {
+                metrics_serve(fd);
+                continue;
+            }
+            if (r->set && fd == r->inbox.efd) {
+                // 다른 샤드가 보낸 전달/응답. 처리 중 생긴 출력은 아래에서 한 번에 내보낸다
+                shard_drain(r);
+                reactor_flush(r);
+                process_resumed(r);
+                continue;
+            }
+
+            // 같은 배치 안에서 이미 닫힌 연결일 수 있다
+            conn_t *c = (fd < r->conn_cap) ? r->conns[fd] : NULL;
+            if (c == NULL) continue;
+
+            uint32_t e = events[i].events;
+            int rc = 0;
+            if (e & EPOLLOUT) rc = flush_out(r, c);
+            if (rc == 0 && c->paused) {
+                // 멈춘 발행자는 읽지 않는다. 끊겼을 때만 닫는다
+                if (e & (EPOLLHUP | EPOLLERR)) rc = -1;
+            } else if (rc == 0 && (e & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+                rc = handle_read(r, c);
+            }
+            // 이 입력으로 생긴 출력을 연결마다 writev() 한 번으로 내보낸다
+            reactor_flush(r);
+            if (rc == -1 || c->closing) conn_close(r, c);
+            process_resumed(r);
+        }
+        if (nfds > 0) metrics_observe(MET_LOOP_US, metrics_now_us() - t0);
+        if (timeout != -1) flow_sweep(r);
+    }
+}
+
+void reactor_destroy(reactor_t *r)
+{
+    for (int fd = 0; fd < r->conn_cap; fd++) {
+        if (r->conns[fd]) conn_close(r, r->conns[fd]);
+    }
+    free(r->conns);
+    room_registry_free(&r->rooms);
+    close(r->epfd);
+    close(r->lfd);
+}
@@ -0,0 +1,97 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include "comm.h"
+#include "message.h"
+#include "frame.h"
+#include "command.h"
+#include "shard.h"
+#include "flowctl.h"
+#include "metrics.h"
+#include <sys/epoll.h>
+
+// --- 매크로 정의 ---
+#define REACTOR_MAX_EVENTS 256   // epoll_wait() 한 번에 꺼내올 최대 이벤트 수
+#define REACTOR_ROOM_INIT  64    // 방 목록의 처음 칸 수 (모자라면 늘어난다)
+#define REACTOR_SWEEP_MS   1000  // 혼잡한 연결이 있을 때 퇴출/재개를 검사하는 주기
+
+// --- 구조체 정의 ---
+// 리액터가 직접 관리하는 클라이언트 연결 하나
+// fork 서버의 pipeInfo와 달리 파이프 대신 소켓 fd를 그대로 들고 있다
+typedef struct conn {
+    int fd;                      // 클라이언트 소켓
+    uint32_t gen;                // 세대 번호 (다른 샤드가 conn_ref_t 로 가리킬 때 확인용)
+    char name[NAME];             // 닉네임 (첫 메시지로 설정)
+    room_member_t room;          // 참여 중인 채팅방 (방 id + 같은 방 멤버 링크)
+
+    frame_buf_t in;              // 아직 프레임이 덜 온 입력 (재조립 버퍼)
+
+    msg_queue_t outq;            // 보낼 메시지 참조들 (writev 한 번으로 내보낸다)
+    bool want_out;               // EPOLLOUT 감시 중인지
+    bool dirty;                  // 이번 입력 처리 중에 outq 에 새 메시지가 들어왔는지
+    struct conn *dirty_next;     // 내보낼 연결 목록의 다음
+    bool closing;                // 쓰기 오류로 닫기 예정인 연결
+
+    flow_state_t flow;           // outq 가 high/low 워터마크를 넘었는지
+    bool paused;                 // 혼잡한 방에 보내다가 읽기를 멈춘 발행자
+    bool resume;                 // 읽기를 다시 시작했으니 버퍼에 남은 프레임부터 처리해야 한다
+    struct conn *paused_next;    // 멈춘 발행자 목록 (또는 재개 목록) 의 다음
+} conn_t;
+
+// epoll 리액터 (샤드 하나)
+// 리스닝 소켓과 이 샤드가 받은 클라이언트 소켓을 하나의 epoll 집합에서 처리한다
+// 샤드가 여러 개면 스레드마다 리액터 하나가 돌고, 커널이 SO_REUSEPORT 로 연결을 나눠 준다
+typedef struct reactor {
+    int epfd;                    // epoll 인스턴스
+    int lfd;                     // 리스닝 소켓
+    int mfd;                     // 지표 유닉스 소켓 (-1 : 없음, 0 번 샤드만 연다)
+    conn_t **conns;              // fd 번호 -> 연결 (fd로 바로 찾는다)
+    int conn_cap;                // conns 배열 크기
+    int nconns;                  // 현재 연결 수
+    uint32_t next_gen;           // 다음 연결의 세대 번호
+    room_registry_t rooms;       // 이 샤드 연결들이 들어가 있는 방 + 방별 멤버 리스트
+    conn_t *dirty;               // outq 에 새 메시지가 쌓인 연결들
+    conn_t *paused;              // 읽기를 멈춘 발행자들
+    conn_t *resumed;             // 다시 읽기 시작했지만 버퍼에 남은 프레임을 아직 처리하지 않은 연결들
+    int ncongested;              // high 워터마크를 넘은 연결 수 (0 이 아니면 주기적으로 퇴출 검사)
+    int64_t last_sweep;          // 마지막 퇴출 검사 시각
+
+    shard_set_t *set;            // 속한 샤드 묶음
+    int shard_id;
+    mpsc_t inbox;                // 다른 샤드가 보낸 작업들
+    shard_owner_t owner;         // 이 샤드가 주인인 방/닉네임
+} reactor_t;
+
+// SIGINT/SIGTERM 이 들어오면 1 이 되어 루프를 빠져나간다 (모든 샤드 스레드가 읽으므로 원자 변수)
+extern atomic_int reactor_shutdown;
+
+// --- 리액터 함수 ---
+// 리스닝 소켓 생성 (논블로킹, SO_REUSEADDR)
+// reuseport 면 SO_REUSEPORT 도 켜서 샤드마다 같은 포트에 따로 listen 한다
+int reactor_listen(int port, bool reuseport);
+int reactor_init(reactor_t *r, int lfd);
+// 지표 소켓 mfd 를 이 리액터의 epoll 집합에 넣는다. 접속이 오면 루프 안에서 바로 응답한다
+int reactor_watch_metrics(reactor_t *r, int mfd);
+// reactor_shutdown 이 설정될 때까지 이벤트 루프를 돈다
+void reactor_run(reactor_t *r);
+void reactor_destroy(reactor_t *r);
+
+// 클라이언트 출력 큐에 메시지 참조를 넣는다 (복사 없음)
+// 실제 전송은 입력 하나를 다 처리한 뒤 reactor_flush() 에서 연결당 writev() 한 번으로 한다
+int reactor_send_msg(reactor_t *r, conn_t *c, message_t *m);
+// data 를 프레임 하나로 만들어 넣는다 (한 사람에게만 가는 응답용)
+int reactor_send(reactor_t *r, conn_t *c, const char *data, size_t len);
+// 큐에 쌓인 연결들을 내보낸다. 소켓이 가득 차면 EPOLLOUT 으로 마저 보낸다
+void reactor_flush(reactor_t *r);
+// c 가 보낸 메시지 때문에 방이 혼잡해졌다. 방 멤버들이 low 워터마크 밑으로 빠질 때까지 c 를 읽지 않는다
+void reactor_pause(reactor_t *r, conn_t *c);
+// 다른 샤드가 들고 있던 값으로 이 샤드의 연결 찾기. 이미 끊겼으면 NULL
+conn_t *reactor_conn(reactor_t *r, conn_ref_t ref);
+
+// --- 채팅 명령 처리 (chatcore.c) ---
+// 프레임 하나의 내용 line[0..len) 을 처리한다 ('\0' 으로 끝나지 않아도 된다)
+void chat_handle_line(reactor_t *r, conn_t *c, const char *line, size_t len);
+// 연결이 끊기기 직전에 호출된다
+void chat_on_close(reactor_t *r, conn_t *c);
+
+#endif //REACTOR_H
@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "room.h"
+
+// --- 방 목록 함수 ---
+int room_registry_init(room_registry_t *reg, int cap)
+{
+    reg->rooms = calloc(cap, sizeof(room_t));
+    if (reg->rooms == NULL) return -1;
+    reg->cap = cap;
+    reg->room_num = 0;
+    return 0;
+}
+
+void room_registry_free(room_registry_t *reg)
+{
+    free(reg->rooms);
+    reg->rooms = NULL;
+    reg->cap = reg->room_num = 0;
+}
+
+int room_find(room_registry_t *reg, const char *name)
+{
+    for (int id = 0; id < reg->cap; id++) {
+        if (reg->rooms[id].used && strcmp(reg->rooms[id].name, name) == 0) return id;
+    }
+    return -1;
+}
+
+// 칸을 두 배로 늘린다. 멤버들은 room_t 가 아니라 방 id 와 서로를 가리키므로 옮겨져도 된다
+static int room_grow(room_registry_t *reg)
+{
+    int cap = reg->cap ? reg->cap * 2 : 4;
+    room_t *p = realloc(reg->rooms, sizeof(room_t) * cap);
+    if (p == NULL) return -1;
+    memset(p + reg->cap, 0, sizeof(room_t) * (cap - reg->cap));
+    reg->rooms = p;
+    reg->cap = cap;
+    return 0;
+}
+
+int room_add(room_registry_t *reg, const char *name)
+{
+    int free_id = -1;
+    for (int id = 0; id < reg->cap; id++) {
+        if (!reg->rooms[id].used) {
+            if (free_id == -1) free_id = id;
+        } else if (strcmp(reg->rooms[id].name, name) == 0) {
+            return -2;
+        }
+    }
+    if (free_id == -1) {
+        free_id = reg->cap;
+        if (room_grow(reg) == -1) return -1;
+    }
+
+    room_t *room = &reg->rooms[free_id];
+    snprintf(room->name, sizeof(room->name), "%s", name);
+    room->used = true;
+    room->count = 0;
+    room->head = NULL;
+    reg->room_num++;
+    return free_id;
+}
+
+void room_remove(room_registry_t *reg, int id)
+{
+    room_t *room = &reg->rooms[id];
+    if (!room->used) return;
+
+    room_member_t *m = room->head;
+    while (m != NULL) {
+        room_member_t *next = m->next;
+        room_member_init(m);
+        m = next;
+    }
+    memset(room, 0, sizeof(*room));
+    reg->room_num--;
+}
+
+const char *room_name(room_registry_t *reg, int id)
+{
+    return (id >= 0 && id < reg->cap && reg->rooms[id].used) ? reg->rooms[id].name : "";
+}
+
+room_member_t *room_first(room_registry_t *reg, int id)
+{
+    return (id >= 0 && id < reg->cap) ? reg->rooms[id].head : NULL;
+}
+
+// --- 멤버 함수 ---
+void room_member_init(room_member_t *m)
+{
+    m->prev = m->next = NULL;
+    m->room_id = -1;
+}
+
+void room_join(room_registry_t *reg, int id, room_member_t *m)
+{
+    room_t *room = &reg->rooms[id];
+    if (m->room_id == id) return;
+    room_leave(reg, m);
+
+    // 맨 앞에 끼워 넣는다
+    m->prev = NULL;
+    m->next = room->head;
+    if (room->head) room->head->prev = m;
+    room->head = m;
+    m->room_id = id;
+    room->count++;
+}
+
+void room_leave(room_registry_t *reg, room_member_t *m)
+{
+    if (m->room_id < 0) return;
+    room_t *room = &reg->rooms[m->room_id];
+
+    if (m->prev) m->prev->next = m->next;
+    else room->head = m->next;
+    if (m->next) m->next->prev = m->prev;
+    room->count--;
+    room_member_init(m);
+}
@@ -0,0 +1,61 @@
+#ifndef ROOM_H
+#define ROOM_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// --- 매크로 정의 ---
+#define ROOM_NAME 32   // 채팅방 이름 최대 길이 (comm.h 의 NAME 과 같게)
+
+// 멤버 링크 포인터로부터 그 링크를 품고 있는 구조체(pipeInfo, conn_t ...)를 얻는다
+#define room_entry(ptr, type, field) ((type *)((char *)(ptr) - offsetof(type, field)))
+
+// 방의 멤버 목록을 순회한다 (순회 중에 현재 멤버를 빼면 안 된다)
+#define room_for_each(reg, id, m) \
+    for (room_member_t *m = room_first((reg), (id)); m != NULL; m = m->next)
+
+// --- 구조체 정의 ---
+// 클라이언트 구조체 안에 그대로 박아 넣는 멤버 링크 (침투형 리스트)
+// 클라이언트 -> 방 id 는 room_id, 방 -> 클라이언트 들은 prev/next 로 이어진다
+typedef struct room_member {
+    struct room_member *prev;
+    struct room_member *next;
+    int room_id;                 // 참여 중인 방 (-1 : 없음)
+} room_member_t;
+
+// 채팅방 하나. 방 id 는 rooms[] 의 인덱스이고, 지워지거나 rooms[] 가 늘어나도 다른 방의 id 는 바뀌지 않는다
+typedef struct {
+    char name[ROOM_NAME];
+    bool used;
+    int count;                   // 멤버 수
+    room_member_t *head;         // 멤버 목록의 첫 번째
+} room_t;
+
+typedef struct {
+    room_t *rooms;
+    int cap;                     // rooms[] 칸 수 (가득 차면 두 배로 늘린다)
+    int room_num;                // 만들어진 채팅방의 수
+} room_registry_t;
+
+// --- 방 목록 함수 ---
+// cap 은 처음 잡는 칸 수
+int room_registry_init(room_registry_t *reg, int cap);
+void room_registry_free(room_registry_t *reg);
+
+// 이름으로 방 찾기. 없으면 -1
+int room_find(room_registry_t *reg, const char *name);
+// 방 만들기. 성공하면 방 id, 같은 이름이 있으면 -2, 칸을 늘릴 메모리가 없으면 -1
+// rooms[] 가 옮겨질 수 있으므로 room_t 포인터를 들고 있다가 부르면 안 된다
+int room_add(room_registry_t *reg, const char *name);
+// 방 지우기. 멤버들은 모두 방에서 빠진다 (멤버 수 만큼만 걸린다)
+void room_remove(room_registry_t *reg, int id);
+const char *room_name(room_registry_t *reg, int id);
+room_member_t *room_first(room_registry_t *reg, int id);
+
+// --- 멤버 함수 (모두 O(1)) ---
+void room_member_init(room_member_t *m);
+// 다른 방에 있었다면 먼저 빠지고 id 방에 들어간다
+void room_join(room_registry_t *reg, int id, room_member_t *m);
+void room_leave(room_registry_t *reg, room_member_t *m);
+
+#endif //ROOM_H
@@ -0,0 +1,1002 @@
+#define _GNU_SOURCE // madvise(), fdatasync()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "roomlog.h"
+#include "room.h"
+#include "mpsc.h"
+#include "hashidx.h"
+#include "metrics.h"
+#include "chatlog.h"
+#include "comm.h"
+
+#define RLOG_BATCH 32            // writev() 한 번에 묶는 레코드 수 (머리말 + 내용 = iovec 두 칸)
+#define RLOG_DIR_MAX 256         // CHAT_ROOMLOG_DIR 최대 길이
+#define RLOG_PATH  400           // 디렉터리 + 방 이름(%XX 로 최대 세 배) + 파일 이름
+
+// --- 구조체 정의 ---
+// 세그먼트 하나의 요약. 질의는 락 안에서 이 목록을 복사해 가고, 파일은 락 밖에서 mmap 한다
+typedef struct {
+    uint32_t id;                 // 파일 번호 (%08u.seg / %08u.idx)
+    uint64_t first_rec;          // 첫 레코드 번호
+    int64_t first_ts;            // 첫 레코드 시각 (비어 있으면 0)
+    uint32_t size;               // write() 가 끝난 바이트 (이 앞쪽은 바뀌지 않는다)
+    uint32_t nidx;               // 색인 항목 수
+} rlog_seg_t;
+
+typedef struct {
+    char name[ROOM_NAME];
+    rlog_seg_t *segs;            // 오래된 순서
+    uint32_t nseg;
+    uint32_t segcap;
+    uint64_t nrec;               // 다음 레코드 번호
+    // 여기부터는 쓰기 스레드만 본다
+    uint32_t next_id;            // 다음 세그먼트 파일 번호. 방을 지워도 되돌리지 않는다
+                                 // (다시 만든 방이 지우기 전 질의가 들고 있는 경로를 쓰지 않도록)
+    int fd;                      // 마지막 세그먼트 (-1 : 아직 안 열었음)
+    int idx_fd;
+    uint32_t idx_next;           // 이 위치 이후에 시작하는 첫 레코드에 색인을 남긴다
+    bool dirty;                  // 마지막 fdatasync() 뒤에 쓴 것이 있다
+} rlog_room_t;
+
+enum { RLOG_APPEND, RLOG_DROP, RLOG_JOB };
+
+typedef struct {
+    mpsc_node_t node;            // 맨 앞 (mpsc 큐 링크)
+    int kind;
+    char room[ROOM_NAME];
+    int64_t ts_ms;
+    message_t *m;                // RLOG_APPEND 만
+    roomlog_job_t *job;          // RLOG_JOB 만
+} rlog_op_t;
+
+static struct {
+    bool enabled;
+    char dir[RLOG_DIR_MAX];
+    size_t seg_max;
+    uint32_t keep;
+    long sync_ms;
+
+    pthread_mutex_t lock;        // 방 표와 세그먼트 목록 (쓰기 스레드가 바꾸고 질의가 읽는다)
+    rlog_room_t **rooms;         // 방 레코드는 옮기지 않는다 (지운 방도 빈 채로 남겨 다시 쓴다)
+    uint32_t nrooms;
+    uint32_t cap;
+    hidx_t by_name;              // 방 이름 -> rooms[] 번호
+
+    mpsc_t q;                    // 이벤트 루프 -> 쓰기 스레드
+    mpsc_t done;                 // 쓰기 스레드 -> 이벤트 루프 (끝난 질의)
+    _Atomic uint32_t queued;
+    _Atomic bool stopping;
+    pthread_t writer;
+    bool running;
+    roomlog_tap_t tap;           // 쓴 레코드를 검색 색인에 넘긴다
+} rl = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static void seg_close(rlog_room_t *r);
+
+// --- 작은 함수들 ---
+static int64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int64_t mono_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// 방 이름은 사용자가 정하므로 [A-Za-z0-9_-] 밖의 바이트는 %XX 로 바꾼다 ("..", "/" 가 경로가 되지 않게)
+static void name_escape(char *dst, const char *name)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+        if ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || (*p >= '0' && *p <= '9') || *p == '_' || *p == '-') {
+            *dst++ = *p;
+        } else {
+            *dst++ = '%';
+            *dst++ = hex[*p >> 4];
+            *dst++ = hex[*p & 15];
+        }
+    }
+    *dst = '\0';
+}
+
+static int name_unescape(char *dst, size_t size, const char *src)
+{
+    size_t n = 0;
+    while (*src) {
+        unsigned int c = (unsigned char)*src++;
+        if (c == '%') {
+            if (sscanf(src, "%2x", &c) != 1) return -1;
+            src += 2;
+        }
+        if (n + 1 >= size) return -1;
+        dst[n++] = c;
+    }
+    dst[n] = '\0';
+    return 0;
+}
+
+static void room_dir(char *path, size_t size, const char *name)
+{
+    char esc[ROOM_NAME * 3 + 1];
+    name_escape(esc, name);
+    snprintf(path, size, "%s/%s", rl.dir, esc);
+}
+
+static void seg_path(char *path, size_t size, const char *name, uint32_t id, const char *ext)
+{
+    char esc[ROOM_NAME * 3 + 1];
+    name_escape(esc, name);
+    snprintf(path, size, "%s/%s/%08u.%s", rl.dir, esc, id, ext);
+}
+
+// --- 방 표 (락을 잡고 부른다) ---
+static rlog_room_t *room_lookup(const char *name)
+{
+    uint64_t v;
+    if (!hidx_get_name(&rl.by_name, name, strlen(name), &v)) return NULL;
+    return rl.rooms[v];
+}
+
+static rlog_room_t *room_create(const char *name)
+{
+    if (rl.nrooms == rl.cap) {
+        uint32_t cap = rl.cap ? rl.cap * 2 : 8;
+        rlog_room_t **p = realloc(rl.rooms, sizeof(*p) * cap);
+        if (p == NULL) return NULL;
+        rl.rooms = p;
+        rl.cap = cap;
+    }
+    rlog_room_t *r = calloc(1, sizeof(*r));
+    if (r == NULL) return NULL;
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->fd = r->idx_fd = -1;
+    if (hidx_put_name(&rl.by_name, r->name, strlen(r->name), rl.nrooms) == -1) {
+        free(r);
+        return NULL;
+    }
+    rl.rooms[rl.nrooms++] = r;
+    return r;
+}
+
+static int seg_push(rlog_room_t *r, const rlog_seg_t *s)
+{
+    if (r->nseg == r->segcap) {
+        uint32_t cap = r->segcap ? r->segcap * 2 : 4;
+        rlog_seg_t *p = realloc(r->segs, sizeof(*p) * cap);
+        if (p == NULL) return -1;
+        r->segs = p;
+        r->segcap = cap;
+    }
+    r->segs[r->nseg++] = *s;
+    return 0;
+}
+
+// --- 다시 띄울 때 읽어 들이기 ---
+// 세그먼트를 처음부터 훑어 온전한 레코드가 끝나는 곳을 돌려준다
+// idx_fd 가 있으면 색인을 처음부터 다시 쓴다. *count 에 레코드 수, *first_ts 에 첫 시각
+static uint32_t seg_scan(const char *base, uint32_t size, uint64_t first_rec, int idx_fd,
+                         uint64_t *count, int64_t *first_ts, uint32_t *nidx, uint32_t *idx_next)
+{
+    uint32_t off = 0, next = 0;
+    uint64_t rec = first_rec;
+    rlog_rec_t h;
+
+    *nidx = 0;
+    *first_ts = 0;
+    while (off + sizeof(h) <= size) {
+        memcpy(&h, base + off, sizeof(h));
+        if (h.len > size - off - sizeof(h) || fnv1a(base + off + sizeof(h), h.len) != h.sum) break;
+        if (off == 0) *first_ts = h.ts_ms;
+        if (idx_fd >= 0 && off >= next) {
+            rlog_idx_t e = { .ts_ms = h.ts_ms, .rec = rec, .off = off };
+            if (write(idx_fd, &e, sizeof(e)) == sizeof(e)) (*nidx)++;
+            next = off + ROOMLOG_INDEX_EVERY;
+        }
+        off += sizeof(h) + h.len;
+        rec++;
+    }
+    *count = rec - first_rec;
+    *idx_next = next;
+    return off;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// 마지막 세그먼트 : 찢어진 꼬리를 잘라 내고 색인을 다시 만든 뒤 붙여 쓰도록 열어 둔다
+static int load_tail(rlog_room_t *r, rlog_seg_t *s)
+{
+    char path[RLOG_PATH], ipath[RLOG_PATH];
+    struct stat st;
+
+    seg_path(path, sizeof(path), r->name, s->id, "seg");
+    seg_path(ipath, sizeof(ipath), r->name, s->id, "idx");
+    int fd = open(path, O_RDWR | O_APPEND | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) == -1) goto fail;
+    int ifd = open(ipath, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (ifd < 0) goto fail;
+
+    uint32_t size = st.st_size, end = 0;
+    uint64_t count = 0;
+    if (size > 0) {
+        char *base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) {
+            close(ifd);
+            goto fail;
+        }
+        end = seg_scan(base, size, s->first_rec, ifd, &count, &s->first_ts, &s->nidx, &r->idx_next);
+        munmap(base, size);
+    }
+    if (end < size) {
+        chat_log(LOG_WARNING, "Room log '%s': dropping %u torn bytes at the end of segment %u.", r->name, size - end, s->id);
+        if (ftruncate(fd, end) == -1) chat_log(LOG_ERR, "Room log '%s': ftruncate failed: %m", r->name);
+    }
+    s->size = end;
+    r->fd = fd;
+    r->idx_fd = ifd;
+    r->nrec = s->first_rec + count;
+    return 0;
+
+fail:
+    chat_log(LOG_ERR, "Room log '%s': cannot open segment %u: %m", r->name, s->id);
+    if (fd >= 0) close(fd);
+    return -1;
+}
+
+// 앞쪽 세그먼트는 닫을 때 fdatasync() 했으므로 색인 첫 항목과 크기만 읽는다
+static int load_seg(rlog_room_t *r, rlog_seg_t *s)
+{
+    char path[RLOG_PATH];
+    struct stat st;
+    rlog_idx_t e;
+
+    seg_path(path, sizeof(path), r->name, s->id, "seg");
+    if (stat(path, &st) == -1) return -1;
+    s->size = st.st_size;
+    seg_path(path, sizeof(path), r->name, s->id, "idx");
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    int ok = fstat(fd, &st) == 0 && pread(fd, &e, sizeof(e), 0) == sizeof(e);
+    close(fd);
+    if (!ok) return -1;
+    s->nidx = st.st_size / sizeof(rlog_idx_t);
+    s->first_rec = e.rec;
+    s->first_ts = e.ts_ms;
+    return 0;
+}
+
+// 닫힌 세그먼트의 레코드 수 (색인이 찢어진 다음 세그먼트의 첫 번호를 셀 때만)
+static uint64_t seg_count(rlog_room_t *r, const rlog_seg_t *s)
+{
+    char path[RLOG_PATH];
+    uint64_t count = 0;
+    int64_t ts;
+    uint32_t nidx, next;
+
+    if (s->size == 0) return 0;
+    seg_path(path, sizeof(path), r->name, s->id, "seg");
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    char *base = mmap(NULL, s->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return 0;
+    seg_scan(base, s->size, s->first_rec, -1, &count, &ts, &nidx, &next);
+    munmap(base, s->size);
+    return count;
+}
+
+static void load_room(const char *esc)
+{
+    char name[ROOM_NAME], dir[RLOG_PATH];
+    uint32_t *ids = NULL, n = 0, cap = 0;
+    struct dirent *de;
+
+    if (name_unescape(name, sizeof(name), esc) == -1 || name[0] == '\0') return;
+    snprintf(dir, sizeof(dir), "%s/%s", rl.dir, esc);
+    DIR *d = opendir(dir);
+    if (d == NULL) return;
+    while ((de = readdir(d)) != NULL) {
+        unsigned id;
+        char ext[4];
+        if (sscanf(de->d_name, "%8u.%3s", &id, ext) != 2 || strcmp(ext, "seg") != 0) continue;
+        if (n == cap) {
+            cap = cap ? cap * 2 : 8;
+            uint32_t *p = realloc(ids, sizeof(*ids) * cap);
+            if (p == NULL) break;
+            ids = p;
+        }
+        ids[n++] = id;
+    }
+    closedir(d);
+    if (n == 0) {
+        free(ids);
+        return;
+    }
+    qsort(ids, n, sizeof(*ids), cmp_u32);
+
+    rlog_room_t *r = room_create(name);
+    if (r == NULL) {
+        free(ids);
+        return;
+    }
+    for (uint32_t i = 0; i + 1 < n; i++) {
+        rlog_seg_t s = { .id = ids[i] };
+        if (load_seg(r, &s) == -1) {
+            chat_log(LOG_WARNING, "Room log '%s': skipping unreadable segment %u.", name, ids[i]);
+            continue;
+        }
+        if (seg_push(r, &s) == -1) break;
+    }
+    // 마지막 세그먼트의 첫 번호는 색인 첫 항목, 색인이 찢어졌으면 앞 세그먼트에 이어서 센다
+    rlog_seg_t s = { .id = ids[n - 1] }, tmp = s;
+    if (load_seg(r, &tmp) == 0) s.first_rec = tmp.first_rec;
+    else if (r->nseg > 0) s.first_rec = r->segs[r->nseg - 1].first_rec + seg_count(r, &r->segs[r->nseg - 1]);
+    r->nrec = s.first_rec;
+    if (load_tail(r, &s) == 0 && seg_push(r, &s) == -1) seg_close(r);
+    // 읽지 못해 목록에 넣지 못한 세그먼트가 있어도 그 번호는 다시 쓰지 않는다 (새 세그먼트는 디렉터리에서 가장 큰 번호 다음)
+    r->next_id = ids[n - 1] + 1;
+    free(ids);
+    chat_log(LOG_INFO, "Room log '%s': %u segments, %llu messages.", name, r->nseg, (unsigned long long)r->nrec);
+}
+
+static void load_all(void)
+{
+    DIR *d = opendir(rl.dir);
+    struct dirent *de;
+
+    if (d == NULL) return;
+    while ((de = readdir(d)) != NULL) {
+        if (de->d_name[0] == '.') continue;
+        load_room(de->d_name);
+    }
+    closedir(d);
+}
+
+// --- 쓰기 스레드 ---
+static void seg_close(rlog_room_t *r)
+{
+    if (r->fd >= 0) {
+        fdatasync(r->fd);
+        close(r->fd);
+    }
+    if (r->idx_fd >= 0) {
+        fdatasync(r->idx_fd);
+        close(r->idx_fd);
+    }
+    r->fd = r->idx_fd = -1;
+    r->dirty = false;
+}
+
+static void seg_unlink(const char *name, uint32_t id)
+{
+    char path[RLOG_PATH];
+    seg_path(path, sizeof(path), name, id, "seg");
+    unlink(path);
+    seg_path(path, sizeof(path), name, id, "idx");
+    unlink(path);
+}
+
+// 새 세그먼트를 열고 목록에 붙인다. 남기는 수를 넘으면 가장 오래된 것을 지운다
+static int seg_roll(rlog_room_t *r, int64_t ts)
+{
+    char path[RLOG_PATH];
+    uint32_t id = r->next_id;
+
+    seg_close(r);
+    room_dir(path, sizeof(path), r->name);
+    if (mkdir(path, 0755) == -1 && errno != EEXIST) goto fail;
+    // 이미 있는 세그먼트는 열지 않는다 (읽어 들이지 못한 기록이라도 덮어쓰지 않고 다음 번호로 넘어간다)
+    for (;;) {
+        id = r->next_id++;
+        seg_path(path, sizeof(path), r->name, id, "seg");
+        r->fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC, 0644);
+        if (r->fd >= 0 || errno != EEXIST) break;
+        chat_log(LOG_WARNING, "Room log '%s': segment %u already exists, skipping it.", r->name, id);
+    }
+    if (r->fd < 0) goto fail;
+    // 세그먼트가 없던 번호의 색인은 남은 찌꺼기이므로 지우고 새로 만든다
+    seg_path(path, sizeof(path), r->name, id, "idx");
+    unlink(path);
+    r->idx_fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC, 0644);
+    if (r->idx_fd < 0) goto fail;
+    r->idx_next = 0;
+
+    rlog_seg_t s = { .id = id, .first_rec = r->nrec, .first_ts = ts };
+    rlog_seg_t old = { 0 };
+    bool drop_old = false;
+    pthread_mutex_lock(&rl.lock);
+    int rc = seg_push(r, &s);
+    if (rc == 0 && r->nseg > rl.keep) {
+        old = r->segs[0];
+        memmove(r->segs, r->segs + 1, sizeof(*r->segs) * (r->nseg - 1));
+        r->nseg--;
+        drop_old = true;
+    }
+    pthread_mutex_unlock(&rl.lock);
+    if (rc == -1) goto fail;
+    // 질의가 이미 열었던 파일은 닫을 때까지 남아 있다
+    if (drop_old) seg_unlink(r->name, old.id);
+    return 0;
+
+fail:
+    chat_log(LOG_ERR, "Room log '%s': cannot start segment %u: %m", r->name, id);
+    seg_close(r);
+    return -1;
+}
+
+// 같은 방 레코드 n 개를 writev() 한 번으로 붙여 쓰고, 끝나면 크기를 공개한다
+static void room_write(rlog_room_t *r, rlog_op_t **ops, int n)
+{
+    struct iovec iov[RLOG_BATCH * 2];
+    rlog_rec_t hdr[RLOG_BATCH];
+    rlog_idx_t idx[RLOG_BATCH];
+    int nidx = 0;
+    size_t total = 0;
+    rlog_seg_t *s = &r->segs[r->nseg - 1];
+    uint32_t off = s->size;
+
+    for (int i = 0; i < n; i++) {
+        message_t *m = ops[i]->m;
+        hdr[i] = (rlog_rec_t){ .len = m->len, .sum = fnv1a(m->data, m->len), .ts_ms = ops[i]->ts_ms };
+        iov[2 * i] = (struct iovec){ .iov_base = &hdr[i], .iov_len = sizeof(hdr[i]) };
+        iov[2 * i + 1] = (struct iovec){ .iov_base = m->data, .iov_len = m->len };
+        if (off >= r->idx_next) {
+            idx[nidx++] = (rlog_idx_t){ .ts_ms = ops[i]->ts_ms, .rec = r->nrec + i, .off = off };
+            r->idx_next = off + ROOMLOG_INDEX_EVERY;
+        }
+        off += sizeof(hdr[i]) + m->len;
+        total += sizeof(hdr[i]) + m->len;
+    }
+
+    ssize_t w = writev(r->fd, iov, 2 * n);
+    if (w != (ssize_t)total) {
+        // 반쯤 쓴 레코드가 남지 않도록 되돌리고 이 묶음은 버린다
+        chat_log(LOG_ERR, "Room log '%s': write failed, dropping %d messages: %m", r->name, n);
+        if (ftruncate(r->fd, s->size) == -1) chat_log(LOG_ERR, "Room log '%s': ftruncate failed: %m", r->name);
+        r->idx_next = s->size;
+        metrics_add(MET_ROOMLOG_DROPPED, n);
+        return;
+    }
+    if (nidx > 0 && write(r->idx_fd, idx, sizeof(*idx) * nidx) != (ssize_t)(sizeof(*idx) * nidx)) {
+        // 색인이 모자라면 질의가 조금 더 훑을 뿐이다. 다음에 띄울 때 다시 만든다
+        chat_log(LOG_WARNING, "Room log '%s': index write failed: %m", r->name);
+        nidx = 0;
+    }
+
+    pthread_mutex_lock(&rl.lock);
+    s->size = off;
+    s->nidx += nidx;
+    // 크기와 함께 넘긴다 (받은 쪽이 바로 roomlog_scan() 해도 보이고, 떼어 낸 뒤에는 부르지 않는다)
+    if (rl.tap) {
+        for (int i = 0; i < n; i++) rl.tap(r->name, r->nrec + i, ops[i]->m);
+    }
+    r->nrec += n;
+    pthread_mutex_unlock(&rl.lock);
+    r->dirty = true;
+}
+
+// 모은 작업을 차례로 처리한다. 같은 방이 이어지는 동안은 한 번에 쓴다
+static void apply_ops(rlog_op_t **ops, int n)
+{
+    int i = 0;
+    while (i < n) {
+        rlog_op_t *op = ops[i];
+        if (op->kind == RLOG_JOB) {
+            op->job->run(op->job);
+            mpsc_push(&rl.done, &op->job->node);
+            i++;
+            continue;
+        }
+        pthread_mutex_lock(&rl.lock);
+        rlog_room_t *r = room_lookup(op->room);
+        if (r == NULL && op->kind == RLOG_APPEND) r = room_create(op->room);
+        pthread_mutex_unlock(&rl.lock);
+
+        if (op->kind == RLOG_DROP) {
+            i++;
+            if (r == NULL) continue;
+            seg_close(r);
+            pthread_mutex_lock(&rl.lock);
+            rlog_seg_t *segs = r->segs;
+            uint32_t nseg = r->nseg;
+            r->segs = NULL;
+            r->nseg = r->segcap = 0;
+            r->nrec = 0;
+            if (rl.tap) rl.tap(r->name, 0, NULL);
+            pthread_mutex_unlock(&rl.lock);
+            for (uint32_t k = 0; k < nseg; k++) seg_unlink(r->name, segs[k].id);
+            free(segs);
+            char dir[RLOG_PATH];
+            room_dir(dir, sizeof(dir), r->name);
+            rmdir(dir);
+            chat_log(LOG_INFO, "Room log '%s': removed.", r->name);
+            continue;
+        }
+        if (r == NULL) {
+            chat_log(LOG_ERR, "Room log: out of memory for room '%s'.", op->room);
+            metrics_inc(MET_ROOMLOG_DROPPED);
+            i++;
+            continue;
+        }
+
+        // 한 세그먼트에 들어가는 데까지, 같은 방 APPEND 를 RLOG_BATCH 개까지 묶는다
+        if (r->fd < 0 || (r->segs[r->nseg - 1].size > 0 &&
+                          r->segs[r->nseg - 1].size + sizeof(rlog_rec_t) + op->m->len > rl.seg_max)) {
+            if (seg_roll(r, op->ts_ms) == -1) {
+                metrics_inc(MET_ROOMLOG_DROPPED);
+                i++;
+                continue;
+            }
+        }
+        size_t room_left = rl.seg_max - r->segs[r->nseg - 1].size;
+        int j = i;
+        size_t bytes = 0;
+        while (j < n && j - i < RLOG_BATCH && ops[j]->kind == RLOG_APPEND && strcmp(ops[j]->room, op->room) == 0) {
+            size_t sz = sizeof(rlog_rec_t) + ops[j]->m->len;
+            if (j > i && bytes + sz > room_left) break;
+            bytes += sz;
+            j++;
+        }
+        room_write(r, ops + i, j - i);
+        i = j;
+    }
+}
+
+// 모아 두었다가 주기마다 한 번씩 fdatasync() 한다 (그 사이에 쓴 레코드들이 함께 디스크에 간다)
+static void sync_dirty(void)
+{
+    for (uint32_t i = 0; i < rl.nrooms; i++) {
+        rlog_room_t *r = rl.rooms[i];
+        if (!r->dirty) continue;
+        if (fdatasync(r->fd) == -1) chat_log(LOG_ERR, "Room log '%s': fdatasync failed: %m", r->name);
+        fdatasync(r->idx_fd);
+        r->dirty = false;
+    }
+}
+
+static void *writer_main(void *arg)
+{
+    static rlog_op_t *ops[RLOG_BATCH * 8];
+    struct pollfd pfd = { .fd = rl.q.efd, .events = POLLIN };
+    int64_t last_sync = mono_ms();
+    bool dirty = false;
+
+    for (;;) {
+        bool stopping = atomic_load_explicit(&rl.stopping, memory_order_acquire);
+        int timeout = -1;
+        if (dirty) {
+            int64_t left = last_sync + rl.sync_ms - mono_ms();
+            timeout = left > 0 ? (int)left : 0;
+        }
+        if (!stopping && poll(&pfd, 1, timeout) < 0 && errno != EINTR) break;
+
+        mpsc_ack(&rl.q);
+        for (;;) {
+            int n = 0;
+            mpsc_node_t *node;
+            while (n < (int)(sizeof(ops) / sizeof(ops[0])) && (node = mpsc_pop(&rl.q)) != NULL) {
+                ops[n++] = (rlog_op_t *)node;
+            }
+            if (n == 0) break;
+            atomic_fetch_sub_explicit(&rl.queued, n, memory_order_relaxed);
+            apply_ops(ops, n);
+            for (int i = 0; i < n; i++) {
+                if (ops[i]->m) msg_unref(ops[i]->m);
+                free(ops[i]);
+            }
+            dirty = true;
+        }
+        if (dirty && (stopping || mono_ms() - last_sync >= rl.sync_ms)) {
+            sync_dirty();
+            last_sync = mono_ms();
+            dirty = false;
+        }
+        if (stopping) break;
+    }
+    return NULL;
+}
+
+// --- 함수 ---
+int roomlog_init(void)
+{
+    const char *dir = getenv(ROOMLOG_DIR_ENV);
+    if (dir == NULL) dir = ROOMLOG_DIR;
+    if (*dir == '\0') return 0;
+    if (strlen(dir) >= sizeof(rl.dir)) {
+        chat_log(LOG_ERR, "Room log: directory name too long.");
+        return -1;
+    }
+    strcpy(rl.dir, dir);
+    rl.seg_max = env_long("CHAT_ROOMLOG_SEGMENT", ROOMLOG_SEGMENT, 1);
+    if (rl.seg_max > UINT32_MAX / 2) rl.seg_max = UINT32_MAX / 2;   // 세그먼트 안 위치는 32비트
+    rl.keep = env_long("CHAT_ROOMLOG_KEEP", ROOMLOG_KEEP, 1);
+    rl.sync_ms = env_long("CHAT_ROOMLOG_SYNC_MS", ROOMLOG_SYNC_MS, 1);
+    hidx_init(&rl.by_name);
+    atomic_store(&rl.stopping, false);   // 업그레이드가 실패하면 닫았다가 다시 연다
+
+    if (mkdir(rl.dir, 0755) == -1 && errno != EEXIST) {
+        chat_log(LOG_ERR, "Room log: cannot create '%s': %m", rl.dir);
+        return -1;
+    }
+    load_all();
+    if (mpsc_init(&rl.q) == -1) return -1;
+    if (mpsc_init(&rl.done) == -1) {
+        mpsc_destroy(&rl.q);
+        return -1;
+    }
+
+    // 시그널은 메인 스레드의 signalfd 로 가야 하므로 쓰기 스레드는 모두 막는다 (chatlog 플러셔와 같다)
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int rc = pthread_create(&rl.writer, NULL, writer_main, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (rc != 0) {
+        chat_log(LOG_ERR, "Room log: cannot start writer thread.");
+        mpsc_destroy(&rl.q);
+        mpsc_destroy(&rl.done);
+        return -1;
+    }
+    rl.running = true;
+    rl.enabled = true;
+    chat_log(LOG_INFO, "Room log: '%s', %zu byte segments, keep %u, fdatasync every %ld ms.",
+             rl.dir, rl.seg_max, rl.keep, rl.sync_ms);
+    return 0;
+}
+
+void roomlog_shutdown(void)
+{
+    if (!rl.running) return;
+    rl.enabled = false;
+    atomic_store_explicit(&rl.stopping, true, memory_order_release);
+    mpsc_kick(&rl.q);
+    pthread_join(rl.writer, NULL);
+    rl.running = false;
+    // 스레드가 끝낸 질의의 결과는 보내지 않는다 (업그레이드 중이면 링은 곧 새 프로세스의 것이다)
+    mpsc_node_t *node;
+    mpsc_ack(&rl.done);
+    while ((node = mpsc_pop(&rl.done)) != NULL) {
+        roomlog_job_t *job = (roomlog_job_t *)node;
+        job->done(job, false);
+    }
+
+    for (uint32_t i = 0; i < rl.nrooms; i++) {
+        seg_close(rl.rooms[i]);
+        free(rl.rooms[i]->segs);
+        free(rl.rooms[i]);
+    }
+    free(rl.rooms);
+    rl.rooms = NULL;
+    rl.nrooms = rl.cap = 0;
+    hidx_free(&rl.by_name);
+    mpsc_destroy(&rl.q);
+    mpsc_destroy(&rl.done);
+}
+
+bool roomlog_enabled(void)
+{
+    return rl.enabled;
+}
+
+static int enqueue(int kind, const char *room, message_t *m, roomlog_job_t *job)
+{
+    if (atomic_load_explicit(&rl.queued, memory_order_relaxed) >= ROOMLOG_QUEUE_MAX) {
+        metrics_inc(MET_ROOMLOG_DROPPED);
+        return -1;
+    }
+    rlog_op_t *op = malloc(sizeof(*op));
+    if (op == NULL) {
+        metrics_inc(MET_ROOMLOG_DROPPED);
+        return -1;
+    }
+    op->kind = kind;
+    snprintf(op->room, sizeof(op->room), "%s", room);
+    op->ts_ms = now_ms();
+    op->m = m ? msg_ref(m) : NULL;
+    op->job = job;
+    atomic_fetch_add_explicit(&rl.queued, 1, memory_order_relaxed);
+    mpsc_push(&rl.q, &op->node);
+    return 0;
+}
+
+int roomlog_append(const char *room, message_t *m)
+{
+    if (!rl.enabled) return 0;
+    return enqueue(RLOG_APPEND, room, m, NULL);
+}
+
+void roomlog_drop(const char *room)
+{
+    if (rl.enabled) enqueue(RLOG_DROP, room, NULL, NULL);
+}
+
+int roomlog_submit(roomlog_job_t *job)
+{
+    if (!rl.enabled) return -1;
+    return enqueue(RLOG_JOB, "", NULL, job);
+}
+
+int roomlog_done_fd(void)
+{
+    return rl.enabled ? rl.done.efd : -1;
+}
+
+void roomlog_complete(void)
+{
+    mpsc_node_t *node;
+
+    mpsc_ack(&rl.done);
+    while ((node = mpsc_pop(&rl.done)) != NULL) {
+        roomlog_job_t *job = (roomlog_job_t *)node;
+        job->done(job, true);
+    }
+}
+
+// --- 질의 ---
+// 색인에서 조건을 만족하지 않는 마지막 항목 (거기서부터 훑으면 된다). 색인이 없으면 세그먼트 처음
+static void idx_seek(const char *room, const rlog_seg_t *s, uint64_t rec, int64_t since_ms,
+                     uint32_t *off, uint64_t *at)
+{
+    char path[RLOG_PATH];
+    struct stat st;
+
+    *off = 0;
+    *at = s->first_rec;
+    if (s->nidx == 0) return;
+    seg_path(path, sizeof(path), room, s->id, "idx");
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    // 세그먼트처럼 파일 끝을 넘겨 잡지 않는다
+    uint32_t nidx = s->nidx;
+    if (fstat(fd, &st) == -1 || (uint64_t)st.st_size < sizeof(rlog_idx_t)) {
+        close(fd);
+        return;
+    }
+    if ((uint64_t)st.st_size / sizeof(rlog_idx_t) < nidx) nidx = st.st_size / sizeof(rlog_idx_t);
+    size_t len = sizeof(rlog_idx_t) * nidx;
+    const rlog_idx_t *e = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (e == MAP_FAILED) return;
+
+    // e[lo] 는 항상 "아직 모자란" 항목 (시작점으로 써도 되는 곳)
+    uint32_t lo = 0, hi = nidx;
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        bool before = since_ms < 0 ? e[mid].rec <= rec : e[mid].ts_ms < since_ms;
+        if (before) lo = mid;
+        else hi = mid;
+    }
+    if (e[lo].off < s->size) {
+        *off = e[lo].off;
+        *at = e[lo].rec;
+    }
+    munmap((void *)e, len);
+}
+
+// 세그먼트의 공개된 크기만큼 읽기 전용으로 mmap 한다. 비었거나 그 사이에 보존 한도로 지워졌으면 NULL
+// 파일이 그보다 짧으면 (방이 지워진 뒤 같은 경로가 다시 쓰이는 등) 파일 끝까지만 잡는다. 매핑한 크기는 *size
+static const char *seg_map(const char *room, const rlog_seg_t *s, uint32_t *size)
+{
+    char path[RLOG_PATH];
+    struct stat st;
+
+    if (s->size == 0) return NULL;
+    seg_path(path, sizeof(path), room, s->id, "seg");
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    // 파일 끝을 넘는 페이지를 건드리면 SIGBUS 이므로 공개된 크기를 그대로 믿지 않는다
+    if (fstat(fd, &st) == -1 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    *size = (uint64_t)st.st_size < s->size ? (uint32_t)st.st_size : s->size;
+    const char *base = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    return base == MAP_FAILED ? NULL : base;
+}
+
+// 세그먼트 목록만 락 안에서 복사한다. 공개된 크기 앞쪽은 다시 쓰이지 않으므로 파일은 락 없이 읽는다
+// *total 에 다음 레코드 번호. 방이 없거나 비었으면 NULL
+static rlog_seg_t *segs_snapshot(const char *room, uint32_t *nseg, uint64_t *total)
+{
+    pthread_mutex_lock(&rl.lock);
+    rlog_room_t *r = room_lookup(room);
+    *nseg = r ? r->nseg : 0;
+    *total = r ? r->nrec : 0;
+    rlog_seg_t *segs = *nseg ? malloc(sizeof(*segs) * *nseg) : NULL;
+    if (segs) memcpy(segs, r->segs, sizeof(*segs) * *nseg);
+    pthread_mutex_unlock(&rl.lock);
+    return segs;
+}
+
+// 세그먼트를 mmap 해서 off 부터 레코드 머리말만 읽으며 넘긴다 (내용은 복사하지 않는다)
+static int seg_walk(const char *room, const rlog_seg_t *s, uint32_t off, uint64_t rec,
+                    uint64_t start_rec, int64_t since_ms, int max, roomlog_cb_t cb, void *arg)
+{
+    rlog_rec_t h;
+    uint32_t size;
+    int sent = 0;
+
+    const char *base = seg_map(room, s, &size);
+    if (base == NULL) return 0;
+    madvise((void *)base, size, MADV_SEQUENTIAL);
+
+    while (sent < max && off + sizeof(h) <= size) {
+        memcpy(&h, base + off, sizeof(h));
+        if (h.len > size - off - sizeof(h)) break;
+        if (since_ms < 0 ? rec >= start_rec : h.ts_ms >= since_ms) {
+            cb(arg, base + off + sizeof(h), h.len, h.ts_ms);
+            sent++;
+        }
+        off += sizeof(h) + h.len;
+        rec++;
+    }
+    munmap((void *)base, size);
+    return sent;
+}
+
+int roomlog_query(const char *room, uint32_t n, int64_t since_ms, roomlog_cb_t cb, void *arg)
+{
+    uint32_t nseg;
+    uint64_t total;
+
+    if (!rl.enabled) return 0;
+    rlog_seg_t *segs = segs_snapshot(room, &nseg, &total);
+    if (segs == NULL) return 0;
+
+    int max = ROOMLOG_QUERY_MAX;
+    uint64_t start_rec = 0;
+    if (since_ms < 0) {
+        if (n < (uint32_t)max) max = n;
+        start_rec = total > (uint64_t)max ? total - max : 0;
+    }
+    // 조건이 시작되는 세그먼트 : 첫 레코드가 조건보다 앞서는 마지막 세그먼트
+    uint32_t first = 0;
+    for (uint32_t i = 0; i < nseg; i++) {
+        bool before = since_ms < 0 ? segs[i].first_rec <= start_rec : segs[i].first_ts < since_ms;
+        if (before) first = i;
+    }
+
+    int sent = 0;
+    for (uint32_t i = first; i < nseg && sent < max; i++) {
+        uint32_t off = 0;
+        uint64_t at = segs[i].first_rec;
+        if (i == first) idx_seek(room, &segs[i], start_rec, since_ms, &off, &at);
+        sent += seg_walk(room, &segs[i], off, at, start_rec, since_ms, max - sent, cb, arg);
+    }
+    free(segs);
+    return sent;
+}
+
+// 레코드마다 색인으로 세그먼트 안 위치를 찾아 그 앞에서부터 걷는다 (번호가 오름차순이라 뒤로는 가지 않는다)
+int roomlog_fetch(const char *room, const uint64_t *recs, int n, roomlog_cb_t cb, void *arg)
+{
+    uint32_t nseg;
+    uint64_t total;
+    rlog_rec_t h;
+    int sent = 0, k = 0;
+
+    if (!rl.enabled || n <= 0) return 0;
+    rlog_seg_t *segs = segs_snapshot(room, &nseg, &total);
+    if (segs == NULL) return 0;
+
+    for (uint32_t i = 0; i < nseg && k < n; i++) {
+        uint64_t end = i + 1 < nseg ? segs[i + 1].first_rec : total;
+        while (k < n && recs[k] < segs[i].first_rec) k++;     // 이미 지워진 세그먼트
+        if (k == n || recs[k] >= end) continue;
+        uint32_t size;
+        const char *base = seg_map(room, &segs[i], &size);
+        if (base == NULL) continue;
+
+        uint32_t off = 0;
+        uint64_t at = segs[i].first_rec;
+        for (; k < n && recs[k] < end; k++) {
+            uint32_t ioff;
+            uint64_t iat;
+            idx_seek(room, &segs[i], recs[k], -1, &ioff, &iat);
+            if (iat > at) {
+                off = ioff;
+                at = iat;
+            }
+            while (off + sizeof(h) <= size) {
+                memcpy(&h, base + off, sizeof(h));
+                if (h.len > size - off - sizeof(h)) break;
+                if (at == recs[k]) {
+                    cb(arg, base + off + sizeof(h), h.len, h.ts_ms);
+                    sent++;
+                }
+                off += sizeof(h) + h.len;
+                if (at++ == recs[k]) break;
+            }
+        }
+        munmap((void *)base, size);
+    }
+    free(segs);
+    return sent;
+}
+
+// --- 검색 색인용 ---
+void roomlog_set_tap(roomlog_tap_t tap)
+{
+    pthread_mutex_lock(&rl.lock);
+    rl.tap = tap;
+    pthread_mutex_unlock(&rl.lock);
+}
+
+void roomlog_rooms(void (*cb)(void *arg, const char *room), void *arg)
+{
+    // 콜백이 오래 걸릴 수 있으므로 이름만 복사해 두고 락 밖에서 부른다
+    pthread_mutex_lock(&rl.lock);
+    uint32_t n = 0;
+    char (*names)[ROOM_NAME] = rl.nrooms ? malloc(sizeof(*names) * rl.nrooms) : NULL;
+    for (uint32_t i = 0; names && i < rl.nrooms; i++) {
+        if (rl.rooms[i]->nseg > 0) memcpy(names[n++], rl.rooms[i]->name, ROOM_NAME);
+    }
+    pthread_mutex_unlock(&rl.lock);
+    for (uint32_t i = 0; i < n; i++) cb(arg, names[i]);
+    free(names);
+}
+
+uint64_t roomlog_scan(const char *room, uint64_t from, roomlog_rec_cb_t cb, void *arg)
+{
+    uint32_t nseg;
+    uint64_t total;
+    rlog_rec_t h;
+
+    if (!rl.enabled) return from;
+    rlog_seg_t *segs = segs_snapshot(room, &nseg, &total);
+    if (segs == NULL) return from;
+
+    for (uint32_t i = 0; i < nseg; i++) {
+        uint64_t end = i + 1 < nseg ? segs[i + 1].first_rec : total;
+        if (end <= from) continue;
+        uint32_t size;
+        const char *base = seg_map(room, &segs[i], &size);
+        if (base == NULL) continue;
+        madvise((void *)base, size, MADV_SEQUENTIAL);
+        uint32_t off = 0;
+        uint64_t rec = segs[i].first_rec;
+        idx_seek(room, &segs[i], from, -1, &off, &rec);
+        while (off + sizeof(h) <= size) {
+            memcpy(&h, base + off, sizeof(h));
+            if (h.len > size - off - sizeof(h)) break;
+            if (rec >= from) cb(arg, rec, base + off + sizeof(h), h.len);
+            off += sizeof(h) + h.len;
+            rec++;
+        }
+        munmap((void *)base, size);
+    }
+    free(segs);
+    return total > from ? total : from;
+}
+
+uint64_t roomlog_first(const char *room)
+{
+    pthread_mutex_lock(&rl.lock);
+    rlog_room_t *r = room_lookup(room);
+    uint64_t first = r && r->nseg ? r->segs[0].first_rec : 0;
+    pthread_mutex_unlock(&rl.lock);
+    return first;
+}
@@ -0,0 +1,93 @@
+#ifndef ROOMLOG_H
+#define ROOMLOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "message.h"
+#include "mpsc.h"
+
+// --- 매크로 정의 ---
+// 방마다 디렉터리 하나, 그 안에 번호순 세그먼트(.seg)와 드문 색인(.idx)을 붙여 쓴다
+#define ROOMLOG_DIR_ENV     "CHAT_ROOMLOG_DIR"          // 빈 문자열이면 끈다
+#define ROOMLOG_DIR         "/tmp/chat_server.rooms"    // CHAT_ROOMLOG_DIR 이 없을 때
+#define ROOMLOG_SEGMENT     (4 * 1024 * 1024)  // CHAT_ROOMLOG_SEGMENT : 넘으면 새 세그먼트
+#define ROOMLOG_KEEP        8                  // CHAT_ROOMLOG_KEEP : 방마다 남기는 세그먼트 수 (오래된 것부터 지운다)
+#define ROOMLOG_SYNC_MS     1000               // CHAT_ROOMLOG_SYNC_MS : fdatasync() 를 묶는 주기
+#define ROOMLOG_INDEX_EVERY 4096               // 세그먼트에서 이만큼마다 색인 항목을 하나 남긴다
+#define ROOMLOG_QUEUE_MAX   65536              // 쓰기 스레드가 밀렸을 때 쌓아 두는 최대 레코드 수 (넘으면 버리고 센다)
+#define ROOMLOG_QUERY_MAX   500                // 질의 한 번에 돌려주는 최대 메시지 수
+#define ROOMLOG_QUERY_DEF   20                 // /history 에 수를 주지 않았을 때
+
+// --- 파일 형식 ---
+// 세그먼트 레코드 : [rlog_rec_t][내용 len 바이트]. 정렬 없이 붙어 있으므로 머리말은 memcpy 로 읽는다
+typedef struct {
+    uint32_t len;
+    uint32_t sum;                // 내용의 FNV-1a (다시 띄울 때 찢어진 꼬리를 찾는다)
+    int64_t ts_ms;               // 방에 브로드캐스트한 시각 (CLOCK_REALTIME, 밀리초)
+} rlog_rec_t;
+
+// 색인 항목 : 세그먼트의 첫 레코드와, 그 뒤 ROOMLOG_INDEX_EVERY 바이트마다 처음 시작하는 레코드
+typedef struct {
+    int64_t ts_ms;
+    uint64_t rec;                // 방 안에서의 레코드 번호 (0 부터)
+    uint32_t off;                // 세그먼트 안 위치
+    uint32_t pad;
+} rlog_idx_t;
+
+// 질의 결과 하나. data 는 mmap 한 세그먼트 안을 가리키므로 콜백 안에서만 쓴다
+typedef void (*roomlog_cb_t)(void *arg, const char *data, uint32_t len, int64_t ts_ms);
+// 레코드 번호까지 넘기는 훑기 (검색 색인을 다시 만들 때)
+typedef void (*roomlog_rec_cb_t)(void *arg, uint64_t rec, const char *data, uint32_t len);
+// 파일을 훑는 질의 하나. 세그먼트를 mmap 해서 읽는 일은 이벤트 루프에서 하지 않는다
+// (긴 기록이나 페이지 캐시에 없는 세그먼트를 읽는 동안 모든 클라이언트가 멈추지 않도록)
+// run 은 쓰기 스레드가 앞서 넣은 레코드와 방 지우기를 처리한 다음 부르고,
+// done 은 이벤트 루프가 roomlog_complete() 에서 부른다. ok == false 면 결과를 보내지 말고 풀기만 한다 (종료 중)
+typedef struct roomlog_job {
+    mpsc_node_t node;            // 맨 앞 (roomlog 가 쓴다)
+    void (*run)(struct roomlog_job *job);
+    void (*done)(struct roomlog_job *job, bool ok);
+} roomlog_job_t;
+
+// 쓰기 스레드가 레코드를 파일에 쓴 직후 방 표 락을 잡은 채 부른다 (짧게 끝내고 roomlog_* 를 부르지 않는다)
+// m 은 참조를 잡아 가도 된다. m == NULL 이면 방 기록이 지워졌다 (번호가 0 부터 다시 시작한다)
+typedef void (*roomlog_tap_t)(const char *room, uint64_t rec, message_t *m);
+
+// --- 함수 ---
+// 디렉터리의 기존 기록을 읽어 들이고 쓰기 스레드를 띄운다 (꺼져 있어도 0). 실패하면 -1
+int roomlog_init(void);
+// 쌓인 레코드를 모두 쓰고 fdatasync() 한 뒤 스레드를 멈춘다
+void roomlog_shutdown(void);
+bool roomlog_enabled(void);
+
+// 이벤트 루프에서 부른다. 참조만 하나 잡아 큐에 넣고 바로 돌아온다 (디스크를 기다리지 않는다)
+// 큐가 가득 찼거나 메모리가 없으면 -1 (버린 레코드는 지표로 센다)
+int roomlog_append(const char *room, message_t *m);
+// 방이 지워졌다. 그 방의 파일을 모두 지운다 (앞서 넣은 레코드를 쓴 다음에)
+void roomlog_drop(const char *room);
+
+// since_ms < 0 이면 마지막 n 개, 아니면 since_ms 이후의 것을 오래된 순서로 cb 에 넘긴다
+// 둘 다 ROOMLOG_QUERY_MAX 개까지. 넘긴 수를 돌려준다
+int roomlog_query(const char *room, uint32_t n, int64_t since_ms, roomlog_cb_t cb, void *arg);
+// 오름차순 레코드 번호들의 내용을 cb 에 넘긴다 (보존 한도로 지워진 것은 건너뛴다). 넘긴 수를 돌려준다
+int roomlog_fetch(const char *room, const uint64_t *recs, int n, roomlog_cb_t cb, void *arg);
+
+// --- 질의 맡기기 ---
+// job 을 쓰기 스레드에 맡긴다. 꺼져 있거나 큐가 가득 찼으면 -1 (job 은 부른 쪽이 푼다)
+int roomlog_submit(roomlog_job_t *job);
+// 끝난 질의가 있으면 읽을 수 있게 되는 초인종 (이벤트 루프의 epoll 에 건다). 꺼져 있으면 -1
+int roomlog_done_fd(void);
+// 끝난 질의들의 done 을 부른다 (이벤트 루프에서만)
+void roomlog_complete(void);
+
+// --- 검색 색인용 ---
+// 이벤트 루프가 돌기 전에 건다. NULL 로 떼어 내면 돌아온 뒤로는 부르지 않는다
+void roomlog_set_tap(roomlog_tap_t tap);
+// 기록이 있는 방 이름마다 cb 를 부른다 (이름은 콜백 안에서만 쓴다)
+void roomlog_rooms(void (*cb)(void *arg, const char *room), void *arg);
+// from 번 이후 지금까지 쓴 레코드를 차례로 넘긴다. 다음 레코드 번호를 돌려준다
+uint64_t roomlog_scan(const char *room, uint64_t from, roomlog_rec_cb_t cb, void *arg);
+// 아직 남아 있는 가장 오래된 레코드 번호 (보존 한도로 앞쪽 세그먼트가 지워지면 커진다)
+uint64_t roomlog_first(const char *room);
+
+#endif //ROOMLOG_H
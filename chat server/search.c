@@ -0,0 +1,499 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+
+#include "search.h"
+#include "roomlog.h"
+#include "room.h"
+#include "mpsc.h"
+#include "hashidx.h"
+#include "metrics.h"
+#include "chatlog.h"
+
+#define SX_BATCH 64              // 색인 스레드가 락을 한 번 잡고 넣는 메시지 수
+#define SX_VARINT_MAX 10         // 64비트 varint 최대 길이
+
+// --- 구조체 정의 ---
+// 낱말 하나의 메시지 번호 목록 : 앞 번호와의 차이를 varint(7비트씩, 위 비트가 1 이면 이어짐)로 붙여 쓴다
+// 번호는 늘기만 하므로 차이가 작고, 대부분 1~2 바이트로 들어간다
+typedef struct {
+    uint8_t *buf;
+    uint32_t len;
+    uint32_t cap;
+    uint32_t count;
+    uint64_t last;               // 마지막으로 넣은 번호 (다음 차이의 기준)
+} posting_t;
+
+typedef struct {
+    char name[ROOM_NAME];
+    hidx_t terms;                // 낱말 -> posts[] 번호
+    posting_t *posts;
+    uint32_t nposts;
+    uint32_t cap;
+    uint64_t base;               // 이 번호부터 색인했다 (앞쪽은 보존 한도로 지워졌다)
+    uint64_t next;               // 다음에 넣을 번호 (이보다 작은 번호는 이미 넣었다)
+    uint32_t since_trim;         // 마지막으로 지워진 번호를 정리한 뒤 넣은 수
+    size_t bytes;                // 목록과 표가 쓰는 메모리
+} sx_room_t;
+
+typedef struct {
+    mpsc_node_t node;            // 맨 앞 (mpsc 큐 링크)
+    char room[ROOM_NAME];
+    uint64_t rec;
+    message_t *m;                // NULL : 방 기록이 지워졌다
+} sx_op_t;
+
+static struct {
+    bool enabled;
+    pthread_mutex_t lock;        // 방 표와 색인 (색인 스레드가 바꾸고 /search 가 읽는다)
+    sx_room_t **rooms;           // 지운 방도 빈 채로 남겨 다시 쓴다
+    uint32_t nrooms;
+    uint32_t cap;
+    hidx_t by_name;
+
+    mpsc_t q;                    // 방 기록 쓰기 스레드 -> 색인 스레드
+    _Atomic uint32_t queued;
+    _Atomic bool stopping;
+    pthread_t thread;
+    bool running;
+} sx = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+// --- 낱말 나누기 ---
+// ASCII 영숫자와 UTF-8 바이트(0x80 이상, 한글 등)가 이어진 곳이 낱말이다. ASCII 는 소문자로 바꾼다
+// 다음 낱말을 term 에 채우고 그 뒤 위치를 돌려준다. 더 없으면 NULL
+static const char *next_term(const char *p, const char *end, char *term, size_t *len)
+{
+    for (;;) {
+        while (p < end) {
+            unsigned char c = *p;
+            if (c >= 0x80 || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) break;
+            p++;
+        }
+        if (p == end) return NULL;
+
+        size_t n = 0;
+        while (p < end) {
+            unsigned char c = *p;
+            if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+            else if (!(c >= 0x80 || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z'))) break;
+            if (n < SEARCH_TERM_MAX) term[n++] = c;
+            p++;
+        }
+        // 잘린 자리가 UTF-8 글자 중간이면 그 글자를 통째로 뺀다
+        if (n == SEARCH_TERM_MAX) {
+            while (n > 0 && ((unsigned char)term[n - 1] & 0xC0) == 0x80) n--;
+            if (n > 0 && ((unsigned char)term[n - 1] & 0xC0) == 0xC0) n--;
+        }
+        if (n >= SEARCH_TERM_MIN) {
+            *len = n;
+            return p;
+        }
+    }
+}
+
+// --- 번호 목록 ---
+static int varint_put(uint8_t *out, uint64_t v)
+{
+    int n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)v | 0x80;
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+static const uint8_t *varint_get(const uint8_t *p, uint64_t *v)
+{
+    uint64_t x = 0;
+    int shift = 0;
+    while (*p & 0x80) {
+        x |= (uint64_t)(*p++ & 0x7F) << shift;
+        shift += 7;
+    }
+    *v = x | (uint64_t)*p++ << shift;
+    return p;
+}
+
+static int post_add(sx_room_t *r, posting_t *pl, uint64_t id)
+{
+    uint8_t tmp[SX_VARINT_MAX];
+
+    if (pl->count > 0 && pl->last == id) return 0;     // 한 메시지에 같은 낱말이 또 나왔다
+    int n = varint_put(tmp, id - (pl->count ? pl->last : 0));
+    if (pl->len + n > pl->cap) {
+        uint32_t cap = pl->cap ? pl->cap * 2 : 8;
+        while (cap < pl->len + n) cap *= 2;
+        uint8_t *p = realloc(pl->buf, cap);
+        if (p == NULL) return -1;
+        r->bytes += cap - pl->cap;
+        pl->buf = p;
+        pl->cap = cap;
+    }
+    memcpy(pl->buf + pl->len, tmp, n);
+    pl->len += n;
+    pl->count++;
+    pl->last = id;
+    return 0;
+}
+
+// 목록을 모두 풀어 ids 에 (오름차순)
+static void post_decode(const posting_t *pl, uint64_t *ids)
+{
+    const uint8_t *p = pl->buf;
+    uint64_t id = 0, d;
+    for (uint32_t i = 0; i < pl->count; i++) {
+        p = varint_get(p, &d);
+        id += d;
+        ids[i] = id;
+    }
+}
+
+// ids[0..n) 중 pl 에도 있는 것만 남긴다 (둘 다 오름차순이라 한 번씩만 훑는다)
+static uint32_t post_intersect(const posting_t *pl, uint64_t *ids, uint32_t n)
+{
+    const uint8_t *p = pl->buf;
+    uint64_t id = 0, d;
+    uint32_t i = 0, kept = 0, seen = 0;
+
+    while (i < n && seen < pl->count) {
+        p = varint_get(p, &d);
+        id += d;
+        seen++;
+        while (i < n && ids[i] < id) i++;
+        if (i < n && ids[i] == id) ids[kept++] = ids[i++];
+    }
+    return kept;
+}
+
+// --- 방 색인 ---
+static sx_room_t *room_new(const char *name, uint64_t base)
+{
+    sx_room_t *r = calloc(1, sizeof(*r));
+    if (r == NULL) return NULL;
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    hidx_init(&r->terms);
+    r->base = r->next = base;
+    return r;
+}
+
+static void room_free(sx_room_t *r)
+{
+    for (uint32_t i = 0; i < r->nposts; i++) free(r->posts[i].buf);
+    free(r->posts);
+    hidx_free(&r->terms);
+    free(r);
+}
+
+static size_t room_table_bytes(const sx_room_t *r)
+{
+    return sizeof(*r) + sizeof(posting_t) * r->cap + sizeof(hidx_slot_t) * r->terms.cap;
+}
+
+static posting_t *room_term(sx_room_t *r, const char *term, size_t len)
+{
+    uint64_t v;
+
+    if (hidx_get_name(&r->terms, term, len, &v)) return &r->posts[v];
+    if (r->nposts == r->cap) {
+        uint32_t cap = r->cap ? r->cap * 2 : 64;
+        posting_t *p = realloc(r->posts, sizeof(*p) * cap);
+        if (p == NULL) return NULL;
+        r->posts = p;
+        r->cap = cap;
+    }
+    if (hidx_put_name(&r->terms, term, len, r->nposts) == -1) return NULL;
+    r->bytes += len + 1;     // 표가 들고 있는 낱말 사본
+    posting_t *pl = &r->posts[r->nposts++];
+    memset(pl, 0, sizeof(*pl));
+    return pl;
+}
+
+// 메시지 하나의 낱말들을 넣는다. 메모리가 없으면 -1 (그 메시지는 일부 낱말로만 찾힌다)
+static int room_index(sx_room_t *r, uint64_t id, const char *data, uint32_t len)
+{
+    char term[SEARCH_TERM_MAX];
+    size_t tlen;
+    const char *p = data, *end = data + len;
+    int rc = 0;
+
+    while ((p = next_term(p, end, term, &tlen)) != NULL) {
+        posting_t *pl = room_term(r, term, tlen);
+        if (pl == NULL || post_add(r, pl, id) == -1) rc = -1;
+    }
+    r->next = id + 1;
+    r->since_trim++;
+    return rc;
+}
+
+static void rebuild_rec(void *arg, uint64_t rec, const char *data, uint32_t len)
+{
+    room_index(arg, rec, data, len);
+}
+
+// --- 방 표 (락을 잡고 부른다) ---
+static uint32_t room_slot(const char *name, bool create)
+{
+    uint64_t v;
+
+    if (hidx_get_name(&sx.by_name, name, strlen(name), &v)) return v;
+    if (!create) return UINT32_MAX;
+    if (sx.nrooms == sx.cap) {
+        uint32_t cap = sx.cap ? sx.cap * 2 : 8;
+        sx_room_t **p = realloc(sx.rooms, sizeof(*p) * cap);
+        if (p == NULL) return UINT32_MAX;
+        sx.rooms = p;
+        sx.cap = cap;
+    }
+    sx_room_t *r = room_new(name, 0);
+    if (r == NULL) return UINT32_MAX;
+    if (hidx_put_name(&sx.by_name, r->name, strlen(r->name), sx.nrooms) == -1) {
+        room_free(r);
+        return UINT32_MAX;
+    }
+    metrics_gauge_add(MET_SEARCH_BYTES, room_table_bytes(r));
+    sx.rooms[sx.nrooms] = r;
+    return sx.nrooms++;
+}
+
+// 새 색인으로 바꿔 끼운다 (옛것은 락 밖에서 푼다)
+static sx_room_t *room_swap(uint32_t slot, sx_room_t *r)
+{
+    sx_room_t *old = sx.rooms[slot];
+    sx.rooms[slot] = r;
+    metrics_gauge_add(MET_SEARCH_BYTES, (int64_t)(r->bytes + room_table_bytes(r)) - (int64_t)(old->bytes + room_table_bytes(old)));
+    return old;
+}
+
+// --- 색인 스레드 ---
+// 방 기록 파일의 남은 레코드로 방 색인을 새로 만든다. 만드는 동안은 옛 색인으로 찾는다
+static void room_rebuild(void *arg, const char *name)
+{
+    uint64_t first = roomlog_first(name);
+    sx_room_t *r = room_new(name, first);
+    if (r == NULL) return;
+    r->next = roomlog_scan(name, first, rebuild_rec, r);
+    r->since_trim = 0;
+
+    pthread_mutex_lock(&sx.lock);
+    uint32_t slot = room_slot(name, true);
+    sx_room_t *old = NULL;
+    if (slot != UINT32_MAX) {
+        // 만드는 사이에 큐로 들어와 이미 넣은 것이 더 앞서 있으면 그대로 둔다 (방이 지워졌다 다시 생긴 경우)
+        if (sx.rooms[slot]->next > r->next) old = r;
+        else old = room_swap(slot, r);
+    } else {
+        old = r;
+    }
+    pthread_mutex_unlock(&sx.lock);
+    if (old) room_free(old);
+    if (old != r) {
+        chat_log(LOG_INFO, "Search: indexed room '%s' from record %llu, %u terms, %zu bytes.",
+                 name, (unsigned long long)first, r->nposts, r->bytes);
+    }
+}
+
+// 보존 한도로 앞쪽 세그먼트가 지워져 색인의 절반 이상이 찾을 수 없는 번호면 다시 만든다
+static void room_trim(const char *name, uint64_t base, uint64_t next)
+{
+    uint64_t first = roomlog_first(name);
+    if (first <= base || (first - base) * 2 < next - base) return;
+    room_rebuild(NULL, name);
+}
+
+static void apply_ops(sx_op_t **ops, int n)
+{
+    char trim[SX_BATCH][ROOM_NAME];
+    uint64_t trim_base[SX_BATCH], trim_next[SX_BATCH];
+    int ntrim = 0;
+
+    pthread_mutex_lock(&sx.lock);
+    for (int i = 0; i < n; i++) {
+        sx_op_t *op = ops[i];
+        uint32_t slot = room_slot(op->room, op->m != NULL);
+        if (slot == UINT32_MAX) {
+            if (op->m) metrics_inc(MET_SEARCH_DROPPED);
+            continue;
+        }
+        sx_room_t *r = sx.rooms[slot];
+        if (op->m == NULL) {
+            // 방이 지워졌다 : 빈 색인으로 바꾼다 (번호가 0 부터 다시 시작한다)
+            sx_room_t *e = room_new(op->room, 0);
+            if (e) room_free(room_swap(slot, e));
+            continue;
+        }
+        if (op->rec < r->next) continue;       // 다시 만들 때 이미 넣었다
+        size_t before = r->bytes + room_table_bytes(r);
+        if (room_index(r, op->rec, op->m->data, op->m->len) == -1) {
+            chat_log(LOG_WARNING, "Search: out of memory indexing room '%s'.", r->name);
+        }
+        metrics_gauge_add(MET_SEARCH_BYTES, (int64_t)(r->bytes + room_table_bytes(r)) - (int64_t)before);
+        if (r->since_trim >= SEARCH_TRIM_EVERY) {
+            r->since_trim = 0;
+            memcpy(trim[ntrim], r->name, ROOM_NAME);
+            trim_base[ntrim] = r->base;
+            trim_next[ntrim++] = r->next;
+        }
+    }
+    pthread_mutex_unlock(&sx.lock);
+
+    for (int i = 0; i < ntrim; i++) room_trim(trim[i], trim_base[i], trim_next[i]);
+}
+
+static void *search_main(void *arg)
+{
+    sx_op_t *ops[SX_BATCH];
+    struct pollfd pfd = { .fd = sx.q.efd, .events = POLLIN };
+
+    // 다시 띄웠으면 기록 파일에 남은 메시지부터 색인한다 (그 사이 들어온 새 메시지는 큐에서 기다린다)
+    roomlog_rooms(room_rebuild, NULL);
+
+    for (;;) {
+        if (atomic_load_explicit(&sx.stopping, memory_order_acquire)) break;
+        if (poll(&pfd, 1, -1) < 0 && errno != EINTR) break;
+
+        mpsc_ack(&sx.q);
+        for (;;) {
+            int n = 0;
+            mpsc_node_t *node;
+            while (n < SX_BATCH && (node = mpsc_pop(&sx.q)) != NULL) ops[n++] = (sx_op_t *)node;
+            if (n == 0) break;
+            atomic_fetch_sub_explicit(&sx.queued, n, memory_order_relaxed);
+            apply_ops(ops, n);
+            for (int i = 0; i < n; i++) {
+                if (ops[i]->m) msg_unref(ops[i]->m);
+                free(ops[i]);
+            }
+        }
+    }
+    return NULL;
+}
+
+// 방 기록 쓰기 스레드에서 (방 표 락 안에서) 불린다. 참조만 잡아 큐에 넣는다
+static void search_tap(const char *room, uint64_t rec, message_t *m)
+{
+    if (m && atomic_load_explicit(&sx.queued, memory_order_relaxed) >= SEARCH_QUEUE_MAX) {
+        metrics_inc(MET_SEARCH_DROPPED);
+        return;
+    }
+    sx_op_t *op = malloc(sizeof(*op));
+    if (op == NULL) {
+        metrics_inc(MET_SEARCH_DROPPED);
+        return;
+    }
+    snprintf(op->room, sizeof(op->room), "%s", room);
+    op->rec = rec;
+    op->m = m ? msg_ref(m) : NULL;
+    atomic_fetch_add_explicit(&sx.queued, 1, memory_order_relaxed);
+    mpsc_push(&sx.q, &op->node);
+}
+
+// --- 함수 ---
+int search_init(void)
+{
+    const char *v = getenv(SEARCH_ENV);
+    if (!roomlog_enabled() || (v && strcmp(v, "0") == 0)) return 0;
+
+    hidx_init(&sx.by_name);
+    atomic_store(&sx.stopping, false);   // 업그레이드가 실패하면 닫았다가 다시 연다
+    if (mpsc_init(&sx.q) == -1) return -1;
+
+    // 시그널은 메인 스레드의 signalfd 로 가야 하므로 색인 스레드는 모두 막는다
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int rc = pthread_create(&sx.thread, NULL, search_main, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (rc != 0) {
+        chat_log(LOG_ERR, "Search: cannot start index thread.");
+        mpsc_destroy(&sx.q);
+        return -1;
+    }
+    sx.running = true;
+    sx.enabled = true;
+    roomlog_set_tap(search_tap);
+    chat_log(LOG_INFO, "Search: indexing room messages.");
+    return 0;
+}
+
+void search_shutdown(void)
+{
+    if (!sx.running) return;
+    // 먼저 떼어 내서 더 들어오지 않게 한다. 방 기록은 색인 스레드가 멈출 때까지 닫지 않는다
+    roomlog_set_tap(NULL);
+    sx.enabled = false;
+    atomic_store_explicit(&sx.stopping, true, memory_order_release);
+    mpsc_kick(&sx.q);
+    pthread_join(sx.thread, NULL);
+    sx.running = false;
+
+    mpsc_node_t *node;
+    while ((node = mpsc_pop(&sx.q)) != NULL) {
+        sx_op_t *op = (sx_op_t *)node;
+        if (op->m) msg_unref(op->m);
+        free(op);
+    }
+    for (uint32_t i = 0; i < sx.nrooms; i++) room_free(sx.rooms[i]);
+    free(sx.rooms);
+    sx.rooms = NULL;
+    sx.nrooms = sx.cap = 0;
+    hidx_free(&sx.by_name);
+    mpsc_destroy(&sx.q);
+}
+
+bool search_enabled(void)
+{
+    return sx.enabled;
+}
+
+int search_query(const char *room, const char *query, uint64_t *ids, int max)
+{
+    char terms[SEARCH_QUERY_TERMS][SEARCH_TERM_MAX];
+    size_t lens[SEARCH_QUERY_TERMS];
+    int nterm = 0, found = 0;
+    const char *p = query, *end = query + strlen(query);
+
+    if (!sx.enabled || max <= 0) return 0;
+    while (nterm < SEARCH_QUERY_TERMS && (p = next_term(p, end, terms[nterm], &lens[nterm])) != NULL) nterm++;
+    if (nterm == 0) return 0;
+    uint64_t first = roomlog_first(room);
+
+    pthread_mutex_lock(&sx.lock);
+    uint32_t slot = room_slot(room, false);
+    sx_room_t *r = slot != UINT32_MAX ? sx.rooms[slot] : NULL;
+    const posting_t *lists[SEARCH_QUERY_TERMS];
+    int shortest = 0;
+    for (int i = 0; r && i < nterm; i++) {
+        uint64_t v;
+        if (!hidx_get_name(&r->terms, terms[i], lens[i], &v)) {
+            r = NULL;
+            break;
+        }
+        lists[i] = &r->posts[v];
+        if (lists[i]->count < lists[shortest]->count) shortest = i;
+    }
+    // 가장 짧은 목록을 풀어 두고 나머지와 차례로 겹친다
+    uint64_t *all = r ? malloc(sizeof(*all) * lists[shortest]->count) : NULL;
+    uint32_t n = 0;
+    if (all) {
+        post_decode(lists[shortest], all);
+        n = lists[shortest]->count;
+        for (int i = 0; i < nterm && n > 0; i++) {
+            if (i != shortest) n = post_intersect(lists[i], all, n);
+        }
+    }
+    pthread_mutex_unlock(&sx.lock);
+
+    // 보존 한도로 지워진 번호는 빼고 가장 최근 max 개
+    uint32_t lo = 0;
+    while (lo < n && all[lo] < first) lo++;
+    if (n - lo > (uint32_t)max) lo = n - max;
+    for (uint32_t i = lo; i < n; i++) ids[found++] = all[i];
+    free(all);
+    return found;
+}
@@ -0,0 +1,28 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// --- 매크로 정의 ---
+// 방마다 낱말 -> 메시지 번호 목록(역색인). 메시지 번호는 방 기록 파일의 레코드 번호라서
+// 찾은 메시지의 내용은 roomlog_fetch() 로 파일에서 꺼낸다 (색인은 번호만 들고 있다)
+#define SEARCH_ENV        "CHAT_SEARCH"   // "0" 이면 끈다 (방 기록이 꺼져 있어도 꺼진다)
+#define SEARCH_TERM_MIN   2               // 이보다 짧은 낱말(바이트)은 넣지 않는다
+#define SEARCH_TERM_MAX   32              // 이보다 긴 낱말은 앞쪽만 쓴다
+#define SEARCH_QUERY_TERMS 4              // /search 한 번에 쓰는 낱말 수 (모두 들어 있는 메시지만)
+#define SEARCH_RESULTS    20              // /search 가 돌려주는 최대 메시지 수 (가장 최근 것부터)
+#define SEARCH_QUEUE_MAX  65536           // 색인 스레드가 밀렸을 때 쌓아 두는 최대 메시지 수
+#define SEARCH_TRIM_EVERY 4096            // 이만큼 넣을 때마다 보존 한도로 지워진 번호를 정리할지 본다
+
+// --- 함수 ---
+// 기존 방 기록으로 색인을 다시 만드는 일과 새 메시지 색인을 스레드에 맡긴다. roomlog_init() 다음에 부른다
+int search_init(void);
+// roomlog_shutdown() 전에 부른다
+void search_shutdown(void);
+bool search_enabled(void);
+
+// query 의 낱말이 모두 들어 있는 메시지 번호를 오래된 순서로 ids 에 (가장 최근 max 개까지). 찾은 수를 돌려준다
+int search_query(const char *room, const char *query, uint64_t *ids, int max);
+
+#endif //SEARCH_H
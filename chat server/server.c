@@ -1,472 +1,1819 @@
+// 연결마다 fork() 하는 채팅 서버 (부모는 방과 클러스터를, 자식은 클라이언트 소켓 하나를 맡는다)
+//
+// 빌드 : gcc -O2 -pthread -o server server.c clientprocess.c sig.c comm.c deamon.c common.c command.c frame.c message.c flowctl.c metrics.c chatlog.c hashidx.c slab.c room.c shmring.c notify.c workerpool.c history.c roomlog.c search.c uring.c cluster.c upgrade.c mpsc.c
+// 실행 : ./server   (데몬으로 뜬다. 포트는 CHAT_PORT, 없으면 TCP_PORT)
+//        자식 대신 작업자 프로세스에 연결을 나누려면 CHAT_WORKERS, 받기/보내기를 io_uring 으로 하려면 CHAT_IO=uring
+//        방 기록은 CHAT_ROOMLOG_DIR (빈 문자열이면 끈다), 검색 색인은 CHAT_SEARCH=0 으로 끈다
+//        클러스터는 CHAT_CLUSTER (모든 노드의 링크 주소) 와 CHAT_NODE (이 노드의 주소) 를 함께 준다
+//        로그는 CHAT_LOG_FILE 이 있으면 그 파일에, 없으면 syslog 로. 지표는 CHAT_METRICS_SOCK 유닉스 소켓에서 읽는다
+//        kill -USR2 로 같은 경로의 새 바이너리에게 연결을 넘긴다
 #include "comm.h"  
 #include "clientprocess.h"
 #include "sig.h"
+#include "workerpool.h"
+#include "history.h"
+#include "roomlog.h"
+#include "search.h"
+#include "uring.h"
+#include "cluster.h"
+#include "upgrade.h"
+#include <sys/eventfd.h>
+#include <limits.h>
 
 // --- 전역 변수 정의 ---
-roomInfo room_info[CHAT_ROOM]        = {0}; 
-pipeInfo active_children[MAX_CLIENT] = {0}; 
-volatile int num_active_children     = 0;
-volatile int room_num                = 0; 
+room_registry_t rooms                = {0}; 
+slab_t active_children; 
+hidx_t child_by_pid;
+hidx_t child_by_name;
+notify_t parent_notify;
 
-volatile sig_atomic_t parent_sigusr_arrived = 0; 
-volatile sig_atomic_t child_sigusr_arrived  = 0;  
-volatile sig_atomic_t child_exited_flag     = 0;
+// 훑을 일이 있을 때만 자식 목록을 돈다 (유휴 자식만 있으면 매 회차 O(1))
+static bool backlog_pending;      // 대기열에 쌓아 둔 자식이 있을 수 있다
+static bool publishers_paused;    // 멈춘 발행자가 있을 수 있다
+static bool evict_pending;        // 퇴출했지만 아직 방에서 빼지 않은 자식이 있을 수 있다
+// 노드 번호 -> 그 노드가 보낸 메시지 때문에 혼잡해진 방 (-1 : 붙잡지 않음). 멈춘 발행자처럼 방이 풀리면 놓아 준다
+static int held_nodes[CLUSTER_MAX];
 
-int main(int argc, char **argv)
+// 방 id -> 그 방의 최근 메시지 (/join 때 다시 보내 준다). 방 목록처럼 모자라면 늘린다
+static room_history_t *histories;
+static int history_cap;
+
+// --- 흐름 제어 ---
+// 너무 느린 자식(클라이언트)을 내보낸다. 대기열은 바로 비우고, 목록 정리는 SIGCHLD 때 한다
+// 방 멤버 목록을 도는 중(fanout)에 불릴 수 있으므로 표시만 하고, 방에서 빼는 것은 회차 끝의 leave_evicted() 가 한다
+static void evict_child(pipeInfo *child)
 {
-    int ssock;   // 서버 소켓 (클라이언트 연결을 받을 때 사용)
-    int csock;   // 클라이언트 소켓 (각 클라이언트와 1대1 통신)
-    socklen_t cli_len; // 주소 구조체 길이를 저장할 변수 
-    struct sockaddr_in servaddr, cliaddr; // 클라이언트의 주소정보를 담을 빈 그릇
-    char mesg_buffer[BUFSIZ]; // 메시지 버퍼 (main 함수용)
-    ssize_t n_read_write; // 읽거나 쓴 바이트 수
+    chat_log(LOG_WARNING, "Parent: evicting slow client %d ('%s'), %zu bytes queued.", child->pid, child->name, child->backlog.bytes);
+    child->isActive = false;
+    child->paused = false;
+    child->flow.congested = false;
+    evict_pending = true;
+    metrics_inc(MET_CONN_EVICTED);
+    metrics_add(MET_WRITE_DROPPED, child->backlog.count);
+    msgq_clear(&child->backlog);
+    // 작업자에게 맡긴 연결은 작업자가 소켓을 닫고 알려 온다
+    if (child->worker) pool_ctl(child, WCTL_CLOSE);
+    else {
+        // 끝날 때까지 누르는 초인종은 볼 필요가 없다 (레코드는 SIGCHLD 때 푼다)
+        notify_del(&parent_notify, &child->note);
+        kill(child->pid, SIGTERM);
+    }
+}
+
+// 이번 회차에 퇴출한 자식들을 방에서 뺀다 (메인 루프에서만 부른다)
+static void leave_evicted(void)
+{
+    if (!evict_pending) return;
+    slab_for_each(&active_children, pipeInfo, child) {
+        if (!child->isActive) room_leave(&rooms, &child->room);
+    }
+    evict_pending = false;
+}
+
+// 자식 링, 또는 그 연결을 맡은 작업자의 링에 넣는다. 자리가 없으면 -1
+// notify 가 false 면 초인종은 누르지 않는다 (여러 개를 넣고 child_notify() 로 한 번만 누른다)
+static int child_push(pipeInfo *child, const char *data, size_t len, bool notify)
+{
+    if (child->worker) return pool_push(child, data, len, notify);
+    if (shm_ring_push(child->to_child.ring, data, len) == -1) return -1;
+    if (notify) shm_chan_notify(&child->to_child);
+    return 0;
+}
+
+static void child_notify(pipeInfo *child)
+{
+    shm_chan_notify(child->worker ? &child->worker->to_worker : &child->to_child);
+}
+
+// 자기 자식이면 그 초인종 알림만 끈다
+// 작업자 링은 여러 연결이 함께 쓰므로 부모가 링을 건너뛸 수 없다. 작업자가 그 소켓을 읽지 않게 한다
+static void set_paused(pipeInfo *child, bool paused)
+{
+    child->paused = paused;
+    if (paused) publishers_paused = true;
+    if (child->worker) {
+        pool_ctl(child, paused ? WCTL_PAUSE : WCTL_RESUME);
+        return;
+    }
+    notify_pause(&parent_notify, &child->note, paused);
+    // 멈춘 동안 링에 남은 메시지는 초인종을 이미 받았으므로 한 번 더 눌러 둔다
+    if (!paused && !shm_ring_empty(child->to_parent.ring)) shm_chan_notify(&child->to_parent);
+}
+
+// 링이 가득 차서 자식별 대기열에 쌓는다 (메시지는 참조만 하나 더 잡는다). 대기열이 한도를 넘으면 퇴출한다
+static void backlog_push(pipeInfo *child, message_t *m)
+{
+    if (m == NULL || msgq_push(&child->backlog, m) == -1) {
+        chat_log(LOG_ERR, "Parent: out of memory queueing for child %d.", child->pid);
+        metrics_inc(MET_WRITE_DROPPED);
+        evict_child(child);
+        return;
+    }
+    backlog_pending = true;
+    metrics_inc(MET_MSG_QUEUED);
+    metrics_observe(MET_QUEUE_BYTES, child->backlog.bytes);
+    // 작업자 링은 연결들이 함께 쓰므로 링이 찼다고 이 연결이 느린 것은 아니다 (판정은 작업자가 한다)
+    if (child->worker) return;
+    if (flow_update(&child->flow, child->backlog.bytes) == FLOW_EVICT) evict_child(child);
+}
+
+// 여러 자식에게 가는 메시지 (브로드캐스트, 방 기록). 링이 차면 같은 message_t 를 대기열에 건다
+static void send_msg_to_child(pipeInfo *child, message_t *m, bool notify)
+{
+    if (!child->isActive) return;
+    // 대기열이 비어 있을 때만 링에 바로 넣는다 (순서가 뒤바뀌지 않도록)
+    if (msgq_empty(&child->backlog) && child_push(child, m->data, m->len, notify) == 0) {
+        metrics_inc(MET_MSG_QUEUED);
+        return;
+    }
+    backlog_push(child, m);
+}
+
+// 부모 -> 자식 메시지 전달 (data 를 링에 복사한다)
+// 링이 가득 차면 버리지 않고 자식별 대기열에 쌓는다
+static void send_copy(pipeInfo *child, const char *data, size_t len, bool notify)
+{
+    if (!child->isActive) return;
+    if (msgq_empty(&child->backlog) && child_push(child, data, len, notify) == 0) {
+        metrics_inc(MET_MSG_QUEUED);
+        return;
+    }
+
+    message_t *m = msg_from(data, len);
+    backlog_push(child, m);
+    if (m) msg_unref(m);
+}
+
+// 자식의 링에 넣고 eventfd 초인종을 누른다 (예전의 write() + kill(SIGUSR1) 대신)
+static void send_to_child(pipeInfo *child, const char *data, size_t len)
+{
+    send_copy(child, data, len, true);
+}
+
+// 링에 자리가 난 만큼 대기열을 옮긴다. 아직 남은 대기열이 있으면 true
+static bool flush_backlogs(void)
+{
+    bool pending = false;
+    message_t *m;
+
+    if (!backlog_pending) return false;
+    slab_for_each(&active_children, pipeInfo, child) {
+        if (!child->isActive || msgq_empty(&child->backlog)) continue;
+
+        while ((m = msgq_head(&child->backlog)) != NULL) {
+            if (child_push(child, m->data, m->len, true) == -1) break;
+            msgq_pop(&child->backlog);
+        }
+        // low 밑으로 빠지면 혼잡 해제, 너무 오래 high 위에 있으면 퇴출
+        if (!child->worker && flow_update(&child->flow, child->backlog.bytes) == FLOW_EVICT) {
+            evict_child(child);
+            continue;
+        }
+        if (!msgq_empty(&child->backlog)) pending = true;
+    }
+    backlog_pending = pending;
+    return pending;
+}
+
+// 방 멤버 중 하나라도 대기열이 high 를 넘어 있으면 혼잡한 방
+static bool room_saturated(int room_id)
+{
+    if (room_id < 0) return false;
+    room_for_each(&rooms, room_id, m) {
+        if (room_entry(m, pipeInfo, room)->flow.congested) return true;
+    }
+    return false;
+}
+
+// 다른 노드가 주인인 방에 보내는 발행자는 그 노드로 가는 링크 대기열이 밀려도 멈춘다
+static bool publisher_blocked(pipeInfo *child)
+{
+    int room_id = child->room.room_id;
+
+    if (room_saturated(room_id)) return true;
+    return room_id >= 0 && cluster_congested(cluster_owner(room_name(&rooms, room_id)));
+}
+
+// 방이 풀린 발행자와 노드는 다시 읽는다. 아직 멈춘 것이 있으면 true
+static bool resume_publishers(void)
+{
+    bool paused = false;
+
+    if (!publishers_paused) return false;
+    for (int node = 0; node < CLUSTER_MAX; node++) {
+        if (held_nodes[node] < 0) continue;
+        if (room_saturated(held_nodes[node])) {
+            paused = true;
+            continue;
+        }
+        held_nodes[node] = -1;
+        cluster_hold(node, false);
+        chat_log(LOG_INFO, "Parent: resuming reads from node %d.", node);
+    }
+    slab_for_each(&active_children, pipeInfo, child) {
+        if (!child->paused) continue;
+        if (child->isActive && publisher_blocked(child)) {
+            paused = true;
+            continue;
+        }
+        set_paused(child, false);
+        chat_log(LOG_INFO, "Parent: resuming reads from client %d ('%s').", child->pid, child->name);
+    }
+    publishers_paused = paused;
+    return paused;
+}
+
+// --- 방 기록 ---
+// room_id 방의 기록. grow 면 칸이 모자랄 때 늘리고, 아니면 아직 없는 방은 NULL
+static room_history_t *room_history(int room_id, bool grow)
+{
+    if (room_id < 0) return NULL;
+    if (room_id >= history_cap) {
+        if (!grow) return NULL;
+        int cap = rooms.cap > room_id ? rooms.cap : room_id + 1;
+        room_history_t *p = realloc(histories, sizeof(*p) * cap);
+        if (p == NULL) return NULL;
+        for (int i = history_cap; i < cap; i++) history_init(&p[i]);
+        histories = p;
+        history_cap = cap;
+    }
+    return &histories[room_id];
+}
+
+static void history_report(int room_id)
+{
+    room_history_t *h = room_history(room_id, false);
+    metrics_room_history(room_name(&rooms, room_id), h ? h->count : 0, h ? history_mem(h) : 0);
+}
+
+// 방에 막 들어온 자식에게 그 방의 최근 메시지를 보낸다
+// 링에는 초인종 없이 모두 넣고 마지막에 한 번만 누르므로, 자식은 한 번 깨어나서 한 번에 내보낸다
+static void replay_history(pipeInfo *child, int room_id)
+{
+    room_history_t *h = room_history(room_id, false);
+    if (h == NULL || h->count == 0) return;
+
+    for (uint32_t i = 0; i < h->count && child->isActive; i++) {
+        send_msg_to_child(child, history_at(h, i), false);
+    }
+    if (child->isActive) child_notify(child);
+    chat_log(LOG_DEBUG, "Parent: replayed %u messages of room '%s' to client %d.", h->count, room_name(&rooms, room_id), child->pid);
+}
+
+// --- 방 ---
+// 방 id -> 그 방 멤버가 있는 다른 노드들 (비트 하나가 노드 하나, CLUSTER_MAX 가 32 라서 한 칸에 들어간다)
+// 이 노드가 주인인 방에만 쓴다. 방 기록처럼 모자라면 늘린다
+static uint32_t *room_peers;
+static int peers_cap;
+
+static uint32_t *room_subs(int room_id, bool grow)
+{
+    if (room_id < 0) return NULL;
+    if (room_id >= peers_cap) {
+        if (!grow) return NULL;
+        int cap = rooms.cap > room_id ? rooms.cap : room_id + 1;
+        uint32_t *p = realloc(room_peers, sizeof(*p) * cap);
+        if (p == NULL) return NULL;
+        memset(p + peers_cap, 0, sizeof(*p) * (cap - peers_cap));
+        room_peers = p;
+        peers_cap = cap;
+    }
+    return &room_peers[room_id];
+}
+
+// 비트가 켜진 노드들에게 같은 링크 메시지를 보낸다 (m 의 참조는 부른 쪽 것)
+static void send_to_nodes(uint32_t nodes, message_t *m)
+{
+    if (m == NULL) {
+        metrics_inc(MET_CLUSTER_DROPPED);
+        return;
+    }
+    for (int node = 0; nodes != 0; node++, nodes >>= 1) {
+        if (nodes & 1) cluster_send_msg(node, m);
+    }
+}
+
+static int room_create(room_registry_t *reg, const char *name)
+{
+    int room_id = room_add(reg, name);
+    if (room_id >= 0) {
+        chat_log(LOG_INFO, "Parent: Room '%s' created.", room_name(reg, room_id));
+    } else if (room_id == -2) {
+        chat_log(LOG_WARNING, "Parent: Room '%s' already exists.", name);
+    } else {
+        chat_log(LOG_WARNING, "Parent: out of memory creating room '%s'.", name);
+    }
+    return room_id;
+}
+
+// 지우는 방 때문에 붙잡은 노드는 놓아 준다 (방 번호는 다음에 만드는 방이 다시 쓴다)
+static void room_unhold(int room_id)
+{
+    for (int node = 0; node < CLUSTER_MAX; node++) {
+        if (held_nodes[node] != room_id) continue;
+        held_nodes[node] = -1;
+        cluster_hold(node, false);
+        chat_log(LOG_INFO, "Parent: resuming reads from node %d.", node);
+    }
+}
+
+// 방을 지운다. 멤버들은 모두 방에서 빠진다
+// 주인이면 기록도 지우고 멤버가 있는 노드들에게 알린다 (그 노드들은 자기 사본을 지운다)
+static void room_drop(int room_id)
+{
+    const char *name = room_name(&rooms, room_id);
+
+    if (cluster_owns(name)) {
+        uint32_t *subs = room_subs(room_id, false);
+        if (subs && *subs) {
+            message_t *m = cluster_encode(LINK_RM, name, "", "", 0);
+            send_to_nodes(*subs, m);
+            msg_unref(m);
+            *subs = 0;
+        }
+        // 같은 칸에 새로 만든 방이 옛 기록을 보여 주지 않도록 기록도 지운다
+        room_history_t *h = room_history(room_id, false);
+        if (h) history_clear(h);
+        history_report(room_id);
+        roomlog_drop(name);
+    }
+    room_unhold(room_id);
+    room_remove(&rooms, room_id);
+}
+
+// 닉네임 색인으로 바로 찾는다 (접속자 수와 상관없이 일정). 없으면 NULL
+static pipeInfo *child_named(strview_t name)
+{
+    uint64_t v;
+
+    if (name.len == 0 || !hidx_get_name(&child_by_name, name.p, name.len, &v)) return NULL;
+    return slab_get(&active_children, slab_handle_unpack(v));
+}
+
+// --- 방 메시지 ---
+// 방의 이 노드 쪽 멤버들에게 보낸다. 혼잡한 멤버가 있으면 true
+// 전체 클라이언트를 strcmp 로 훑지 않고, 그 방의 멤버 목록만 따라간다
+static bool fanout(int room_id, message_t *msg, const char *text, size_t len)
+{
+    bool saturated = false;
+
+    room_for_each(&rooms, room_id, m) {
+        pipeInfo *member = room_entry(m, pipeInfo, room);
+        chat_log(LOG_DEBUG, "Parent broadcasting to client %d ('%s') in room '%s'. Message: %.*s", member->pid, member->name, room_name(&rooms, room_id), (int)len, text);
+        if (msg) send_msg_to_child(member, msg, true);
+        else send_to_child(member, text, len);
+        if (member->flow.congested) saturated = true;
+    }
+    return saturated;
+}
+
+// 주인 노드가 방 메시지 하나를 낸다 : 방 기록, 기록 파일, 이 노드의 멤버들, 멤버가 있는 다른 노드들
+// publisher 는 이 노드에서 보낸 자식 (다른 노드에서 LINK_PUB 로 왔으면 NULL). 방이 혼잡하면 true
+static bool publish(int room_id, const char *text, size_t len, pipeInfo *publisher)
+{
+    metrics_inc(MET_MSG_PUBLISHED);
+    metrics_observe(MET_FANOUT, rooms.rooms[room_id].count);
+    metrics_room_msg(room_name(&rooms, room_id));
+
+    // 메시지는 한 번만 만들어 방 기록과 멤버들의 대기열이 함께 가리킨다
+    message_t *msg = msg_from(text, len);
+    room_history_t *h = room_history(room_id, true);
+    if (msg == NULL || h == NULL || history_push(h, msg) == -1) {
+        chat_log(LOG_WARNING, "Parent: out of memory keeping history of room '%s'.", room_name(&rooms, room_id));
+    } else {
+        history_report(room_id);
+    }
+    // 다시 띄워도 남도록 방 기록 파일에도 넣는다 (쓰기 스레드가 묶어서 쓴다)
+    if (msg) roomlog_append(room_name(&rooms, room_id), msg);
+
+    bool saturated = fanout(room_id, msg, text, len);
+    msg_unref(msg);
+
+    // 다른 노드의 멤버들에게는 노드마다 한 번만 보내고, 그 노드가 자기 멤버들에게 뿌린다
+    uint32_t *subs = room_subs(room_id, false);
+    if (subs && *subs) {
+        message_t *lm = cluster_encode(LINK_MSG, room_name(&rooms, room_id), "", text, len);
+        send_to_nodes(*subs, lm);
+        msg_unref(lm);
+    }
+
+    // 방이 혼잡하면 풀릴 때까지 이 발행자의 링을 읽지 않는다
+    // 링이 차면 자식이 소켓을 읽지 않으므로 TCP 가 클라이언트를 늦춘다
+    if (saturated && publisher && !publisher->paused) {
+        set_paused(publisher, true);
+        metrics_inc(MET_PUBLISHER_PAUSED);
+        chat_log(LOG_INFO, "Parent: room '%s' is saturated, pausing reads from client %d.", room_name(&rooms, room_id), publisher->pid);
+    }
+    return saturated;
+}
+
+// --- 명령 핸들러 ---
+// srv 는 채팅방 목록, cli 는 명령을 보낸 자식 (pipeInfo)
+// 보낸 자식을 바로 넘겨받으므로 pid 로 active_children 을 다시 훑지 않는다
+// 클러스터에서는 방마다 주인 노드가 있다. 다른 노드가 주인인 방의 명령은 주인에게 넘긴다
+static void cmd_add(void *srv, void *cli, const cmd_t *cmd)
+{
+    room_registry_t *reg = srv;
+    char add_room_name[NAME];
+
+    if (cmd->arg.len == 0) return;
+    sv_copy(add_room_name, sizeof(add_room_name), cmd->arg);
+    if (!cluster_owns(add_room_name)) {
+        cluster_send(cluster_owner(add_room_name), LINK_ADD, add_room_name, "", "", 0);
+        return;
+    }
+    room_create(reg, add_room_name);
+}
+
+static void cmd_join(void *srv, void *cli, const cmd_t *cmd)
+{
+    room_registry_t *reg = srv;
+    pipeInfo *child = cli;
+    char join_room_name[NAME];
+
+    sv_copy(join_room_name, sizeof(join_room_name), cmd->arg);
+    //그 클라이언트를 채팅방 멤버 목록에 넣는다 (방 이름 비교는 여기서 한 번만)
+    int room_id = room_find(reg, join_room_name);
+    // 다른 노드가 주인인 방이면 이 노드에 사본을 만들어 들어간다. 없는 방이면 주인이 LINK_NOROOM 으로 답한다
+    bool remote = !cluster_owns(join_room_name);
+    if (room_id == -1 && remote) room_id = room_add(reg, join_room_name);
+    if(room_id >= 0){
+        // 이미 있던 방에 다시 들어오면 기록은 보내지 않는다 (이미 받은 메시지들이다)
+        bool moved = child->room.room_id != room_id;
+        room_join(reg, room_id, &child->room);
+        chat_log(LOG_INFO, "Parent: Client %d ('%s') joined room '%s'.", child->pid, child->name, room_name(reg, room_id));
+        // 주인은 이 노드에 방 메시지를 보내기 시작하고, 기록은 LINK_TO 로 이 사람에게 보낸다
+        if (moved && remote) cluster_send(cluster_owner(join_room_name), LINK_SUB, join_room_name, child->name, "", 0);
+        else if (moved) replay_history(child, room_id);
+    } else {
+        chat_log(LOG_WARNING, "Parent: Client %d tried to join unknown room '%s'.", child->pid, join_room_name);
+    }
+}
+
+static void cmd_rm(void *srv, void *cli, const cmd_t *cmd)
+{
+    room_registry_t *reg = srv;
+    char rm_room_name[NAME];
+
+    sv_copy(rm_room_name, sizeof(rm_room_name), cmd->arg);
+    //방 멤버들의 채팅방 정보와 채팅방 목록에서 삭제 (그 방 멤버만 건드린다)
+    int room_id = room_find(reg, rm_room_name);
+    if (!cluster_owns(rm_room_name)) {
+        // 이 노드의 사본은 바로 지운다 (다른 노드의 사본은 주인이 알린다)
+        cluster_send(cluster_owner(rm_room_name), LINK_RM, rm_room_name, "", "", 0);
+        if (room_id != -1) {
+            room_unhold(room_id);
+            room_remove(reg, room_id);
+        }
+        return;
+    }
+    if(room_id != -1){
+        room_drop(room_id);
+        chat_log(LOG_INFO, "Parent: Remove Room Info '%s'", rm_room_name);
+    }
+}
+
+static void cmd_list(void *srv, void *cli, const cmd_t *cmd)
+{
+    room_registry_t *reg = srv;
+    pipeInfo *child = cli;
+    //리스트 목록 작성하기
+    for(int k=0; k<reg->cap; k++){
+        if(!reg->rooms[k].used) continue;
+        // 다른 노드가 주인인 방의 사본은 빼고, 그 방은 주인이 알려 준다
+        if(!cluster_owns(reg->rooms[k].name)) continue;
+        chat_log(LOG_INFO, "Parent: Show Room List %d : ('%s')",k,reg->rooms[k].name);
+        //strnlen : 보통 버퍼 크기가 정해져 있을 때, 그 크기를 넘지 않고 문자열 길이를 안전하게 구함
+        size_t name_len = strnlen(reg->rooms[k].name, sizeof(reg->rooms[k].name));
+        send_to_child(child, reg->rooms[k].name, name_len);
+    }
+    // 다른 노드들은 자기가 주인인 방들을 LINK_TO 로 이 사람에게 보낸다
+    cluster_broadcast(LINK_LIST, "", child->name, "", 0);
+}
+
+static void cmd_leave(void *srv, void *cli, const cmd_t *cmd)
+{
+    pipeInfo *child = cli;
+    //leave한 클라이언트의 채팅방 정보 삭제
+    room_leave(srv, &child->room);
+    chat_log(LOG_INFO, "Parent : Leave the chat room");
+}
+
+/////////////////////////////////////////////////////////////////////////////
+///////////////     유저 고유 명령어  /////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
+static void cmd_users(void *srv, void *cli, const cmd_t *cmd)
+{
+    pipeInfo *child = cli;
+    //이 명령어를 쓴 유저에게 현재 채팅방의 유저를 알려준다. 같은 방 멤버 목록만 따라간다
+    room_for_each((room_registry_t *)srv, child->room.room_id, m){
+        pipeInfo *member = room_entry(m, pipeInfo, room);
+        if (!member->isActive) continue;   // 퇴출되어 회차 끝에 빠질 멤버
+        //이름 하나가 프레임 하나이므로 구분자를 붙이지 않는다
+        send_to_child(child, member->name, strnlen(member->name, NAME));
+    }
+    // 다른 노드에 있는 같은 방 멤버들은 그 노드들이 LINK_TO 로 보낸다
+    if (child->room.room_id >= 0) {
+        cluster_broadcast(LINK_USERS, room_name(srv, child->room.room_id), child->name, "", 0);
+    }
+}
+
+static void cmd_whisper(void *srv, void *cli, const cmd_t *cmd)
+{
+    pipeInfo *child = cli;
+    char final_message[FRAME_MAX];
+
+    // 받는 사람/내용은 원본 메시지를 가리키는 조각이라 strcpy/strtok 로 복사하지 않는다
+    chat_log(LOG_DEBUG, "Parent: Client whisper to '%.*s'.", (int)cmd->target.len, cmd->target.p);
+    if (cmd->target.len == 0) return;
+    int final_len = snprintf(final_message, sizeof(final_message), "from %.*s : %.*s",
+            (int)strnlen(child->name, NAME), child->name,
+            (int)cmd->body.len, cmd->body.p);
+    if (final_len < 0) return;
+    if ((size_t)final_len >= sizeof(final_message)) final_len = sizeof(final_message) - 1;
+
+    pipeInfo *member = child_named(cmd->target);
+    if (member != NULL) {
+        send_to_child(member, final_message, final_len);
+        return;
+    }
+    if (cluster_enabled()) {
+        // 이 노드에 없는 사람이면 다른 노드들에 보낸다 (그 사람이 있는 노드만 전한다)
+        char target[NAME];
+        sv_copy(target, sizeof(target), cmd->target);
+        cluster_broadcast(LINK_TO, "", target, final_message, final_len);
+        return;
+    }
+    chat_log(LOG_ERR, "this user no exist");
+}
+
+// --- 방 기록 질의 ---
+// /history, /search 와 다른 노드가 보낸 LINK_HISTORY/LINK_SEARCH
+// 세그먼트는 방 기록 쓰기 스레드가 훑고, 찾은 메시지는 message_t 로 모아 두었다가 이벤트 루프가 보낸다
+enum { LQ_HISTORY, LQ_SEARCH };
+
+typedef struct {
+    roomlog_job_t job;           // 맨 앞
+    int kind;
+    char room[ROOM_NAME];
+    uint32_t n;                  // LQ_HISTORY : 마지막 n 개, 또는 since_ms 이후
+    int64_t since_ms;
+    char *query;                 // LQ_SEARCH
+    // 받는 곳 : node < 0 이면 이 노드의 자식 (그 사이에 끝나서 칸이 다시 쓰였으면 세대가 달라 버린다)
+    int node;
+    uint64_t child;
+    char user[NAME];             // node >= 0 : 그 노드의 사람
+    // 결과 (쓰기 스레드가 채운다)
+    message_t *out[ROOMLOG_QUERY_MAX];
+    int nout;
+    int found;
+} log_query_t;
+
+// 찾은 메시지 하나. data 는 mmap 한 세그먼트 안이므로 복사해 둔다
+static void query_collect(void *arg, const char *data, uint32_t len, int64_t ts_ms)
+{
+    log_query_t *q = arg;
+    if (q->nout == ROOMLOG_QUERY_MAX) return;
+    message_t *m = msg_from(data, len);
+    if (m) q->out[q->nout++] = m;
+}
+
+// 쓰기 스레드 : 색인에서는 번호만 찾고 내용은 방 기록 파일에서 꺼낸다
+static void query_run(roomlog_job_t *job)
+{
+    log_query_t *q = (log_query_t *)job;
+    uint64_t ids[SEARCH_RESULTS];
+
+    if (q->kind == LQ_HISTORY) {
+        q->found = roomlog_query(q->room, q->n, q->since_ms, query_collect, q);
+        return;
+    }
+    q->found = search_query(q->room, q->query, ids, SEARCH_RESULTS);
+    roomlog_fetch(q->room, ids, q->found, query_collect, q);
+}
+
+// 이벤트 루프 : 찾은 것을 보낸다. 자식에게는 링에 다 넣고 초인종을 한 번만 누른다
+static void query_done(roomlog_job_t *job, bool ok)
+{
+    log_query_t *q = (log_query_t *)job;
+
+    if (ok && q->node < 0) {
+        pipeInfo *child = slab_get(&active_children, slab_handle_unpack(q->child));
+        if (child != NULL && child->isActive) {
+            for (int i = 0; i < q->nout; i++) send_msg_to_child(child, q->out[i], false);
+            if (q->nout > 0 && child->isActive) child_notify(child);
+            chat_log(LOG_DEBUG, "Parent: room log query on '%s' for client %d: %d found, %d sent.",
+                     q->room, child->pid, q->found, q->nout);
+        }
+    } else if (ok) {
+        for (int i = 0; i < q->nout; i++) cluster_send(q->node, LINK_TO, "", q->user, q->out[i]->data, q->out[i]->len);
+        chat_log(LOG_DEBUG, "Parent: room log query on '%s' for '%s' on node %d: %d found, %d sent.",
+                 q->room, q->user, q->node, q->found, q->nout);
+    }
+    for (int i = 0; i < q->nout; i++) msg_unref(q->out[i]);
+    free(q->query);
+    free(q);
+}
+
+// 끝낸 질의는 쓰기 스레드가 초인종으로 알린다
+static note_t roomlog_note = { .fd = -1 };
+
+static void roomlog_watch(void)
+{
+    if (roomlog_enabled() && notify_add(&parent_notify, &roomlog_note, NOTE_ROOMLOG, roomlog_done_fd()) == -1)
+        chat_log(LOG_ERR, "Parent: cannot watch the room log (%m).");
+}
+
+static log_query_t *query_new(int kind, const char *room)
+{
+    log_query_t *q = calloc(1, sizeof(*q));
+    if (q == NULL) {
+        chat_log(LOG_ERR, "Parent: out of memory for a room log query.");
+        return NULL;
+    }
+    q->kind = kind;
+    snprintf(q->room, sizeof(q->room), "%s", room);
+    q->node = -1;
+    q->job.run = query_run;
+    q->job.done = query_done;
+    return q;
+}
+
+// 쓰기 스레드에 맡긴다. 밀려서 큐가 가득 찼으면 버린다 (사용자가 다시 보내면 된다)
+static void query_submit(log_query_t *q)
+{
+    if (roomlog_submit(&q->job) == 0) return;
+    chat_log(LOG_WARNING, "Parent: room log busy, dropping a query on room '%s'.", q->room);
+    query_done(&q->job, false);
+}
+
+// /history N : 마지막 N 개, /history since <유닉스 시각(초)> : 그 뒤의 것. 인자가 틀렸으면 -1
+static int history_args(const cmd_t *cmd, uint32_t *n, int64_t *since_ms)
+{
+    char num[24];
+    char *end;
+
+    *n = ROOMLOG_QUERY_DEF;
+    *since_ms = -1;
+    if (sv_eq(cmd->target, "since")) {
+        sv_copy(num, sizeof(num), cmd->body);
+        long long sec = strtoll(num, &end, 10);
+        if (end == num || *end != '\0' || sec < 0) return -1;
+        *since_ms = sec * 1000;
+    } else if (cmd->arg.len > 0) {
+        sv_copy(num, sizeof(num), cmd->arg);
+        unsigned long v = strtoul(num, &end, 10);
+        if (end == num || *end != '\0') return -1;
+        *n = v > ROOMLOG_QUERY_MAX ? ROOMLOG_QUERY_MAX : v;
+    }
+    return 0;
+}
+
+// 지금 방의 기록. 다시 띄우기 전의 메시지도 방 기록 파일에서 찾는다
+// 다른 노드가 주인인 방의 기록은 주인만 들고 있으므로 인자를 그대로 넘긴다 (결과는 LINK_TO)
+static void cmd_history(void *srv, void *cli, const cmd_t *cmd)
+{
+    pipeInfo *child = cli;
+    int room_id = child->room.room_id;
+    uint32_t n;
+    int64_t since_ms;
+
+    if (room_id < 0) return;
+    const char *room = room_name(&rooms, room_id);
+    if (!cluster_owns(room)) {
+        cluster_send(cluster_owner(room), LINK_HISTORY, room, child->name, cmd->arg.p, cmd->arg.len);
+        return;
+    }
+    if (!roomlog_enabled()) return;
+    if (history_args(cmd, &n, &since_ms) == -1) {
+        chat_log(LOG_WARNING, "Parent: bad /history '%.*s' from client %d.", (int)cmd->arg.len, cmd->arg.p, child->pid);
+        return;
+    }
+
+    log_query_t *q = query_new(LQ_HISTORY, room);
+    if (q == NULL) return;
+    q->n = n;
+    q->since_ms = since_ms;
+    q->child = slab_handle_pack(slab_handle(child));
+    query_submit(q);
+}
+
+// /search 낱말... : 지금 방에서 낱말이 모두 들어 있는 최근 메시지
+static void cmd_search(void *srv, void *cli, const cmd_t *cmd)
+{
+    pipeInfo *child = cli;
+    int room_id = child->room.room_id;
+
+    if (room_id < 0 || cmd->arg.len == 0) return;
+    const char *room = room_name(&rooms, room_id);
+    if (!cluster_owns(room)) {
+        cluster_send(cluster_owner(room), LINK_SEARCH, room, child->name, cmd->arg.p, cmd->arg.len);
+        return;
+    }
+    if (!search_enabled()) return;
+    log_query_t *q = query_new(LQ_SEARCH, room);
+    if (q == NULL) return;
+    if ((q->query = strndup(cmd->arg.p, cmd->arg.len)) == NULL) {
+        query_done(&q->job, false);
+        return;
+    }
+    q->child = slab_handle_pack(slab_handle(child));
+    query_submit(q);
+}
+
+// 명령 번호 -> 핸들러. 새 명령은 command.h/command.c 에 등록하고 여기 한 줄 추가한다
+static const cmd_handler_t parent_commands[CMD_COUNT] = {
+    [CMD_ADD]     = cmd_add,
+    [CMD_JOIN]    = cmd_join,
+    [CMD_RM]      = cmd_rm,
+    [CMD_LIST]    = cmd_list,
+    [CMD_USERS]   = cmd_users,
+    [CMD_LEAVE]   = cmd_leave,
+    [CMD_WHISPER] = cmd_whisper,
+    [CMD_HISTORY] = cmd_history,
+    [CMD_SEARCH]  = cmd_search,
+};
 
-    // 메인 프로세스(부모)의 시그널 핸들러를 설정
-    setup_signal_handlers_parent_main(); 
+// 자식 child 의 링에서 꺼낸 메시지 하나를 처리한다
+// 링마다 보낸 자식이 정해져 있으므로 "PID:내용" 을 strtok 으로 나눌 필요가 없다
+// 명령은 cmd_parse() 로 한 번 훑어서 나누고 표에서 핸들러를 바로 찾는다
+static void handle_child_message(pipeInfo *child, const char *content, size_t len)
+{
+    cmd_t cmd;
+    cmd_id_t id = cmd_parse(content, len, &cmd);
+
+    // 끝의 줄바꿈은 빼고 다룬다
+    while (len > 0 && (content[len - 1] == '\n' || content[len - 1] == '\r')) len--;
+    if (len == 0) return;
 
-    // 데몬화 함수 호출 (argc, argv 인자 전달)
-    daemonize(argc, argv); 
+    if (content[0] == '/') {
+        cmd_dispatch(parent_commands, &rooms, child, &cmd);
+    }
+    else if (child->name[0] == '\0') { 
+        sv_copy(child->name, NAME, (strview_t){ content, len });
+        if (hidx_put_name(&child_by_name, child->name, strlen(child->name),
+                          slab_handle_pack(slab_handle(child))) == -1) {
+            chat_log(LOG_ERR, "Parent: out of memory indexing name '%s'.", child->name);
+        }
+        chat_log(LOG_INFO, "Parent: Client %d set name to '%s'.", child->pid, child->name);
+    }
+    else if (id != CMD_NONE) { //귓속말일때
+        cmd_dispatch(parent_commands, &rooms, child, &cmd);
+    }
+    else { 
+        char broadcast_mesg[FRAME_MAX]; 
+        int broadcast_len = snprintf(broadcast_mesg, sizeof(broadcast_mesg), "%s: %.*s", child->name, (int)len, content);
+        if (broadcast_len < 0) return;
+        if ((size_t)broadcast_len >= sizeof(broadcast_mesg)) broadcast_len = sizeof(broadcast_mesg) - 1;
+
+        int sender_room_id = child->room.room_id;
+        if (sender_room_id < 0) { 
+            chat_log(LOG_DEBUG, "Parent: Message from client %d ('%s') but not in a room. Message: %.*s", child->pid, child->name, (int)len, content);
+            return; 
+        }
+        const char *room = room_name(&rooms, sender_room_id);
+        // 다른 노드가 주인인 방은 주인이 순서를 정해 뿌린다 (이 노드 멤버들에게는 LINK_MSG 로 돌아온다)
+        if (!cluster_owns(room)) {
+            int owner = cluster_owner(room);
+            cluster_send(owner, LINK_PUB, room, child->name, broadcast_mesg, broadcast_len);
+            // 주인에게 가는 링크가 밀리면 풀릴 때까지 이 발행자의 링을 읽지 않는다
+            if (cluster_congested(owner) && !child->paused) {
+                set_paused(child, true);
+                metrics_inc(MET_PUBLISHER_PAUSED);
+                chat_log(LOG_INFO, "Parent: link to node %d is backed up, pausing reads from client %d.", owner, child->pid);
+            }
+            return;
+        }
+        publish(sender_room_id, broadcast_mesg, broadcast_len, child);
+    }
+}
+
+// 작업자 링에서 꺼낸 레코드를 보낸 연결의 메시지로 처리한다
+// 한 번에 WORKER_DRAIN_BATCH 개까지만 꺼낸다. 같은 작업자의 연결들에게 팬아웃하면
+// 작업자 링이 금방 차므로, 큰 링을 통째로 비우면 대기열이 한꺼번에 한도를 넘는다
+// 링에 아직 남았으면 true
+static bool drain_worker(worker_t *w, int batch)
+{
+    char buf[sizeof(worker_hdr_t) + FRAME_MAX + 1];
+    pipeInfo *child;
+    int n;
+
+    shm_chan_ack(&w->to_parent);
+    while (batch-- > 0 && (n = pool_pop(w, &child, buf, sizeof(buf) - 1)) >= 0) {
+        if (child == NULL || !child->isActive) continue;   // 이미 닫혔거나 퇴출된 연결
+        buf[n] = '\0';
+        chat_log(LOG_DEBUG, "Parent received message from worker %d: %s", w->pid, buf);
+        metrics_inc(MET_MSG_IN);
+        handle_child_message(child, buf, n);
+    }
+    return !shm_ring_empty(w->to_parent.ring);
+}
+
+// 작업자가 연결이 닫혔다고 알려 왔다
+// 닫기 전에 링에 넣은 마지막 메시지들을 먼저 처리하고 레코드를 푼다
+static void worker_conn_closed(pipeInfo *child)
+{
+    drain_worker(child->worker, INT_MAX);
+    remove_child(child);
+}
+
+// 초인종이 울린 자식 하나의 링을 비운다
+static void drain_child(pipeInfo *child)
+{
+    char buf[FRAME_MAX + 1]; // 프레임 하나가 통째로 들어간다
+    int n;
+
+    shm_chan_ack(&child->to_parent);
+    if (!child->isActive) return;
+    while (!child->paused && (n = shm_ring_pop(child->to_parent.ring, buf, sizeof(buf) - 1)) >= 0) {
+        buf[n] = '\0';
+        chat_log(LOG_DEBUG, "Parent received message from child %d: %s", child->pid, buf);
+        metrics_inc(MET_MSG_IN);
+        handle_child_message(child, buf, n);
+    }
+}
+
+// --- 클러스터 링크 ---
+// 다른 노드가 보낸 메시지. from 은 보낸 노드 번호
+// 방/사람 이름은 링크 버퍼 안의 조각이므로 '\0' 으로 끝나게 복사해서 쓴다
+
+static void link_add(int from, const link_msg_t *m)
+{
+    char room[ROOM_NAME];
+
+    sv_copy(room, sizeof(room), m->room);
+    if (cluster_owns(room)) room_create(&rooms, room);
+}
+
+static void link_rm(int from, const link_msg_t *m)
+{
+    char room[ROOM_NAME];
+
+    sv_copy(room, sizeof(room), m->room);
+    int room_id = room_find(&rooms, room);
+    if (room_id == -1) return;
+    // 주인이면 방을 지우고 멤버가 있는 노드들에 알린다. 주인이 보낸 것이면 사본만 지운다
+    room_drop(room_id);
+    chat_log(LOG_INFO, "Parent: Remove Room Info '%s' (node %d)", room, from);
+}
+
+static void link_sub(int from, const link_msg_t *m)
+{
+    char room[ROOM_NAME], user[NAME];
+
+    sv_copy(room, sizeof(room), m->room);
+    sv_copy(user, sizeof(user), m->user);
+    int room_id = room_find(&rooms, room);
+    uint32_t *subs = room_id >= 0 && cluster_owns(room) ? room_subs(room_id, true) : NULL;
+    if (subs == NULL) {
+        cluster_send(from, LINK_NOROOM, room, user, "", 0);
+        return;
+    }
+    *subs |= 1u << from;
+    // 들어온 사람에게 최근 메시지를 보낸다. 같은 링크로 이어서 가는 방 메시지보다 먼저 도착한다
+    room_history_t *h = room_history(room_id, false);
+    for (uint32_t i = 0; h != NULL && i < h->count; i++) {
+        message_t *hm = history_at(h, i);
+        cluster_send(from, LINK_TO, "", user, hm->data, hm->len);
+    }
+    chat_log(LOG_INFO, "Parent: '%s' on node %d joined room '%s'.", user, from, room);
+}
+
+static void link_noroom(int from, const link_msg_t *m)
+{
+    char room[ROOM_NAME];
+
+    sv_copy(room, sizeof(room), m->room);
+    int room_id = room_find(&rooms, room);
+    if (room_id == -1 || cluster_owns(room)) return;
+    pipeInfo *member = child_named(m->user);
+    if (member != NULL && member->room.room_id == room_id) room_leave(&rooms, &member->room);
+    if (rooms.rooms[room_id].count == 0) {
+        room_unhold(room_id);
+        room_remove(&rooms, room_id);
+    }
+    chat_log(LOG_WARNING, "Parent: Client '%.*s' tried to join unknown room '%s'.", (int)m->user.len, m->user.p, room);
+}
+
+static void link_unsub(int from, const link_msg_t *m)
+{
+    char room[ROOM_NAME];
+
+    sv_copy(room, sizeof(room), m->room);
+    uint32_t *subs = room_subs(room_find(&rooms, room), false);
+    if (subs) *subs &= ~(1u << from);
+}
+
+static void link_pub(int from, const link_msg_t *m)
+{
+    char room[ROOM_NAME];
+
+    sv_copy(room, sizeof(room), m->room);
+    int room_id = room_find(&rooms, room);
+    if (room_id == -1 || !cluster_owns(room)) {
+        chat_log(LOG_DEBUG, "Parent: message from node %d for unknown room '%s'.", from, room);
+        return;
+    }
+    metrics_inc(MET_MSG_IN);
+    // 방이 혼잡하면 풀릴 때까지 그 노드의 링크를 읽지 않는다 (그 노드의 발행자들은 링크 대기열이 밀려서 멈춘다)
+    if (publish(room_id, m->text.p, m->text.len, NULL) && held_nodes[from] < 0) {
+        held_nodes[from] = room_id;
+        publishers_paused = true;
+        cluster_hold(from, true);
+        metrics_inc(MET_PUBLISHER_PAUSED);
+        chat_log(LOG_INFO, "Parent: room '%s' is saturated, pausing reads from node %d.", room, from);
+    }
+}
+
+static void link_msg(int from, const link_msg_t *m)
+{
+    char room[ROOM_NAME];
+
+    sv_copy(room, sizeof(room), m->room);
+    int room_id = room_find(&rooms, room);
+    if (room_id == -1 || rooms.rooms[room_id].count == 0) {
+        // 이 노드에는 이제 멤버가 없다. 주인이 더 보내지 않게 하고 사본을 지운다
+        cluster_send(from, LINK_UNSUB, room, "", "", 0);
+        if (room_id != -1 && !cluster_owns(room)) {
+            room_unhold(room_id);
+            room_remove(&rooms, room_id);
+        }
+        return;
+    }
+    message_t *msg = msg_from(m->text.p, m->text.len);
+    fanout(room_id, msg, m->text.p, m->text.len);
+    msg_unref(msg);
+}
+
+static void link_to(int from, const link_msg_t *m)
+{
+    pipeInfo *member = child_named(m->user);
+    if (member != NULL && member->isActive) send_to_child(member, m->text.p, m->text.len);
+}
+
+static void link_list(int from, const link_msg_t *m)
+{
+    char user[NAME];
+
+    sv_copy(user, sizeof(user), m->user);
+    for (int k = 0; k < rooms.cap; k++) {
+        if (!rooms.rooms[k].used || !cluster_owns(rooms.rooms[k].name)) continue;
+        cluster_send(from, LINK_TO, "", user, rooms.rooms[k].name, strnlen(rooms.rooms[k].name, ROOM_NAME));
+    }
+}
+
+static void link_users(int from, const link_msg_t *m)
+{
+    char room[ROOM_NAME], user[NAME];
+
+    sv_copy(room, sizeof(room), m->room);
+    sv_copy(user, sizeof(user), m->user);
+    int room_id = room_find(&rooms, room);
+    room_for_each(&rooms, room_id, rm) {
+        pipeInfo *member = room_entry(rm, pipeInfo, room);
+        if (!member->isActive) continue;
+        cluster_send(from, LINK_TO, "", user, member->name, strnlen(member->name, NAME));
+    }
+}
+
+static void link_history(int from, const link_msg_t *m)
+{
+    char room[ROOM_NAME], user[NAME], line[FRAME_MAX];
+    cmd_t cmd;
+    uint32_t n;
+    int64_t since_ms;
+
+    sv_copy(room, sizeof(room), m->room);
+    sv_copy(user, sizeof(user), m->user);
+    if (!cluster_owns(room) || room_find(&rooms, room) == -1 || !roomlog_enabled()) return;
+    // 인자는 이 노드의 /history 와 같은 파서로 나눈다
+    int len = snprintf(line, sizeof(line), "/history %.*s", (int)m->text.len, m->text.p);
+    if (len < 0) return;
+    if ((size_t)len >= sizeof(line)) len = sizeof(line) - 1;
+    cmd_parse(line, len, &cmd);
+    if (history_args(&cmd, &n, &since_ms) == -1) {
+        chat_log(LOG_WARNING, "Parent: bad /history '%.*s' from '%s' on node %d.", (int)cmd.arg.len, cmd.arg.p, user, from);
+        return;
+    }
+    log_query_t *q = query_new(LQ_HISTORY, room);
+    if (q == NULL) return;
+    q->n = n;
+    q->since_ms = since_ms;
+    q->node = from;
+    memcpy(q->user, user, sizeof(q->user));
+    query_submit(q);
+}
+
+static void link_search(int from, const link_msg_t *m)
+{
+    char room[ROOM_NAME];
+
+    sv_copy(room, sizeof(room), m->room);
+    if (!cluster_owns(room) || room_find(&rooms, room) == -1 || !search_enabled() || m->text.len == 0) return;
+    log_query_t *q = query_new(LQ_SEARCH, room);
+    if (q == NULL) return;
+    if ((q->query = strndup(m->text.p, m->text.len)) == NULL) {
+        query_done(&q->job, false);
+        return;
+    }
+    q->node = from;
+    sv_copy(q->user, sizeof(q->user), m->user);
+    query_submit(q);
+}
+
+// 링크 메시지 종류 -> 핸들러 (LINK_HELLO 는 cluster.c 가 처리한다)
+static const link_handler_t link_handlers[LINK_COUNT] = {
+    [LINK_ADD]     = link_add,
+    [LINK_RM]      = link_rm,
+    [LINK_SUB]     = link_sub,
+    [LINK_NOROOM]  = link_noroom,
+    [LINK_UNSUB]   = link_unsub,
+    [LINK_PUB]     = link_pub,
+    [LINK_MSG]     = link_msg,
+    [LINK_TO]      = link_to,
+    [LINK_LIST]    = link_list,
+    [LINK_USERS]   = link_users,
+    [LINK_HISTORY] = link_history,
+    [LINK_SEARCH]  = link_search,
+};
+
+// --- io_uring 다중 accept ---
+// CHAT_IO=uring 이면 서버 소켓을 epoll 에 거는 대신 다중 accept 요청 하나를 걸어 둡니다.
+// 완료가 생기면 링에 등록한 eventfd 가 울리고, 그 알림 한 번에 쌓인 소켓을 모두 꺼냅니다.
+static uring_t accept_ring = { .fd = -1 };
+static int accept_efd = -1;
+static bool accept_multi = true;   // 다중 accept 를 못 쓰는 커널이면 완료마다 다시 겁니다
+
+static void accept_ring_close(void)
+{
+    uring_close(&accept_ring);
+    if (accept_efd >= 0) close(accept_efd);
+    accept_efd = -1;
+}
+
+static int accept_ring_start(int ssock, note_t *note)
+{
+    if (uring_init(&accept_ring, ACCEPT_RING_ENTRIES) == -1) return -1;
+    accept_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (accept_efd < 0 || uring_register_eventfd(&accept_ring, accept_efd) == -1 ||
+        uring_accept(&accept_ring, ssock, true, 0) == -1 || uring_submit(&accept_ring, 0) == -1 ||
+        notify_add(&parent_notify, note, NOTE_ACCEPT_RING, accept_efd) == -1) {
+        accept_ring_close();
+        return -1;
+    }
+    return 0;
+}
+
+// 완료된 accept 들을 fds 에 꺼낸다. 요청이 끝났으면 (다중이 아니거나 오류) 다시 건다
+static int accept_ring_take(int ssock, int *fds, int max)
+{
+    struct io_uring_cqe cqes[URING_BATCH];
+    uint64_t v;
+    bool rearm = false;
+
+    if (max > URING_BATCH) max = URING_BATCH;
+    if (read(accept_efd, &v, sizeof(v)) < 0 && errno != EAGAIN) chat_log(LOG_WARNING, "Parent: accept eventfd: %m");
+    int n = uring_reap(&accept_ring, cqes, max), k = 0;
+    for (int i = 0; i < n; i++) {
+        int res = cqes[i].res;
+        if (!(cqes[i].flags & IORING_CQE_F_MORE)) rearm = true;
+        if (res >= 0) {
+            fds[k++] = res;
+        } else if (res == -EINVAL && accept_multi) {
+            chat_log(LOG_INFO, "Parent: multishot accept unsupported, re-arming per connection.");
+            accept_multi = false;
+        } else if (res == -EMFILE || res == -ENFILE) {
+            chat_log(LOG_WARNING, "accept(): out of file descriptors (%d clients).", active_children.used);
+            metrics_inc(MET_CONN_REJECTED);
+        } else {
+            chat_log(LOG_ERR, "accept() error: %s", strerror(-res));
+        }
+    }
+    if (rearm && (uring_accept(&accept_ring, ssock, accept_multi, 0) == -1 || uring_submit(&accept_ring, 0) == -1)) {
+        chat_log(LOG_ERR, "Parent: cannot re-arm accept: %m");
+    }
+    // 다 꺼내지 못했으면 eventfd 가 다시 울리지 않으므로 스스로 한 번 더 울린다
+    if (n == max) eventfd_write(accept_efd, 1);
+    return k;
+}
+
+// --- 새 연결 ---
+// 받은 소켓 하나를 맡긴다 : 작업자 풀이면 작업자에게, 아니면 fork() 한 자식에게
+// addr 이 NULL 이면 (io_uring 다중 accept 는 주소를 받지 않는다) 로그용 주소만 따로 묻는다
+static void admit_client(int csock, const struct sockaddr_in *addr, int ssock, int mfd)
+{
+    struct sockaddr_in peer;
+    socklen_t peer_len = sizeof(peer);
+    char mesg_buffer[INET_ADDRSTRLEN] = "?"; // 접속한 클라이언트 주소 문자열
+
+    if (addr == NULL && getpeername(csock, (struct sockaddr *)&peer, &peer_len) == 0) addr = &peer;
+    if (addr) inet_ntop(AF_INET, &addr->sin_addr, mesg_buffer, sizeof(mesg_buffer));
+    chat_log(LOG_INFO, "Client is connected : %s", mesg_buffer);
+    // 자식/작업자가 회차마다 모아서 보내므로 Nagle 로 더 묶을 것이 없습니다. (실패해도 연결은 씁니다)
+    set_nodelay(csock);
+
+    // 작업자 풀 모드: fork() 없이 레코드만 만들고 소켓은 가장 한가한 작업자에게 넘깁니다.
+    if (pool.n > 0) {
+        pipeInfo *child = slab_alloc(&active_children, NULL);
+        if (child == NULL || pool_assign(csock, child) == -1) {
+            chat_log(LOG_ERR, "Parent: cannot place new client.");
+            if (child) slab_free(&active_children, child);
+            metrics_inc(MET_CONN_REJECTED);
+            close(csock);
+            return;
+        }
+        close(csock);
+        child->isActive = true;
+        room_member_init(&child->room);
+        chat_log(LOG_INFO, "Parent: Client handed to worker %d. Total active children: %u.", child->pid, active_children.used);
+        metrics_inc(MET_CONN_ACCEPTED);
+        metrics_gauge_add(MET_CONN_ACTIVE, 1);
+        return;
+    }
+
+    // 파이프 두 개 대신 방향별 공유 메모리 링 + eventfd 초인종을 fork() 전에 만듭니다.
+    shm_chan_t to_child, to_parent;
+
+    if (shm_chan_open(&to_child) < 0) {
+        chat_log(LOG_ERR, "Failed to create parent->child ring: %m");
+        close(csock); 
+        return; 
+    }
+    if (shm_chan_open(&to_parent) < 0) {
+        chat_log(LOG_ERR, "Failed to create child->parent ring: %m");
+        shm_chan_close(&to_child);
+        close(csock); 
+        return; 
+    }
+
+    pid_t pids_; 
+    if((pids_ = fork()) < 0){ 
+        chat_log(LOG_ERR, "fork failed: %m");
+        close(csock);
+        shm_chan_close(&to_child);
+        shm_chan_close(&to_parent);
+        return; 
+    }
+    // --- 자식 프로세스 ---
+    else if(pids_ == 0){ 
+        chat_log(LOG_INFO, "Child process started for PID %d.", getpid());
+        
+        // 자식은 서버 리스닝 소켓을 사용하지 않으므로 닫습니다.
+        // ssock은 main 함수의 로컬 변수지만, fork()에 의해 FD가 복제되었으므로 자식 프로세스에서 닫을 수 있습니다.
+        close(ssock); 
+        // 지표 소켓은 부모 것이므로 닫기만 하고 파일은 지우지 않습니다.
+        if (mfd >= 0) close(mfd);
+        // 부모의 epoll/signalfd 를 닫고 막아 둔 시그널을 되돌립니다. (client_work 가 자기 signalfd 를 만듭니다)
+        notify_forget(&parent_notify);
+        // 다른 노드와의 링크 소켓도 닫습니다. (자식이 들고 있으면 부모가 닫아도 링크가 끊기지 않습니다)
+        cluster_forget();
+        // 부모의 accept 링도 물려받았습니다. (자식은 필요하면 자기 링을 만듭니다)
+        accept_ring_close();
+        // 다른 자식들의 링과 초인종도 물려받았으므로 정리합니다.
+        slab_for_each(&active_children, pipeInfo, other) {
+            shm_chan_close(&other->to_child);
+            shm_chan_close(&other->to_parent);
+            if (other->adopted) close(other->pidfd);
+        }
+
+        // client_work 함수로 제어권을 넘깁니다.
+        client_work(getpid(), getppid(), csock, &to_child, &to_parent);
+        // client_work 내부에서 exit(0) 호출로 자식 프로세스가 종료되므로, 이 이후의 코드는 실행되지 않습니다.
+    }
+    // --- 부모 프로세스 ---
+    else { 
+        close(csock); 
+
+        // 새 레코드는 0 으로 채워져 나옵니다 (이름, 대기열, 흐름 상태 모두 빈 값)
+        slab_handle_t handle;
+        pipeInfo *child = slab_alloc(&active_children, &handle);
+        if (child != NULL && hidx_put_id(&child_by_pid, pids_, slab_handle_pack(handle)) == -1) {
+            slab_free(&active_children, child);
+            child = NULL;
+        }
+        if (child == NULL) {
+            chat_log(LOG_ERR, "Parent: out of memory for child %d.", pids_);
+            kill(pids_, SIGTERM);
+            shm_chan_close(&to_child);
+            shm_chan_close(&to_parent);
+            return;
+        }
+        child->pid = pids_; 
+        child->to_child = to_child; 
+        child->to_parent = to_parent;   
+        child->isActive = true; 
+        room_member_init(&child->room);
+        // 이 자식의 초인종이 울리면 note 로 바로 이 레코드를 찾습니다.
+        if (notify_add(&parent_notify, &child->note, NOTE_CHILD, to_parent.efd) == -1) {
+            chat_log(LOG_ERR, "Parent: cannot watch child %d: %m", pids_);
+            child->isActive = false;
+            kill(pids_, SIGTERM);   // 레코드는 SIGCHLD 때 풉니다
+            return;
+        }
+
+        chat_log(LOG_INFO, "Parent: Child %d added. Total active children: %u.", pids_, active_children.used);
+        metrics_inc(MET_CONN_ACCEPTED);
+        metrics_gauge_add(MET_CONN_ACTIVE, 1);
+    }
+}
+
+// --- 무중단 업그레이드 ---
+// 옛 프로세스 : 서버 소켓, 방과 방 기록, 자식들의 링과 대기열을 넘긴다
+// 방 id 는 새 프로세스가 이름으로 다시 만들며 정하므로, 방 기록과 자식은 방 이름으로 잇는다
+static int upgrade_send_state(int sock, int ssock)
+{
+    upgrade_rec_t rec = { .kind = UPG_LISTEN };
+    if (upgrade_send(sock, &rec, NULL, 0, &ssock, 1) == -1) return -1;
+
+    for (int id = 0; id < rooms.cap; id++) {
+        if (!rooms.rooms[id].used) continue;
+        uint32_t *subs = room_subs(id, false);
+        rec = (upgrade_rec_t){ .kind = UPG_ROOM, .peers = subs ? *subs : 0 };
+        snprintf(rec.room, sizeof(rec.room), "%s", room_name(&rooms, id));
+        if (upgrade_send(sock, &rec, NULL, 0, NULL, 0) == -1) return -1;
+
+        room_history_t *h = room_history(id, false);
+        rec.kind = UPG_HISTORY;
+        for (uint32_t i = 0; h && i < h->count; i++) {
+            message_t *m = history_at(h, i);
+            if (upgrade_send(sock, &rec, m->data, m->len, NULL, 0) == -1) return -1;
+        }
+    }
+
+    // 퇴출 중인 자식은 넘기지 않는다 (SIGTERM 을 받았으니 곧 끝난다)
+    slab_for_each(&active_children, pipeInfo, child) {
+        if (child->worker || !child->isActive) continue;
+        rec = (upgrade_rec_t){ .kind = UPG_CHILD, .pid = child->pid };
+        snprintf(rec.name, sizeof(rec.name), "%s", child->name);
+        if (child->room.room_id >= 0) snprintf(rec.room, sizeof(rec.room), "%s", room_name(&rooms, child->room.room_id));
+        int fds[UPGRADE_FDS] = { child->to_child.mfd, child->to_child.efd, child->to_parent.mfd, child->to_parent.efd };
+        if (upgrade_send(sock, &rec, NULL, 0, fds, UPGRADE_FDS) == -1) return -1;
+
+        msg_queue_t *q = &child->backlog;
+        rec.kind = UPG_BACKLOG;
+        for (uint32_t i = 0; i < q->count; i++) {
+            message_t *m = q->items[(q->head + i) & (q->cap - 1)];
+            if (upgrade_send(sock, &rec, m->data, m->len, NULL, 0) == -1) return -1;
+        }
+    }
+    rec = (upgrade_rec_t){ .kind = UPG_END };
+    return upgrade_send(sock, &rec, NULL, 0, NULL, 0);
+}
+
+// 새 프로세스가 다 받고 링의 주인이 되었다고 답하면 true
+static bool upgrade_wait_ready(int sock)
+{
+    upgrade_rec_t rec;
+    char buf[1];
+    int fds[UPGRADE_FDS], nfds;
+
+    if (upgrade_recv(sock, &rec, buf, sizeof(buf), fds, &nfds) < 0) return false;
+    for (int i = 0; i < nfds; i++) close(fds[i]);
+    return rec.kind == UPG_READY;
+}
+
+// SIGUSR2 : 새 바이너리에게 넘긴다. 넘겼으면 true (부른 쪽은 자식들을 건드리지 않고 끝낸다)
+// 넘기지 못하면 새 프로세스를 죽이고 닫았던 것들을 다시 열어 그대로 돈다
+static bool hot_upgrade(int ssock, int mfd, note_t *listen_note)
+{
+    // 작업자 풀의 연결은 작업자가 부모 칸 번호로 부르므로 넘길 수 없다
+    if (pool.n > 0) {
+        chat_log(LOG_WARNING, "Parent: upgrade is not supported with a worker pool.");
+        return false;
+    }
+    // 자식들은 부모의 pidfd 를 지켜보다가 새 부모를 따라간다. pidfd 가 없는 커널이면 PDEATHSIG 로 함께 끝난다
+    int probe = pid_watch(getpid());
+    if (probe < 0) {
+        chat_log(LOG_WARNING, "Parent: upgrade needs pidfd support: %m");
+        return false;
+    }
+    close(probe);
+    chat_log(LOG_INFO, "Parent: upgrading, handing over %u clients.", active_children.used);
+
+    // 더 받지 않는다. io_uring 으로 이미 받아 둔 연결은 자식으로 만들어 함께 넘긴다
+    if (accept_efd >= 0) {
+        int fds[URING_BATCH];
+        int n = accept_ring_take(ssock, fds, URING_BATCH);
+        for (int i = 0; i < n; i++) admit_client(fds[i], NULL, ssock, mfd);
+    }
+    notify_del(&parent_notify, listen_note);
+    accept_ring_close();
+    // 링크 포트와 방 기록/검색 파일은 새 프로세스가 다시 연다 (두 프로세스가 같은 파일에 쓰지 않도록)
+    cluster_shutdown();
+    search_shutdown();
+    notify_del(&parent_notify, &roomlog_note);
+    roomlog_shutdown();
+
+    pid_t pid;
+    int sock = upgrade_spawn(&parent_notify, &pid);
+    bool ok = sock >= 0 && upgrade_send_state(sock, ssock) == 0 && upgrade_wait_ready(sock);
+    if (sock >= 0) close(sock);
+    if (ok) {
+        chat_log(LOG_INFO, "Parent: handed over to %d, exiting.", pid);
+        return true;
+    }
+
+    chat_log(LOG_ERR, "Parent: upgrade failed, keeping this binary.");
+    if (pid > 0) {
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+    }
+    // 새 프로세스가 링의 주인을 바꿨을 수 있다
+    slab_for_each(&active_children, pipeInfo, child) {
+        if (child->worker) continue;
+        shm_ring_set_owner(child->to_child.ring, getpid());
+        shm_ring_set_owner(child->to_parent.ring, getpid());
+    }
+    if (roomlog_init() == -1) chat_log(LOG_WARNING, "Parent: room log disabled.");
+    else roomlog_watch();
+    if (search_init() == -1) chat_log(LOG_WARNING, "Parent: search disabled.");
+    for (int i = 0; i < CLUSTER_MAX; i++) held_nodes[i] = -1;
+    if (cluster_init(&parent_notify, link_handlers) == -1) chat_log(LOG_ERR, "Parent: cannot rejoin cluster.");
+    if (uring_on() && accept_ring_start(ssock, listen_note) == -1) {
+        chat_log(LOG_WARNING, "Parent: cannot restart accept ring (%m), using epoll.");
+    }
+    if (accept_efd < 0 && notify_add(&parent_notify, listen_note, NOTE_LISTEN, ssock) == -1) {
+        chat_log(LOG_ERR, "Parent: cannot watch server socket: %m");
+    }
+    return false;
+}
+
+// 새 프로세스 : 넘겨받은 자식 하나를 등록한다. fds 는 to_child memfd/eventfd, to_parent memfd/eventfd
+// 이 프로세스의 자식이 아니라서 SIGCHLD 가 오지 않으므로 pidfd 로 끝난 것을 안다 (NOTE_CHILD_EXIT)
+static pipeInfo *adopt_child(const upgrade_rec_t *rec, int *fds, int nfds)
+{
+    shm_chan_t to_child = { .efd = -1, .mfd = -1 }, to_parent = { .efd = -1, .mfd = -1 };
+    slab_handle_t handle;
+    pipeInfo *child = NULL;
+    int pidfd = -1;
+
+    if (nfds != UPGRADE_FDS || (pidfd = pid_watch(rec->pid)) < 0 ||
+        shm_chan_attach(&to_child, fds[0], fds[1]) == -1 || shm_chan_attach(&to_parent, fds[2], fds[3]) == -1 ||
+        (child = slab_alloc(&active_children, &handle)) == NULL) {
+        chat_log(LOG_ERR, "Parent: cannot adopt client %d: %m", rec->pid);
+        shm_ring_destroy(to_child.ring);
+        shm_ring_destroy(to_parent.ring);
+        for (int i = 0; i < nfds; i++) close(fds[i]);
+        if (pidfd >= 0) close(pidfd);
+        kill(rec->pid, SIGTERM);
+        return NULL;
+    }
+    child->pid = rec->pid;
+    child->to_child = to_child;
+    child->to_parent = to_parent;
+    child->isActive = true;
+    child->adopted = true;
+    child->pidfd = pidfd;
+    child->note.fd = child->exit_note.fd = -1;
+    room_member_init(&child->room);
+    metrics_gauge_add(MET_CONN_ACTIVE, 1);
+
+    // 레코드를 모두 채운 뒤에 색인과 epoll 에 건다. 하나라도 못 걸면 연결을 끊는다
+    uint64_t v = slab_handle_pack(handle);
+    sv_copy(child->name, NAME, (strview_t){ rec->name, strnlen(rec->name, NAME) });
+    int room_id = rec->room[0] ? room_find(&rooms, rec->room) : -1;
+    if (room_id >= 0) room_join(&rooms, room_id, &child->room);
+    if (hidx_put_id(&child_by_pid, child->pid, v) == -1 ||
+        (child->name[0] && hidx_put_name(&child_by_name, child->name, strlen(child->name), v) == -1) ||
+        notify_add(&parent_notify, &child->exit_note, NOTE_CHILD_EXIT, pidfd) == -1 ||
+        notify_add(&parent_notify, &child->note, NOTE_CHILD, to_parent.efd) == -1) {
+        chat_log(LOG_ERR, "Parent: cannot watch adopted client %d: %m", child->pid);
+        kill(child->pid, SIGTERM);
+        remove_child(child);
+        return NULL;
+    }
+    // 넘기는 동안 자식이 넣은 메시지는 옛 프로세스가 초인종만 받았을 수 있다
+    if (!shm_ring_empty(to_parent.ring)) shm_chan_notify(&to_parent);
+    return child;
+}
+
+// 새 프로세스 : 옛 프로세스가 보낸 것을 UPG_END 까지 받는다. 서버 소켓은 *ssock
+static int upgrade_adopt(int sock, int *ssock)
+{
+    static char data[FRAME_MAX];
+    upgrade_rec_t rec;
+    int fds[UPGRADE_FDS], nfds;
+    int room_id = -1;
+    pipeInfo *child = NULL;
+    ssize_t n;
+
+    *ssock = -1;
+    while ((n = upgrade_recv(sock, &rec, data, sizeof(data), fds, &nfds)) >= 0) {
+        switch (rec.kind) {
+        case UPG_LISTEN:
+            if (nfds == 1 && *ssock < 0) {
+                *ssock = fds[0];
+                nfds = 0;
+            }
+            break;
+        case UPG_ROOM:
+            rec.room[ROOM_NAME - 1] = '\0';
+            room_id = room_create(&rooms, rec.room);
+            if (room_id >= 0 && rec.peers) {
+                uint32_t *subs = room_subs(room_id, true);
+                if (subs) *subs = rec.peers;
+            }
+            break;
+        case UPG_HISTORY: {
+            room_history_t *h = room_history(room_id, true);
+            message_t *m = msg_from(data, n);
+            if (h && m) history_push(h, m);
+            if (m) msg_unref(m);
+            if (h) history_report(room_id);
+            break;
+        }
+        case UPG_CHILD:
+            rec.room[ROOM_NAME - 1] = '\0';
+            child = adopt_child(&rec, fds, nfds);
+            nfds = 0;
+            break;
+        case UPG_BACKLOG:
+            if (child && child->isActive) {
+                message_t *m = msg_from(data, n);
+                backlog_push(child, m);
+                if (m) msg_unref(m);
+            }
+            break;
+        case UPG_END:
+            chat_log(LOG_INFO, "Parent: adopted %u clients and %d rooms.", active_children.used, rooms.room_num);
+            return *ssock >= 0 ? 0 : -1;
+        }
+        // 쓰지 않은 fd 는 닫는다
+        for (int i = 0; i < nfds; i++) close(fds[i]);
+    }
+    return -1;
+}
+
+// 새 프로세스 : 자식들의 링 주인이 되고 옛 프로세스에게 끝나도 된다고 알린다
+// 옛 프로세스가 먼저 끝나도 자식들은 주인을 보고 이 프로세스를 따라오므로 알리지 못해도 계속 돈다
+static void upgrade_finish(int sock)
+{
+    slab_for_each(&active_children, pipeInfo, child) {
+        shm_ring_set_owner(child->to_child.ring, getpid());
+        shm_ring_set_owner(child->to_parent.ring, getpid());
+    }
+    upgrade_rec_t rec = { .kind = UPG_READY };
+    if (upgrade_send(sock, &rec, NULL, 0, NULL, 0) == -1) {
+        chat_log(LOG_WARNING, "Parent: previous process did not wait for the handover.");
+    }
+    close(sock);
+}
+
+// --- 서버 소켓 ---
+// 실패하면 -1
+static int listen_socket(void)
+{
+    int ssock;   // 서버 소켓 (클라이언트 연결을 받을 때 사용)
+    struct sockaddr_in servaddr;
 
     // 서버 소켓 생성
     if((ssock = socket(AF_INET, SOCK_STREAM, 0)) < 0){
-        syslog(LOG_ERR, "socket not create: %m");
-        exit(1);
+        chat_log(LOG_ERR, "socket not create: %m");
+        return -1;
     }
     // 서버 소켓 설정
     memset(&servaddr, 0, sizeof(servaddr));
     servaddr.sin_family = AF_INET;
     servaddr.sin_addr.s_addr = htonl(INADDR_ANY);
-    servaddr.sin_port = htons(TCP_PORT);
+    // 한 호스트에 노드를 여럿 띄울 때는 CHAT_PORT 로 포트를 나눕니다.
+    const char *port_env = getenv(PORT_ENV);
+    int port = port_env ? atoi(port_env) : 0;
+    servaddr.sin_port = htons(port > 0 && port <= 65535 ? port : TCP_PORT);
 
     // SO_REUSEADDR 옵션 설정: 서버 재시작 시 이전에 사용 중이던 포트를 즉시 재사용할 수 있게 합니다.
     int optval = 1;
     if (setsockopt(ssock, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)) < 0) {
-        syslog(LOG_ERR, "setsockopt(SO_REUSEADDR) failed: %m");
+        chat_log(LOG_ERR, "setsockopt(SO_REUSEADDR) failed: %m");
         close(ssock);
-        exit(1);
+        return -1;
     }
 
     // 서버 소켓 연결 (바인드): 소켓에 IP 주소와 포트 번호를 할당합니다.
     if(bind(ssock, (struct sockaddr *)&servaddr, sizeof(servaddr)) < 0){
-        syslog(LOG_ERR, "No Bind: %m");
-        exit(1);
+        chat_log(LOG_ERR, "No Bind: %m");
+        close(ssock);
+        return -1;
     }
-    // 서버 소켓 가동 (리스닝): 클라이언트의 연결 요청을 대기하며, 최대 8개의 대기 연결 큐를 설정합니다.
-    if(listen(ssock, 8) < 0){
-        syslog(LOG_ERR, "Cannot listen: %m");
-        exit(1);
+    // 서버 소켓 가동 (리스닝): 대기 연결 큐는 리액터처럼 SOMAXCONN 으로 둡니다.
+    // 8 개면 접속이 몰릴 때 큐가 넘쳐 SYN 이 버려지고, 클라이언트는 1초 뒤에야 다시 시도합니다.
+    if(listen(ssock, SOMAXCONN) < 0){
+        chat_log(LOG_ERR, "Cannot listen: %m");
+        close(ssock);
+        return -1;
     }
 
     // 서버 소켓(ssock)을 논블로킹 모드로 설정합니다.
     // 이렇게 하면 accept() 호출 시 대기 중인 연결이 없어도 블로킹되지 않고 즉시 반환됩니다.
     if (set_nonblocking(ssock) == -1) {
-        syslog(LOG_ERR, "Failed to set ssock non-blocking: %m");
+        chat_log(LOG_ERR, "Failed to set ssock non-blocking: %m");
+        close(ssock);
+        return -1;
+    }
+    return ssock;
+}
+
+int main(int argc, char **argv)
+{
+    int ssock;   // 서버 소켓 (클라이언트 연결을 받을 때 사용)
+    int csock;   // 클라이언트 소켓 (각 클라이언트와 1대1 통신)
+    socklen_t cli_len; // 주소 구조체 길이를 저장할 변수 
+    struct sockaddr_in cliaddr; // 클라이언트의 주소정보를 담을 빈 그릇
+    note_t *ready[NOTIFY_BATCH];  // epoll_wait() 로 받은 알림들 (보낸 곳의 note)
+    note_t listen_note, metrics_note;
+    int mfd;     // 지표 유닉스 소켓 (-1 : 꺼짐)
+    bool more_input = false; // 작업자 링을 한 번에 다 비우지 못했음 (기다리지 않고 다시 꺼낸다)
+    bool input_held = false; // 작업자 링 초인종 알림을 꺼 두었음
+    bool running = true;     // SIGTERM/SIGINT 를 받으면 false
+    bool upgrade = false;    // SIGUSR2 를 받았음 (회차 끝에 새 바이너리로 넘긴다)
+    bool handed_off = false; // 새 바이너리에게 넘겼음 (자식들을 끝내지 않고 나간다)
+    int upg;                 // 업그레이드로 떴으면 옛 프로세스와 잇는 넘기기 소켓 (-1 : 보통 시작)
+    static const int parent_signals[] = { SIGCHLD, SIGTERM, SIGINT, SIGUSR2 };
+
+    // 채팅방 목록과 자식 목록 준비 (둘 다 모자라면 늘어납니다)
+    if (room_registry_init(&rooms, CHAT_ROOM) == -1) {
+        exit(1);
+    }
+    slab_init(&active_children, sizeof(pipeInfo));
+    hidx_init(&child_by_pid);
+    hidx_init(&child_by_name);
+
+    // 출력 대기열 한도 (CHAT_OUTQ_* 환경 변수)
+    flow_limits_load();
+    // 방 기록 한도 (CHAT_HISTORY_* 환경 변수)
+    history_limits_load();
+
+    // SIGUSR2 로 업그레이드할 때 같은 경로의 새 바이너리를 같은 인자로 띄웁니다. (데몬화가 작업 디렉터리를 바꾸기 전에)
+    upgrade_remember(argv);
+    upg = upgrade_inherited();
+
+    // 데몬화 함수 호출 (argc, argv 인자 전달). 업그레이드로 뜬 프로세스는 옛 프로세스가 이미 데몬입니다.
+    if (upg < 0) daemonize(argc, argv); 
+
+    // 로그 플러셔 스레드는 데몬화 fork() 뒤에 띄웁니다. (클라이언트 자식은 fork() 때 자기 플러셔를 새로 띄움)
+    chatlog_init("server");
+
+    // SIGCHLD/SIGTERM/SIGINT/SIGUSR2 는 핸들러 대신 막아 두고 signalfd 로 받습니다.
+    // 자식 초인종, 서버 소켓과 같은 epoll 에서 기다리므로 플래그를 확인할 틈이 생기지 않습니다.
+    if (notify_init(&parent_notify, NOTE_SIGNAL, parent_signals, 4) == -1) {
+        chat_log(LOG_ERR, "Parent: cannot set up epoll/signalfd: %m");
         exit(1);
     }
 
+    // 부모는 자식 하나에 링 fd 네 개 (memfd + eventfd 두 쌍, 업그레이드 때 넘긴다) 를 들고 있으므로
+    // fd 한도를 허용된 최대로 올립니다.
+    struct rlimit nofile;
+    if (getrlimit(RLIMIT_NOFILE, &nofile) == 0 && nofile.rlim_cur < nofile.rlim_max) {
+        nofile.rlim_cur = nofile.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &nofile);
+    }
+
+    // 옛 프로세스가 보내는 서버 소켓, 방, 자식들을 받습니다. 받지 못하면 옛 프로세스가 이 프로세스를 죽이고 그대로 돕니다.
+    if (upg >= 0 && upgrade_adopt(upg, &ssock) == -1) {
+        chat_log(LOG_ERR, "Parent: upgrade handover failed.");
+        exit(1);
+    }
+
+    // 방 기록 파일을 읽어 들이고 쓰기 스레드를 띄웁니다. 못 열면 기록 없이 계속 돕니다.
+    if (roomlog_init() == -1) {
+        chat_log(LOG_WARNING, "Parent: room log disabled.");
+    } else {
+        roomlog_watch();
+    }
+    // 검색 색인은 방 기록 파일의 레코드 번호를 쓰므로 방 기록이 있을 때만 켭니다.
+    if (search_init() == -1) {
+        chat_log(LOG_WARNING, "Parent: search disabled.");
+    }
+    // CHAT_CLUSTER/CHAT_NODE 가 있으면 다른 노드들과 링크를 잇습니다. 설정이 틀렸으면 혼자 돌지 않고 멈춥니다.
+    // (노드마다 방의 주인이 다르므로 혼자 돌면 같은 방이 둘로 갈라집니다)
+    for (int i = 0; i < CLUSTER_MAX; i++) held_nodes[i] = -1;
+    if (cluster_init(&parent_notify, link_handlers) == -1) {
+        chat_log(LOG_ERR, "Parent: cannot join cluster.");
+        exit(1);
+    }
+
+    // 서버 소켓 : 업그레이드로 떴으면 옛 프로세스가 넘겨준 것을 그대로 씁니다. (대기 중인 연결도 그대로)
+    if (upg < 0 && (ssock = listen_socket()) < 0) {
+        exit(1);
+    }
+
+    // CHAT_IO=uring 이면 다중 accept 링으로 받고, 커널이 지원하지 않으면 예전처럼 epoll 로 받습니다.
+    // (클라이언트 자식도 이 선택을 물려받아 소켓을 io_uring 으로 돌립니다)
+    if (uring_select() && accept_ring_start(ssock, &listen_note) == -1) {
+        chat_log(LOG_WARNING, "Parent: cannot start accept ring (%m), using epoll.");
+    }
+    if (accept_efd < 0 && notify_add(&parent_notify, &listen_note, NOTE_LISTEN, ssock) == -1) {
+        chat_log(LOG_ERR, "Parent: cannot watch server socket: %m");
+        exit(1);
+    }
+
+    // 지표 소켓도 같은 epoll 에서 기다렸다가 접속이 오면 바로 응답합니다. (부모만 값을 셉니다)
+    mfd = metrics_listen(METRICS_SOCK);
+    if (mfd >= 0 && notify_add(&parent_notify, &metrics_note, NOTE_METRICS, mfd) == -1) {
+        chat_log(LOG_WARNING, "Parent: cannot watch metrics socket: %m");
+    }
+
+    // CHAT_WORKERS 가 있으면 작업자를 미리 띄워 두고, 받은 소켓을 SCM_RIGHTS 로 넘깁니다.
+    // 접속 때 fork() 와 링 두 개를 만드는 비용이 없어집니다. (없으면 예전처럼 접속마다 자식 하나)
+    if (pool_start(ssock, mfd) == -1) {
+        chat_log(LOG_ERR, "Cannot start worker pool.");
+        exit(1);
+    }
+
+    // 넘겨받은 자식들의 링 주인이 되고 옛 프로세스를 끝냅니다. 그 뒤로 받는 연결은 이 프로세스가 받습니다.
+    if (upg >= 0) upgrade_finish(upg);
+
     cli_len = sizeof(cliaddr); 
     
     // --- 부모 프로세스의 메인 루프 (새 클라이언트 연결 수락 및 자식 관리) ---
-    while(true) { 
-        // 자식 종료 플래그가 설정되었다면, 종료된 자식을 정리합니다.
-        if(child_exited_flag){
-            clean_active_process(); // SIGCHLD 핸들러가 설정한 플래그를 확인하여 실제 정리 수행
-            child_exited_flag = 0; // 플래그 초기화
+    // 서버 소켓, 각 자식의 eventfd 초인종, signalfd 를 epoll 하나로 기다립니다.
+    // 알림마다 보낸 곳의 note 가 오므로 유휴 자식은 훑지도 read() 하지도 않습니다.
+    while(running) { 
+        // 링이 가득 차서 쌓아 둔 대기열을 옮기고, 방이 풀린 발행자를 다시 읽습니다.
+        // 자식이 링을 비웠다는 알림은 없으므로, 남은 일이 있으면 짧게 자고 다시 봅니다.
+        bool busy = flush_backlogs();
+        // 작업자 링이 가득 차 있는 동안에는 작업자들의 입력을 읽지 않습니다.
+        // 그러면 작업자 쪽 링이 차고, 작업자가 소켓을 읽지 않아 TCP 가 클라이언트를 늦춥니다.
+        bool hold_input = busy && pool.n > 0;
+        busy |= resume_publishers();
+        int timeout = (more_input && !hold_input) ? 0 : busy ? 10 : -1;
+        bool leftover = more_input;
+        more_input = false;
+        // 붙잡아 두는 동안 울리는 작업자 초인종에 계속 깨지 않도록 알림을 끕니다.
+        if (hold_input != input_held) {
+            pool_hold(hold_input);
+            input_held = hold_input;
         }
 
-        // 클라이언트 연결 감지 및 수락: accept()는 논블로킹 소켓이므로, 연결이 없으면 EAGAIN/EWOULDBLOCK을 반환합니다.
-        // 시그널에 의해 중단되면 EINTR을 반환합니다.
-        csock = accept(ssock, (struct sockaddr *)&cliaddr, &cli_len);
-        if (csock < 0) {
-            // accept()가 오류를 반환했을 때의 처리
-            if (errno == EINTR) { 
-                syslog(LOG_INFO, "Parent: accept() interrupted by signal (EINTR).");
-                // 시그널에 의해 깨어났으니, 자식으로부터 온 메시지를 확인하는 로직으로 넘어갑니다.
-            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // 논블로킹 모드에서 현재 대기 중인 연결이 없는 경우
-                usleep(10000); 
-                //syslog(LOG_INFO, "Parent: No pending connections, accept() returned EAGAIN/EWOULDBLOCK.");
-            } else {
-                syslog(LOG_ERR, "accept() error: %m");
-                break; 
-            }
+        int nready = notify_wait(&parent_notify, ready, NOTIFY_BATCH, timeout);
+        if (nready < 0) {
+            chat_log(LOG_ERR, "epoll_wait() error: %m");
+            break;
+        }
+        uint64_t t0 = metrics_now_us();
+        bool listen_ready = false;
+        bool accept_ready = false;
+        bool reap = false;
+        bool reap_adopted = false;
 
-            // 시그널에 의해 중단되었거나, 연결이 없어 EAGAIN/EWOULDBLOCK이 발생한 경우
-            // 여기서 자식들로부터 온 메시지를 확인하는 로직을 수행합니다.
-            if (parent_sigusr_arrived) { 
-                parent_sigusr_arrived = 0; 
-                syslog(LOG_INFO, "Parent: Checking for messages from children.");
-                for (int i = 0; i < num_active_children; i++) {
-                    if (!active_children[i].isActive) {
-                        continue; 
+        // 자식 레코드는 SIGCHLD 정리 때만 풀리고 정리는 이 루프 뒤에 하므로, 받은 note 포인터는 유효합니다.
+        // (작업자 풀 모드에서 닫힌 연결은 레코드가 바로 풀리지만, 그 연결들은 note 를 걸지 않습니다)
+        for (int i = 0; i < nready; i++) {
+            note_t *note = ready[i];
+            switch (note->kind) {
+            case NOTE_LISTEN:
+                listen_ready = true;
+                break;
+            case NOTE_ACCEPT_RING:
+                accept_ready = true;
+                break;
+            case NOTE_METRICS:
+                metrics_serve(mfd);
+                break;
+            case NOTE_SIGNAL: {
+                int signo;
+                while ((signo = notify_signal(&parent_notify)) != 0) {
+                    if (signo == SIGCHLD) {
+                        reap = true;
+                        continue;
                     }
-                    n_read_write = read(active_children[i].child_to_parent_read_fd, mesg_buffer, sizeof(mesg_buffer) - 1);
-                    
-                    if (n_read_write > 0) {
-                        mesg_buffer[n_read_write] = '\0';
-                        syslog(LOG_INFO, "Parent received message from child %d: %s", active_children[i].pid, mesg_buffer);
-                        /*
-                            strchr 함수는 content라는 문자열(데이터 덩어리) 안에서 
-                            '\n'이라는 문자를 찾아. 그리고 그 '\n' 문자가 메모리 상의 
-                            어디에 있는지, 그 '주소'를 찾아내서 알려줌
-                        */
-                        char *pid_str  = strtok(mesg_buffer, ":");
-                        char *content  = strtok(NULL, "");
-                        char *rm_enter = strchr(content, '\n');
-                        if(rm_enter) *rm_enter = '\0';
-
-                        if (pid_str && content) {
-                            pid_t from_who = atoi(pid_str); 
-                            
-                            if (content[0] == '/') {
-                                int isAdd     = check_command(content, "add"    );
-                                int isJoin    = check_command(content, "join"   );
-                                int isRm      = check_command(content, "rm"     ); 
-                                int isList    = check_command(content, "list"   ); 
-                                int isUsers   = check_command(content, "users"  );
-                                int isLeave   = check_command(content, "leave"  );
-
-                                if (isAdd) {
-                                    if (room_num < CHAT_ROOM) {
-                                        strncpy(room_info[room_num].name, content + 2 + strlen("add"), NAME - 1);
-                                        room_info[room_num].name[NAME - 1] = '\0'; 
-                                        syslog(LOG_INFO, "Parent: Room '%s' created.", room_info[room_num].name);
-                                        room_num++;
-                                    } else {
-                                        syslog(LOG_WARNING, "Parent: Max chat rooms reached. Cannot create room '%s'.", content + 2 + strlen("add"));
-                                    }
-                                } else if (isJoin) {
-                                    char *join_room_name = content + 2 + strlen("join");
-                                    int client_idx = -1;
-                                    //누가 이 명령어 썼냐, 쓴 클라이언트에게 부여하기 위한 검색 작업
-                                    for(int k=0; k<num_active_children; k++){
-                                        if(active_children[k].pid == from_who){
-                                            client_idx = k;
-                                            break;
-                                        }
-                                    }
-                                    //그 클라이언트의 구조체에 채팅방 정보 저장
-                                    if(client_idx != -1){
-                                        strncpy(active_children[client_idx].room_name, join_room_name, NAME - 1);
-                                        active_children[client_idx].room_name[NAME - 1] = '\0';
-                                        syslog(LOG_INFO, "Parent: Client %d ('%s') joined room '%s'.", from_who, active_children[client_idx].name, active_children[client_idx].room_name);
-                                    } else {
-                                        syslog(LOG_ERR, "Parent: Could not find client with PID %d to join room.", from_who);
-                                    }
-                                } else if(isRm){
-                                    /*
-                                        content + 2 + 2가 되어 content + 4와 같음 (포인터 연산)
-                                        즉, 원본 문자열의 처음 4글자를 건너뛰어라
-
-                                        연산자로 문자열을 비교하면 문자열의 내용이 
-                                        아니라 문자열의 주소(포인터)를 비교
-                                    */
-                                    char *rm_room_name = content + 2 + strlen("rm");
-                                    //pipinfo에서 채팅방 정보 삭제
-                                    for(int k=0; k<num_active_children; k++){
-                                        if(strcmp(active_children[k].room_name, rm_room_name)==0){
-                                            /*
-                                            C언어에서 배열 이름은 곧 그 배열의 첫 번째 요소의 주소(포인터)로 
-                                            취급. 배열 자체를 통째로 = 연산자로 복사할 수 없음
-                                            */
-                                            strcpy(active_children[k].room_name, "");
-                                            syslog(LOG_INFO, "Parent: Remove Room Info" );
-                                            
-                                        }
-                                    }
-                                    //roomInfo에서 채팅방 목록에서 삭제
-                                    for(int k=0; k<room_num; k++){
-                                        if(strcmp(room_info[k].name, rm_room_name)==0){
-                                            if(k < room_num-1){
-                                                for(int j = k; j<room_num-1; j++){
-                                                    room_info[j] = room_info[j+1];
-                                                    syslog(LOG_INFO, "Shifted: room at index %d is now '%s'", j, room_info[j].name);
-                                                }
-                                            }
-                                            room_num--;
-                                            break;
-                                        }
-                                    }
-                                }else if(isList){//방 리스트 목록
-                                    int client_idx = -1;
-                                    //누가 이 명령어 썼냐, 쓴 클라이언트에게 부여하기 위한 검색 작업
-                                    for(int k=0; k<num_active_children; k++){
-                                        if(active_children[k].pid == from_who){
-                                            client_idx = k;
-                                            break;
-                                        }
-                                    }
-                                    //리스트 목록 작성하기
-                                    for(int k=0; k<room_num; k++){
-                                        syslog(LOG_INFO, "Parent: Show Room List %d : ('%s')",k,room_info[k].name);
-                                        //strnlen : 보통 버퍼 크기가 정해져 있을 때, 그 크기를 넘지 않고 문자열 길이를 안전하게 구함
-                                        size_t name_len = strnlen(room_info[k].name, sizeof(room_info[k].name));
-                                        ssize_t wlen = write(active_children[client_idx].parent_to_child_write_fd, room_info[k].name, name_len);
-                                        if ( wlen <= 0) { 
-                                            if (errno != EAGAIN && errno != EWOULDBLOCK) {
-                                                    //syslog(LOG_ERR, "Parent failed to broadcast to child %d: %m", active_children[j].pid);
-                                            }
-                                        }else if(wlen > 0){
-                                            if (kill(active_children[client_idx].pid, SIGUSR1) == -1) {
-                                                syslog(LOG_ERR, "Parent: (list) Failed to send SIGUSR1 to child %d: %m", active_children[client_idx].pid);
-                                            } 
-                                        }
-                                    }
-                                }else if(isLeave){
-                                    //leave한 pid 클라이언트의 채팅방 정보 삭제
-                                    for(int k=0; k<num_active_children; k++){
-                                        if(active_children[k].pid == from_who){
-                                            strcpy(active_children[k].room_name, "");
-                                            syslog(LOG_INFO, "Parent : Leave the chat room");
-                                            break;
-                                        }
-                                    }
-                                }
-                                /////////////////////////////////////////////////////////////////////////////
-                                ///////////////     유저 고유 명령어  /////////////////////////////////////////
-                                /////////////////////////////////////////////////////////////////////////////
-                                else if(isUsers){ //채팅방에 참여하는 사용자 목록수 
-                                    int client_idx = -1;
-                                    //누가 이 명령어 썼냐, 쓴 클라이언트에게 부여하기 위한 검색 작업
-                                    for(int k=0; k<num_active_children; k++){
-                                        if(active_children[k].pid == from_who){
-                                            client_idx = k;
-                                            break;
-                                        }
-                                    }
-
-                                    if(client_idx != -1){ //이 명령어를 쓴 유저에게 현재 채팅방의 유저를 알려준다. 
-                                        for(int k=0; k<num_active_children; k++){
-                                            if(strcmp(active_children[k].room_name,active_children[client_idx].room_name) == 0){
-                                                size_t name_len = strnlen(active_children[k].name, sizeof(active_children[k].name));
-                                                char temp[BUFSIZ];
-                                                sprintf(temp, "%s\n", active_children[k].name);
-                                                ssize_t wlen = write(active_children[client_idx].parent_to_child_write_fd, temp, strlen(temp));
-                                                if ( wlen <= 0) { 
-                                                    if (errno != EAGAIN && errno != EWOULDBLOCK) {
-                                                            //syslog(LOG_ERR, "Parent failed to broadcast to child %d: %m", active_children[j].pid);
-                                                    }
-                                                }else if(wlen > 0){
-                                                    if (kill(active_children[client_idx].pid, SIGUSR1) == -1) {
-                                                        syslog(LOG_ERR, "Parent: (users) Failed to send SIGUSR1 to child %d: %m", active_children[client_idx].pid);
-                                                    } 
-                                                }
-                                            }
-                                        }
-                                    }else{
-                                        syslog(LOG_ERR, "this user no exist");
-                                    }
-                                }
-                            } 
-                            else if (active_children[i].name[0] == '\0') { 
-                                strncpy(active_children[i].name, content, NAME - 1);
-                                active_children[i].name[NAME - 1] = '\0';
-                                syslog(LOG_INFO, "Parent: Client %d set name to '%s'.", from_who, active_children[i].name);
-                            }
-                            else if (content[0] == '!'){ //귓속말일때
-                                if(check_command(content, "whisper"))
-                                {
-                                    char *c = content + 2 + strlen("whisper");
-                                    char user_name[BUFSIZ];
-                                    char mesg[BUFSIZ];
-                                    char origin[BUFSIZ]; // 원본 문자열을 보존하기 위한 복사본
-                                    strcpy(origin, c); // '!whisper+ "공백" ' 건너뛰기
-                                    //strtok는 원본을 훼손함
-                                    char *token = strtok(origin, " "); // origin에서 첫번째 공백까지 잘라라
-                                    if (token != NULL) {
-                                        strcpy(user_name, token);
-                                        // 나머지 부분을 메시지로 저장
-                                        token = strtok(NULL, ""); // 첫번째 공백까지 잘라진 나머지 부분을 가져와라
-                                        if (token != NULL) {
-                                            strcpy(mesg, token);
-                                        }else {
-                                            mesg[0] = '\0';
-                                        }
-                                    }
-                                    
-                                    int client_idx = -1;
-                                    //누가 이 명령어 썼냐, 쓴 클라이언트에게 부여하기 위한 검색 작업
-                                    for(int k=0; k<num_active_children; k++){
-                                        if(active_children[k].pid == from_who){
-                                            client_idx = k;
-                                            break;
-                                        }
-                                    }
-                                    syslog(LOG_INFO, "Parent: Client whisper to '%s'.", user_name);
-                                    if(client_idx != -1){ //이 명령어를 쓴 유저가 귓속말 하려는 유저에게 write 
-                                        for(int k=0; k<num_active_children; k++){
-                                            if(strcmp(active_children[k].name, user_name) == 0){
-                                                
-                                                char final_message[BUFSIZ];
-                                                size_t name_len = strnlen(active_children[client_idx].name, NAME);
-                                                size_t mesg_len = strnlen(mesg, 1024);
-
-                                                // // 적당한 최대 길이 설정 (예: final_message 크기 - 여유 공간)
-                                                size_t max_len = sizeof(final_message) - name_len - 10; // 10은 포맷 문자 여유
-
-                                                if (mesg_len > max_len) {
-                                                    mesg_len = max_len;
-                                                    mesg[mesg_len] = '\0'; // 문자열 자르기
-                                                }
-                                                snprintf(final_message, sizeof(final_message), "from %.*s : %.*s",
-                                                        (int)name_len, active_children[client_idx].name,
-                                                        (int)mesg_len, mesg);
-                                                size_t final_len = strlen(final_message);
-                                                ssize_t wlen = write(active_children[k].parent_to_child_write_fd, final_message, final_len);
-                                                if ( wlen <= 0) { 
-                                                    if (errno != EAGAIN && errno != EWOULDBLOCK) {
-                                                            //syslog(LOG_ERR, "Parent failed to broadcast to child %d: %m", active_children[j].pid);
-                                                    }
-                                                }else if(wlen > 0){
-                                                    if (kill(active_children[k].pid, SIGUSR1) == -1) {
-                                                        syslog(LOG_ERR, "Parent: (whisper) Failed to send SIGUSR1 to child %d: %m", active_children[client_idx].pid);
-                                                    } 
-                                                }
-                                                break;
-                                            }
-                                        }
-                                    }else{
-                                        syslog(LOG_ERR, "this user no exist");
-                                    }
-                                }
-                            }
-                            else { 
-                                char broadcast_mesg[BUFSIZ + NAME + 10]; 
-                                snprintf(broadcast_mesg, sizeof(broadcast_mesg), "%s: %s", active_children[i].name, content);
-                                ssize_t broadcast_len = strlen(broadcast_mesg);
-
-                                char *sender_room_name = active_children[i].room_name;
-                                if (sender_room_name[0] == '\0') { 
-                                    syslog(LOG_INFO, "Parent: Message from client %d ('%s') but not in a room. Message: %s", from_who, active_children[i].name, content);
-                                    continue; 
-                                }
-                                //부모가 해당 채팅방에 브로드캐스트 하는 곳 
-                                for (int j = 0; j < num_active_children; j++) {
-                                    if (active_children[j].isActive && 
-                                        (strcmp(active_children[j].room_name, sender_room_name) == 0)) 
-                                    {
-                                        syslog(LOG_INFO, "Parent broadcasting to client %d ('%s') in room '%s'. Message: %s", active_children[j].pid, active_children[j].name, active_children[j].room_name, broadcast_mesg);
-                                        ssize_t wlen = write(active_children[j].parent_to_child_write_fd, broadcast_mesg, broadcast_len + 1);
-                                        if ( wlen <= 0) { 
-                                            if (errno != EAGAIN && errno != EWOULDBLOCK) {
-                                                    //syslog(LOG_ERR, "Parent failed to broadcast to child %d: %m", active_children[j].pid);
-                                            }
-                                        }else if(wlen > 0){
-                                            if (kill(active_children[j].pid, SIGUSR1) == -1) {
-                                                syslog(LOG_ERR, "Parent: (broad cast) Failed to send SIGUSR1 to child %d: %m", active_children[j].pid);
-                                            } 
-                                        }
-                                    }
-                                }
-                            }
-                        } else {
-                            syslog(LOG_WARNING, "Parent: Received malformed message from child %d: %s", active_children[i].pid, mesg_buffer);
-                        }
-                    } else if (n_read_write == 0) {
-                        syslog(LOG_INFO, "Parent: Child %d pipe closed (detected during read scan).", active_children[i].pid);
-                    } else { 
-                        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) { 
-                            //syslog(LOG_ERR, "Parent read from child %d pipe error: %m", active_children[i].pid);
-                        }
+                    if (signo == SIGUSR2) {
+                        upgrade = true;
+                        continue;
                     }
+                    chat_log(LOG_INFO, "Parent: received signal %d, shutting down.", signo);
+                    running = false;
                 }
+                break;
+            }
+            case NOTE_CHILD:
+                // 초인종이 울린 그 자식의 링만 비웁니다.
+                drain_child(note_entry(note, pipeInfo, note));
+                break;
+            case NOTE_CHILD_EXIT:
+                // 넘겨받은 자식이 끝났습니다. 레코드는 SIGCHLD 때처럼 이 루프 뒤에 풉니다.
+                notify_del(&parent_notify, note);
+                reap_adopted = true;
+                break;
+            case NOTE_WORKER_RING:
+                // 작업자 링에는 그 작업자의 모든 연결 메시지가 섞여 옵니다.
+                if (!hold_input) more_input |= drain_worker(note_entry(note, worker_t, ring_note), WORKER_DRAIN_BATCH);
+                break;
+            case NOTE_LINK_LISTEN:
+            case NOTE_LINK_OUT:
+            case NOTE_LINK_IN:
+            case NOTE_LINK_TIMER:
+                cluster_event(note);
+                break;
+            case NOTE_ROOMLOG:
+                // 쓰기 스레드가 끝낸 /history, /search 결과를 보냅니다.
+                roomlog_complete();
+                break;
+            case NOTE_WORKER_CTL:
+                // 닫힘 알림은 그 작업자 링에 남은 것을 다 처리한 뒤 레코드를 풉니다 (worker_conn_closed)
+                pool_read_ctl(note_entry(note, worker_t, ctl_note), worker_conn_closed);
+                break;
             }
-            continue; 
         }
-
-        // --- 새로운 클라이언트 연결 처리 (csock >= 0 인 경우) ---
-
-        if (num_active_children >= MAX_CLIENT) {
-            syslog(LOG_WARNING, "MAX_CLIENT limit reached. Closing new connection from %s.", inet_ntop(AF_INET, &cliaddr.sin_addr, mesg_buffer, BUFSIZ));
-            close(csock); 
-            continue; 
+        // 지난 회차에 다 비우지 못한 작업자 링은 초인종 없이 이어서 꺼냅니다.
+        if (leftover && !hold_input) {
+            for (int i = 0; i < pool.n; i++) {
+                worker_t *w = &pool.w[i];
+                if (w->pid > 0 && !shm_ring_empty(w->to_parent.ring)) more_input |= drain_worker(w, WORKER_DRAIN_BATCH);
+            }
         }
+        // 이번 회차(대기열 옮기기, 방 메시지)에 퇴출한 자식들은 멤버 목록을 다 돈 뒤인 여기서 방에서 뺍니다.
+        leave_evicted();
+        // 여러 번 온 SIGCHLD 는 하나로 합쳐질 수 있으므로 clean_active_process() 가 waitpid() 로 다 거둡니다.
+        if (reap) clean_active_process();
+        if (reap_adopted) clean_adopted_process();
+        // 이번 회차에 다른 노드로 보낼 것을 링크마다 writev() 한 번으로 내보냅니다.
+        cluster_flush();
+        metrics_observe(MET_LOOP_US, metrics_now_us() - t0);
 
-        inet_ntop(AF_INET, &cliaddr.sin_addr, mesg_buffer, BUFSIZ);
-        syslog(LOG_INFO, "Client is connected : %s", mesg_buffer);
-
-        int parent_pfd[2]; 
-        int child_pfd[2];  
-
-        if(pipe(child_pfd) < 0){ 
-            syslog(LOG_ERR, "Failed to create child->parent pipe: %m");
-            close(csock); 
-            continue; 
+        if (!running) {
+            continue;
         }
-        if(pipe(parent_pfd) < 0){ 
-            syslog(LOG_ERR, "Failed to create parent->child pipe: %m");
-            close(child_pfd[0]); close(child_pfd[1]); 
-            close(csock); 
-            continue; 
+        // 업그레이드는 회차가 끝난 자리에서 합니다. (처리하다 만 알림이나 대기열로 옮기다 만 메시지가 없습니다)
+        if (upgrade) {
+            upgrade = false;
+            if (hot_upgrade(ssock, mfd, &listen_note)) {
+                handed_off = true;
+                running = false;
+                continue;
+            }
         }
-
-        if (set_nonblocking(parent_pfd[0]) == -1 || set_nonblocking(parent_pfd[1]) == -1 ||
-            set_nonblocking(child_pfd[0]) == -1 || set_nonblocking(child_pfd[1]) == -1) {
-            syslog(LOG_ERR, "Failed to set pipe FDs non-blocking: %m");
-            close(csock);
-            close(parent_pfd[0]); close(parent_pfd[1]);
-            close(child_pfd[0]);  close(child_pfd[1]);
+        // io_uring 으로 이미 받아 둔 소켓들 (accept() 시스템 콜 없이)
+        if (accept_ready) {
+            int fds[URING_BATCH];
+            int n = accept_ring_take(ssock, fds, URING_BATCH);
+            for (int i = 0; i < n; i++) admit_client(fds[i], NULL, ssock, mfd);
+        }
+        if (!listen_ready) {
             continue;
         }
 
-        pid_t pids_; 
-        if((pids_ = fork()) < 0){ 
-            syslog(LOG_ERR, "fork failed: %m");
-            close(csock);
-            close(parent_pfd[0]); close(parent_pfd[1]);
-            close(child_pfd[0]);  close(child_pfd[1]);
-            continue; 
-        }
-        // --- 자식 프로세스 ---
-        else if(pids_ == 0){ 
-            syslog(LOG_INFO, "Child process started for PID %d.", getpid());
-            
-            // 자식은 서버 리스닝 소켓을 사용하지 않으므로 닫습니다.
-            // ssock은 main 함수의 로컬 변수지만, fork()에 의해 FD가 복제되었으므로 자식 프로세스에서 닫을 수 있습니다.
-            close(ssock); 
-
-            // client_work 함수로 제어권을 넘깁니다.
-            // client_work 함수 내에서 필요한 시그널 핸들러 설정과 파이프 FD 정리가 이루어집니다.
-            client_work(getpid(), getppid(), csock, parent_pfd, child_pfd);
-            // client_work 내부에서 exit(0) 호출로 자식 프로세스가 종료되므로, 이 이후의 코드는 실행되지 않습니다.
-        }
-        // --- 부모 프로세스 ---
-        else { 
-            close(csock); 
-
-            close(parent_pfd[0]); 
-            close(child_pfd[1]);
-
-            if (num_active_children < MAX_CLIENT) {
-                active_children[num_active_children].pid = pids_; 
-                active_children[num_active_children].parent_to_child_write_fd = parent_pfd[1]; 
-                active_children[num_active_children].child_to_parent_read_fd = child_pfd[0];   
-                active_children[num_active_children].isActive = true; 
-                memset(active_children[num_active_children].name, 0, NAME);
-                memset(active_children[num_active_children].room_name, 0, NAME);
-
-                syslog(LOG_INFO, "Parent: Child %d added. Total active children: %d.", pids_, num_active_children + 1);
-                num_active_children++; 
-            } else {
-                syslog(LOG_WARNING, "Parent: MAX_CLIENT limit reached. Not managing child %d.", pids_);
-                close(parent_pfd[1]); 
-                close(child_pfd[0]);
-                kill(pids_, SIGTERM); 
+        // 클라이언트 연결 수락: 서버 소켓은 논블로킹이므로 다른 곳에서 먼저 가져갔다면 EAGAIN 입니다.
+        csock = accept(ssock, (struct sockaddr *)&cliaddr, &cli_len);
+        if (csock < 0) {
+            if (errno == EMFILE || errno == ENFILE) {
+                // 인원 제한은 없고 fd 가 바닥난 경우입니다. 서버는 계속 돌고 자식이 나가면 다시 받습니다.
+                chat_log(LOG_WARNING, "accept(): out of file descriptors (%d clients).", active_children.used);
+                metrics_inc(MET_CONN_REJECTED);
+                continue;
+            }
+            if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) {
+                chat_log(LOG_ERR, "accept() error: %m");
+                break; 
             }
+            continue; 
         }
+
+        // --- 새로운 클라이언트 연결 처리 (csock >= 0 인 경우) ---
+        admit_client(csock, &cliaddr, ssock, mfd);
     } 
     
     // --- 서버 종료 로직 (Graceful Shutdown) ---
-    for (int i = 0; i < num_active_children; i++) {
-        syslog(LOG_INFO, "Parent: Sending SIGTERM to child %d.", active_children[i].pid);
-        kill(active_children[i].pid, SIGTERM);
-        close(active_children[i].parent_to_child_write_fd);
-        close(active_children[i].child_to_parent_read_fd);
+    // 새 바이너리에게 넘긴 자식들은 끝내지 않고 이 프로세스의 링 매핑과 fd 만 닫습니다.
+    slab_for_each(&active_children, pipeInfo, child) {
+        msgq_clear(&child->backlog);
+        if (child->worker) continue;
+        notify_del(&parent_notify, &child->note);
+        if (child->adopted) close(child->pidfd);
+        if (!handed_off) {
+            chat_log(LOG_INFO, "Parent: Sending SIGTERM to child %d.", child->pid);
+            kill(child->pid, SIGTERM);
+        }
+        shm_chan_close(&child->to_child);
+        shm_chan_close(&child->to_parent);
     }
-    while (wait(NULL) > 0);
+    // wait(NULL) 은 데몬화 때 fork() 한 프로세스까지 기다리므로 끝낸 자식만 거둡니다.
+    // (넘겨받은 자식은 이 프로세스의 자식이 아니라 waitpid() 가 바로 돌아옵니다)
+    slab_for_each(&active_children, pipeInfo, child) {
+        if (!child->worker && !handed_off) waitpid(child->pid, NULL, 0);
+    }
+    pool_stop();
+    cluster_shutdown();
+    search_shutdown();
+    notify_del(&parent_notify, &roomlog_note);
+    roomlog_shutdown();
+    slab_destroy(&active_children);
+    hidx_free(&child_by_pid);
+    hidx_free(&child_by_name);
+    for (int i = 0; i < history_cap; i++) history_clear(&histories[i]);
+    free(histories);
+    free(room_peers);
+    room_registry_free(&rooms);
     
+    accept_ring_close();
     close(ssock); 
-    syslog(LOG_INFO, "Server shutting down gracefully.");
+    // 지표 소켓 파일은 새 프로세스가 다시 만들었으므로 지우지 않습니다.
+    if (handed_off) {
+        if (mfd >= 0) close(mfd);
+    } else {
+        metrics_close(mfd);
+    }
+    notify_close(&parent_notify);
+    chat_log(LOG_INFO, "Server shutting down gracefully.");
 
     return 0;
-}
+}
\ No newline at end of file
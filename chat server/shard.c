@@ -0,0 +1,531 @@
+#include "reactor.h"
+
+// --- 작업 종류 ---
+enum {
+    // 주인 샤드가 처리
+    SOP_ADD,          // 방 만들기
+    SOP_JOIN,         // 방 참여 요청 -> 멤버 샤드에 SOP_JOINED
+    SOP_RM,           // 방 지우기 -> 멤버가 있는 샤드에 SOP_DROP
+    SOP_LIST,         // 주인인 방 이름들을 응답
+    SOP_USERS,        // 멤버가 있는 샤드에 SOP_NAMES
+    SOP_LEAVE,        // 샤드별 멤버 수 하나 줄이기
+    SOP_PUBLISH,      // 멤버가 있는 샤드에 SOP_DELIVER
+    SOP_NICK_SET,     // 닉네임 등록
+    SOP_NICK_DEL,     // 닉네임 삭제
+    SOP_WHISPER,      // 닉네임 주인의 샤드에 SOP_REPLY
+    // 연결이 사는 샤드가 처리
+    SOP_JOINED,       // 주인이 허락한 참여를 로컬 방 목록에 반영
+    SOP_DROP,         // 지워진 방의 로컬 멤버들을 뺀다
+    SOP_NAMES,        // 로컬 멤버 이름들을 요청한 연결에 응답
+    SOP_DELIVER,      // 로컬 멤버들에게 메시지 전달
+    SOP_REPLY,        // 연결 하나에 메시지 전달
+};
+
+// --- 작업 함수 ---
+static shard_op_t *op_new(int type, const char *name)
+{
+    shard_op_t *op = calloc(1, sizeof(shard_op_t));
+    if (op == NULL) {
+        chat_log(LOG_ERR, "Shard: out of memory for op %d", type);
+        return NULL;
+    }
+    op->type = type;
+    if (name) {
+        snprintf(op->name, sizeof(op->name), "%s", name);
+    }
+    return op;
+}
+
+static void op_free(shard_op_t *op)
+{
+    if (op->msg) msg_unref(op->msg);
+    free(op);
+}
+
+static conn_ref_t conn_ref(reactor_t *r, conn_t *c)
+{
+    return (conn_ref_t){ .shard = r->shard_id, .fd = c->fd, .gen = c->gen };
+}
+
+// 이름 -> 주인 샤드 (FNV-1a)
+static int owner_of(reactor_t *r, const char *name)
+{
+    return fnv1a(name, strlen(name)) % r->set->n;
+}
+
+static void op_exec(reactor_t *r, shard_op_t *op);
+
+// 작업을 to 샤드에 보낸다. 자기 자신이면 큐를 거치지 않고 바로 처리한다
+static void post(reactor_t *r, int to, shard_op_t *op)
+{
+    if (op == NULL) return;
+    if (atomic_load_explicit(&r->set->stopping, memory_order_relaxed)) {
+        op_free(op);
+        return;
+    }
+    if (to == r->shard_id) {
+        op_exec(r, op);
+        op_free(op);
+        return;
+    }
+    mpsc_push(&r->set->shard[to]->inbox, &op->node);
+}
+
+// 연결 하나에 메시지 (연결이 사는 샤드로 보낸다)
+static void reply(reactor_t *r, conn_ref_t to, message_t *m)
+{
+    shard_op_t *op = op_new(SOP_REPLY, NULL);
+    if (op == NULL) return;
+    op->from = to;
+    op->msg = msg_ref(m);
+    post(r, to.shard, op);
+}
+
+static void reply_text(reactor_t *r, conn_ref_t to, const char *text)
+{
+    message_t *m = msg_frame(text, strlen(text));
+    if (m == NULL) return;
+    reply(r, to, m);
+    msg_unref(m);
+}
+
+// 로컬 방에서 빠지고 주인에게 알린다. 로컬 멤버가 없어진 방은 로컬 목록에서 지운다
+static void local_leave(reactor_t *r, conn_t *c)
+{
+    int id = c->room.room_id;
+    if (id < 0) return;
+
+    shard_op_t *op = op_new(SOP_LEAVE, room_name(&r->rooms, id));
+    room_leave(&r->rooms, &c->room);
+    if (r->rooms.rooms[id].count == 0) room_remove(&r->rooms, id);
+    if (op == NULL) return;
+    op->shard = r->shard_id;
+    post(r, owner_of(r, op->name), op);
+}
+
+// --- 주인 샤드 쪽 처리 ---
+static void owner_add(reactor_t *r, shard_op_t *op)
+{
+    shard_owner_t *o = &r->owner;
+    int id = room_add(&o->rooms, op->name);
+    if (id == -2) {
+        reply_text(r, op->from, "room already exists");
+        return;
+    }
+    if (id >= 0 && id >= o->members_cap) {
+        // 방 목록이 늘어났으면 샤드별 멤버 수 표도 같은 칸 수로 늘린다
+        uint16_t (*p)[SHARD_MAX] = realloc(o->members, sizeof(*o->members) * o->rooms.cap);
+        if (p == NULL) {
+            room_remove(&o->rooms, id);
+            id = -1;
+        } else {
+            memset(p + o->members_cap, 0, sizeof(*p) * (o->rooms.cap - o->members_cap));
+            o->members = p;
+            o->members_cap = o->rooms.cap;
+        }
+    }
+    if (id == -1) {
+        chat_log(LOG_WARNING, "Shard %d: out of memory creating room '%s'.", r->shard_id, op->name);
+        return;
+    }
+    memset(o->members[id], 0, sizeof(o->members[id]));
+    chat_log(LOG_INFO, "Shard %d: Room '%s' created.", r->shard_id, op->name);
+}
+
+static void owner_join(reactor_t *r, shard_op_t *op)
+{
+    int id = room_find(&r->owner.rooms, op->name);
+    if (id == -1) {
+        reply_text(r, op->from, "no such room");
+        return;
+    }
+    // 참여가 반영되기 전에도 전달 대상에 들도록 먼저 센다 (빠질 때 SOP_LEAVE 로 줄인다)
+    r->owner.members[id][op->from.shard]++;
+
+    shard_op_t *joined = op_new(SOP_JOINED, op->name);
+    if (joined == NULL) {
+        r->owner.members[id][op->from.shard]--;
+        return;
+    }
+    joined->from = op->from;
+    post(r, op->from.shard, joined);
+}
+
+static void owner_rm(reactor_t *r, shard_op_t *op)
+{
+    shard_owner_t *o = &r->owner;
+    int id = room_find(&o->rooms, op->name);
+    if (id == -1) return;
+
+    for (int s = 0; s < r->set->n; s++) {
+        if (o->members[id][s] == 0) continue;
+        post(r, s, op_new(SOP_DROP, op->name));
+    }
+    memset(o->members[id], 0, sizeof(o->members[id]));
+    room_remove(&o->rooms, id);
+    chat_log(LOG_INFO, "Shard %d: Room '%s' removed.", r->shard_id, op->name);
+}
+
+static void owner_list(reactor_t *r, shard_op_t *op)
+{
+    for (int id = 0; id < r->owner.rooms.cap; id++) {
+        if (!r->owner.rooms.rooms[id].used) continue;
+        reply_text(r, op->from, r->owner.rooms.rooms[id].name);
+    }
+}
+
+// 멤버가 있는 샤드마다 작업 하나씩 (멤버 수가 아니라 샤드 수 만큼만 큐에 넣는다)
+static void owner_fan_out(reactor_t *r, shard_op_t *op, int type)
+{
+    shard_owner_t *o = &r->owner;
+    int id = room_find(&o->rooms, op->name);
+    if (id == -1) return;
+
+    if (type == SOP_DELIVER) {
+        int fanout = 0;
+        for (int s = 0; s < r->set->n; s++) fanout += o->members[id][s];
+        metrics_inc(MET_MSG_PUBLISHED);
+        metrics_observe(MET_FANOUT, fanout);
+        metrics_room_msg(op->name);
+    }
+    for (int s = 0; s < r->set->n; s++) {
+        if (o->members[id][s] == 0) continue;
+        shard_op_t *out = op_new(type, op->name);
+        if (out == NULL) continue;
+        out->from = op->from;
+        if (op->msg) out->msg = msg_ref(op->msg);
+        post(r, s, out);
+    }
+}
+
+static void owner_leave(reactor_t *r, shard_op_t *op)
+{
+    int id = room_find(&r->owner.rooms, op->name);
+    if (id == -1) return;
+    if (r->owner.members[id][op->shard] > 0) r->owner.members[id][op->shard]--;
+}
+
+// 연결 참조를 색인 값 하나로 접는다 (샤드 4비트 + fd 28비트 + 세대 32비트)
+_Static_assert(SHARD_MAX <= 16, "ref_pack() keeps the shard id in 4 bits");
+static uint64_t ref_pack(conn_ref_t ref)
+{
+    return ((uint64_t)ref.gen << 32) | ((uint64_t)ref.shard << 28) | ((uint32_t)ref.fd & 0x0fffffff);
+}
+
+static conn_ref_t ref_unpack(uint64_t v)
+{
+    return (conn_ref_t){ .shard = (v >> 28) & 0xf, .fd = v & 0x0fffffff, .gen = v >> 32 };
+}
+
+static void owner_nick_set(reactor_t *r, shard_op_t *op)
+{
+    if (hidx_put_name(&r->owner.nicks, op->name, strlen(op->name), ref_pack(op->from)) == -1) {
+        chat_log(LOG_ERR, "Shard %d: out of memory for nickname '%s'", r->shard_id, op->name);
+    }
+}
+
+static void owner_nick_del(reactor_t *r, shard_op_t *op)
+{
+    // 같은 닉네임이 여럿이어도 이 연결의 것만 지운다
+    hidx_del_name(&r->owner.nicks, op->name, strlen(op->name), ref_pack(op->from));
+}
+
+static void owner_whisper(reactor_t *r, shard_op_t *op)
+{
+    uint64_t v;
+    if (hidx_get_name(&r->owner.nicks, op->name, strlen(op->name), &v)) {
+        reply(r, ref_unpack(v), op->msg);
+        return;
+    }
+    reply_text(r, op->from, "no such user");
+}
+
+// --- 멤버 샤드 쪽 처리 ---
+static void member_joined(reactor_t *r, shard_op_t *op)
+{
+    conn_t *c = reactor_conn(r, op->from);
+    int id = -1;
+
+    if (c != NULL) {
+        local_leave(r, c);
+        id = room_find(&r->rooms, op->name);
+        if (id == -1) id = room_add(&r->rooms, op->name);
+    }
+    if (id < 0) {
+        // 그 사이 끊겼거나 로컬 방 목록이 가득 찼다. 주인이 미리 센 것을 되돌린다
+        shard_op_t *leave = op_new(SOP_LEAVE, op->name);
+        if (leave == NULL) return;
+        leave->shard = r->shard_id;
+        post(r, owner_of(r, op->name), leave);
+        return;
+    }
+    room_join(&r->rooms, id, &c->room);
+    chat_log(LOG_INFO, "Shard %d: Client fd %d ('%s') joined room '%s'.", r->shard_id, c->fd, c->name, op->name);
+}
+
+static void member_drop(reactor_t *r, shard_op_t *op)
+{
+    int id = room_find(&r->rooms, op->name);
+    if (id != -1) room_remove(&r->rooms, id);
+}
+
+static void member_names(reactor_t *r, shard_op_t *op)
+{
+    int id = room_find(&r->rooms, op->name);
+    if (id == -1) return;
+    room_for_each(&r->rooms, id, m) {
+        reply_text(r, op->from, room_entry(m, conn_t, room)->name);
+    }
+}
+
+static void member_deliver(reactor_t *r, shard_op_t *op)
+{
+    int id = room_find(&r->rooms, op->name);
+    if (id == -1) return;
+    // 다른 샤드에서 만든 메시지도 복사 없이 참조만 출력 큐에 넣는다
+    bool saturated = false;
+    room_for_each(&r->rooms, id, m) {
+        conn_t *to = room_entry(m, conn_t, room);
+        reactor_send_msg(r, to, op->msg);
+        if (to->flow.congested) saturated = true;
+    }
+    // 발행자가 이 샤드에 있으면 방이 풀릴 때까지 그 발행자를 읽지 않는다
+    // (다른 샤드의 발행자는 멈추지 않고, 느린 멤버는 워터마크/퇴출로만 막는다)
+    if (saturated && op->from.shard == r->shard_id) {
+        conn_t *pub = reactor_conn(r, op->from);
+        if (pub) reactor_pause(r, pub);
+    }
+}
+
+static void member_reply(reactor_t *r, shard_op_t *op)
+{
+    conn_t *c = reactor_conn(r, op->from);
+    if (c != NULL) reactor_send_msg(r, c, op->msg);
+}
+
+static void op_exec(reactor_t *r, shard_op_t *op)
+{
+    switch (op->type) {
+    case SOP_ADD:      owner_add(r, op); break;
+    case SOP_JOIN:     owner_join(r, op); break;
+    case SOP_RM:       owner_rm(r, op); break;
+    case SOP_LIST:     owner_list(r, op); break;
+    case SOP_USERS:    owner_fan_out(r, op, SOP_NAMES); break;
+    case SOP_LEAVE:    owner_leave(r, op); break;
+    case SOP_PUBLISH:  owner_fan_out(r, op, SOP_DELIVER); break;
+    case SOP_NICK_SET: owner_nick_set(r, op); break;
+    case SOP_NICK_DEL: owner_nick_del(r, op); break;
+    case SOP_WHISPER:  owner_whisper(r, op); break;
+    case SOP_JOINED:   member_joined(r, op); break;
+    case SOP_DROP:     member_drop(r, op); break;
+    case SOP_NAMES:    member_names(r, op); break;
+    case SOP_DELIVER:  member_deliver(r, op); break;
+    case SOP_REPLY:    member_reply(r, op); break;
+    }
+}
+
+// --- 샤드 함수 ---
+int shard_attach(reactor_t *r, shard_set_t *set, int id)
+{
+    r->set = set;
+    r->shard_id = id;
+    if (mpsc_init(&r->inbox) == -1) return -1;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = r->inbox.efd;
+    if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, r->inbox.efd, &ev) == -1) {
+        chat_log(LOG_ERR, "epoll_ctl(ADD) shard inbox: %m");
+        mpsc_destroy(&r->inbox);
+        return -1;
+    }
+    if (room_registry_init(&r->owner.rooms, REACTOR_ROOM_INIT) == -1) {
+        mpsc_destroy(&r->inbox);
+        return -1;
+    }
+    r->owner.members = calloc(REACTOR_ROOM_INIT, sizeof(*r->owner.members));
+    r->owner.members_cap = REACTOR_ROOM_INIT;
+    if (r->owner.members == NULL) {
+        room_registry_free(&r->owner.rooms);
+        mpsc_destroy(&r->inbox);
+        return -1;
+    }
+    return 0;
+}
+
+void shard_detach(reactor_t *r)
+{
+    mpsc_node_t *n;
+    // 처리되지 못한 작업은 메시지 참조만 놓고 버린다
+    while ((n = mpsc_pop(&r->inbox)) != NULL) op_free((shard_op_t *)n);
+    mpsc_destroy(&r->inbox);
+    room_registry_free(&r->owner.rooms);
+    free(r->owner.members);
+    hidx_free(&r->owner.nicks);
+    memset(&r->owner, 0, sizeof(r->owner));
+}
+
+void shard_drain(reactor_t *r)
+{
+    mpsc_node_t *n;
+
+    mpsc_ack(&r->inbox);
+    while ((n = mpsc_pop(&r->inbox)) != NULL) {
+        shard_op_t *op = (shard_op_t *)n;
+        op_exec(r, op);
+        op_free(op);
+    }
+}
+
+// --- 샤드 묶음 함수 ---
+int shard_set_init(shard_set_t *set, int n, int port)
+{
+    memset(set, 0, sizeof(*set));
+    atomic_init(&set->stopping, false);
+    if (n < 1) n = 1;
+    if (n > SHARD_MAX) n = SHARD_MAX;
+
+    for (int i = 0; i < n; i++) {
+        reactor_t *r = calloc(1, sizeof(reactor_t));
+        if (r == NULL) goto fail;
+
+        // 샤드가 하나면 예전처럼 리스닝 소켓 하나
+        int lfd = reactor_listen(port, n > 1);
+        if (lfd < 0) {
+            free(r);
+            goto fail;
+        }
+        if (reactor_init(r, lfd) == -1) {
+            close(lfd);
+            free(r);
+            goto fail;
+        }
+        if (shard_attach(r, set, i) == -1) {
+            reactor_destroy(r);
+            free(r);
+            goto fail;
+        }
+        set->shard[i] = r;
+        set->n = i + 1;
+    }
+    return 0;
+
+fail:
+    shard_set_destroy(set);
+    return -1;
+}
+
+static void *shard_thread(void *arg)
+{
+    reactor_run(arg);
+    return NULL;
+}
+
+void shard_set_run(shard_set_t *set)
+{
+    int started = 1;
+    for (int i = 1; i < set->n; i++) {
+        if (pthread_create(&set->thread[i], NULL, shard_thread, set->shard[i]) != 0) {
+            chat_log(LOG_ERR, "Shard %d: pthread_create failed", i);
+            reactor_shutdown = 1;
+            shard_set_wake(set);
+            break;
+        }
+        started++;
+    }
+    if (!reactor_shutdown) reactor_run(set->shard[0]);
+
+    // 0 번이 끝났으면 종료 중이다. 나머지도 깨워서 기다린다
+    shard_set_wake(set);
+    for (int i = 1; i < started; i++) pthread_join(set->thread[i], NULL);
+}
+
+void shard_set_wake(shard_set_t *set)
+{
+    for (int i = 0; i < set->n; i++) {
+        if (set->shard[i]) mpsc_kick(&set->shard[i]->inbox);
+    }
+}
+
+void shard_set_destroy(shard_set_t *set)
+{
+    // 연결을 닫으며 생기는 LEAVE 등은 이미 정리 중인 샤드로 보내지 않는다
+    atomic_store(&set->stopping, true);
+    for (int i = 0; i < set->n; i++) {
+        reactor_t *r = set->shard[i];
+        reactor_destroy(r);
+        shard_detach(r);
+        free(r);
+        set->shard[i] = NULL;
+    }
+    set->n = 0;
+}
+
+// --- 채팅 동작 ---
+static void post_named(reactor_t *r, conn_t *c, int type, const char *name, message_t *m)
+{
+    shard_op_t *op = op_new(type, name);
+    if (op == NULL) return;
+    op->from = conn_ref(r, c);
+    if (m) op->msg = msg_ref(m);
+    post(r, owner_of(r, op->name), op);
+}
+
+void shard_room_add(reactor_t *r, conn_t *c, const char *room)
+{
+    post_named(r, c, SOP_ADD, room, NULL);
+}
+
+void shard_room_join(reactor_t *r, conn_t *c, const char *room)
+{
+    post_named(r, c, SOP_JOIN, room, NULL);
+}
+
+void shard_room_rm(reactor_t *r, conn_t *c, const char *room)
+{
+    post_named(r, c, SOP_RM, room, NULL);
+}
+
+void shard_room_list(reactor_t *r, conn_t *c)
+{
+    // 방마다 주인이 다르므로 모든 샤드에 묻는다
+    for (int s = 0; s < r->set->n; s++) {
+        shard_op_t *op = op_new(SOP_LIST, NULL);
+        if (op == NULL) return;
+        op->from = conn_ref(r, c);
+        post(r, s, op);
+    }
+}
+
+void shard_room_users(reactor_t *r, conn_t *c)
+{
+    if (c->room.room_id < 0) return;
+    post_named(r, c, SOP_USERS, room_name(&r->rooms, c->room.room_id), NULL);
+}
+
+void shard_room_leave(reactor_t *r, conn_t *c)
+{
+    local_leave(r, c);
+}
+
+void shard_publish(reactor_t *r, conn_t *c, message_t *m)
+{
+    if (c->room.room_id < 0) return;
+    post_named(r, c, SOP_PUBLISH, room_name(&r->rooms, c->room.room_id), m);
+}
+
+void shard_nick_set(reactor_t *r, conn_t *c)
+{
+    post_named(r, c, SOP_NICK_SET, c->name, NULL);
+}
+
+void shard_nick_del(reactor_t *r, conn_t *c)
+{
+    if (c->name[0] == '\0') return;
+    post_named(r, c, SOP_NICK_DEL, c->name, NULL);
+}
+
+void shard_whisper(reactor_t *r, conn_t *c, const char *to, message_t *m)
+{
+    post_named(r, c, SOP_WHISPER, to, m);
+}
@@ -0,0 +1,86 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "mpsc.h"
+#include "room.h"
+#include "message.h"
+#include "hashidx.h"
+
+// --- 매크로 정의 ---
+#define SHARD_MAX 16   // 최대 리액터 스레드 수 (코어 수 만큼이면 충분하다)
+
+struct reactor;
+struct conn;
+
+// --- 구조체 정의 ---
+// 다른 샤드의 연결을 가리키는 값 (포인터 대신 fd + 세대 번호)
+// 같은 fd 가 다시 쓰여도 세대가 다르면 이미 끊긴 연결로 본다
+typedef struct {
+    uint16_t shard;
+    int fd;
+    uint32_t gen;
+} conn_ref_t;
+
+// 샤드 사이에 주고받는 작업 하나 (MPSC 큐의 노드)
+typedef struct shard_op {
+    mpsc_node_t node;            // 맨 앞이어야 노드 포인터를 그대로 형변환할 수 있다
+    int type;
+    conn_ref_t from;             // 요청한 연결 (응답을 보낼 곳)
+    int shard;                   // LEAVE : 멤버가 빠진 샤드
+    char name[ROOM_NAME];        // 방 이름 또는 닉네임
+    message_t *msg;              // 전달할 메시지 (참조 하나를 들고 있다)
+} shard_op_t;
+
+// 샤드 하나가 주인으로서 들고 있는 상태
+// 방과 닉네임은 이름의 해시로 주인 샤드가 정해지고, 생성/삭제/조회는 주인만 한다
+// 멤버 목록 자체는 연결이 사는 샤드의 rooms 에 있고, 주인은 샤드별 멤버 수만 안다
+typedef struct {
+    room_registry_t rooms;       // 이 샤드가 주인인 방들
+    uint16_t (*members)[SHARD_MAX]; // 방 id -> 샤드별 멤버 수 (0 인 샤드에는 보내지 않는다)
+    int members_cap;             // members 칸 수 (rooms 가 늘어나면 따라 늘린다)
+    hidx_t nicks;                // 닉네임 -> 연결 (conn_ref_t 를 64비트로 접어서 넣는다)
+} shard_owner_t;
+
+// 리액터 스레드 묶음
+typedef struct shard_set {
+    int n;
+    struct reactor *shard[SHARD_MAX];
+    pthread_t thread[SHARD_MAX];
+    atomic_bool stopping;        // 정리 중에는 샤드 사이 작업을 보내지 않는다
+} shard_set_t;
+
+// --- 샤드 묶음 함수 ---
+// n 개의 리액터를 만든다. n > 1 이면 각자 SO_REUSEPORT 리스닝 소켓을 연다
+int shard_set_init(shard_set_t *set, int n, int port);
+// 0 번 샤드는 부른 스레드에서, 나머지는 새 스레드에서 돈다. reactor_shutdown 까지 반환하지 않는다
+void shard_set_run(shard_set_t *set);
+// 모든 샤드를 깨운다 (시그널 핸들러에서 불러도 된다)
+void shard_set_wake(shard_set_t *set);
+void shard_set_destroy(shard_set_t *set);
+
+// --- 샤드 함수 (리액터가 부른다) ---
+int shard_attach(struct reactor *r, shard_set_t *set, int id);
+void shard_detach(struct reactor *r);
+// 받은 편지함(MPSC 큐)의 작업들을 처리한다
+void shard_drain(struct reactor *r);
+
+// --- 채팅 동작 (chatcore.c 가 부른다) ---
+// 주인이 자기 자신이면 바로 처리하고, 아니면 주인 샤드의 큐에 넣는다
+void shard_room_add(struct reactor *r, struct conn *c, const char *room);
+void shard_room_join(struct reactor *r, struct conn *c, const char *room);
+void shard_room_rm(struct reactor *r, struct conn *c, const char *room);
+void shard_room_list(struct reactor *r, struct conn *c);
+void shard_room_users(struct reactor *r, struct conn *c);
+void shard_room_leave(struct reactor *r, struct conn *c);
+// c 가 있는 방의 모든 멤버에게 m 을 보낸다 (다른 샤드 멤버들은 샤드마다 큐 작업 하나)
+void shard_publish(struct reactor *r, struct conn *c, message_t *m);
+void shard_nick_set(struct reactor *r, struct conn *c);
+void shard_nick_del(struct reactor *r, struct conn *c);
+void shard_whisper(struct reactor *r, struct conn *c, const char *to, message_t *m);
+
+#endif //SHARD_H
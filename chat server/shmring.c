@@ -0,0 +1,225 @@
+#define _GNU_SOURCE // memfd_create()
+#include <string.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+
+#include "shmring.h"
+
+// --- 링 함수 ---
+static shm_ring_t *ring_map(int mfd, size_t len)
+{
+    shm_ring_t *r = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, mfd, 0);
+    if (r == MAP_FAILED) {
+        syslog(LOG_ERR, "shm_ring mmap failed: %m");
+        return NULL;
+    }
+    return r;
+}
+
+shm_ring_t *shm_ring_create(uint32_t size, int *mfd)
+{
+    // size 는 2의 거듭제곱이어야 & 연산으로 위치를 감쌀 수 있다
+    if (size == 0 || (size & (size - 1)) != 0) return NULL;
+
+    int fd = memfd_create("chat-ring", MFD_CLOEXEC);
+    if (fd == -1 || ftruncate(fd, sizeof(shm_ring_t) + size) == -1) {
+        syslog(LOG_ERR, "shm_ring memfd failed: %m");
+        if (fd != -1) close(fd);
+        return NULL;
+    }
+    shm_ring_t *r = ring_map(fd, sizeof(shm_ring_t) + size);
+    if (r == NULL || mfd == NULL) {
+        close(fd);
+        fd = -1;
+    }
+    if (r == NULL) return NULL;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    atomic_init(&r->owner, getpid());
+    r->size = size;
+    if (mfd) *mfd = fd;
+    return r;
+}
+
+shm_ring_t *shm_ring_attach(int mfd)
+{
+    struct stat st;
+
+    if (fstat(mfd, &st) == -1 || (size_t)st.st_size <= sizeof(shm_ring_t)) return NULL;
+    shm_ring_t *r = ring_map(mfd, st.st_size);
+    // 크기는 파일과 링 머리말이 맞아야 한다 (다른 fd 를 잘못 받은 경우)
+    if (r && sizeof(shm_ring_t) + r->size != (size_t)st.st_size) {
+        munmap(r, st.st_size);
+        return NULL;
+    }
+    return r;
+}
+
+void shm_ring_destroy(shm_ring_t *r)
+{
+    if (r) munmap(r, sizeof(shm_ring_t) + r->size);
+}
+
+void shm_ring_set_owner(shm_ring_t *r, pid_t pid)
+{
+    atomic_store_explicit(&r->owner, pid, memory_order_release);
+}
+
+pid_t shm_ring_owner(shm_ring_t *r)
+{
+    return atomic_load_explicit(&r->owner, memory_order_acquire);
+}
+
+// pos 위치부터 len 바이트 복사 (끝에서 처음으로 넘어가는 경우 두 번에 나눠 복사)
+static void ring_write(shm_ring_t *r, uint32_t pos, const void *src, uint32_t len)
+{
+    uint32_t off = pos & (r->size - 1);
+    uint32_t first = r->size - off;
+    if (first > len) first = len;
+    memcpy(r->data + off, src, first);
+    memcpy(r->data, (const char *)src + first, len - first);
+}
+
+static void ring_read(shm_ring_t *r, uint32_t pos, void *dst, uint32_t len)
+{
+    uint32_t off = pos & (r->size - 1);
+    uint32_t first = r->size - off;
+    if (first > len) first = len;
+    memcpy(dst, r->data + off, first);
+    memcpy((char *)dst + first, r->data, len - first);
+}
+
+int shm_ring_push(shm_ring_t *r, const void *data, uint32_t len)
+{
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    // 소비자가 tail 을 옮긴 뒤에야 그 자리를 덮어쓸 수 있다
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    uint32_t need = sizeof(uint32_t) + len;
+
+    if (need > r->size - (head - tail)) return -1;
+
+    ring_write(r, head, &len, sizeof(uint32_t));
+    ring_write(r, head + sizeof(uint32_t), data, len);
+    // 내용을 다 쓴 다음에 head 를 공개한다
+    atomic_store_explicit(&r->head, head + need, memory_order_release);
+    return 0;
+}
+
+int shm_ring_pop(shm_ring_t *r, void *buf, uint32_t cap)
+{
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    uint32_t len;
+
+    if (head == tail) return -1;
+
+    ring_read(r, tail, &len, sizeof(uint32_t));
+    ring_read(r, tail + sizeof(uint32_t), buf, len < cap ? len : cap);
+    atomic_store_explicit(&r->tail, tail + sizeof(uint32_t) + len, memory_order_release);
+    return len < cap ? (int)len : (int)cap;
+}
+
+bool shm_ring_empty(shm_ring_t *r)
+{
+    return atomic_load_explicit(&r->head, memory_order_acquire) ==
+           atomic_load_explicit(&r->tail, memory_order_relaxed);
+}
+
+// --- 복사하지 않고 읽기 ---
+uint32_t shm_ring_tail(shm_ring_t *r)
+{
+    return atomic_load_explicit(&r->tail, memory_order_relaxed);
+}
+
+int shm_ring_peek(shm_ring_t *r, uint32_t *pos, struct iovec iov[2])
+{
+    // head 를 acquire 로 읽었으니 그 앞까지의 내용은 다 쓰여 있다
+    if (*pos == atomic_load_explicit(&r->head, memory_order_acquire)) return -1;
+
+    uint32_t len;
+    ring_read(r, *pos, &len, sizeof(uint32_t));
+    uint32_t off = (*pos + sizeof(uint32_t)) & (r->size - 1);
+    uint32_t first = r->size - off;
+    if (first > len) first = len;
+    *pos += sizeof(uint32_t) + len;
+
+    int n = 0;
+    if (first > 0) iov[n++] = (struct iovec){ .iov_base = r->data + off, .iov_len = first };
+    if (len > first) iov[n++] = (struct iovec){ .iov_base = r->data, .iov_len = len - first };
+    return n;
+}
+
+void shm_ring_release(shm_ring_t *r, uint32_t pos)
+{
+    // 내용을 다 읽은 다음에 자리를 내준다
+    atomic_store_explicit(&r->tail, pos, memory_order_release);
+}
+
+// --- 채널 함수 ---
+int shm_chan_open(shm_chan_t *ch)
+{
+    return shm_chan_open_size(ch, SHM_RING_SIZE);
+}
+
+int shm_chan_open_size(shm_chan_t *ch, uint32_t size)
+{
+    ch->ring = shm_ring_create(size, &ch->mfd);
+    if (ch->ring == NULL) return -1;
+
+    ch->efd = eventfd(0, EFD_NONBLOCK);
+    if (ch->efd == -1) {
+        syslog(LOG_ERR, "eventfd failed: %m");
+        shm_ring_destroy(ch->ring);
+        close(ch->mfd);
+        ch->ring = NULL;
+        ch->mfd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+int shm_chan_attach(shm_chan_t *ch, int mfd, int efd)
+{
+    ch->ring = shm_ring_attach(mfd);
+    if (ch->ring == NULL) return -1;
+    ch->mfd = mfd;
+    ch->efd = efd;
+    return 0;
+}
+
+void shm_chan_close(shm_chan_t *ch)
+{
+    if (ch->ring) shm_ring_destroy(ch->ring);
+    if (ch->efd >= 0) close(ch->efd);
+    if (ch->mfd >= 0) close(ch->mfd);
+    ch->ring = NULL;
+    ch->efd = -1;
+    ch->mfd = -1;
+}
+
+int shm_chan_send(shm_chan_t *ch, const void *data, uint32_t len)
+{
+    if (shm_ring_push(ch->ring, data, len) == -1) return -1;
+    shm_chan_notify(ch);
+    return 0;
+}
+
+void shm_chan_notify(shm_chan_t *ch)
+{
+    uint64_t one = 1;
+    // eventfd 는 카운터라서 여러 번 눌러도 신호처럼 사라지지 않는다
+    if (write(ch->efd, &one, sizeof(one)) == -1) {
+        // EAGAIN 은 카운터가 넘칠 때뿐이고, 이미 깨울 일이 쌓여 있다는 뜻
+    }
+}
+
+void shm_chan_ack(shm_chan_t *ch)
+{
+    uint64_t cnt;
+    if (read(ch->efd, &cnt, sizeof(cnt)) == -1) {
+        // EAGAIN : 이미 비어 있음
+    }
+}
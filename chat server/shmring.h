@@ -0,0 +1,76 @@
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <sys/uio.h>
+#include <sys/types.h>
+
+// --- 매크로 정의 ---
+#define SHM_RING_SIZE  (64 * 1024) // 방향별 링 데이터 크기 (2의 거듭제곱)
+#define SHM_RING_LINE  64          // 캐시 라인 크기 (head/tail 분리용)
+
+// --- 구조체 정의 ---
+// 부모/자식 프로세스가 공유 메모리로 주고받는 SPSC(생산자 1, 소비자 1) 링
+// memfd 를 fork() 전에 MAP_SHARED 로 매핑해 두면 두 프로세스가 같은 메모리를 본다
+// memfd 를 들고 있으면 fork() 하지 않은 프로세스에도 넘겨서 매핑할 수 있다 (무중단 업그레이드)
+// 각 레코드는 [uint32_t 길이][내용] 이라서 여러 메시지가 붙어서 읽히지 않는다
+// 업그레이드 뒤에는 옛 바이너리의 자식과 새 바이너리의 부모가 같은 링을 보므로 이 배치와 레코드 형식은 바꾸지 않는다
+typedef struct {
+    _Atomic uint32_t head;             // 생산자가 다음에 쓸 위치 (계속 증가)
+    char pad1[SHM_RING_LINE - sizeof(uint32_t)];
+    _Atomic uint32_t tail;             // 소비자가 다음에 읽을 위치 (계속 증가)
+    char pad2[SHM_RING_LINE - sizeof(uint32_t)];
+    uint32_t size;                     // data 크기
+    _Atomic int32_t owner;             // 이 링을 맡은 부모 pid (업그레이드로 부모가 바뀌면 새 부모가 쓴다)
+    char data[];
+} shm_ring_t;
+
+// 링 + eventfd 초인종
+// 생산자는 링에 넣은 뒤 efd 에 1 을 써서 소비자를 깨운다
+typedef struct {
+    shm_ring_t *ring;
+    int efd;
+    int mfd;                           // 링 메모리의 memfd (다른 프로세스에 SCM_RIGHTS 로 넘길 때)
+} shm_chan_t;
+
+// --- 링 함수 ---
+// memfd 에 링을 만든다. mfd 가 NULL 이면 매핑만 남기고 memfd 는 닫는다
+shm_ring_t *shm_ring_create(uint32_t size, int *mfd);
+// 다른 프로세스가 만든 링의 memfd 를 매핑한다 (내용은 그대로)
+shm_ring_t *shm_ring_attach(int mfd);
+void shm_ring_destroy(shm_ring_t *r);
+void shm_ring_set_owner(shm_ring_t *r, pid_t pid);
+pid_t shm_ring_owner(shm_ring_t *r);
+// 레코드 하나 넣기. 자리가 없으면 -1 (아무것도 쓰지 않음)
+int shm_ring_push(shm_ring_t *r, const void *data, uint32_t len);
+// 레코드 하나 꺼내기. 비어 있으면 -1, 아니면 레코드 길이
+// cap 보다 긴 레코드는 잘라서 복사하고 나머지는 버린다
+int shm_ring_pop(shm_ring_t *r, void *buf, uint32_t cap);
+bool shm_ring_empty(shm_ring_t *r);
+
+// --- 복사하지 않고 읽기 (소비자) ---
+// 레코드를 버퍼로 꺼내지 않고 링 메모리를 그대로 writev()/sendmsg() 에 넘길 때 쓴다
+// pos 는 shm_ring_tail() 에서 시작하고, 다 쓴 만큼 shm_ring_release() 로 돌려줄 때까지 생산자가 덮어쓰지 않는다
+uint32_t shm_ring_tail(shm_ring_t *r);
+// pos 의 레코드 내용을 iov 에 담고 (링 끝에서 감기면 두 조각) pos 를 다음 레코드로 옮긴다
+// 조각 수 (빈 레코드면 0), pos 에 레코드가 없으면 -1
+int shm_ring_peek(shm_ring_t *r, uint32_t *pos, struct iovec iov[2]);
+// pos 앞까지의 레코드를 다 읽었다고 생산자에게 돌려준다
+void shm_ring_release(shm_ring_t *r, uint32_t pos);
+
+// --- 채널 함수 (링 + eventfd) ---
+int shm_chan_open(shm_chan_t *ch);               // SHM_RING_SIZE 링
+int shm_chan_open_size(shm_chan_t *ch, uint32_t size);
+void shm_chan_close(shm_chan_t *ch);
+// 넘겨받은 memfd 와 eventfd 로 채널을 잇는다. 실패하면 -1 (두 fd 는 부른 쪽이 닫는다)
+int shm_chan_attach(shm_chan_t *ch, int mfd, int efd);
+// 링에 넣고 초인종을 누른다
+int shm_chan_send(shm_chan_t *ch, const void *data, uint32_t len);
+// 초인종만 누른다 (shm_ring_push() 로 여러 개 넣은 뒤 한 번)
+void shm_chan_notify(shm_chan_t *ch);
+// 초인종 카운터를 비운다 (논블로킹)
+void shm_chan_ack(shm_chan_t *ch);
+
+#endif //SHMRING_H
@@ -1,75 +1,58 @@
 #include "sig.h"
-
-// --- 시그널 핸들러 함수 정의 ---
-void handle_parent_sigusr(int signum) {
-    parent_sigusr_arrived = 1; 
-    syslog(LOG_INFO, "Parent: SIGUSR1 received (message from child).");
+#include "workerpool.h"
+
+// pid 로 자식 레코드 찾기 (색인에서 바로 찾는다)
+static pipeInfo *find_child(pid_t pid)
+{
+    uint64_t v;
+    if (!hidx_get_id(&child_by_pid, pid, &v)) return NULL;
+    return slab_get(&active_children, slab_handle_unpack(v));
 }
 
-void handle_child_sigusr(int signum) {
-    child_sigusr_arrived = 1;
-    syslog(LOG_INFO, "Child: SIGUSR1 received (message from parent).");
-}
+void remove_child(pipeInfo *child) {
+    pid_t pid = child->pid;
 
-void handle_sigchld_main(int signum) { 
-    child_exited_flag = 1; 
-    syslog(LOG_INFO, "Parent: SIGCHLD received. Child exited flag set.");
+    // 작업자에게 맡긴 연결은 자기 링이 없다 (작업자의 링을 함께 쓴다)
+    if (child->worker == NULL) {
+        notify_del(&parent_notify, &child->note);
+        shm_chan_close(&child->to_child);
+        shm_chan_close(&child->to_parent);
+    }
+    if (child->adopted) {
+        notify_del(&parent_notify, &child->exit_note);
+        close(child->pidfd);
+    }
+    msgq_clear(&child->backlog);
+    child->isActive = false; 
+    room_leave(&rooms, &child->room);
+
+    // 색인에서 빼고 칸을 빈칸 목록에 돌려준다 (O(1)). 다른 자식들은 옮겨지지 않으므로 방 멤버 링크도 그대로다
+    uint64_t v = slab_handle_pack(slab_handle(child));
+    if (child->worker == NULL) hidx_del_id(&child_by_pid, pid, v);
+    if (child->name[0] != '\0') hidx_del_name(&child_by_name, child->name, strlen(child->name), v);
+    slab_free(&active_children, child);
+    metrics_inc(MET_CONN_CLOSED);
+    metrics_gauge_add(MET_CONN_ACTIVE, -1);
+    chat_log(LOG_INFO, "Parent: Child %d removed from list. Active children: %u.", pid, active_children.used);
 }
 
+// SIGCHLD 는 signalfd 로 받아서 부모 루프가 부른다. 여러 번 온 SIGCHLD 가 하나로 합쳐질 수 있으므로 다 거둔다
 void clean_active_process() {
     pid_t pid;
     int status;
     while ((pid = waitpid(-1, &status, WNOHANG)) > 0) { 
-        syslog(LOG_INFO, "Parent: Child %d terminated (status: %d).", pid, status);
-        for (int i = 0; i < num_active_children; i++) {
-            if (active_children[i].pid == pid) {
-                close(active_children[i].parent_to_child_write_fd); 
-                close(active_children[i].child_to_parent_read_fd);  
-                active_children[i].isActive = false; 
-                
-                for (int j = i; j < num_active_children - 1; j++) {
-                    active_children[j] = active_children[j+1];
-                }
-                num_active_children--;
-                syslog(LOG_INFO, "Parent: Child %d removed from list. Active children: %d.", pid, num_active_children);
-                break; 
-            }
-        }
+        chat_log(LOG_INFO, "Parent: Child %d terminated (status: %d).", pid, status);
+        pipeInfo *child = find_child(pid);
+        if (child != NULL) remove_child(child);
+        else pool_reap(pid); // 작업자가 죽었으면 그 연결들을 정리하고 다시 띄운다
     }
 }
 
-// --- 시그널 핸들러 등록 함수 ---
-void setup_signal_handlers_parent_main() { 
-    struct sigaction sa_usr, sa_chld;
-
-    sa_usr.sa_handler = handle_parent_sigusr;
-    sigemptyset(&sa_usr.sa_mask);
-    sa_usr.sa_flags = 0; 
-    if (sigaction(SIGUSR1, &sa_usr, NULL) == -1) {
-        syslog(LOG_ERR, "Parent: Failed to set SIGUSR1 handler: %m");
-        exit(1);
-    }
-    syslog(LOG_INFO, "Parent: SIGUSR1 handler set for parent.");
-
-    sa_chld.sa_handler = handle_sigchld_main; 
-    sigemptyset(&sa_chld.sa_mask);
-    sa_chld.sa_flags = SA_RESTART | SA_NOCLDSTOP; 
-    if (sigaction(SIGCHLD, &sa_chld, NULL) == -1) {
-        syslog(LOG_ERR, "Parent: Failed to set SIGCHLD handler: %m");
-        exit(1);
-    }
-    syslog(LOG_INFO, "Parent: SIGCHLD handler set for parent.");
-}
-
-void setup_signal_handlers_child_main() { 
-    struct sigaction sa_usr;
-
-    sa_usr.sa_handler = handle_child_sigusr;
-    sigemptyset(&sa_usr.sa_mask);
-    sa_usr.sa_flags = 0; 
-    if (sigaction(SIGUSR1, &sa_usr, NULL) == -1) {
-        syslog(LOG_ERR, "Child: Failed to set SIGUSR1 handler: %m");
-        exit(1);
+// 업그레이드로 넘겨받은 자식은 SIGCHLD 대신 pidfd 로 끝난 것을 안다. 알림이 온 자식은 exit_note 를 떼어 두었다
+void clean_adopted_process() {
+    slab_for_each(&active_children, pipeInfo, child) {
+        if (!child->adopted || child->exit_note.fd >= 0) continue;
+        chat_log(LOG_INFO, "Parent: Adopted child %d terminated.", child->pid);
+        remove_child(child);
     }
-    syslog(LOG_INFO, "Child: SIGUSR1 handler set for child.");
 }
@@ -3,16 +3,11 @@
 
 #include "comm.h"
 
-//자식에게 받은 신호
-void handle_parent_sigusr(int signum);
-//부모에게 받은 신호
-void handle_child_sigusr(int signum);
-//자식이 죽은 신호
-void handle_sigchld_main(int signum);
 //죽었을때 열린 파이프 및 각종 메모리 해제 담당
 void clean_active_process();
-// --- 시그널 핸들러 등록 함수 ---
-void setup_signal_handlers_parent_main();
-void setup_signal_handlers_child_main();
+// 업그레이드로 넘겨받은 자식 중 끝난 것들을 정리 (exit_note 를 뗀 자식)
+void clean_adopted_process();
+// 자식 레코드 하나를 방/색인에서 빼고 푼다 (자식 프로세스가 끝났거나 작업자가 연결이 닫혔다고 알렸을 때)
+void remove_child(pipeInfo *child);
 
 #endif //SIG_H
\ No newline at end of file
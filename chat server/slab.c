@@ -0,0 +1,109 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+
+#include "slab.h"
+
+// --- 칸 머리말 ---
+// 세대는 할당할 때와 풀 때 하나씩 올린다. 홀수면 사용 중
+typedef struct {
+    uint32_t gen;
+    uint32_t idx;
+    uint32_t next_free;
+} slab_hdr_t;
+
+#define SLAB_ALIGN  alignof(max_align_t)
+#define SLAB_HDR    ((sizeof(slab_hdr_t) + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1))
+
+static inline slab_hdr_t *slot_hdr(const slab_t *s, uint32_t idx)
+{
+    return (slab_hdr_t *)(s->chunks[idx / SLAB_CHUNK] + (size_t)(idx % SLAB_CHUNK) * s->stride);
+}
+
+static inline slab_hdr_t *obj_hdr(const void *obj)
+{
+    return (slab_hdr_t *)((char *)obj - SLAB_HDR);
+}
+
+// --- 함수 ---
+void slab_init(slab_t *s, size_t obj_size)
+{
+    memset(s, 0, sizeof(*s));
+    s->stride = (SLAB_HDR + obj_size + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1);
+    s->free_head = SLAB_NONE;
+}
+
+void slab_destroy(slab_t *s)
+{
+    for (uint32_t i = 0; i < s->nchunks; i++) free(s->chunks[i]);
+    free(s->chunks);
+    slab_init(s, s->stride - SLAB_HDR);
+}
+
+// 덩어리 하나를 붙이고 새 칸들을 빈칸 목록에 넣는다 (덩어리 포인터 배열만 realloc 한다)
+static int slab_grow(slab_t *s)
+{
+    char **chunks = realloc(s->chunks, sizeof(char *) * (s->nchunks + 1));
+    if (chunks == NULL) return -1;
+    s->chunks = chunks;
+    char *chunk = calloc(SLAB_CHUNK, s->stride);
+    if (chunk == NULL) return -1;
+    s->chunks[s->nchunks++] = chunk;
+
+    // 낮은 번호부터 쓰이도록 뒤에서부터 끼워 넣는다
+    for (uint32_t i = SLAB_CHUNK; i-- > 0; ) {
+        uint32_t idx = s->cap + i;
+        slab_hdr_t *h = slot_hdr(s, idx);
+        h->idx = idx;
+        h->next_free = s->free_head;
+        s->free_head = idx;
+    }
+    s->cap += SLAB_CHUNK;
+    return 0;
+}
+
+void *slab_alloc(slab_t *s, slab_handle_t *h)
+{
+    if (s->free_head == SLAB_NONE && slab_grow(s) == -1) return NULL;
+
+    slab_hdr_t *hdr = slot_hdr(s, s->free_head);
+    s->free_head = hdr->next_free;
+    hdr->next_free = SLAB_NONE;
+    hdr->gen++;
+    s->used++;
+
+    void *obj = (char *)hdr + SLAB_HDR;
+    memset(obj, 0, s->stride - SLAB_HDR);
+    if (h) *h = (slab_handle_t){ .idx = hdr->idx, .gen = hdr->gen };
+    return obj;
+}
+
+void slab_free(slab_t *s, void *obj)
+{
+    slab_hdr_t *hdr = obj_hdr(obj);
+    if (!(hdr->gen & 1)) return;   // 이미 풀린 칸
+    hdr->gen++;
+    hdr->next_free = s->free_head;
+    s->free_head = hdr->idx;
+    s->used--;
+}
+
+void *slab_get(const slab_t *s, slab_handle_t h)
+{
+    if (h.idx >= s->cap) return NULL;
+    slab_hdr_t *hdr = slot_hdr(s, h.idx);
+    return (hdr->gen == h.gen && (h.gen & 1)) ? (char *)hdr + SLAB_HDR : NULL;
+}
+
+slab_handle_t slab_handle(const void *obj)
+{
+    const slab_hdr_t *hdr = obj_hdr(obj);
+    return (slab_handle_t){ .idx = hdr->idx, .gen = hdr->gen };
+}
+
+void *slab_at(const slab_t *s, uint32_t idx)
+{
+    if (idx >= s->cap) return NULL;
+    slab_hdr_t *hdr = slot_hdr(s, idx);
+    return (hdr->gen & 1) ? (char *)hdr + SLAB_HDR : NULL;
+}
@@ -0,0 +1,58 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- 매크로 정의 ---
+#define SLAB_CHUNK 64            // 모자라면 이만큼씩 칸을 늘린다 (덩어리 단위라 이미 있는 칸은 옮겨지지 않는다)
+#define SLAB_NONE  UINT32_MAX
+
+// 살아 있는 칸을 모두 훑는다. 몸체 안의 break 는 안쪽 for 만 빠지므로 쓰지 않는다 (return/continue 는 된다)
+#define slab_for_each(s, type, p) \
+    for (uint32_t p##_idx = 0; p##_idx < (s)->cap; p##_idx++) \
+        for (type *p = slab_at((s), p##_idx); p != NULL; p = NULL)
+
+// --- 구조체 정의 ---
+// 칸 번호 + 세대 번호. 칸이 풀리거나 다른 것에 다시 쓰이면 세대가 바뀌어서 옛 핸들은 NULL 을 돌려받는다
+typedef struct {
+    uint32_t idx;
+    uint32_t gen;
+} slab_handle_t;
+
+// 같은 크기 레코드들의 늘어나는 배열 + 빈칸 목록
+// 할당/해제 모두 O(1) 이고, 레코드 주소는 해제될 때까지 바뀌지 않는다
+// (방 멤버 링크처럼 레코드 안을 가리키는 포인터를 그대로 들고 있어도 된다)
+typedef struct {
+    size_t stride;               // 칸 하나 크기 (머리말 포함, 정렬 맞춤)
+    char **chunks;               // SLAB_CHUNK 칸짜리 덩어리들
+    uint32_t nchunks;
+    uint32_t cap;                // 전체 칸 수
+    uint32_t used;               // 사용 중인 칸 수
+    uint32_t free_head;          // 빈칸 목록의 첫 칸 (SLAB_NONE : 없음)
+} slab_t;
+
+// 핸들을 64비트 값 하나로 접는다 (해시 색인의 값으로 넣을 때)
+static inline uint64_t slab_handle_pack(slab_handle_t h)
+{
+    return ((uint64_t)h.gen << 32) | h.idx;
+}
+
+static inline slab_handle_t slab_handle_unpack(uint64_t v)
+{
+    return (slab_handle_t){ .idx = (uint32_t)v, .gen = (uint32_t)(v >> 32) };
+}
+
+// --- 함수 ---
+void slab_init(slab_t *s, size_t obj_size);
+void slab_destroy(slab_t *s);
+// 0 으로 채운 레코드 하나. 빈칸이 없으면 덩어리 하나를 늘린다. 메모리가 없으면 NULL
+void *slab_alloc(slab_t *s, slab_handle_t *h);
+void slab_free(slab_t *s, void *obj);
+// 핸들이 아직 같은 레코드를 가리키면 그 주소, 아니면 NULL
+void *slab_get(const slab_t *s, slab_handle_t h);
+slab_handle_t slab_handle(const void *obj);
+// idx 칸이 사용 중이면 레코드 주소, 아니면 NULL (훑기용)
+void *slab_at(const slab_t *s, uint32_t idx);
+
+#endif //SLAB_H
@@ -0,0 +1,152 @@
+#define _GNU_SOURCE // SOCK_CLOEXEC, MSG_CMSG_CLOEXEC
+#include "upgrade.h"
+#include <limits.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+
+#ifndef CLOSE_RANGE_CLOEXEC
+#define CLOSE_RANGE_CLOEXEC (1U << 2)
+#endif
+
+// --- 전역 변수 정의 ---
+static char exe_path[PATH_MAX];   // "" : 경로를 알 수 없어 업그레이드할 수 없다
+static char **exe_argv;
+
+void upgrade_remember(char **argv)
+{
+    ssize_t n = readlink("/proc/self/exe", exe_path, sizeof(exe_path) - 1);
+    exe_path[n > 0 ? n : 0] = '\0';
+    exe_argv = argv;
+}
+
+int upgrade_inherited(void)
+{
+    const char *v = getenv(UPGRADE_ENV);
+    if (v == NULL) return -1;
+    int fd = atoi(v);
+    unsetenv(UPGRADE_ENV);
+    if (fd < 3 || fcntl(fd, F_GETFD) == -1) return -1;
+    // 이 프로세스가 fork() 하는 자식들은 넘기기 소켓을 쓰지 않는다
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+// 0, 1, 2 를 뺀 모든 fd 를 exec 때 닫히게 한다 (서버 소켓, 자식 링의 eventfd 처럼 CLOEXEC 가 아닌 것들)
+// fork() 뒤라 시스템 콜만 쓴다
+static void cloexec_all(void)
+{
+#ifdef SYS_close_range
+    if (syscall(SYS_close_range, 3, ~0U, CLOSE_RANGE_CLOEXEC) == 0) return;
+#endif
+    long max = sysconf(_SC_OPEN_MAX);
+    for (long fd = 3; fd < max; fd++) fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
+
+int upgrade_spawn(notify_t *nt, pid_t *pid)
+{
+    int sv[2];
+    char env[16];
+
+    *pid = -1;
+    if (exe_path[0] == '\0') {
+        chat_log(LOG_ERR, "Upgrade: executable path unknown.");
+        return -1;
+    }
+    // SEQPACKET 이라 레코드 하나가 메시지 하나로 오고, SCM_RIGHTS 로 fd 를 같이 넘길 수 있다 (작업자 제어 소켓과 같다)
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == -1) {
+        chat_log(LOG_ERR, "Upgrade: socketpair failed: %m");
+        return -1;
+    }
+    // 양쪽 모두 한쪽이 멈추면 기다리다 포기한다 (새 프로세스가 뜨다가 멈춰도 옛 프로세스는 계속 돈다)
+    struct timeval tv = { .tv_sec = UPGRADE_WAIT_MS / 1000, .tv_usec = UPGRADE_WAIT_MS % 1000 * 1000 };
+    for (int i = 0; i < 2; i++) {
+        setsockopt(sv[i], SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        setsockopt(sv[i], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    }
+
+    // fork() 뒤의 자식은 시스템 콜만 부르도록 환경 변수는 미리 넣어 둔다
+    snprintf(env, sizeof(env), "%d", sv[1]);
+    setenv(UPGRADE_ENV, env, 1);
+    pid_t p = fork();
+    if (p == 0) {
+        // 막아 둔 시그널을 되돌리고 (새 프로세스가 다시 막는다) 넘기기 소켓 말고는 아무것도 물려주지 않는다
+        notify_forget(nt);
+        cloexec_all();
+        fcntl(sv[1], F_SETFD, 0);
+        execv(exe_path, exe_argv);
+        _exit(127);
+    }
+    unsetenv(UPGRADE_ENV);
+    close(sv[1]);
+    if (p < 0) {
+        chat_log(LOG_ERR, "Upgrade: fork failed: %m");
+        close(sv[0]);
+        return -1;
+    }
+    chat_log(LOG_INFO, "Upgrade: started %s as %d.", exe_path, p);
+    *pid = p;
+    return sv[0];
+}
+
+int upgrade_send(int sock, const upgrade_rec_t *rec, const void *data, size_t len, const int *fds, int nfds)
+{
+    char cbuf[CMSG_SPACE(sizeof(int) * UPGRADE_FDS)] = {0};
+    struct iovec iov[2] = {
+        { .iov_base = (void *)rec, .iov_len = sizeof(*rec) },
+        { .iov_base = (void *)data, .iov_len = len },
+    };
+    struct msghdr mh = { .msg_iov = iov, .msg_iovlen = len ? 2 : 1 };
+
+    if (nfds > 0) {
+        mh.msg_control = cbuf;
+        mh.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+        struct cmsghdr *cm = CMSG_FIRSTHDR(&mh);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_RIGHTS;
+        cm->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+        memcpy(CMSG_DATA(cm), fds, sizeof(int) * nfds);
+    }
+    ssize_t n;
+    do {
+        n = sendmsg(sock, &mh, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    if (n != (ssize_t)(sizeof(*rec) + len)) {
+        chat_log(LOG_ERR, "Upgrade: send failed: %m");
+        return -1;
+    }
+    return 0;
+}
+
+ssize_t upgrade_recv(int sock, upgrade_rec_t *rec, void *data, size_t cap, int *fds, int *nfds)
+{
+    char cbuf[CMSG_SPACE(sizeof(int) * UPGRADE_FDS)];
+    struct iovec iov[2] = {
+        { .iov_base = rec, .iov_len = sizeof(*rec) },
+        { .iov_base = data, .iov_len = cap },
+    };
+    struct msghdr mh = { .msg_iov = iov, .msg_iovlen = 2, .msg_control = cbuf, .msg_controllen = sizeof(cbuf) };
+
+    *nfds = 0;
+    ssize_t n;
+    do {
+        n = recvmsg(sock, &mh, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        if (n == 0) errno = ECONNRESET;
+        chat_log(LOG_ERR, "Upgrade: receive failed: %m");
+        return -1;
+    }
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&mh);
+    if (cm && cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS) {
+        *nfds = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        memcpy(fds, CMSG_DATA(cm), sizeof(int) * *nfds);
+    }
+    // 잘린 레코드는 받은 fd 를 닫고 실패로 본다 (양쪽이 같은 upgrade_rec_t 를 쓰지 않는 바이너리)
+    if ((mh.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) || (size_t)n < sizeof(*rec)) {
+        chat_log(LOG_ERR, "Upgrade: malformed record.");
+        for (int i = 0; i < *nfds; i++) close(fds[i]);
+        *nfds = 0;
+        return -1;
+    }
+    return n - sizeof(*rec);
+}
@@ -0,0 +1,55 @@
+#ifndef UPGRADE_H
+#define UPGRADE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "comm.h"
+
+// --- 매크로 정의 ---
+// 무중단 업그레이드 : 돌고 있는 서버에 SIGUSR2 를 보내면 처음 띄운 경로의 (새로 깔린) 바이너리를 같은 인자로 띄우고,
+// 서버 소켓, 클라이언트 자식들의 링(memfd + eventfd), 방/닉네임/방 기록을 유닉스 소켓으로 넘긴 뒤 끝난다
+// 클라이언트 소켓은 자식 프로세스가 들고 있으므로 그대로 두고, 자식은 링의 주인이 바뀐 것을 보고 새 부모를 따라간다
+#define UPGRADE_ENV     "CHAT_UPGRADE_FD" // 새 프로세스가 물려받은 넘기기 소켓 번호 (옛 프로세스가 채운다)
+#define UPGRADE_WAIT_MS 10000             // 새 프로세스가 받고 답할 때까지 기다리는 시간 (넘으면 새 프로세스를 죽이고 그대로 돈다)
+#define UPGRADE_FDS     4                 // 레코드 하나에 붙는 최대 fd 수
+
+// 레코드 종류. 옛 -> 새 : LISTEN, (ROOM, HISTORY...)..., (CHILD, BACKLOG...)..., END
+enum {
+    UPG_LISTEN = 1,   // fd : 서버 소켓
+    UPG_ROOM,         // room : 방 이름, peers : 그 방 멤버가 있는 다른 노드들 (이 노드가 주인인 방)
+    UPG_HISTORY,      // 바로 앞 ROOM 의 최근 메시지 하나 (오래된 것부터, 내용 = 프레임)
+    UPG_CHILD,        // pid, name, room : 클라이언트 자식 하나. fd : to_child memfd/eventfd, to_parent memfd/eventfd
+    UPG_BACKLOG,      // 바로 앞 CHILD 의 대기열 메시지 하나 (내용 = 프레임)
+    UPG_END,
+    UPG_READY,        // 새 -> 옛 : 다 받았고 링의 주인이 되었다 (옛 프로세스는 이것을 받고 끝난다)
+};
+
+// --- 구조체 정의 ---
+// 레코드 머리말. 내용은 머리말 바로 뒤에 붙어서 SOCK_SEQPACKET 메시지 하나로 간다
+typedef struct {
+    int32_t kind;
+    int32_t pid;
+    uint32_t peers;
+    char room[ROOM_NAME];
+    char name[NAME];
+} upgrade_rec_t;
+
+// --- 함수 ---
+// 지금 바이너리 경로와 인자를 기억해 둔다 (데몬화가 작업 디렉터리를 바꾸기 전에, 새 파일이 깔리기 전에)
+void upgrade_remember(char **argv);
+// 새 프로세스 쪽 : 물려받은 넘기기 소켓, 업그레이드로 뜬 것이 아니면 -1
+// 환경 변수는 지운다 (이 프로세스가 나중에 띄우는 업그레이드나 자식이 물려받지 않도록)
+int upgrade_inherited(void);
+// 옛 프로세스 쪽 : 기억해 둔 바이너리를 띄우고 넘기기 소켓을 돌려준다. 새 프로세스 pid 는 *pid. 실패하면 -1
+// 새 프로세스는 nt 의 epoll/signalfd 와 CLOEXEC 가 아닌 fd 들도 물려받지 않는다
+int upgrade_spawn(notify_t *nt, pid_t *pid);
+
+// 레코드 하나를 보낸다. fds[0..nfds) 는 SCM_RIGHTS 로 함께 간다 (보낸 쪽 fd 는 그대로 열려 있다)
+int upgrade_send(int sock, const upgrade_rec_t *rec, const void *data, size_t len, const int *fds, int nfds);
+// 레코드 하나를 받는다. 내용 길이, 실패하거나 끊겼거나 UPGRADE_WAIT_MS 안에 오지 않으면 -1
+// 받은 fd 는 fds 에 (CLOEXEC 로 열린다), 그 수는 *nfds
+ssize_t upgrade_recv(int sock, upgrade_rec_t *rec, void *data, size_t cap, int *fds, int *nfds);
+
+#endif //UPGRADE_H
@@ -0,0 +1,317 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#include "uring.h"
+#include "chatlog.h"
+
+// --- 시스템 콜 ---
+static int sys_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_register(int fd, unsigned op, void *arg, unsigned nr)
+{
+    return (int)syscall(__NR_io_uring_register, fd, op, arg, nr);
+}
+
+static int selected = -1;     // -1 : 아직 확인 안 함
+
+// --- 선택 ---
+// 쓰는 요청 종류가 모두 있고, 버퍼 링(5.19 이후)을 등록할 수 있는지 본다
+static bool probe(void)
+{
+    uring_t u;
+    uring_bufs_t b;
+    static const uint8_t need[] = {
+        IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SENDMSG, IORING_OP_READ, IORING_OP_POLL_ADD, IORING_OP_TIMEOUT,
+    };
+
+    if (uring_init(&u, 8) == -1) {
+        chat_log(LOG_WARNING, "io_uring: setup failed (%m).");
+        return false;
+    }
+    size_t len = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *pr = calloc(1, len);
+    bool ok = pr != NULL && sys_register(u.fd, IORING_REGISTER_PROBE, pr, 256) == 0;
+    for (size_t i = 0; ok && i < sizeof(need); i++) {
+        ok = need[i] <= pr->last_op && (pr->ops[need[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(pr);
+    if (!ok) {
+        chat_log(LOG_WARNING, "io_uring: kernel lacks a needed opcode.");
+    } else if (uring_bufs_init(&u, &b, 0, 1, 64) == -1) {
+        chat_log(LOG_WARNING, "io_uring: kernel lacks provided buffer rings (%m).");
+        ok = false;
+    } else {
+        uring_bufs_free(&u, &b);
+    }
+    uring_close(&u);
+    return ok;
+}
+
+bool uring_select(void)
+{
+    if (selected >= 0) return selected;
+    const char *v = getenv(URING_ENV);
+    selected = 0;
+    if (v && strcmp(v, "uring") == 0) {
+        selected = probe();
+        if (selected) chat_log(LOG_INFO, "I/O backend: io_uring.");
+        else chat_log(LOG_WARNING, "I/O backend: io_uring unavailable, falling back to epoll.");
+    }
+    return selected;
+}
+
+bool uring_on(void)
+{
+    return selected > 0;
+}
+
+// --- 링 ---
+int uring_init(uring_t *u, unsigned entries)
+{
+    struct io_uring_params p;
+
+    memset(u, 0, sizeof(*u));
+    memset(&p, 0, sizeof(p));
+    u->fd = sys_setup(entries, &p);
+    if (u->fd < 0) return -1;
+
+    u->sq_map_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cq_map_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    // 5.4 이후로는 SQ 와 CQ 가 한 영역이다
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (u->cq_map_len > u->sq_map_len) u->sq_map_len = u->cq_map_len;
+        u->cq_map_len = u->sq_map_len;
+    }
+    u->sq_map = mmap(NULL, u->sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    if (u->sq_map == MAP_FAILED) goto fail;
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        u->cq_map = u->sq_map;
+    } else {
+        u->cq_map = mmap(NULL, u->cq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+        if (u->cq_map == MAP_FAILED) goto fail;
+    }
+    u->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) goto fail;
+
+    char *sq = u->sq_map, *cq = u->cq_map;
+    u->sq_head = (unsigned *)(sq + p.sq_off.head);
+    u->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    u->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    u->sq_array = (unsigned *)(sq + p.sq_off.array);
+    u->cq_head = (unsigned *)(cq + p.cq_off.head);
+    u->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    u->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    u->sq_entries = p.sq_entries;
+    return 0;
+
+fail:
+    if (u->sqes == MAP_FAILED) u->sqes = NULL;
+    if (u->cq_map == MAP_FAILED) u->cq_map = NULL;
+    if (u->sq_map == MAP_FAILED) u->sq_map = NULL;
+    uring_close(u);
+    return -1;
+}
+
+void uring_close(uring_t *u)
+{
+    if (u->sqes) munmap(u->sqes, u->sqes_len);
+    if (u->cq_map && u->cq_map != u->sq_map) munmap(u->cq_map, u->cq_map_len);
+    if (u->sq_map) munmap(u->sq_map, u->sq_map_len);
+    if (u->fd >= 0) close(u->fd);
+    memset(u, 0, sizeof(*u));
+    u->fd = -1;
+}
+
+int uring_submit(uring_t *u, unsigned wait_nr)
+{
+    for (;;) {
+        int n = sys_enter(u->fd, u->sq_pending, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0);
+        if (n >= 0) {
+            u->sq_pending -= n;
+            return n;
+        }
+        if (errno != EINTR) return -1;
+        // 시그널로 깼으면 넘기기만 끝내고 돌아간다 (기다리던 쪽이 다시 부른다)
+        if (u->sq_pending == 0) return 0;
+    }
+}
+
+unsigned uring_reap(uring_t *u, struct io_uring_cqe *out, unsigned max)
+{
+    unsigned head = *u->cq_head;
+    unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+    unsigned n = 0;
+
+    while (head != tail && n < max) out[n++] = u->cqes[head++ & *u->cq_mask];
+    __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+    return n;
+}
+
+int uring_register_eventfd(uring_t *u, int efd)
+{
+    return sys_register(u->fd, IORING_REGISTER_EVENTFD, &efd, 1);
+}
+
+// --- 받기 버퍼 링 ---
+int uring_bufs_init(uring_t *u, uring_bufs_t *b, uint16_t bgid, uint32_t count, uint32_t size)
+{
+    memset(b, 0, sizeof(*b));
+    b->map_len = count * sizeof(struct io_uring_buf);
+    b->br = mmap(NULL, b->map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (b->br == MAP_FAILED) {
+        b->br = NULL;
+        return -1;
+    }
+    b->mem = malloc((size_t)count * size);
+    if (b->mem == NULL) {
+        munmap(b->br, b->map_len);
+        b->br = NULL;
+        return -1;
+    }
+    struct io_uring_buf_reg reg = { .ring_addr = (uintptr_t)b->br, .ring_entries = count, .bgid = bgid };
+    if (sys_register(u->fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+        int e = errno;
+        free(b->mem);
+        munmap(b->br, b->map_len);
+        b->br = NULL;
+        errno = e;
+        return -1;
+    }
+    b->count = count;
+    b->size = size;
+    b->bgid = bgid;
+    for (uint32_t i = 0; i < count; i++) uring_buf_put(b, i);
+    return 0;
+}
+
+void uring_bufs_free(uring_t *u, uring_bufs_t *b)
+{
+    if (b->br == NULL) return;
+    struct io_uring_buf_reg reg = { .bgid = b->bgid };
+    sys_register(u->fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    munmap(b->br, b->map_len);
+    free(b->mem);
+    memset(b, 0, sizeof(*b));
+}
+
+void uring_buf_put(uring_bufs_t *b, uint16_t bid)
+{
+    struct io_uring_buf *e = &b->br->bufs[b->tail & (b->count - 1)];
+    e->addr = (uintptr_t)uring_buf(b, bid);
+    e->len = b->size;
+    e->bid = bid;
+    b->tail++;
+    // 커널은 tail 이 바뀐 것을 보고 새 버퍼를 가져가므로 칸을 다 채운 뒤에 공개한다
+    __atomic_store_n(&b->br->tail, b->tail, __ATOMIC_RELEASE);
+}
+
+// --- 요청 채우기 ---
+static struct io_uring_sqe *sqe_get(uring_t *u)
+{
+    unsigned tail = *u->sq_tail;
+    if (tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= u->sq_entries) {
+        if (uring_submit(u, 0) == -1) return NULL;
+        if (tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= u->sq_entries) return NULL;
+    }
+    unsigned idx = tail & *u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    u->sq_array[idx] = idx;
+    // SQPOLL 을 쓰지 않으므로 커널은 io_uring_enter() 때만 읽는다. 채우는 것은 돌려받은 뒤에 해도 된다
+    __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    u->sq_pending++;
+    return sqe;
+}
+
+int uring_accept(uring_t *u, int fd, bool multi, uint64_t ud)
+{
+    struct io_uring_sqe *sqe = sqe_get(u);
+    if (sqe == NULL) return -1;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = multi ? IORING_ACCEPT_MULTISHOT : 0;
+    sqe->user_data = ud;
+    return 0;
+}
+
+int uring_recv(uring_t *u, int fd, const uring_bufs_t *b, bool multi, uint64_t ud)
+{
+    struct io_uring_sqe *sqe = sqe_get(u);
+    if (sqe == NULL) return -1;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->len = multi ? 0 : b->size;     // 다중 받기는 길이를 0 으로 두고 버퍼 크기만큼 받는다
+    sqe->ioprio = multi ? IORING_RECV_MULTISHOT : 0;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = b->bgid;
+    sqe->user_data = ud;
+    return 0;
+}
+
+int uring_sendmsg(uring_t *u, int fd, const struct msghdr *mh, int flags, uint64_t ud)
+{
+    struct io_uring_sqe *sqe = sqe_get(u);
+    if (sqe == NULL) return -1;
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = (uintptr_t)mh;
+    sqe->len = 1;
+    // 다 보낼 때까지 커널이 기다렸다가 이어서 보낸다 (덜 보낸 채로 끝나지 않는다)
+    sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL | flags;
+    sqe->user_data = ud;
+    return 0;
+}
+
+int uring_read(uring_t *u, int fd, void *buf, size_t len, uint64_t ud)
+{
+    struct io_uring_sqe *sqe = sqe_get(u);
+    if (sqe == NULL) return -1;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (uintptr_t)buf;
+    sqe->len = len;
+    sqe->off = (uint64_t)-1;     // 파일 위치가 없는 fd (eventfd 등)
+    sqe->user_data = ud;
+    return 0;
+}
+
+int uring_poll(uring_t *u, int fd, uint64_t ud)
+{
+    struct io_uring_sqe *sqe = sqe_get(u);
+    if (sqe == NULL) return -1;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = ud;
+    return 0;
+}
+
+int uring_timeout(uring_t *u, long ms, uint64_t ud)
+{
+    struct io_uring_sqe *sqe = sqe_get(u);
+    if (sqe == NULL) return -1;
+    u->ts.tv_sec = ms / 1000;
+    u->ts.tv_nsec = (ms % 1000) * 1000000;
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = (uintptr_t)&u->ts;
+    sqe->len = 1;
+    sqe->user_data = ud;
+    return 0;
+}
@@ -0,0 +1,77 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/socket.h>
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+
+// --- 매크로 정의 ---
+// liburing 없이 시스템 콜 세 개(setup/enter/register)와 mmap 한 링만 쓴다
+#define URING_ENV     "CHAT_IO"   // "uring" 이면 io_uring, 없거나 다른 값이면 epoll/poll
+#define URING_BATCH   64          // uring_reap() 이 한 번에 꺼내는 완료 수
+
+// --- 구조체 정의 ---
+// 제출 큐(SQ)와 완료 큐(CQ). head/tail 은 커널과 함께 보는 공유 메모리라서 acquire/release 로만 읽고 쓴다
+typedef struct {
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    unsigned sq_entries;
+    unsigned sq_pending;          // 채웠지만 아직 io_uring_enter() 로 넘기지 않은 수
+    void *sq_map, *cq_map;
+    size_t sq_map_len, cq_map_len, sqes_len;
+    struct __kernel_timespec ts;  // uring_timeout() 이 커널에 넘기는 시간 (완료될 때까지 살아 있어야 한다)
+} uring_t;
+
+// 받기용으로 커널에 미리 맡겨 두는 버퍼들 (provided buffer ring)
+// 커널이 데이터가 올 때 하나를 골라 채우고 완료에 번호(bid)를 적어 준다. 다 쓰면 uring_buf_put() 으로 돌려준다
+typedef struct {
+    struct io_uring_buf_ring *br;
+    char *mem;                    // count * size 바이트
+    uint32_t count;               // 2의 거듭제곱
+    uint32_t size;
+    uint16_t bgid;
+    uint16_t tail;
+    size_t map_len;
+} uring_bufs_t;
+
+// --- 함수 ---
+// CHAT_IO=uring 이고 커널이 필요한 기능(다중 accept/recv 의 바탕인 버퍼 링 등록)을 지원하면 true
+// 처음 한 번만 확인하고 결과를 기억한다 (fork() 한 자식은 물려받는다)
+bool uring_select(void);
+bool uring_on(void);
+
+int uring_init(uring_t *u, unsigned entries);
+void uring_close(uring_t *u);
+// 채운 요청을 넘기고 완료가 wait_nr 개 이상 쌓일 때까지 기다린다 (시스템 콜 한 번)
+int uring_submit(uring_t *u, unsigned wait_nr);
+// 완료를 out 에 복사하고 CQ 에서 뺀다. 꺼낸 수
+unsigned uring_reap(uring_t *u, struct io_uring_cqe *out, unsigned max);
+// 완료가 생길 때마다 efd 를 울린다 (epoll 루프에 링을 붙일 때)
+int uring_register_eventfd(uring_t *u, int efd);
+
+int uring_bufs_init(uring_t *u, uring_bufs_t *b, uint16_t bgid, uint32_t count, uint32_t size);
+void uring_bufs_free(uring_t *u, uring_bufs_t *b);
+static inline char *uring_buf(const uring_bufs_t *b, uint16_t bid)
+{
+    return b->mem + (size_t)bid * b->size;
+}
+void uring_buf_put(uring_bufs_t *b, uint16_t bid);
+
+// --- 요청 채우기 (SQ 가 가득 차면 먼저 넘기고 채운다. 그래도 자리가 없으면 -1) ---
+// multi : 다중(multishot) 요청 하나로 완료가 계속 온다 (IORING_CQE_F_MORE 가 빠지면 끝났다)
+int uring_accept(uring_t *u, int fd, bool multi, uint64_t ud);
+int uring_recv(uring_t *u, int fd, const uring_bufs_t *b, bool multi, uint64_t ud);
+// flags : MSG_NOSIGNAL 에 더할 send() 플래그 (MSG_MORE 등)
+// mh 와 그것이 가리키는 iovec 은 완료가 올 때까지 살아 있어야 한다
+int uring_sendmsg(uring_t *u, int fd, const struct msghdr *mh, int flags, uint64_t ud);
+int uring_read(uring_t *u, int fd, void *buf, size_t len, uint64_t ud);
+int uring_poll(uring_t *u, int fd, uint64_t ud);
+int uring_timeout(uring_t *u, long ms, uint64_t ud);
+
+#endif //URING_H
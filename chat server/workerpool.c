@@ -0,0 +1,612 @@
+#include "workerpool.h"
+#include "sig.h"
+#include "cluster.h"
+#include <sys/epoll.h>
+#include <sys/prctl.h>
+
+// --- 전역 변수 정의 ---
+worker_pool_t pool = { .n = 0, .ssock = -1, .mfd = -1 };
+
+// =====================================================================
+// 작업자 프로세스 쪽
+// 연결 여러 개를 epoll 하나로 돌리며, 소켓 <-> 부모 링 사이에서 프레임만 옮긴다
+// 방/닉네임/명령 처리는 예전처럼 부모가 한다
+// =====================================================================
+
+#define WK_TAG_CTL   ((uint64_t)UINT32_MAX)       // epoll 이벤트 꼬리표 : 제어 소켓
+#define WK_TAG_RING  ((uint64_t)UINT32_MAX - 1)   // 부모 링 초인종 (나머지는 연결의 칸 번호)
+#define WK_EVENTS    64
+#define WK_RETRY_MS  10                            // 부모 링이 가득 차서 멈춘 연결을 다시 볼 간격
+#define WK_SWEEP_MS  1000                          // 혼잡한 연결이 있을 때 퇴출을 검사하는 주기 (리액터와 같음)
+
+typedef struct wconn {
+    int fd;
+    uint32_t idx;                // 부모 active_children 칸 번호 + 세대 (부모와 주고받는 연결 이름)
+    uint32_t gen;
+    frame_buf_t in;              // 소켓 재조립 버퍼
+    msg_queue_t out;             // 소켓에 보낼 프레임들 (writev 한 번으로 내보낸다)
+    flow_state_t flow;           // out 이 워터마크를 넘었는지 (너무 오래 넘으면 퇴출)
+    uint32_t events;             // 지금 epoll 에 걸어 둔 이벤트
+    bool paused;                 // 부모가 읽기를 멈추라고 했다 (혼잡한 방의 발행자)
+    bool blocked;                // 부모 링이 가득 차서 재조립 버퍼에 프레임이 남아 있다
+    bool closed;                 // 닫혔지만 dirty 목록에 남아 있어 아직 풀지 않았다
+    bool dirty;                  // 이번 회차에 out 에 새 프레임이 들어왔다
+    struct wconn *dirty_next;
+} wconn_t;
+
+static struct {
+    worker_t *self;
+    int ctl;
+    int epfd;
+    wconn_t **conns;             // 부모 칸 번호 -> 연결
+    uint32_t cap;
+    wconn_t *dirty;
+    uint32_t nblocked;
+    uint32_t ncongested;         // high 를 넘은 연결 수 (0 이 아니면 주기적으로 퇴출 검사)
+    int64_t last_sweep;
+    bool notify_parent;          // 부모 링에 넣은 레코드가 있다 (회차 끝에 초인종 한 번)
+} ws;
+
+static wconn_t *conn_lookup(uint32_t idx, uint32_t gen)
+{
+    if (idx >= ws.cap || ws.conns[idx] == NULL) return NULL;
+    return ws.conns[idx]->gen == gen ? ws.conns[idx] : NULL;
+}
+
+static void conn_events(wconn_t *c)
+{
+    uint32_t want = (!c->paused && !c->blocked ? EPOLLIN : 0) | (!msgq_empty(&c->out) ? EPOLLOUT : 0);
+    if (want == c->events) return;
+    struct epoll_event ev = { .events = want, .data.u64 = c->idx };
+    epoll_ctl(ws.epfd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->events = want;
+}
+
+static void conn_free(wconn_t *c)
+{
+    frame_buf_free(&c->in);
+    msgq_clear(&c->out);
+    free(c);
+}
+
+// 부모에게 알린다. 제어 소켓은 작업자 쪽만 블로킹이라 알림이 사라지지 않는다
+static void report(uint32_t kind, uint32_t idx, uint32_t gen)
+{
+    worker_ctl_t m = { .kind = kind, .idx = idx, .gen = gen };
+    if (send(ws.ctl, &m, sizeof(m), MSG_NOSIGNAL) != sizeof(m)) {
+        chat_log(LOG_ERR, "Worker %d: cannot report to parent (kind %u, connection %u): %m", getpid(), kind, idx);
+    }
+}
+
+// 연결을 닫고 부모에게 알린다 (WCTL_CLOSE 또는 WCTL_EVICTED). 부모는 이 알림을 받아야 레코드를 푼다
+static void conn_close(wconn_t *c, uint32_t kind)
+{
+    epoll_ctl(ws.epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    if (c->blocked) ws.nblocked--;
+    if (c->flow.congested) ws.ncongested--;
+    ws.conns[c->idx] = NULL;
+    report(kind, c->idx, c->gen);
+    if (c->dirty) c->closed = true;   // dirty 목록을 돌 때 푼다
+    else conn_free(c);
+}
+
+static void conn_open(uint32_t idx, uint32_t gen, int fd)
+{
+    if (idx >= ws.cap) {
+        uint32_t cap = ws.cap ? ws.cap : SLAB_CHUNK;
+        while (cap <= idx) cap *= 2;
+        wconn_t **p = realloc(ws.conns, sizeof(*p) * cap);
+        if (p == NULL) goto fail;
+        memset(p + ws.cap, 0, sizeof(*p) * (cap - ws.cap));
+        ws.conns = p;
+        ws.cap = cap;
+    }
+    // 같은 칸의 옛 연결은 부모가 이미 닫힘을 받고 풀었다
+    if (ws.conns[idx] != NULL) conn_close(ws.conns[idx], WCTL_CLOSE);
+
+    wconn_t *c = calloc(1, sizeof(*c));
+    if (c == NULL) goto fail;
+    if (frame_buf_init(&c->in, 0) == -1) {
+        free(c);
+        goto fail;
+    }
+    c->fd = fd;
+    c->idx = idx;
+    c->gen = gen;
+    c->events = EPOLLIN;
+    // 소켓은 이 작업자만 쓰므로 한 번 논블로킹으로 두고 다시 바꾸지 않는다
+    set_nonblocking(fd);
+    struct epoll_event ev = { .events = EPOLLIN, .data.u64 = idx };
+    if (epoll_ctl(ws.epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        conn_free(c);
+        goto fail;
+    }
+    ws.conns[idx] = c;
+    return;
+
+fail:
+    chat_log(LOG_ERR, "Worker %d: cannot take connection %u: %m", getpid(), idx);
+    report(WCTL_CLOSE, idx, gen);
+    close(fd);
+}
+
+// 재조립 버퍼의 완성된 프레임을 [머리말][내용] 레코드로 부모 링에 넣는다
+// 다 넣었으면 1, 링이 가득 차서 남았으면 0, 잘못된 프레임이면 -1
+static int conn_forward(wconn_t *c)
+{
+    static char rec[sizeof(worker_hdr_t) + FRAME_MAX];
+    worker_hdr_t hdr = { .idx = c->idx, .gen = c->gen };
+    frame_view_t frame;
+    int rc;
+
+    memcpy(rec, &hdr, sizeof(hdr));
+    while ((rc = frame_next(&c->in, &frame)) == 1) {
+        memcpy(rec + sizeof(hdr), frame.data, frame.len);
+        if (shm_ring_push(ws.self->to_parent.ring, rec, sizeof(hdr) + frame.len) == -1) {
+            frame_unget(&c->in, &frame);
+            return 0;
+        }
+        ws.notify_parent = true;
+    }
+    return rc < 0 ? -1 : 1;
+}
+
+// 부모 링이 가득 찼었거나 멈췄던 연결의 남은 프레임을 다시 넘긴다
+static void conn_retry(wconn_t *c)
+{
+    int rc = conn_forward(c);
+    if (rc < 0) {
+        conn_close(c, WCTL_CLOSE);
+        return;
+    }
+    if (c->blocked != (rc == 0)) {
+        c->blocked = (rc == 0);
+        if (c->blocked) ws.nblocked++;
+        else ws.nblocked--;
+    }
+    conn_events(c);
+}
+
+static void conn_read(wconn_t *c)
+{
+    if (c->paused || c->blocked) return;
+
+    ssize_t n = frame_read(&c->in, c->fd);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        chat_log(LOG_INFO, "Worker %d: connection %u closed by client.", getpid(), c->idx);
+        conn_close(c, WCTL_CLOSE);
+        return;
+    }
+    if (n > 0) conn_retry(c);
+}
+
+// out 길이가 바뀐 뒤 혼잡 상태를 갱신하고 바뀌었으면 부모에게 알린다. 퇴출했으면 -1
+static int flow_check(wconn_t *c)
+{
+    switch (flow_update(&c->flow, c->out.bytes)) {
+    case FLOW_EVICT:
+        chat_log(LOG_WARNING, "Worker %d: evicting slow connection %u, %zu bytes queued.", getpid(), c->idx, c->out.bytes);
+        conn_close(c, WCTL_EVICTED);
+        return -1;
+    case FLOW_CONGESTED:
+        ws.ncongested++;
+        report(WCTL_CONGESTED, c->idx, c->gen);
+        break;
+    case FLOW_RELIEVED:
+        ws.ncongested--;
+        report(WCTL_RELIEVED, c->idx, c->gen);
+        break;
+    }
+    return 0;
+}
+
+static void conn_flush(wconn_t *c)
+{
+    if (msgq_flush(&c->out, c->fd) < 0) {
+        conn_close(c, WCTL_CLOSE);
+        return;
+    }
+    if (flow_check(c) == 0) conn_events(c);
+}
+
+// 소켓을 전혀 읽지 않는 연결은 EPOLLOUT 도 오지 않으므로 시간 퇴출을 따로 검사한다
+static void flow_sweep(void)
+{
+    int64_t now = flow_now_ms();
+    if (now - ws.last_sweep < WK_SWEEP_MS) return;
+    ws.last_sweep = now;
+
+    for (uint32_t k = 0; k < ws.cap && ws.ncongested > 0; k++) {
+        wconn_t *c = ws.conns[k];
+        if (c && c->flow.congested) flow_check(c);
+    }
+}
+
+// 부모 링의 레코드를 연결별 출력 큐로 옮긴다. 소켓에는 회차 끝에 연결마다 writev 한 번
+static void ring_drain(void)
+{
+    static char rec[sizeof(worker_hdr_t) + FRAME_MAX];
+    worker_hdr_t hdr;
+    int n;
+
+    shm_chan_ack(&ws.self->to_worker);
+    while ((n = shm_ring_pop(ws.self->to_worker.ring, rec, sizeof(rec))) >= 0) {
+        if ((size_t)n < sizeof(hdr)) continue;
+        memcpy(&hdr, rec, sizeof(hdr));
+        wconn_t *c = conn_lookup(hdr.idx, hdr.gen);
+        if (c == NULL) continue;   // 이미 닫힌 연결
+
+        message_t *m = msg_frame(rec + sizeof(hdr), n - sizeof(hdr));
+        if (m == NULL || msgq_push(&c->out, m) == -1) {
+            msg_unref(m);
+            conn_close(c, WCTL_CLOSE);
+            continue;
+        }
+        msg_unref(m);
+        if (!c->dirty) {
+            c->dirty = true;
+            c->dirty_next = ws.dirty;
+            ws.dirty = c;
+        }
+    }
+}
+
+static void flush_dirty(void)
+{
+    while (ws.dirty) {
+        wconn_t *c = ws.dirty;
+        ws.dirty = c->dirty_next;
+        c->dirty = false;
+        if (c->closed) conn_free(c);
+        else conn_flush(c);
+    }
+}
+
+// 부모의 알림을 모두 읽는다. 부모가 죽었으면 -1
+static int ctl_recv(void)
+{
+    for (;;) {
+        worker_ctl_t m;
+        char cbuf[CMSG_SPACE(sizeof(int))];
+        struct iovec iov = { .iov_base = &m, .iov_len = sizeof(m) };
+        struct msghdr mh = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = cbuf, .msg_controllen = sizeof(cbuf) };
+        int fd = -1;
+
+        ssize_t n = recvmsg(ws.ctl, &mh, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+        if (n == 0) return -1;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+        struct cmsghdr *cm = CMSG_FIRSTHDR(&mh);
+        if (cm && cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS) {
+            memcpy(&fd, CMSG_DATA(cm), sizeof(fd));
+        }
+        if (n != sizeof(m)) {
+            if (fd >= 0) close(fd);
+            continue;
+        }
+
+        wconn_t *c = (m.kind == WCTL_OPEN) ? NULL : conn_lookup(m.idx, m.gen);
+        switch (m.kind) {
+        case WCTL_OPEN:
+            if (fd >= 0) conn_open(m.idx, m.gen, fd);
+            fd = -1;
+            break;
+        case WCTL_CLOSE:
+            if (c) conn_close(c, WCTL_CLOSE);
+            break;
+        case WCTL_PAUSE:
+        case WCTL_RESUME:
+            if (c == NULL) break;
+            c->paused = (m.kind == WCTL_PAUSE);
+            // 다시 읽을 때는 버퍼에 남은 프레임부터 넘긴다
+            if (!c->paused) conn_retry(c);
+            else conn_events(c);
+            break;
+        }
+        if (fd >= 0) close(fd);
+    }
+}
+
+static void worker_main(worker_t *self, int ctl)
+{
+    struct epoll_event evs[WK_EVENTS];
+
+    // 부모가 죽으면 같이 정리되도록 한다 (클라이언트 자식과 같음)
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    if (getppid() <= 1) exit(0);
+
+    ws.self = self;
+    ws.ctl = ctl;
+    ws.epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (ws.epfd < 0) {
+        chat_log(LOG_ERR, "Worker %d: epoll_create1 failed: %m", getpid());
+        exit(1);
+    }
+    struct epoll_event ev = { .events = EPOLLIN, .data.u64 = WK_TAG_CTL };
+    epoll_ctl(ws.epfd, EPOLL_CTL_ADD, ctl, &ev);
+    ev.data.u64 = WK_TAG_RING;
+    epoll_ctl(ws.epfd, EPOLL_CTL_ADD, self->to_worker.efd, &ev);
+    chat_log(LOG_INFO, "Worker %d started.", getpid());
+
+    for (;;) {
+        int timeout = ws.nblocked ? WK_RETRY_MS : ws.ncongested ? WK_SWEEP_MS : -1;
+        int n = epoll_wait(ws.epfd, evs, WK_EVENTS, timeout);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            chat_log(LOG_ERR, "Worker %d: epoll_wait failed: %m", getpid());
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            uint64_t tag = evs[i].data.u64;
+            if (tag == WK_TAG_CTL) {
+                if (ctl_recv() == -1) goto out;
+                continue;
+            }
+            if (tag == WK_TAG_RING) {
+                ring_drain();
+                continue;
+            }
+            wconn_t *c = ws.conns[tag];
+            if (c == NULL) continue;
+            // 읽기를 멈춘 동안에도 끊김은 계속 알려 오므로 바로 닫는다
+            if ((evs[i].events & (EPOLLHUP | EPOLLERR)) && (c->paused || c->blocked)) {
+                conn_close(c, WCTL_CLOSE);
+                continue;
+            }
+            if (evs[i].events & EPOLLOUT) {
+                conn_flush(c);
+                if (ws.conns[tag] != c) continue;
+            }
+            if (evs[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) conn_read(c);
+        }
+        // 링이 비면 다시 넣어 본다 (부모가 링을 비웠다는 알림은 없다)
+        if (ws.nblocked) {
+            for (uint32_t k = 0; k < ws.cap; k++) {
+                if (ws.conns[k] && ws.conns[k]->blocked) conn_retry(ws.conns[k]);
+            }
+        }
+        flush_dirty();
+        if (ws.ncongested) flow_sweep();
+        if (ws.notify_parent) {
+            ws.notify_parent = false;
+            shm_chan_notify(&self->to_parent);
+        }
+    }
+out:
+    chat_log(LOG_INFO, "Worker %d exiting.", getpid());
+    exit(0);
+}
+
+// =====================================================================
+// 부모 쪽
+// =====================================================================
+
+static int worker_spawn(worker_t *w)
+{
+    int sv[2];
+
+    // SEQPACKET 이라 알림 하나가 레코드 하나로 오고, SCM_RIGHTS 로 소켓을 같이 넘길 수 있다
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == -1) {
+        chat_log(LOG_ERR, "Parent: socketpair for worker failed: %m");
+        return -1;
+    }
+    if (shm_chan_open_size(&w->to_worker, WORKER_RING_SIZE) == -1) goto fail_sock;
+    if (shm_chan_open_size(&w->to_parent, WORKER_RING_SIZE) == -1) goto fail_chan;
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        chat_log(LOG_ERR, "Parent: fork for worker failed: %m");
+        shm_chan_close(&w->to_parent);
+        goto fail_chan;
+    }
+    if (pid == 0) {
+        // 부모의 소켓과 다른 작업자의 링/제어 소켓은 쓰지 않는다
+        // 부모가 막아 둔 SIGTERM 도 되돌린다 (pool_stop() 과 PDEATHSIG 로 끝나야 한다)
+        notify_forget(&parent_notify);
+        cluster_forget();
+        close(sv[0]);
+        if (pool.ssock >= 0) close(pool.ssock);
+        if (pool.mfd >= 0) close(pool.mfd);
+        for (int i = 0; i < WORKER_MAX; i++) {
+            worker_t *o = &pool.w[i];
+            if (o == w || o->pid <= 0) continue;
+            close(o->ctl);
+            shm_chan_close(&o->to_worker);
+            shm_chan_close(&o->to_parent);
+        }
+        worker_main(w, sv[1]);
+    }
+
+    close(sv[1]);
+    set_nonblocking(sv[0]);
+    w->pid = pid;
+    w->ctl = sv[0];
+    w->nconn = 0;
+    // 부모는 어느 작업자의 링/제어 소켓인지 note 로 바로 안다
+    if (notify_add(&parent_notify, &w->ring_note, NOTE_WORKER_RING, w->to_parent.efd) == -1 ||
+        notify_add(&parent_notify, &w->ctl_note, NOTE_WORKER_CTL, w->ctl) == -1) {
+        chat_log(LOG_ERR, "Parent: cannot watch worker %d: %m", pid);
+    }
+    return 0;
+
+fail_chan:
+    shm_chan_close(&w->to_worker);
+fail_sock:
+    close(sv[0]);
+    close(sv[1]);
+    return -1;
+}
+
+static void worker_release(worker_t *w)
+{
+    notify_del(&parent_notify, &w->ring_note);
+    notify_del(&parent_notify, &w->ctl_note);
+    if (w->ctl >= 0) close(w->ctl);
+    shm_chan_close(&w->to_worker);
+    shm_chan_close(&w->to_parent);
+    w->ctl = -1;
+    w->pid = 0;
+    w->nconn = 0;
+}
+
+int pool_start(int ssock, int mfd)
+{
+    const char *v = getenv(WORKERS_ENV);
+    int n = v ? atoi(v) : 0;
+
+    if (n <= 0) return 0;
+    if (n > WORKER_MAX) n = WORKER_MAX;
+    pool.ssock = ssock;
+    pool.mfd = mfd;
+    for (int i = 0; i < n; i++) {
+        pool.w[i].ctl = -1;
+        pool.w[i].ring_note.fd = -1;
+        pool.w[i].ctl_note.fd = -1;
+        if (worker_spawn(&pool.w[i]) == -1) {
+            pool.n = i;
+            pool_stop();
+            return -1;
+        }
+    }
+    pool.n = n;
+    chat_log(LOG_INFO, "Parent: started %d workers.", n);
+    return n;
+}
+
+void pool_stop(void)
+{
+    for (int i = 0; i < pool.n; i++) {
+        pid_t pid = pool.w[i].pid;
+        worker_release(&pool.w[i]);
+        if (pid > 0 && kill(pid, SIGTERM) == 0) waitpid(pid, NULL, 0);
+    }
+    pool.n = 0;
+}
+
+void pool_hold(bool hold)
+{
+    for (int i = 0; i < pool.n; i++) notify_pause(&parent_notify, &pool.w[i].ring_note, hold);
+}
+
+int pool_assign(int csock, pipeInfo *child)
+{
+    worker_t *w = NULL;
+    for (int i = 0; i < pool.n; i++) {
+        if (pool.w[i].pid <= 0) continue;   // 다시 띄우지 못한 작업자
+        if (w == NULL || pool.w[i].nconn < w->nconn) w = &pool.w[i];
+    }
+    if (w == NULL) return -1;
+
+    slab_handle_t h = slab_handle(child);
+    worker_ctl_t m = { .kind = WCTL_OPEN, .idx = h.idx, .gen = h.gen };
+    char cbuf[CMSG_SPACE(sizeof(int))] = {0};
+    struct iovec iov = { .iov_base = &m, .iov_len = sizeof(m) };
+    struct msghdr mh = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = cbuf, .msg_controllen = sizeof(cbuf) };
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&mh);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cm), &csock, sizeof(int));
+
+    if (sendmsg(w->ctl, &mh, MSG_NOSIGNAL) != sizeof(m)) {
+        chat_log(LOG_ERR, "Parent: cannot hand connection to worker %d: %m", w->pid);
+        return -1;
+    }
+    child->worker = w;
+    child->pid = w->pid;
+    w->nconn++;
+    return 0;
+}
+
+int pool_push(pipeInfo *child, const void *data, uint32_t len, bool notify)
+{
+    char rec[sizeof(worker_hdr_t) + FRAME_MAX];
+    slab_handle_t h = slab_handle(child);
+    worker_hdr_t hdr = { .idx = h.idx, .gen = h.gen };
+
+    if (len > FRAME_MAX) len = FRAME_MAX;
+    memcpy(rec, &hdr, sizeof(hdr));
+    memcpy(rec + sizeof(hdr), data, len);
+    if (shm_ring_push(child->worker->to_worker.ring, rec, sizeof(hdr) + len) == -1) return -1;
+    if (notify) shm_chan_notify(&child->worker->to_worker);
+    return 0;
+}
+
+void pool_ctl(pipeInfo *child, uint32_t kind)
+{
+    slab_handle_t h = slab_handle(child);
+    worker_ctl_t m = { .kind = kind, .idx = h.idx, .gen = h.gen };
+
+    if (send(child->worker->ctl, &m, sizeof(m), MSG_NOSIGNAL) != sizeof(m)) {
+        chat_log(LOG_WARNING, "Parent: cannot notify worker %d (kind %u): %m", child->worker->pid, kind);
+    }
+}
+
+int pool_pop(worker_t *w, pipeInfo **child, char *buf, uint32_t cap)
+{
+    worker_hdr_t hdr;
+    int n = shm_ring_pop(w->to_parent.ring, buf, cap);
+
+    *child = NULL;
+    if (n < 0) return -1;
+    if ((size_t)n < sizeof(hdr)) return 0;
+    memcpy(&hdr, buf, sizeof(hdr));
+    n -= sizeof(hdr);
+    memmove(buf, buf + sizeof(hdr), n);
+
+    pipeInfo *c = slab_get(&active_children, (slab_handle_t){ .idx = hdr.idx, .gen = hdr.gen });
+    if (c != NULL && c->worker == w) *child = c;
+    return n;
+}
+
+void pool_read_ctl(worker_t *w, void (*on_close)(pipeInfo *child))
+{
+    worker_ctl_t m;
+
+    for (;;) {
+        ssize_t n = recv(w->ctl, &m, sizeof(m), MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;   // 비었거나, 작업자가 죽었으면 SIGCHLD 때 정리한다
+        if (n != sizeof(m)) continue;
+
+        pipeInfo *c = slab_get(&active_children, (slab_handle_t){ .idx = m.idx, .gen = m.gen });
+        if (c == NULL || c->worker != w) continue;
+        switch (m.kind) {
+        case WCTL_CONGESTED:
+        case WCTL_RELIEVED:
+            // room_saturated() 가 보는 값. 시각과 퇴출 판정은 작업자가 한다
+            c->flow.congested = (m.kind == WCTL_CONGESTED);
+            break;
+        case WCTL_EVICTED:
+            chat_log(LOG_WARNING, "Parent: worker %d evicted slow client '%s'.", w->pid, c->name);
+            metrics_inc(MET_CONN_EVICTED);
+            /* fall through */
+        case WCTL_CLOSE:
+            w->nconn--;
+            on_close(c);
+            break;
+        }
+    }
+}
+
+bool pool_reap(pid_t pid)
+{
+    worker_t *w = NULL;
+    for (int i = 0; i < pool.n; i++) {
+        if (pool.w[i].pid == pid) w = &pool.w[i];
+    }
+    if (w == NULL) return false;
+
+    chat_log(LOG_ERR, "Parent: worker %d died with %u connections, restarting it.", pid, w->nconn);
+    slab_for_each(&active_children, pipeInfo, child) {
+        if (child->worker == w) remove_child(child);
+    }
+    worker_release(w);
+    if (worker_spawn(w) == -1) {
+        chat_log(LOG_ERR, "Parent: cannot restart worker, %d left.", pool.n - 1);
+    }
+    return true;
+}
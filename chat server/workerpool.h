@@ -0,0 +1,80 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include "comm.h"
+#include "frame.h"
+
+// --- 매크로 정의 ---
+// 미리 띄워 두는 작업자 프로세스 수 (0 이거나 없으면 예전처럼 접속마다 fork() 한다)
+#define WORKERS_ENV       "CHAT_WORKERS"
+#define WORKER_MAX        64
+#define WORKER_RING_SIZE  (256 * 1024)  // 작업자 하나의 연결들이 함께 쓰는 링이라 접속당 링보다 크게 잡는다
+#define WORKER_DRAIN_BATCH 64            // 부모가 한 회차에 작업자 링에서 꺼내는 최대 레코드 수
+
+// --- 구조체 정의 ---
+// 링 레코드 머리말 : 어느 연결의 메시지인지 (부모 active_children 의 칸 번호 + 세대)
+// 부모 -> 작업자, 작업자 -> 부모 모두 [머리말][메시지 내용] 이다
+typedef struct {
+    uint32_t idx;
+    uint32_t gen;
+} worker_hdr_t;
+
+// 제어 소켓 (SOCK_SEQPACKET) 으로 주고받는 알림
+// 출력 큐는 작업자에 있으므로 느린 클라이언트 판정(워터마크, 퇴출)도 작업자가 하고 부모에게 알린다
+enum {
+    WCTL_OPEN,                   // 부모 -> 작업자 : 새 연결 (SCM_RIGHTS 로 소켓이 같이 간다)
+    WCTL_CLOSE,                  // 부모 -> 작업자 : 퇴출, 작업자 -> 부모 : 연결이 닫혔다
+    WCTL_PAUSE,                  // 부모 -> 작업자 : 이 연결의 소켓을 잠시 읽지 않는다
+    WCTL_RESUME,                 // 부모 -> 작업자 : 다시 읽는다
+    WCTL_CONGESTED,              // 작업자 -> 부모 : 출력 큐가 high 를 넘었다
+    WCTL_RELIEVED,               // 작업자 -> 부모 : 출력 큐가 low 밑으로 내려갔다
+    WCTL_EVICTED,                // 작업자 -> 부모 : 너무 느려서 닫았다 (WCTL_CLOSE 와 같게 정리)
+};
+
+typedef struct {
+    uint32_t kind;
+    uint32_t idx;
+    uint32_t gen;
+} worker_ctl_t;
+
+// 부모가 관리하는 작업자 하나
+typedef struct worker {
+    pid_t pid;
+    int ctl;                     // 제어 소켓의 부모 쪽 끝 (논블로킹)
+    shm_chan_t to_worker;        // 부모 -> 작업자 링
+    shm_chan_t to_parent;        // 작업자 -> 부모 링
+    uint32_t nconn;              // 맡긴 연결 수 (가장 적은 작업자에게 새 연결을 준다)
+    note_t ring_note;            // to_parent 초인종과 제어 소켓을 부모 epoll 에 건 것
+    note_t ctl_note;
+} worker_t;
+
+typedef struct {
+    worker_t w[WORKER_MAX];
+    int n;                       // 0 : 작업자 풀을 쓰지 않는다
+    int ssock;                   // 작업자를 다시 띄울 때 자식에서 닫을 부모 소켓들
+    int mfd;
+} worker_pool_t;
+
+extern worker_pool_t pool;
+
+// --- 부모 쪽 함수 ---
+// CHAT_WORKERS 개의 작업자를 띄운다. 설정이 없으면 0, 실패하면 -1
+int pool_start(int ssock, int mfd);
+void pool_stop(void);
+// 가장 한가한 작업자에게 소켓을 넘긴다. 넘겼으면 부모는 csock 을 닫아도 된다
+int pool_assign(int csock, pipeInfo *child);
+// 자식 링 대신 그 연결의 작업자 링에 넣는다. 자리가 없으면 -1
+// notify 가 false 면 초인종은 누르지 않는다 (여러 개를 넣은 뒤 한 번만 누를 때)
+int pool_push(pipeInfo *child, const void *data, uint32_t len, bool notify);
+// 작업자에게 WCTL_CLOSE/PAUSE/RESUME 을 알린다
+void pool_ctl(pipeInfo *child, uint32_t kind);
+// 부모가 작업자 링을 잠시 읽지 않을 때 (hold) 초인종 알림을 끈다
+void pool_hold(bool hold);
+// 작업자 링에서 레코드 하나를 꺼낸다. 연결이 아직 살아 있으면 *child 에 넣는다
+int pool_pop(worker_t *w, pipeInfo **child, char *buf, uint32_t cap);
+// 제어 소켓에 온 알림을 처리한다. 혼잡 알림은 child->flow 에 옮기고, 닫힌 연결마다 on_close 를 부른다
+void pool_read_ctl(worker_t *w, void (*on_close)(pipeInfo *child));
+// SIGCHLD 로 거둔 pid 가 작업자였으면 그 연결들을 정리하고 새로 띄운 뒤 true
+bool pool_reap(pid_t pid);
+
+#endif //WORKERPOOL_H